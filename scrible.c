@@ -8,21 +8,102 @@
  * Compile: gcc -o scrible scrible.c `pkg-config --cflags --libs gtk+-3.0 gtksourceview-3.0`
  */
 
+#define _GNU_SOURCE           /* sched_setaffinity for Benchmark Run */
 #include <gtk/gtk.h>
 #include <string.h>
 #include <ctype.h>
+#include <math.h>
 #include <time.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <errno.h>
+#include <stdarg.h>
+#include <glib/gstdio.h>
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wdeprecated-declarations"
 #include <gtksourceview/gtksource.h>
 #pragma GCC diagnostic pop
+#include "scrible_core.h"
+
+/* Installed snippets.conf location, set by the Makefile */
+#ifndef SCRIBLE_DATADIR
+#define SCRIBLE_DATADIR "/usr/local/share/scrible"
+#endif
+
+/* One snippet from snippets.conf; all strings live in SnippetTable.strings */
+typedef struct {
+    const gchar *trigger;
+    const gchar *menu;        /* interned Insert submenu name, NULL = top level */
+    const gchar *label;
+    const gchar *body;
+    gboolean separator;
+} Snippet;
+
+typedef struct {
+    GStringChunk *strings;
+    Snippet *items;            /* file order, used to build the menus */
+    guint n_items;
+    const Snippet **by_trigger;/* sorted by trigger */
+    guint first[257];          /* by_trigger bucket start per first byte */
+} SnippetTable;
+
+/* Tab stop of an expanded snippet, offsets are in characters */
+typedef struct {
+    gint index;
+    glong start;
+    glong end;
+} SnippetStopSpec;
+
+typedef struct {
+    GtkTextMark *start;
+    GtkTextMark *end;
+} SnippetStop;
+
+enum {
+    LATENCY_KEY_TO_PAINT,
+    LATENCY_INSERT_TEXT,
+    LATENCY_DELETE_RANGE,
+    LATENCY_MARK_SET,
+    LATENCY_LAYOUT,
+    LATENCY_PAINT,
+    N_LATENCY
+};
+
+/* Editing latency histograms in microseconds, allocated only when enabled */
+typedef struct {
+    sc_histogram hist[N_LATENCY];
+    gint64 start[N_LATENCY];  /* open measurement per metric, 0 = none */
+    GtkWidget *hud;
+    guint hud_timeout;
+} LatencyStats;
+
+/* Command palette entry: a menu item, a snippet or a symbol line */
+typedef struct {
+    gchar *label;
+    gchar *folded;            /* lowercase text matched against the query */
+    guint64 mask;             /* characters present in folded */
+    GtkWidget *item;
+    const Snippet *snippet;
+    gint line;
+} PaletteEntry;
 
 typedef struct {
     GtkWidget *window;
     GtkWidget *view;
     GtkSourceBuffer *buffer;
     GtkWidget *status_label;
+    guint status_tick;        /* pending status bar refresh, 0 = none */
+    gint status_line;         /* fields the label currently shows */
+    gint status_col;
+    gint status_total;
+    gboolean status_focus;
+    gboolean long_lines;      /* long-line mode: soft break newlines split long lines */
+    GArray *soft_breaks;      /* gint char offsets of the soft breaks, ascending */
+    GList *soft_break_cuts;   /* SoftBreakCut of recent deletions, newest first */
+    gboolean soft_break_undo; /* inside an undo or redo */
     GtkWidget *tree_view;
     GtkWidget *tree_scroll;
     GtkTreeStore *tree_store;
@@ -37,6 +118,42 @@ typedef struct {
     gboolean focus_mode;
     GList *bookmarks; 
     GtkWidget *search_bar;
+    gchar *pending_file;      /* file from argv, loaded once the window is painted */
+    gint pending_line;
+    GApplication *instance;   /* single-instance mode: owns the bus name */
+    SnippetTable *snippets;
+    struct WordIndex *words;  /* identifier counts behind completion */
+    GtkWidget *menubar;
+    GArray *commands;         /* PaletteEntry for every menu action */
+    GtkWidget *editor_overlay;
+    GtkWidget *latency_item;
+    LatencyStats *latency;    /* NULL unless latency instrumentation is on */
+    FILE *record_file;        /* --record script, NULL when not recording */
+    gint64 record_start;
+    gboolean record_muted;    /* action already recorded by the palette */
+    struct ReplayState *replay;
+    struct ProfileData *profile;  /* last Profile & Run result */
+    GtkSourceGutterRenderer *heat_renderer;
+    gchar *build_flags;       /* last Build Options flags, NULL = DEFAULT_BUILD_FLAGS */
+    GtkWidget *editor_paned;  /* editor | Assembly View */
+    struct AsmView *asm_view; /* NULL until first shown */
+    struct Minimap *minimap;
+    struct BraceIndex *braces;  /* brace and #if structure, folds */
+    struct Semantic *semantic;  /* viewport identifier classes */
+    struct ProjectIndex *project;  /* NULL until a file is opened */
+    struct Tags *tags;        /* ctags file near the open file */
+    GtkWidget *sidebar;       /* notebook: Symbols, Files */
+    struct FileTree *files;
+    struct QuickOpen *quick;
+    struct FileWatch *watch;  /* the open file on disk */
+    GArray *snippet_stops;    /* SnippetStop of the snippet being filled in */
+    guint snippet_stop;
+    gboolean startup_stats;
+    gint64 t_start;           /* startup phase timestamps (g_get_monotonic_time) */
+    gint64 t_gtk_init;
+    gint64 t_ui_built;
+    gint64 t_first_paint;
+    gint64 t_file_loaded;
 } EditorApp;
 
 enum {
@@ -45,6 +162,7 @@ enum {
     NUM_COLS
 };
 
+
 /* Helper struct for build dialog callbacks */
 typedef struct {
     GtkWidget *output_entry;
@@ -70,7 +188,189 @@ static void on_change_font(GtkWidget *widget, gpointer data);
 static void insert_at_cursor(EditorApp *app, const gchar *text); 
 static void on_bookmark_list_row_activated(GtkTreeView *tree_view, GtkTreePath *path, 
                                           GtkTreeViewColumn *column, gpointer data); 
+static gboolean load_file(EditorApp *app, const gchar *filename);
+static void jump_to_line(EditorApp *app, gint line);
+static gchar *get_save_text(EditorApp *app);
+static gboolean tags_lookup(EditorApp *app, const gchar *name, GArray *found);
+static void file_tree_open_file(EditorApp *app, const gchar *filename);
+static void file_watch_start(EditorApp *app, const gchar *path, const gchar *text, gssize len);
+static void file_watch_stop(EditorApp *app);
+static gboolean file_watch_confirm_save(EditorApp *app);
+static void show_build_matrix_dialog(EditorApp *app, const gchar *flags, const gchar *linker);
+static void asm_view_refresh(EditorApp *app);
+static void minimap_markers_changed(EditorApp *app);
                                           
+/*
+ * Tracing
+ * Spans are recorded as begin/end events into a ring buffer owned by the
+ * calling thread, so recording takes no lock: only the owner writes a ring
+ * and publishes its head with a release store. Rings are pushed once onto a
+ * lock-free list that the exporter walks; when a thread exits its ring is
+ * marked free and taken over by the next new thread, so short-lived
+ * workers do not each leave a ring behind. When the ring wraps, the oldest
+ * events are overwritten; the owner announces each slot before rewriting it
+ * (a sequence counter), so the exporter copies a ring and then drops the
+ * events that may have changed under the copy. With tracing off,
+ * TRACE_BEGIN/END is one atomic load and a branch.
+ */
+#define TRACE_RING_SIZE 16384   /* events per thread, power of two */
+
+typedef struct {
+    const gchar *name;        /* static string */
+    gint64 ts;                /* g_get_monotonic_time() */
+    gchar phase;              /* 'B' or 'E' */
+} TraceEvent;
+
+typedef struct TraceRing {
+    TraceEvent events[TRACE_RING_SIZE];
+    guint64 head;             /* events written, owner thread stores with release */
+    guint64 claimed;          /* events whose slot may have been written, head or head + 1 */
+    gint tid;
+    gchar name[32];
+    gint free;                /* g_atomic_int: the owner thread exited */
+    struct TraceRing *next;
+} TraceRing;
+
+static gint trace_enabled = FALSE;     /* g_atomic_int: set on the UI thread, read by workers */
+static gint64 trace_epoch;
+static TraceRing *trace_rings = NULL;   /* all rings, newest first */
+static gint trace_next_tid = 1;
+
+/* Thread exit: the events stay exportable, the ring goes to the next thread that records */
+static void trace_ring_release(gpointer data) {
+    g_atomic_int_set(&((TraceRing *)data)->free, TRUE);
+}
+
+static GPrivate trace_ring = G_PRIVATE_INIT(trace_ring_release);
+
+static TraceRing *trace_thread_ring(void) {
+    TraceRing *ring = g_private_get(&trace_ring);
+    
+    if (G_LIKELY(ring)) return ring;
+    for (ring = g_atomic_pointer_get(&trace_rings); ring; ring = ring->next)
+        if (g_atomic_int_compare_and_exchange(&ring->free, TRUE, FALSE)) break;
+    if (ring) {
+        /* Same track in the export: the previous owner's events come first */
+        g_snprintf(ring->name, sizeof(ring->name), "thread %d", ring->tid);
+    } else {
+        ring = g_new0(TraceRing, 1);
+        ring->tid = g_atomic_int_add(&trace_next_tid, 1);
+        g_snprintf(ring->name, sizeof(ring->name), "thread %d", ring->tid);
+        do {
+            ring->next = g_atomic_pointer_get(&trace_rings);
+        } while (!g_atomic_pointer_compare_and_exchange(&trace_rings, ring->next, ring));
+    }
+    g_private_set(&trace_ring, ring);
+    return ring;
+}
+
+static void trace_record(const gchar *name, gchar phase) {
+    TraceRing *ring = trace_thread_ring();
+    guint64 head = ring->head;
+    TraceEvent *ev = &ring->events[head & (TRACE_RING_SIZE - 1)];
+    
+    /* Claim the slot before overwriting it, and order the claim before the event's stores */
+    __atomic_store_n(&ring->claimed, head + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    ev->name = name;
+    ev->ts = g_get_monotonic_time();
+    ev->phase = phase;
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+}
+
+#define TRACE_BEGIN(name) do { if (G_UNLIKELY(g_atomic_int_get(&trace_enabled))) trace_record((name), 'B'); } while (0)
+#define TRACE_END(name)   do { if (G_UNLIKELY(g_atomic_int_get(&trace_enabled))) trace_record((name), 'E'); } while (0)
+
+/* Name the calling thread's track in the exported trace */
+static void trace_set_thread_name(const gchar *name) {
+    TraceRing *ring = trace_thread_ring();
+    g_strlcpy(ring->name, name, sizeof(ring->name));
+}
+
+static void trace_start(void) {
+    if (g_atomic_int_get(&trace_enabled)) return;
+    if (trace_epoch == 0) trace_epoch = g_get_monotonic_time();
+    trace_set_thread_name("main");
+    g_atomic_int_set(&trace_enabled, TRUE);
+}
+
+static void trace_stop(void) {
+    g_atomic_int_set(&trace_enabled, FALSE);
+}
+
+/*
+ * Copy of the events a ring still holds, oldest first. Writers may keep
+ * appending: any event whose slot was claimed for a newer one while it was
+ * copied is dropped. Returns the number of events in copy.
+ */
+static guint trace_ring_snapshot(TraceRing *ring, TraceEvent *copy, guint64 *first) {
+    guint64 head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    guint64 start = head > TRACE_RING_SIZE ? head - TRACE_RING_SIZE : 0;
+    
+    for (guint64 i = start; i < head; i++)
+        copy[i - start] = ring->events[i & (TRACE_RING_SIZE - 1)];
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    guint64 claimed = __atomic_load_n(&ring->claimed, __ATOMIC_RELAXED);
+    /* Slot i is rewritten by event i + TRACE_RING_SIZE, claimed before its stores */
+    guint64 valid = claimed > TRACE_RING_SIZE ? claimed - TRACE_RING_SIZE : 0;
+    if (valid <= start) valid = start;
+    if (valid > head) valid = head;
+    *first = valid - start;
+    return (guint)(head - valid);
+}
+
+/* Chrome trace-event JSON of every ring, loadable in chrome://tracing or Perfetto */
+static gboolean trace_write_json(const gchar *path, GError **error) {
+    GString *json = g_string_new("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    gint pid = getpid();
+    gboolean first = TRUE;
+    TraceEvent *copy = g_new(TraceEvent, TRACE_RING_SIZE);
+    
+    for (TraceRing *ring = g_atomic_pointer_get(&trace_rings); ring; ring = ring->next) {
+        guint64 skip;
+        guint count = trace_ring_snapshot(ring, copy, &skip);
+        gchar *thread_name = g_strescape(ring->name, NULL);
+        
+        g_string_append_printf(json, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,"
+                               "\"args\":{\"name\":\"%s\"}}", first ? "" : ",\n", pid, ring->tid, thread_name);
+        first = FALSE;
+        g_free(thread_name);
+        
+        for (guint i = 0; i < count; i++) {
+            const TraceEvent *ev = &copy[skip + i];
+            gchar *name = g_strescape(ev->name, NULL);
+            g_string_append_printf(json, ",\n{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%" G_GINT64_FORMAT
+                                   ",\"pid\":%d,\"tid\":%d}", name, ev->phase, ev->ts - trace_epoch,
+                                   pid, ring->tid);
+            g_free(name);
+        }
+    }
+    g_string_append(json, "\n]}\n");
+    g_free(copy);
+    
+    gboolean ok = g_file_set_contents(path, json->str, json->len, error);
+    g_string_free(json, TRUE);
+    return ok;
+}
+
+/*
+ * Session recording (--record FILE)
+ * One action per line: "<ms since start> <verb> <args>", see replay_parse_line()
+ */
+static void record_action(EditorApp *app, const gchar *format, ...) G_GNUC_PRINTF(2, 3);
+
+static void record_action(EditorApp *app, const gchar *format, ...) {
+    va_list args;
+    
+    if (!app->record_file) return;
+    fprintf(app->record_file, "%" G_GINT64_FORMAT " ",
+            (g_get_monotonic_time() - app->record_start) / 1000);
+    va_start(args, format);
+    vfprintf(app->record_file, format, args);
+    va_end(args);
+    fputc('\n', app->record_file);
+}
+
 /* Toggle bookmark on current line */
 static void on_toggle_bookmark(GtkWidget *widget, gpointer data) {
     EditorApp *app = (EditorApp *)data;
@@ -112,6 +412,7 @@ static void on_toggle_bookmark(GtkWidget *widget, gpointer data) {
     }
     
     update_status(app);
+    minimap_markers_changed(app);
 }
 
 /* Go to next bookmark */
@@ -225,6 +526,7 @@ static void on_clear_all_bookmarks(GtkWidget *widget, gpointer data) {
     
     g_print("All bookmarks cleared\n");
     update_status(app);
+    minimap_markers_changed(app);
 }
 
 /* List all bookmarks in a dialog */
@@ -284,7 +586,7 @@ static void on_list_bookmarks(GtkWidget *widget, gpointer data) {
             gtk_text_iter_forward_to_line_end(&line_end);
         }
         gchar *line_text = gtk_text_buffer_get_text(GTK_TEXT_BUFFER(app->buffer), 
-                                                    &line_start, &line_end, FALSE);
+                                                    &line_start, &line_end, TRUE);
         
         // Trim whitespace and limit length
         gchar *trimmed = g_strstrip(g_strdup(line_text));
@@ -378,7 +680,7 @@ static void on_duplicate_line(GtkWidget *widget, gpointer data) {
     }
     
     // Copy the line text
-    gchar *line = gtk_text_buffer_get_text(GTK_TEXT_BUFFER(app->buffer), &start, &end, FALSE);
+    gchar *line = gtk_text_buffer_get_text(GTK_TEXT_BUFFER(app->buffer), &start, &end, TRUE);
     
     // Insert newline and duplicate line
     gtk_text_buffer_begin_user_action(GTK_TEXT_BUFFER(app->buffer));
@@ -532,9 +834,8 @@ static void on_color_picker(GtkWidget *widget, gpointer data) {
 // View: Toggle Sidebar (Tree View)
 static void on_toggle_sidebar(GtkWidget *widget, gpointer data) {
     EditorApp *app = (EditorApp *)data;
-    GtkWidget *tree_scroll = gtk_widget_get_parent(app->tree_view);
-    gboolean visible = gtk_widget_get_visible(tree_scroll);
-    gtk_widget_set_visible(tree_scroll, !visible);
+    gboolean visible = gtk_widget_get_visible(app->sidebar);
+    gtk_widget_set_visible(app->sidebar, !visible);
 }
 
 // Format: Strip Trailing Whitespace
@@ -542,15 +843,14 @@ static void on_strip_trailing(GtkWidget *widget, gpointer data) {
     EditorApp *app = (EditorApp *)data;
     GtkTextIter start, end;
     gtk_text_buffer_get_bounds(GTK_TEXT_BUFFER(app->buffer), &start, &end);
-    gchar *text = gtk_text_buffer_get_text(GTK_TEXT_BUFFER(app->buffer), &start, &end, FALSE);
+    gchar *text = gtk_text_buffer_get_text(GTK_TEXT_BUFFER(app->buffer), &start, &end, TRUE);
     
-    // Simple regex-like logic: remove spaces before newlines
-    GRegex *regex = g_regex_new("[ \t]+$", G_REGEX_MULTILINE, 0, NULL);
-    gchar *result = g_regex_replace(regex, text, -1, 0, "", 0, NULL);
+    // Remove spaces and tabs before newlines, in place
+    size_t len = sc_strip_trailing(text, strlen(text), text);
     
-    gtk_text_buffer_set_text(GTK_TEXT_BUFFER(app->buffer), result, -1);
+    gtk_text_buffer_set_text(GTK_TEXT_BUFFER(app->buffer), text, len);
     
-    g_free(text); g_free(result); g_regex_unref(regex);
+    g_free(text);
 }
 
 
@@ -580,6 +880,9 @@ static void update_build_preview(GtkWidget *widget, gpointer user_data) {
     g_free(markup);
 }
 
+#define BUILD_RESPONSE_MATRIX 1   /* Build Options: open the Optimization Matrix */
+#define DEFAULT_BUILD_FLAGS   "-Wall -Wextra -g"
+
 /* Build: Compile & Run with custom options */
 static void on_build_run(GtkWidget *widget, gpointer data) {
     EditorApp *app = (EditorApp *)data;
@@ -599,6 +902,7 @@ static void on_build_run(GtkWidget *widget, gpointer data) {
     GtkWidget *dialog = gtk_dialog_new_with_buttons("Build Options",
                                          GTK_WINDOW(app->window),
                                          GTK_DIALOG_MODAL | GTK_DIALOG_DESTROY_WITH_PARENT,
+                                         "_Matrix...", BUILD_RESPONSE_MATRIX,
                                          "_Cancel", GTK_RESPONSE_CANCEL,
                                          "_Build & Run", GTK_RESPONSE_ACCEPT,
                                          NULL);
@@ -633,7 +937,7 @@ static void on_build_run(GtkWidget *widget, gpointer data) {
     GtkWidget *flags_label = gtk_label_new("Compiler Flags:");
     gtk_widget_set_halign(flags_label, GTK_ALIGN_END);
     GtkWidget *flags_entry = gtk_entry_new();
-    gtk_entry_set_text(GTK_ENTRY(flags_entry), "-Wall -Wextra -g");
+    gtk_entry_set_text(GTK_ENTRY(flags_entry), app->build_flags ? app->build_flags : DEFAULT_BUILD_FLAGS);
     gtk_entry_set_placeholder_text(GTK_ENTRY(flags_entry), "e.g., -Wall -O2 -std=c99");
     
     /* Linker flags */
@@ -697,6 +1001,11 @@ static void on_build_run(GtkWidget *widget, gpointer data) {
         const gchar *flags = gtk_entry_get_text(GTK_ENTRY(flags_entry));
         const gchar *linker = gtk_entry_get_text(GTK_ENTRY(linker_entry));
         
+        /* Remembered for the next build and the Assembly View */
+        g_free(app->build_flags);
+        app->build_flags = g_strdup(flags);
+        asm_view_refresh(app);
+        
         /* Build command */
         gchar *compile_cmd = g_strdup_printf("gcc %s %s %s -o %s",
                                             flags && *flags ? flags : "",
@@ -709,12 +1018,16 @@ static void on_build_run(GtkWidget *widget, gpointer data) {
         g_print("\n=== Building ===\n");
         g_print("Command: %s\n", compile_cmd);
         
+        TRACE_BEGIN("build: compile");
         int compile_result = system(compile_cmd);
+        TRACE_END("build: compile");
         
         if (compile_result == 0) {
             g_print("\n=== Build Successful ===\n");
             g_print("Running: %s\n\n", run_cmd);
+            TRACE_BEGIN("build: run");
             system(run_cmd);
+            TRACE_END("build: run");
             g_print("\n=== Program Finished ===\n");
         } else {
             g_print("\n=== Build Failed ===\n");
@@ -729,6 +1042,18 @@ static void on_build_run(GtkWidget *widget, gpointer data) {
         
         g_free(compile_cmd);
         g_free(run_cmd);
+    } else if (response == BUILD_RESPONSE_MATRIX) {
+        /* Hand the flags over to the matrix dialog, which replaces this one */
+        gchar *flags = g_strdup(gtk_entry_get_text(GTK_ENTRY(flags_entry)));
+        gchar *linker = g_strdup(gtk_entry_get_text(GTK_ENTRY(linker_entry)));
+        g_free(callback_data);
+        gtk_widget_destroy(dialog);
+        g_free(app->build_flags);
+        app->build_flags = g_strdup(flags);
+        show_build_matrix_dialog(app, flags, linker);
+        g_free(flags);
+        g_free(linker);
+        return;
     }
     
     g_free(callback_data);
@@ -754,438 +1079,4575 @@ static void on_quick_build(GtkWidget *widget, gpointer data) {
     gchar *cmd = g_strdup_printf("gcc -Wall -Wextra -g %s -o %s && ./%s",
                                  app->current_file, output, output);
     g_print("\n=== Quick Build ===\n%s\n\n", cmd);
+    TRACE_BEGIN("build: quick build & run");
     system(cmd);
+    TRACE_END("build: quick build & run");
     
     g_free(cmd);
     g_free(output);
 }
-// Tool 1: Word & Character Count
-static void on_word_count(GtkWidget *widget, gpointer data) {
-    EditorApp *app = (EditorApp *)data;
-    GtkTextIter start, end;
-    gtk_text_buffer_get_bounds(GTK_TEXT_BUFFER(app->buffer), &start, &end);
-    gchar *text = gtk_text_buffer_get_text(GTK_TEXT_BUFFER(app->buffer), &start, &end, FALSE);
-    
-    glong chars = g_utf8_strlen(text, -1);
-    gchar **words = g_strsplit_set(text, " \n\t\r", -1);
-    guint word_count = 0;
-    for (int i = 0; words[i] != NULL; i++) {
-        if (strlen(words[i]) > 0) word_count++;
+
+/*
+ * Profile & Run
+ * Builds with -O2 -g, runs the program under perf record (or gprof when
+ * perf is missing or not permitted) and reads the samples back per source
+ * line and per function. Lines of the open file get a heat gutter; all
+ * functions go into a sortable table.
+ */
+typedef struct {
+    gchar *name;
+    gdouble percent;          /* share of all samples, self time */
+    gint line;                /* first sampled line in the open file, 0 = elsewhere */
+} ProfileFunction;
+
+typedef struct ProfileData {
+    GArray *line_percent;     /* gdouble per line of the open file, index 0 unused */
+    gdouble max_percent;
+    GArray *functions;        /* ProfileFunction */
+    const gchar *tool;        /* "perf" or "gprof" */
+    GtkWidget *table_window;
+} ProfileData;
+
+static void profile_function_clear(gpointer data) {
+    g_free(((ProfileFunction *)data)->name);
+}
+
+static ProfileData *profile_data_new(const gchar *tool) {
+    ProfileData *profile = g_new0(ProfileData, 1);
+    profile->line_percent = g_array_new(FALSE, TRUE, sizeof(gdouble));
+    profile->functions = g_array_new(FALSE, TRUE, sizeof(ProfileFunction));
+    g_array_set_clear_func(profile->functions, profile_function_clear);
+    profile->tool = tool;
+    return profile;
+}
+
+static void profile_data_free(ProfileData *profile) {
+    if (!profile) return;
+    if (profile->table_window) gtk_widget_destroy(profile->table_window);
+    g_array_free(profile->line_percent, TRUE);
+    g_array_free(profile->functions, TRUE);
+    g_free(profile);
+}
+
+/* Add one sample row: function, "file:line" location and its percentage */
+static void profile_add(ProfileData *profile, const gchar *source_name, const gchar *func,
+                        const gchar *location, gdouble percent) {
+    gint line = 0;
+    const gchar *colon = location ? strrchr(location, ':') : NULL;
+    
+    if (colon && colon > location) {
+        gchar *path = g_strndup(location, colon - location);
+        gchar *file = g_path_get_basename(path);
+        if (strcmp(file, source_name) == 0) line = atoi(colon + 1);
+        g_free(file);
+        g_free(path);
+    }
+    if (line > 0) {
+        if ((guint)line >= profile->line_percent->len)
+            g_array_set_size(profile->line_percent, line + 1);
+        gdouble *p = &g_array_index(profile->line_percent, gdouble, line);
+        *p += percent;
+        profile->max_percent = MAX(profile->max_percent, *p);
     }
     
-    gchar *msg = g_strdup_printf("Analysis Complete:\n- Words: %u\n- Characters: %ld", word_count, chars);
-    GtkWidget *dialog = gtk_message_dialog_new(GTK_WINDOW(app->window),
-                        GTK_DIALOG_DESTROY_WITH_PARENT | GTK_DIALOG_MODAL,
-                        GTK_MESSAGE_INFO,
-                        GTK_BUTTONS_OK, "%s", msg);
-    gtk_dialog_run(GTK_DIALOG(dialog));
-    gtk_widget_destroy(dialog);  // Safe to destroy after gtk_dialog_run()
-    
-    g_free(msg); 
-    g_free(text); 
-    g_strfreev(words);
-}
-// Tool 2: Sort Selected Lines Alphabetically
-static void on_sort_selection(GtkWidget *widget, gpointer data) {
-    EditorApp *app = (EditorApp *)data;
-    GtkTextIter start, end;
-    if (gtk_text_buffer_get_selection_bounds(GTK_TEXT_BUFFER(app->buffer), &start, &end)) {
-        gchar *text = gtk_text_buffer_get_text(GTK_TEXT_BUFFER(app->buffer), &start, &end, FALSE);
-        gchar **lines = g_strsplit(text, "\n", -1);
-        
-        // Simple bubble sort for lines
-        int count = g_strv_length(lines);
-        for (int i = 0; i < count - 1; i++) {
-            for (int j = i + 1; j < count; j++) {
-                if (g_strcmp0(lines[i], lines[j]) > 0) {
-                    gchar *temp = lines[i];
-                    lines[i] = lines[j];
-                    lines[j] = temp;
-                }
-            }
+    for (guint i = 0; i < profile->functions->len; i++) {
+        ProfileFunction *f = &g_array_index(profile->functions, ProfileFunction, i);
+        if (strcmp(f->name, func) == 0) {
+            f->percent += percent;
+            if (line > 0 && (f->line == 0 || line < f->line)) f->line = line;
+            return;
         }
-        
-        gchar *sorted_text = g_strjoinv("\n", lines);
-        gtk_text_buffer_begin_user_action(GTK_TEXT_BUFFER(app->buffer));
-        gtk_text_buffer_delete(GTK_TEXT_BUFFER(app->buffer), &start, &end);
-        gtk_text_buffer_insert(GTK_TEXT_BUFFER(app->buffer), &start, sorted_text, -1);
-        gtk_text_buffer_end_user_action(GTK_TEXT_BUFFER(app->buffer));
-        
-        g_free(text); g_free(sorted_text); g_strfreev(lines);
-    }
-}
-// Convert Selection to Uppercase
-static void on_uppercase(GtkWidget *widget, gpointer data) {
-    EditorApp *app = (EditorApp *)data;
-    GtkTextIter start, end;
-    if (gtk_text_buffer_get_selection_bounds(GTK_TEXT_BUFFER(app->buffer), &start, &end)) {
-        gchar *text = gtk_text_buffer_get_text(GTK_TEXT_BUFFER(app->buffer), &start, &end, FALSE);
-        gchar *upper = g_utf8_strup(text, -1);
-        
-        gtk_text_buffer_begin_user_action(GTK_TEXT_BUFFER(app->buffer));
-        gtk_text_buffer_delete(GTK_TEXT_BUFFER(app->buffer), &start, &end);
-        gtk_text_buffer_insert(GTK_TEXT_BUFFER(app->buffer), &start, upper, -1);
-        gtk_text_buffer_end_user_action(GTK_TEXT_BUFFER(app->buffer));
-        
-        g_free(text); g_free(upper);
     }
+    ProfileFunction f = { g_strdup(func), percent, line };
+    g_array_append_val(profile->functions, f);
 }
 
-// Sort Lines Alphabetically
-static void on_sort_lines(GtkWidget *widget, gpointer data) {
-    EditorApp *app = (EditorApp *)data;
-    GtkTextIter start, end;
-    if (gtk_text_buffer_get_selection_bounds(GTK_TEXT_BUFFER(app->buffer), &start, &end)) {
-        gchar *text = gtk_text_buffer_get_text(GTK_TEXT_BUFFER(app->buffer), &start, &end, FALSE);
-        gchar **lines = g_strsplit(text, "\n", -1);
-        
-        // Basic bubble sort for the lines array
-        int count = g_strv_length(lines);
-        for (int i = 0; i < count - 1; i++) {
-            for (int j = i + 1; j < count; j++) {
-                if (g_strcmp0(lines[i], lines[j]) > 0) {
-                    gchar *tmp = lines[i]; lines[i] = lines[j]; lines[j] = tmp;
-                }
+/*
+ * perf report --stdio -F overhead,sym,srcline, rows like
+ *     12.34%  [.] busy_loop                  prog.c:42
+ */
+static void profile_parse_perf(ProfileData *profile, const gchar *source_name, const gchar *report) {
+    gchar **lines = g_strsplit(report, "\n", -1);
+    
+    for (gint i = 0; lines[i]; i++) {
+        gchar **tok = g_strsplit_set(g_strstrip(lines[i]), " \t", -1);
+        GPtrArray *words = g_ptr_array_new();
+        for (gint j = 0; tok[j]; j++)
+            if (*tok[j]) g_ptr_array_add(words, tok[j]);
+        
+        /* Only user space samples ("[.]"), kernel time is not in the source */
+        if (words->len >= 4 && g_str_has_suffix(words->pdata[0], "%") &&
+            strcmp(words->pdata[1], "[.]") == 0) {
+            gdouble percent = g_ascii_strtod(words->pdata[0], NULL);
+            const gchar *location = words->pdata[words->len - 1];
+            GString *func = g_string_new(NULL);
+            for (guint j = 2; j + 1 < words->len; j++) {
+                if (func->len) g_string_append_c(func, ' ');
+                g_string_append(func, words->pdata[j]);
             }
+            profile_add(profile, source_name, func->str, location, percent);
+            g_string_free(func, TRUE);
         }
-        
-        gchar *sorted = g_strjoinv("\n", lines);
-        gtk_text_buffer_begin_user_action(GTK_TEXT_BUFFER(app->buffer));
-        gtk_text_buffer_delete(GTK_TEXT_BUFFER(app->buffer), &start, &end);
-        gtk_text_buffer_insert(GTK_TEXT_BUFFER(app->buffer), &start, sorted, -1);
-        gtk_text_buffer_end_user_action(GTK_TEXT_BUFFER(app->buffer));
-        
-        g_strfreev(lines); g_free(text); g_free(sorted);
+        g_ptr_array_free(words, TRUE);
+        g_strfreev(tok);
     }
+    g_strfreev(lines);
 }
-static void on_toggle_focus_mode(GtkCheckMenuItem *item, gpointer data) {
-    EditorApp *app = (EditorApp *)data;
-    app->focus_mode = gtk_check_menu_item_get_active(item);
+
+/*
+ * gprof -b -l -p, line level flat profile rows like
+ *  60.00      0.06     0.06                             busy (prog.c:10 @ 401156)
+ */
+static void profile_parse_gprof(ProfileData *profile, const gchar *source_name, const gchar *report) {
+    gchar **lines = g_strsplit(report, "\n", -1);
     
-    if (!app->focus_mode) {
-        /* Remove the yellow highlight tag when turning off Focus Mode */
-        GtkTextIter start, end;
-        gtk_text_buffer_get_bounds(GTK_TEXT_BUFFER(app->buffer), &start, &end);
-        gtk_text_buffer_remove_tag_by_name(GTK_TEXT_BUFFER(app->buffer), "jump_highlight", &start, &end);
+    for (gint i = 0; lines[i]; i++) {
+        gchar *end;
+        gdouble percent = g_ascii_strtod(lines[i], &end);
+        gchar *open = strrchr(lines[i], '(');
+        
+        if (end == lines[i] || !open || percent <= 0) continue;
+        gchar *at = strstr(open, " @");
+        gchar *name_end = open;
+        while (name_end > end && name_end[-1] == ' ') name_end--;
+        gchar *name_start = name_end;
+        while (name_start > end && name_start[-1] != ' ') name_start--;
+        if (!at || name_start == name_end) continue;
+        
+        gchar *func = g_strndup(name_start, name_end - name_start);
+        gchar *location = g_strndup(open + 1, at - open - 1);
+        profile_add(profile, source_name, func, location, percent);
+        g_free(location);
+        g_free(func);
     }
-    
-    update_status(app);
+    g_strfreev(lines);
 }
 
-static void on_restart_editor(GtkWidget *widget, gpointer data) {
-    EditorApp *app = (EditorApp *)data;
-    
-    /* 1. Save work first */
-    on_save(NULL, app);
-    
-    /* 2. Prepare arguments for restart */
-    /* We assume the executable is named 'scrible' in the current directory */
-    char *args[] = {"./scrible", app->current_file, NULL};
-    
-    /* 3. Restart the process */
-    g_print("Restarting editor...\n");
-    execvp(args[0], args);
+/* Run argv, the program's own output goes to the terminal; report is stdout when wanted */
+static gboolean profile_spawn(gchar **argv, gchar **envp, gchar **report) {
+    GError *error = NULL;
+    gint status;
     
-    /* If execvp returns, it failed */
-    perror("execvp failed");
+    if (!g_spawn_sync(NULL, argv, envp, G_SPAWN_SEARCH_PATH | G_SPAWN_CHILD_INHERITS_STDIN,
+                      NULL, NULL, report, NULL, &status, &error)) {
+        g_print("Profile: %s\n", error->message);
+        g_error_free(error);
+        return FALSE;
+    }
+    return g_spawn_check_exit_status(status, NULL);
 }
 
-/* Find/Replace Callback classic function */
-static void on_find_replace(GtkWidget *widget, gpointer data) {
-    EditorApp *app = (EditorApp *)data;
-    GtkWidget *dialog, *content_area, *grid;
-    GtkWidget *find_entry, *replace_entry;
-    GtkWidget *check_case, *check_word, *check_regex;
-
-    dialog = gtk_dialog_new_with_buttons("Advanced Search & Replace", GTK_WINDOW(app->window),
-                                         GTK_DIALOG_MODAL | GTK_DIALOG_DESTROY_WITH_PARENT,
-                                         "Find Next", 1,
-                                         "Replace All", 4, // Added Replace All
-                                         "Replace", 2,
-                                         "Close", GTK_RESPONSE_CLOSE, NULL);
-
-    content_area = gtk_dialog_get_content_area(GTK_DIALOG(dialog));
-    grid = gtk_grid_new();
-    gtk_grid_set_column_spacing(GTK_GRID(grid), 10);
-    gtk_grid_set_row_spacing(GTK_GRID(grid), 10);
-    gtk_container_set_border_width(GTK_CONTAINER(grid), 15);
-
-    // Entry Fields
-    find_entry = gtk_entry_new();
-    gtk_entry_set_placeholder_text(GTK_ENTRY(find_entry), "Search term...");
-    replace_entry = gtk_entry_new();
-    gtk_entry_set_placeholder_text(GTK_ENTRY(replace_entry), "Replace with...");
-
-    // Option Toggles
-    check_case = gtk_check_button_new_with_label("Match Case");
-    check_word = gtk_check_button_new_with_label("Whole Words Only");
-    check_regex = gtk_check_button_new_with_label("Use Regular Expressions");
-
-    // Layout
-    gtk_grid_attach(GTK_GRID(grid), gtk_label_new("Find:"), 0, 0, 1, 1);
-    gtk_grid_attach(GTK_GRID(grid), find_entry, 1, 0, 1, 1);
-    gtk_grid_attach(GTK_GRID(grid), gtk_label_new("Replace:"), 0, 1, 1, 1);
-    gtk_grid_attach(GTK_GRID(grid), replace_entry, 1, 1, 1, 1);
-    gtk_grid_attach(GTK_GRID(grid), check_case, 1, 2, 1, 1);
-    gtk_grid_attach(GTK_GRID(grid), check_word, 1, 3, 1, 1);
-    gtk_grid_attach(GTK_GRID(grid), check_regex, 1, 4, 1, 1);
-
-    gtk_box_pack_start(GTK_BOX(content_area), grid, TRUE, TRUE, 0);
-    gtk_widget_show_all(dialog);
-
-    if (!app->search_settings) {
-        app->search_settings = gtk_source_search_settings_new();
-        app->search_context = gtk_source_search_context_new(app->buffer, app->search_settings);
-        gtk_source_search_context_set_highlight(app->search_context, TRUE);
+static ProfileData *profile_with_perf(const gchar *source, const gchar *output, const gchar *dir) {
+    gchar *data = g_build_filename(dir, "perf.data", NULL);
+    gchar *program = g_strdup_printf("./%s", output);
+    gchar *cc[] = { "gcc", "-O2", "-g", "-fno-omit-frame-pointer", (gchar *)source,
+                    "-o", (gchar *)output, NULL };
+    gchar *record[] = { "perf", "record", "-F", "999", "-o", data, "--", program, NULL };
+    gchar *report_argv[] = { "perf", "report", "--stdio", "--no-children", "-i", data,
+                             "-F", "overhead,sym,srcline", NULL };
+    gchar *report = NULL;
+    ProfileData *profile = NULL;
+    
+    if (profile_spawn(cc, NULL, NULL) && profile_spawn(record, NULL, NULL) &&
+        profile_spawn(report_argv, NULL, &report)) {
+        gchar *source_name = g_path_get_basename(source);
+        profile = profile_data_new("perf");
+        profile_parse_perf(profile, source_name, report);
+        g_free(source_name);
     }
+    g_free(report);
+    g_free(program);
+    g_free(data);
+    return profile;
+}
 
-    gint result;
-    while ((result = gtk_dialog_run(GTK_DIALOG(dialog))) > 0) {
-        const gchar *find_text = gtk_entry_get_text(GTK_ENTRY(find_entry));
-        const gchar *replace_text = gtk_entry_get_text(GTK_ENTRY(replace_entry));
+static ProfileData *profile_with_gprof(const gchar *source, const gchar *output, const gchar *dir) {
+    gchar *program = g_strdup_printf("./%s", output);
+    gchar *prefix = g_build_filename(dir, "gmon", NULL);
+    gchar **envp = g_environ_setenv(g_get_environ(), "GMON_OUT_PREFIX", prefix, TRUE);
+    gchar *cc[] = { "gcc", "-O2", "-g", "-pg", "-fno-omit-frame-pointer", (gchar *)source,
+                    "-o", (gchar *)output, NULL };
+    gchar *run[] = { program, NULL };
+    gchar *report = NULL;
+    ProfileData *profile = NULL;
+    
+    /* The program's exit status does not matter, only that it wrote gmon.<pid> */
+    if (profile_spawn(cc, NULL, NULL)) {
+        profile_spawn(run, envp, NULL);
         
-        // Apply Settings
-        gtk_source_search_settings_set_search_text(app->search_settings, find_text);
-        gtk_source_search_settings_set_case_sensitive(app->search_settings, gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(check_case)));
-        gtk_source_search_settings_set_at_word_boundaries(app->search_settings, gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(check_word)));
-        gtk_source_search_settings_set_regex_enabled(app->search_settings, gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(check_regex)));
-
-        GtkTextIter start, end, iter;
-        gtk_text_buffer_get_iter_at_mark(GTK_TEXT_BUFFER(app->buffer), &iter, 
-                                         gtk_text_buffer_get_insert(GTK_TEXT_BUFFER(app->buffer)));
-
-        if (result == 1) { // Find Next
-            if (gtk_source_search_context_forward2(app->search_context, &iter, &start, &end, NULL)) {
-                gtk_text_buffer_select_range(GTK_TEXT_BUFFER(app->buffer), &start, &end);
-                gtk_text_view_scroll_to_iter(GTK_TEXT_VIEW(app->view), &start, 0.0, FALSE, 0.0, 0.0);
-            }
-        } else if (result == 2) { // Replace
-            if (gtk_source_search_context_forward2(app->search_context, &iter, &start, &end, NULL)) {
-                gtk_source_search_context_replace2(app->search_context, &start, &end, replace_text, -1, NULL);
+        GDir *d = g_dir_open(dir, 0, NULL);
+        const gchar *name;
+        while (d && !profile && (name = g_dir_read_name(d))) {
+            if (!g_str_has_prefix(name, "gmon")) continue;
+            gchar *gmon = g_build_filename(dir, name, NULL);
+            gchar *gprof[] = { "gprof", "-b", "-l", "-p", (gchar *)output, gmon, NULL };
+            if (profile_spawn(gprof, NULL, &report)) {
+                gchar *source_name = g_path_get_basename(source);
+                profile = profile_data_new("gprof");
+                profile_parse_gprof(profile, source_name, report);
+                g_free(source_name);
             }
-        } else if (result == 4) { // Replace All
-            gtk_source_search_context_replace_all(app->search_context, replace_text, -1, NULL);
+            g_free(gmon);
         }
+        if (d) g_dir_close(d);
     }
-    gtk_widget_destroy(dialog);
+    g_free(report);
+    g_strfreev(envp);
+    g_free(prefix);
+    g_free(program);
+    return profile;
 }
 
-/* Clear Highlighting */
-static void on_clear_search(GtkWidget *widget, gpointer data) {
+/* Heat gutter: the line's share of samples, shaded by its share of the hottest line */
+static void on_heat_query_data(GtkSourceGutterRenderer *renderer, GtkTextIter *start, GtkTextIter *end,
+                               GtkSourceGutterRendererState state, gpointer data) {
     EditorApp *app = (EditorApp *)data;
-    if (app->search_settings) {
-        gtk_source_search_settings_set_search_text(app->search_settings, NULL);
+    ProfileData *profile = app->profile;
+    guint line = gtk_text_iter_get_line(start) + 1;
+    gdouble percent = 0;
+    
+    if (profile && line < profile->line_percent->len)
+        percent = g_array_index(profile->line_percent, gdouble, line);
+    
+    if (percent < 0.05) {
+        gtk_source_gutter_renderer_text_set_text(GTK_SOURCE_GUTTER_RENDERER_TEXT(renderer), "", -1);
+        gtk_source_gutter_renderer_set_background(renderer, NULL);
+        return;
     }
+    gchar text[16];
+    GdkRGBA heat = { 0.9, 0.15, 0.1, 0.15 + 0.75 * percent / profile->max_percent };
+    g_snprintf(text, sizeof(text), "%.1f%%", percent);
+    gtk_source_gutter_renderer_text_set_text(GTK_SOURCE_GUTTER_RENDERER_TEXT(renderer), text, -1);
+    gtk_source_gutter_renderer_set_background(renderer, &heat);
 }
 
-/* Fine selection */
-static void on_find_selection(GtkWidget *widget, gpointer data) {
-    EditorApp *app = (EditorApp *)data;
-    GtkTextIter start, end;
+static void show_heat_gutter(EditorApp *app, gboolean show) {
+    if (!app->heat_renderer) {
+        if (!show) return;
+        GtkSourceGutter *gutter = gtk_source_view_get_gutter(GTK_SOURCE_VIEW(app->view), GTK_TEXT_WINDOW_LEFT);
+        app->heat_renderer = gtk_source_gutter_renderer_text_new();
+        gint width;
+        gtk_source_gutter_renderer_text_measure(GTK_SOURCE_GUTTER_RENDERER_TEXT(app->heat_renderer),
+                                                "100.0%", &width, NULL);
+        gtk_source_gutter_renderer_set_size(app->heat_renderer, width + 6);
+        gtk_source_gutter_renderer_set_alignment(app->heat_renderer, 1.0, 0.5);
+        g_signal_connect(app->heat_renderer, "query-data", G_CALLBACK(on_heat_query_data), app);
+        gtk_source_gutter_insert(gutter, app->heat_renderer, 5);
+    }
+    gtk_source_gutter_renderer_set_visible(app->heat_renderer, show);
+    gtk_source_gutter_renderer_queue_draw(app->heat_renderer);
+}
 
-    if (gtk_text_buffer_get_selection_bounds(GTK_TEXT_BUFFER(app->buffer), &start, &end)) {
-        gchar *selected_text = gtk_text_buffer_get_text(GTK_TEXT_BUFFER(app->buffer), &start, &end, FALSE);
-        
-        if (!app->search_settings) {
-            app->search_settings = gtk_source_search_settings_new();
-            app->search_context = gtk_source_search_context_new(app->buffer, app->search_settings);
-            gtk_source_search_context_set_highlight(app->search_context, TRUE);
-        }
+enum {
+    HOT_COL_NAME = 0,
+    HOT_COL_PERCENT,
+    HOT_COL_LINE,
+    HOT_NUM_COLS
+};
 
-        gtk_source_search_settings_set_search_text(app->search_settings, selected_text);
-        g_free(selected_text);
-    }
+static void on_hot_function_activated(GtkTreeView *tree, GtkTreePath *path,
+                                      GtkTreeViewColumn *column, gpointer data) {
+    EditorApp *app = (EditorApp *)data;
+    GtkTreeModel *model = gtk_tree_view_get_model(tree);
+    GtkTreeIter iter;
+    gint line;
+    
+    if (!gtk_tree_model_get_iter(model, &iter, path)) return;
+    gtk_tree_model_get(model, &iter, HOT_COL_LINE, &line, -1);
+    if (line > 0) jump_to_line(app, line);
 }
 
-static void on_search_entry_changed(GtkSearchEntry *entry, gpointer data) {
+static void percent_cell_data(GtkTreeViewColumn *column, GtkCellRenderer *cell, GtkTreeModel *model,
+                              GtkTreeIter *iter, gpointer data) {
+    gdouble percent;
+    gchar text[16];
+    gtk_tree_model_get(model, iter, HOT_COL_PERCENT, &percent, -1);
+    g_snprintf(text, sizeof(text), "%.2f%%", percent);
+    g_object_set(cell, "text", text, NULL);
+}
+
+static void on_hot_table_destroy(GtkWidget *widget, gpointer data) {
     EditorApp *app = (EditorApp *)data;
-    const gchar *text = gtk_entry_get_text(GTK_ENTRY(entry));
+    if (app->profile) app->profile->table_window = NULL;
+}
+
+/* Non-modal, so the table stays open while editing; click a header to sort */
+static void show_hot_functions(EditorApp *app) {
+    ProfileData *profile = app->profile;
+    GtkListStore *store = gtk_list_store_new(HOT_NUM_COLS, G_TYPE_STRING, G_TYPE_DOUBLE, G_TYPE_INT);
     
-    if (!app->search_settings) {
-        app->search_settings = gtk_source_search_settings_new();
-        app->search_context = gtk_source_search_context_new(app->buffer, app->search_settings);
-        gtk_source_search_context_set_highlight(app->search_context, TRUE);
+    for (guint i = 0; i < profile->functions->len; i++) {
+        ProfileFunction *f = &g_array_index(profile->functions, ProfileFunction, i);
+        GtkTreeIter iter;
+        gtk_list_store_insert_with_values(store, &iter, -1, HOT_COL_NAME, f->name,
+                                          HOT_COL_PERCENT, f->percent, HOT_COL_LINE, f->line, -1);
     }
+    gtk_tree_sortable_set_sort_column_id(GTK_TREE_SORTABLE(store), HOT_COL_PERCENT, GTK_SORT_DESCENDING);
     
-    gtk_source_search_settings_set_search_text(app->search_settings, text);
+    GtkWidget *tree = gtk_tree_view_new_with_model(GTK_TREE_MODEL(store));
+    g_object_unref(store);
+    
+    GtkTreeViewColumn *column = gtk_tree_view_column_new_with_attributes("Function",
+        gtk_cell_renderer_text_new(), "text", HOT_COL_NAME, NULL);
+    gtk_tree_view_column_set_sort_column_id(column, HOT_COL_NAME);
+    gtk_tree_view_column_set_expand(column, TRUE);
+    gtk_tree_view_append_column(GTK_TREE_VIEW(tree), column);
+    
+    GtkCellRenderer *cell = gtk_cell_renderer_text_new();
+    g_object_set(cell, "xalign", 1.0, NULL);
+    column = gtk_tree_view_column_new_with_attributes("Self", cell, NULL);
+    gtk_tree_view_column_set_cell_data_func(column, cell, percent_cell_data, NULL, NULL);
+    gtk_tree_view_column_set_sort_column_id(column, HOT_COL_PERCENT);
+    gtk_tree_view_append_column(GTK_TREE_VIEW(tree), column);
+    
+    column = gtk_tree_view_column_new_with_attributes("Line",
+        gtk_cell_renderer_text_new(), "text", HOT_COL_LINE, NULL);
+    gtk_tree_view_column_set_sort_column_id(column, HOT_COL_LINE);
+    gtk_tree_view_append_column(GTK_TREE_VIEW(tree), column);
+    g_signal_connect(tree, "row-activated", G_CALLBACK(on_hot_function_activated), app);
+    
+    GtkWidget *scroll = gtk_scrolled_window_new(NULL, NULL);
+    gtk_container_add(GTK_CONTAINER(scroll), tree);
+    
+    gchar *title = g_strdup_printf("Hot Functions (%s)", profile->tool);
+    profile->table_window = gtk_window_new(GTK_WINDOW_TOPLEVEL);
+    gtk_window_set_title(GTK_WINDOW(profile->table_window), title);
+    gtk_window_set_transient_for(GTK_WINDOW(profile->table_window), GTK_WINDOW(app->window));
+    gtk_window_set_default_size(GTK_WINDOW(profile->table_window), 420, 360);
+    gtk_container_add(GTK_CONTAINER(profile->table_window), scroll);
+    g_signal_connect(profile->table_window, "destroy", G_CALLBACK(on_hot_table_destroy), app);
+    gtk_widget_show_all(profile->table_window);
+    g_free(title);
 }
 
-/* find all */
-static void on_find_all(GtkWidget *widget, gpointer data) {
+/* Build: Profile & Run */
+static void on_profile_run(GtkWidget *widget, gpointer data) {
     EditorApp *app = (EditorApp *)data;
-    if (!app->search_settings || !app->search_context) return;
-
-    const gchar *text = gtk_source_search_settings_get_search_text(app->search_settings);
-    if (!text || strlen(text) == 0) return;
-
-    int count = gtk_source_search_context_get_occurrences_count(app->search_context);
+    ProfileData *profile = NULL;
     
-    gchar *msg = g_strdup_printf("Found %d occurrences of '%s'", count, text);
-    gtk_label_set_text(GTK_LABEL(app->status_label), msg);
-    g_free(msg);
-
-    // Ensure highlighting is forced on
-    gtk_source_search_context_set_highlight(app->search_context, TRUE);
+    if (!app->current_file) {
+        g_print("Save the file first before profiling!\n");
+        return;
+    }
+    
+    gchar *basename = g_path_get_basename(app->current_file);
+    gchar *output = g_strdup(basename);
+    gchar *dot = strrchr(output, '.');
+    if (dot) *dot = '\0';
+    g_free(basename);
+    
+    gchar *dir = g_dir_make_tmp("scrible-profile-XXXXXX", NULL);
+    if (!dir) {
+        g_print("Profile: cannot create a temporary directory\n");
+        g_free(output);
+        return;
+    }
+    
+    g_print("\n=== Profile & Run ===\n");
+    TRACE_BEGIN("build: profile & run");
+    gchar *perf = g_find_program_in_path("perf");
+    if (perf) profile = profile_with_perf(app->current_file, output, dir);
+    if (!profile) {
+        if (perf) g_print("No perf profile (is kernel.perf_event_paranoid too strict?), trying gprof\n");
+        profile = profile_with_gprof(app->current_file, output, dir);
+    }
+    TRACE_END("build: profile & run");
+    g_free(perf);
+    
+    gchar *rm[] = { "rm", "-rf", dir, NULL };
+    g_spawn_sync(NULL, rm, NULL, G_SPAWN_SEARCH_PATH, NULL, NULL, NULL, NULL, NULL, NULL);
+    g_free(dir);
+    g_free(output);
+    
+    if (!profile || profile->functions->len == 0) {
+        GtkWidget *dialog = gtk_message_dialog_new(GTK_WINDOW(app->window),
+                            GTK_DIALOG_DESTROY_WITH_PARENT | GTK_DIALOG_MODAL,
+                            GTK_MESSAGE_ERROR, GTK_BUTTONS_OK,
+                            "No profile was collected. Check the terminal; the program must "
+                            "compile and run, with perf or gprof installed.");
+        gtk_dialog_run(GTK_DIALOG(dialog));
+        gtk_widget_destroy(dialog);
+        profile_data_free(profile);
+        return;
+    }
+    
+    profile_data_free(app->profile);
+    app->profile = profile;
+    g_print("=== Profile: %u functions (%s) ===\n", profile->functions->len, profile->tool);
+    show_heat_gutter(app, TRUE);
+    show_hot_functions(app);
 }
-/* Quick find */
-static void on_toggle_search_bar(GtkWidget *widget, gpointer data) {
+
+static void on_clear_profile(GtkWidget *widget, gpointer data) {
     EditorApp *app = (EditorApp *)data;
-    // Note: This assumes you added GtkWidget *search_bar to your EditorApp struct
-    gboolean revealed = gtk_search_bar_get_search_mode(GTK_SEARCH_BAR(app->search_bar));
-    gtk_search_bar_set_search_mode(GTK_SEARCH_BAR(app->search_bar), !revealed);
+    
+    profile_data_free(app->profile);
+    app->profile = NULL;
+    show_heat_gutter(app, FALSE);
 }
 
+/*
+ * Build: Benchmark Run
+ * Runs the built program N times after some warmup runs, each in a forked
+ * child reaped with wait4() for its rusage. The program's stdout goes to
+ * /dev/null so terminal speed is not measured. Baselines are kept per
+ * source file in the user cache directory (bench-baselines.ini).
+ */
+enum {
+    BENCH_WALL = 0,
+    BENCH_USER,
+    BENCH_SYS,
+    BENCH_RSS,
+    BENCH_CSW,
+    N_BENCH_METRICS
+};
 
-/* Apply dark theme using GTK CSS */
-static GtkCssProvider *create_light_theme(void) {
-    GtkCssProvider *css = gtk_css_provider_new();
-
-    const gchar *data =
-        "window { background-color: #ffffff; }"
-
-        "GtkSourceView {"
-        "  background-color: #ffffff;"
-        "  color: #000000;"
-        "  caret-color: #000000;"
-        "}"
+static const gchar *bench_metric_names[N_BENCH_METRICS] = {
+    "wall ms", "user ms", "sys ms", "max RSS KB", "ctx switches"
+};
+static const gchar *bench_metric_keys[N_BENCH_METRICS] = {
+    "wall", "user", "sys", "rss", "csw"
+};
 
-        "GtkSourceView text:selected {"
-        "  background-color: #cce4ff;"
-        "  color: #000000;"
-        "}"
+typedef struct {
+    gdouble mean;
+    gdouble median;
+    gdouble stddev;
+    gdouble min;
+    gint n;
+} BenchStats;
 
-        "GtkSourceView gutter {"
-        "  background-color: #f0f0f0;"
-        "}"
+typedef struct {
+    gint runs;
+    gint warmup;
+    gint cpu;                 /* -1 = not pinned */
+    gboolean cold;
+    gchar *sweep;             /* cold runs: BENCH_SWEEP_SIZE bytes to evict the CPU caches with */
+    gchar **argv;
+} BenchConfig;
+
+#define BENCH_SWEEP_SIZE (64 << 20)
+
+static gint compare_gdouble(gconstpointer a, gconstpointer b) {
+    gdouble da = *(const gdouble *)a, db = *(const gdouble *)b;
+    return (da > db) - (da < db);
+}
 
-        "GtkSourceView gutter text {"
-        "  color: #555555;"
-        "}"
+static void bench_stats(gdouble *values, gint n, BenchStats *stats) {
+    gdouble sum = 0, sq = 0;
+    
+    qsort(values, n, sizeof(gdouble), compare_gdouble);
+    for (gint i = 0; i < n; i++) sum += values[i];
+    stats->n = n;
+    stats->mean = sum / n;
+    stats->median = n % 2 ? values[n / 2] : (values[n / 2 - 1] + values[n / 2]) / 2;
+    stats->min = values[0];
+    for (gint i = 0; i < n; i++) sq += (values[i] - stats->mean) * (values[i] - stats->mean);
+    stats->stddev = n > 1 ? sqrt(sq / (n - 1)) : 0;
+}
 
-        "GtkSourceView gutter text.current-line {"
-        "  color: #000000;"
-        "  font-weight: bold;"
-        "}"
+/* Cold runs: drop the program and its file arguments from the page cache, evict the CPU caches */
+static void bench_chill(const BenchConfig *config) {
+    for (gint i = 0; config->argv[i]; i++) {
+        int fd = open(config->argv[i], O_RDONLY);
+        if (fd < 0) continue;
+        fdatasync(fd);
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        close(fd);
+    }
+    for (gsize i = 0; i < BENCH_SWEEP_SIZE; i += 64) config->sweep[i]++;
+}
 
-        "GtkSourceView text.current-line {"
-        "  background-color: #e6e6e6;"
-        "}";
+/* One run; fills one value per metric. FALSE if the program could not be run */
+static gboolean bench_run_once(const BenchConfig *config, gdouble *sample, gint *exit_status) {
+    struct rusage ru;
+    gint status;
+    gint64 t0 = g_get_monotonic_time();
+    pid_t pid = fork();
+    
+    if (pid < 0) return FALSE;
+    if (pid == 0) {
+        if (config->cpu >= 0) {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(config->cpu, &set);
+            sched_setaffinity(0, sizeof(set), &set);
+        }
+        int null = open("/dev/null", O_WRONLY);
+        if (null >= 0) dup2(null, STDOUT_FILENO);
+        execv(config->argv[0], config->argv);
+        _exit(127);
+    }
+    /* A signal delivered to the editor while the child runs is not a failed run */
+    pid_t reaped;
+    do {
+        reaped = wait4(pid, &status, 0, &ru);
+    } while (reaped < 0 && errno == EINTR);
+    if (reaped < 0) return FALSE;
+    
+    sample[BENCH_WALL] = (g_get_monotonic_time() - t0) / 1000.0;
+    sample[BENCH_USER] = ru.ru_utime.tv_sec * 1000.0 + ru.ru_utime.tv_usec / 1000.0;
+    sample[BENCH_SYS] = ru.ru_stime.tv_sec * 1000.0 + ru.ru_stime.tv_usec / 1000.0;
+    sample[BENCH_RSS] = ru.ru_maxrss;
+    sample[BENCH_CSW] = ru.ru_nvcsw + ru.ru_nivcsw;
+    *exit_status = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+    return *exit_status != 127;
+}
 
-    gtk_css_provider_load_from_data(css, data, -1, NULL);
-    return css;
+static gchar *bench_baseline_path(void) {
+    return g_build_filename(g_get_user_cache_dir(), "scrible", "bench-baselines.ini", NULL);
 }
 
-static void apply_theme(EditorApp *app) {
-    GdkScreen *screen = gdk_screen_get_default();
+static gboolean bench_load_baseline(const gchar *source, BenchStats *baseline) {
+    gchar *path = bench_baseline_path();
+    GKeyFile *kf = g_key_file_new();
+    gboolean found = FALSE;
+    
+    if (g_key_file_load_from_file(kf, path, G_KEY_FILE_NONE, NULL) &&
+        g_key_file_has_group(kf, source)) {
+        for (gint m = 0; m < N_BENCH_METRICS; m++) {
+            gsize n = 0;
+            gdouble *v = g_key_file_get_double_list(kf, source, bench_metric_keys[m], &n, NULL);
+            memset(&baseline[m], 0, sizeof(BenchStats));
+            if (v && n == 4) {
+                baseline[m].mean = v[0];
+                baseline[m].median = v[1];
+                baseline[m].stddev = v[2];
+                baseline[m].n = (gint)v[3];
+                found = TRUE;
+            }
+            g_free(v);
+        }
+    }
+    g_key_file_free(kf);
+    g_free(path);
+    return found;
+}
 
-    /* Safety Check: Only remove if the pointer is actually a valid provider */
-    if (app->dark_css && GTK_IS_STYLE_PROVIDER(app->dark_css))
-        gtk_style_context_remove_provider_for_screen(screen, GTK_STYLE_PROVIDER(app->dark_css));
-        
-    if (app->light_css && GTK_IS_STYLE_PROVIDER(app->light_css))
-        gtk_style_context_remove_provider_for_screen(screen, GTK_STYLE_PROVIDER(app->light_css));
-        
-    if (app->green_css && GTK_IS_STYLE_PROVIDER(app->green_css))
-        gtk_style_context_remove_provider_for_screen(screen, GTK_STYLE_PROVIDER(app->green_css));
+static void bench_save_baseline(const gchar *source, const BenchStats *stats) {
+    gchar *path = bench_baseline_path();
+    gchar *dir = g_path_get_dirname(path);
+    GKeyFile *kf = g_key_file_new();
+    GError *error = NULL;
+    
+    g_key_file_load_from_file(kf, path, G_KEY_FILE_KEEP_COMMENTS, NULL);
+    for (gint m = 0; m < N_BENCH_METRICS; m++) {
+        gdouble v[4] = { stats[m].mean, stats[m].median, stats[m].stddev, stats[m].n };
+        g_key_file_set_double_list(kf, source, bench_metric_keys[m], v, 4);
+    }
+    g_mkdir_with_parents(dir, 0755);
+    if (!g_key_file_save_to_file(kf, path, &error)) {
+        g_print("Could not save baseline: %s\n", error->message);
+        g_error_free(error);
+    } else {
+        g_print("Baseline saved to %s\n", path);
+    }
+    g_key_file_free(kf);
+    g_free(dir);
+    g_free(path);
+}
 
-    GtkCssProvider *active = NULL;
-    if (app->theme_mode == 1) active = app->dark_css;
-    else if (app->theme_mode == 2) active = app->green_css;
-    else active = app->light_css;
+/* Table of the results; a change is flagged when it exceeds twice the combined standard error */
+static gchar *bench_format(const BenchConfig *config, const BenchStats *stats,
+                           const BenchStats *baseline, gboolean have_baseline) {
+    GString *out = g_string_new(NULL);
+    
+    g_string_append_printf(out, "%d runs after %d warmup, %s caches", config->runs,
+                           config->warmup, config->cold ? "cold" : "warm");
+    if (config->cpu >= 0) g_string_append_printf(out, ", pinned to CPU %d", config->cpu);
+    g_string_append(out, "\n\n");
+    g_string_append_printf(out, "%-13s %10s %10s %9s %10s", "", "mean", "median", "stddev", "min");
+    if (have_baseline) g_string_append_printf(out, " %10s %8s", "baseline", "change");
+    g_string_append_c(out, '\n');
+    
+    for (gint m = 0; m < N_BENCH_METRICS; m++) {
+        const BenchStats *s = &stats[m];
+        g_string_append_printf(out, "%-13s %10.2f %10.2f %9.2f %10.2f", bench_metric_names[m],
+                               s->mean, s->median, s->stddev, s->min);
+        if (have_baseline && baseline[m].n > 0) {
+            const BenchStats *b = &baseline[m];
+            gdouble change = b->mean != 0 ? (s->mean / b->mean - 1) * 100 : 0;
+            gdouble noise = 2 * sqrt(s->stddev * s->stddev / s->n + b->stddev * b->stddev / b->n);
+            g_string_append_printf(out, " %10.2f %+7.1f%%%s", b->mean, change,
+                                   fabs(s->mean - b->mean) > noise ? " *" : "");
+        }
+        g_string_append_c(out, '\n');
+    }
+    if (have_baseline)
+        g_string_append(out, "\n* change larger than the run-to-run noise\n");
+    return g_string_free(out, FALSE);
+}
 
-    /* Final safety check before adding */
-    if (active && GTK_IS_STYLE_PROVIDER(active)) {
-        gtk_style_context_add_provider_for_screen(
-            screen,
-            GTK_STYLE_PROVIDER(active),
-            GTK_STYLE_PROVIDER_PRIORITY_APPLICATION
-        );
+static void on_benchmark_run(GtkWidget *widget, gpointer data) {
+    EditorApp *app = (EditorApp *)data;
+    
+    if (!app->current_file) {
+        g_print("Save the file first before benchmarking!\n");
+        return;
+    }
+    
+    GtkWidget *dialog = gtk_dialog_new_with_buttons("Benchmark Run",
+                                         GTK_WINDOW(app->window),
+                                         GTK_DIALOG_MODAL | GTK_DIALOG_DESTROY_WITH_PARENT,
+                                         "_Cancel", GTK_RESPONSE_CANCEL,
+                                         "_Run", GTK_RESPONSE_ACCEPT,
+                                         NULL);
+    GtkWidget *content_area = gtk_dialog_get_content_area(GTK_DIALOG(dialog));
+    GtkWidget *grid = gtk_grid_new();
+    gtk_grid_set_column_spacing(GTK_GRID(grid), 10);
+    gtk_grid_set_row_spacing(GTK_GRID(grid), 10);
+    gtk_container_set_border_width(GTK_CONTAINER(grid), 15);
+    
+    GtkWidget *flags_entry = gtk_entry_new();
+    gtk_entry_set_text(GTK_ENTRY(flags_entry), "-O2 -g");
+    GtkWidget *args_entry = gtk_entry_new();
+    gtk_entry_set_placeholder_text(GTK_ENTRY(args_entry), "program arguments");
+    GtkWidget *runs_spin = gtk_spin_button_new_with_range(1, 1000, 1);
+    gtk_spin_button_set_value(GTK_SPIN_BUTTON(runs_spin), 10);
+    GtkWidget *warmup_spin = gtk_spin_button_new_with_range(0, 100, 1);
+    gtk_spin_button_set_value(GTK_SPIN_BUTTON(warmup_spin), 1);
+    GtkWidget *pin_check = gtk_check_button_new_with_label("Pin to CPU");
+    GtkWidget *cpu_spin = gtk_spin_button_new_with_range(0, MAX(0, sysconf(_SC_NPROCESSORS_ONLN) - 1), 1);
+    GtkWidget *cache_combo = gtk_combo_box_text_new();
+    gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(cache_combo), "Warm (back to back)");
+    gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(cache_combo), "Cold (evict caches before each run)");
+    gtk_combo_box_set_active(GTK_COMBO_BOX(cache_combo), 0);
+    
+    const gchar *labels[] = { "Compiler Flags:", "Arguments:", "Runs:", "Warmup Runs:", "", "Caches:" };
+    GtkWidget *fields[] = { flags_entry, args_entry, runs_spin, warmup_spin, cpu_spin, cache_combo };
+    for (gint i = 0; i < (gint)G_N_ELEMENTS(fields); i++) {
+        GtkWidget *label = i == 4 ? pin_check : gtk_label_new(labels[i]);
+        gtk_widget_set_halign(label, GTK_ALIGN_END);
+        gtk_grid_attach(GTK_GRID(grid), label, 0, i, 1, 1);
+        gtk_grid_attach(GTK_GRID(grid), fields[i], 1, i, 1, 1);
+    }
+    gtk_container_add(GTK_CONTAINER(content_area), grid);
+    gtk_widget_show_all(content_area);
+    
+    if (gtk_dialog_run(GTK_DIALOG(dialog)) != GTK_RESPONSE_ACCEPT) {
+        gtk_widget_destroy(dialog);
+        return;
+    }
+    
+    BenchConfig config = { 0 };
+    gchar **flags = NULL, **args = NULL;
+    GError *error = NULL;
+    config.runs = gtk_spin_button_get_value_as_int(GTK_SPIN_BUTTON(runs_spin));
+    config.warmup = gtk_spin_button_get_value_as_int(GTK_SPIN_BUTTON(warmup_spin));
+    config.cpu = gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(pin_check)) ?
+                 gtk_spin_button_get_value_as_int(GTK_SPIN_BUTTON(cpu_spin)) : -1;
+    config.cold = gtk_combo_box_get_active(GTK_COMBO_BOX(cache_combo)) == 1;
+    const gchar *flags_text = gtk_entry_get_text(GTK_ENTRY(flags_entry));
+    const gchar *args_text = gtk_entry_get_text(GTK_ENTRY(args_entry));
+    if ((*flags_text && !g_shell_parse_argv(flags_text, NULL, &flags, &error)) ||
+        (*args_text && !g_shell_parse_argv(args_text, NULL, &args, &error))) {
+        g_print("Benchmark: %s\n", error->message);
+        g_error_free(error);
+        g_strfreev(flags);
+        gtk_widget_destroy(dialog);
+        return;
+    }
+    gtk_widget_destroy(dialog);
+    
+    /* Compile */
+    gchar *basename = g_path_get_basename(app->current_file);
+    gchar *output = g_strdup(basename);
+    gchar *dot = strrchr(output, '.');
+    if (dot) *dot = '\0';
+    g_free(basename);
+    
+    GPtrArray *cc = g_ptr_array_new();
+    g_ptr_array_add(cc, "gcc");
+    for (gint i = 0; flags && flags[i]; i++) g_ptr_array_add(cc, flags[i]);
+    g_ptr_array_add(cc, app->current_file);
+    g_ptr_array_add(cc, "-o");
+    g_ptr_array_add(cc, output);
+    g_ptr_array_add(cc, NULL);
+    
+    g_print("\n=== Benchmark Run ===\n");
+    gint status = -1;
+    gboolean built = g_spawn_sync(NULL, (gchar **)cc->pdata, NULL, G_SPAWN_SEARCH_PATH,
+                                  NULL, NULL, NULL, NULL, &status, NULL) &&
+                     g_spawn_check_exit_status(status, NULL);
+    g_ptr_array_free(cc, TRUE);
+    g_strfreev(flags);
+    
+    GPtrArray *argv = g_ptr_array_new_with_free_func(g_free);
+    g_ptr_array_add(argv, g_strdup_printf("./%s", output));
+    for (gint i = 0; args && args[i]; i++) g_ptr_array_add(argv, g_strdup(args[i]));
+    g_ptr_array_add(argv, NULL);
+    config.argv = (gchar **)argv->pdata;
+    g_strfreev(args);
+    g_free(output);
+    
+    gdouble *samples = g_new(gdouble, (gsize)config.runs * N_BENCH_METRICS);
+    gint done = 0, exit_status = 0;
+    if (config.cold) config.sweep = g_malloc0(BENCH_SWEEP_SIZE);
+    TRACE_BEGIN("build: benchmark run");
+    for (gint i = built ? -config.warmup : config.runs; i < config.runs; i++) {
+        gdouble sample[N_BENCH_METRICS];
+        if (config.cold) bench_chill(&config);
+        if (!bench_run_once(&config, sample, &exit_status)) break;
+        if (i < 0) continue;
+        for (gint m = 0; m < N_BENCH_METRICS; m++)
+            samples[m * config.runs + i] = sample[m];
+        done++;
+        g_print("run %d/%d: %.2f ms\n", done, config.runs, sample[BENCH_WALL]);
+    }
+    TRACE_END("build: benchmark run");
+    g_free(config.sweep);
+    
+    if (done < config.runs) {
+        GtkWidget *error_dialog = gtk_message_dialog_new(GTK_WINDOW(app->window),
+                            GTK_DIALOG_DESTROY_WITH_PARENT | GTK_DIALOG_MODAL,
+                            GTK_MESSAGE_ERROR, GTK_BUTTONS_OK,
+                            built ? "The program could not be run." :
+                                    "Compilation failed! Check the terminal for error messages.");
+        gtk_dialog_run(GTK_DIALOG(error_dialog));
+        gtk_widget_destroy(error_dialog);
+        g_free(samples);
+        g_ptr_array_free(argv, TRUE);
+        return;
     }
+    
+    BenchStats stats[N_BENCH_METRICS], baseline[N_BENCH_METRICS];
+    for (gint m = 0; m < N_BENCH_METRICS; m++)
+        bench_stats(&samples[m * config.runs], config.runs, &stats[m]);
+    gboolean have_baseline = bench_load_baseline(app->current_file, baseline);
+    gchar *report = bench_format(&config, stats, baseline, have_baseline);
+    g_print("%s", report);
+    if (exit_status != 0) g_print("Note: the program exited with status %d\n", exit_status);
+    
+    GtkWidget *result = gtk_dialog_new_with_buttons("Benchmark Results",
+                                         GTK_WINDOW(app->window),
+                                         GTK_DIALOG_MODAL | GTK_DIALOG_DESTROY_WITH_PARENT,
+                                         "Save as _Baseline", GTK_RESPONSE_APPLY,
+                                         "_Close", GTK_RESPONSE_CLOSE,
+                                         NULL);
+    GtkWidget *label = gtk_label_new(NULL);
+    gchar *escaped = g_markup_escape_text(report, -1);
+    gchar *markup = g_strdup_printf("<tt>%s</tt>", escaped);
+    gtk_label_set_markup(GTK_LABEL(label), markup);
+    gtk_label_set_selectable(GTK_LABEL(label), TRUE);
+    gtk_container_set_border_width(GTK_CONTAINER(result), 10);
+    gtk_container_add(GTK_CONTAINER(gtk_dialog_get_content_area(GTK_DIALOG(result))), label);
+    gtk_widget_show_all(result);
+    
+    if (gtk_dialog_run(GTK_DIALOG(result)) == GTK_RESPONSE_APPLY)
+        bench_save_baseline(app->current_file, stats);
+    gtk_widget_destroy(result);
+    
+    g_free(markup);
+    g_free(escaped);
+    g_free(report);
+    g_free(samples);
+    g_ptr_array_free(argv, TRUE);
 }
 
-static GtkCssProvider *create_dark_theme(void) {
-    GtkCssProvider *css = gtk_css_provider_new();
-    const gchar *data =
-        /* 1. Base Window & Panels - Using deep charcoal instead of pure black */
-        "window, .background { background-color: #1e1e1e; color: #eeeeec; }"
-        
-        /* TITLE BAR STYLING */
-        "headerbar { background-color: #2d2d2d; border-bottom: 1px solid #3f3f3f; box-shadow: none; color:#eeeeec;}"
-        "headerbar .title { color: #97a69b; font-weight: bold; border: 3px double #FFFFFF; }"
-        "headerbar button { color: #eeeeec; background: #383838; border: 1px solid #484848;  }"
-        "headerbar button:hover { background: #454545; }"
-        "headerbar text { color: #4948FF; background: #3584e4; }"
-        /* Buttons in the header */
-        /* Window control buttons (minimize, maximize, close) */
-        "headerbar button { "
-        "  background-color: #2d2d2d; "
-        "  border: none; "
-        "  color: #686b69; " 
-        "  min-width: 16px; "
-        "  min-height: 16px; "
-        "}"
-        
-        /* Button icon color */
-        "headerbar button image { "
-        "  color: #686b69; "  
-        "}"
-        /* Hover state for buttons and their icons */
-        "headerbar button:hover { "
-        "  background-color: #162118; "
-        "}"
-     
-        "box, grid, paned { border: 1px solid #333333; }" 
+/*
+ * Build: Optimization Matrix
+ * Compiles the file once per flag combination with GSubprocess, up to one
+ * compiler per core at a time, then runs the binaries one after another
+ * (never alongside a compile or each other, so runtimes are comparable).
+ * Everything is asynchronous; results fill a sortable table as they arrive.
+ */
+enum {
+    MATRIX_COL_FLAGS = 0,
+    MATRIX_COL_SIZE,          /* KB */
+    MATRIX_COL_COMPILE,       /* ms */
+    MATRIX_COL_RUN,           /* ms, median of the runs; -1 = none yet */
+    MATRIX_COL_STATUS,
+    MATRIX_NUM_COLS
+};
 
-        /* 2. THE MENUBAR */
-        "menubar { background-color: #68767d; color: #eeeeec; border-bottom: 1px solid #3f3f3f; }"
-        "menubar > menuitem { padding: 4px 8px; }" 
-        "menubar > menuitem:hover { background-color: #3584e4; color: #ffffff; }"
+typedef struct {
+    gchar *flags;             /* the varying flags, as shown in the table */
+    gchar *binary;
+    GtkTreeIter iter;
+    gint64 started;
+    GArray *run_ms;           /* gdouble per finished run */
+} MatrixJob;
 
-        /* 3. THE DROPDOWN MENUS (Floating Boxes) */
-        "menu { "
-        "  background-color: #2d2d2d; "
-        "  border: 1px dotted #454545; "
-        "  margin: 5px; "
-        "}"
-        "menu menuitem { background-color: #2d2d2d; color: #eeeeec; padding: 5px; }"
-        "menu menuitem:hover { background-color: #3584e4; color: #ffffff; }"
+typedef struct {
+    gchar *source;
+    gchar *dir;               /* temporary directory for the binaries */
+    gchar **base_flags;
+    gchar **linker_flags;
+    gint runs;
+    GPtrArray *jobs;          /* MatrixJob */
+    guint next_compile;
+    guint compiling;
+    guint max_parallel;
+    GQueue run_queue;
+    MatrixJob *running;
+    guint pending;            /* subprocesses not yet reaped */
+    GtkListStore *store;
+    GtkWidget *window;        /* NULL once closed; the matrix is freed when pending drops to 0 */
+    GtkWidget *progress;
+    GSubprocess *run_process; /* killed if the window is closed mid-run */
+} BuildMatrix;
+
+static void matrix_compile_next(BuildMatrix *matrix);
+static void matrix_run_next(BuildMatrix *matrix);
+
+static void matrix_free(BuildMatrix *matrix) {
+    for (guint i = 0; i < matrix->jobs->len; i++) {
+        MatrixJob *job = g_ptr_array_index(matrix->jobs, i);
+        g_unlink(job->binary);
+        g_free(job->binary);
+        g_free(job->flags);
+        g_array_free(job->run_ms, TRUE);
+        g_free(job);
+    }
+    g_rmdir(matrix->dir);
+    g_ptr_array_free(matrix->jobs, TRUE);
+    g_queue_clear(&matrix->run_queue);
+    g_strfreev(matrix->base_flags);
+    g_strfreev(matrix->linker_flags);
+    g_object_unref(matrix->store);
+    g_free(matrix->source);
+    g_free(matrix->dir);
+    g_free(matrix);
+}
 
-        /* 4. THE EDITOR & GUTTER (GtkSourceView) */
-        "GtkSourceView, text { background-color: #1e1e1e; color: #d4d4d4; font-family: 'Monospace'; }"
-        "gutter, GtkSourceView gutter text { background-color: #1e1e1e; color: #858585; border-right: 1px solid #333333; }"
-        "GtkSourceView gutter text.current-line { color: #ffffff; font-weight: bold; }"
-        "GtkSourceView text.current-line { background-color: #2a2a2a; }"
-        "GtkSourceView { caret-color: #ffffff; }"
-        "GtkSourceView text:selected { background-color: #264f78; color: #ffffff; }"
+/* Called as each subprocess is reaped; FALSE when the window is gone and nothing more should start */
+static gboolean matrix_release(BuildMatrix *matrix) {
+    matrix->pending--;
+    if (matrix->window) return TRUE;
+    if (matrix->pending == 0) matrix_free(matrix);
+    return FALSE;
+}
 
-        /* 5. THE SIDEBAR (Treeview) */
-        "treeview { background-color: #252526; color: #cccccc; }"
-        "treeview:selected { background-color: #37373d; color: #ffffff; }"
-        "treeview:hover { background-color: #2a2d2e; }";
+static void matrix_update_progress(BuildMatrix *matrix) {
+    guint finished = 0;
+    for (guint i = 0; i < matrix->jobs->len; i++) {
+        MatrixJob *job = g_ptr_array_index(matrix->jobs, i);
+        gchar *status;
+        gtk_tree_model_get(GTK_TREE_MODEL(matrix->store), &job->iter, MATRIX_COL_STATUS, &status, -1);
+        if (g_strcmp0(status, "done") == 0 || g_str_has_prefix(status, "failed")) finished++;
+        g_free(status);
+    }
+    gchar *text = g_strdup_printf("%u of %u done, %u compiling", finished, matrix->jobs->len,
+                                  matrix->compiling);
+    gtk_progress_bar_set_fraction(GTK_PROGRESS_BAR(matrix->progress),
+                                  matrix->jobs->len ? (gdouble)finished / matrix->jobs->len : 1);
+    gtk_progress_bar_set_text(GTK_PROGRESS_BAR(matrix->progress), text);
+    g_free(text);
+}
 
-    gtk_style_context_add_provider_for_screen(gdk_screen_get_default(),
-                                             GTK_STYLE_PROVIDER(css),
-                                             GTK_STYLE_PROVIDER_PRIORITY_APPLICATION);
-    gtk_css_provider_load_from_data(css, data, -1, NULL);
-    return css;
+static void matrix_set_status(BuildMatrix *matrix, MatrixJob *job, const gchar *status) {
+    gtk_list_store_set(matrix->store, &job->iter, MATRIX_COL_STATUS, status, -1);
+    matrix_update_progress(matrix);
 }
 
-static GtkCssProvider *create_green_theme(void) {
-    GtkCssProvider *css = gtk_css_provider_new();
-const gchar *data =
-    /* 1. Base Window & Panels */
-    "window, .background { background-color: #000000; }"
-    /* TITLE BAR STYLING */
-    "headerbar { background-color: #000000; border-bottom: 2px solid #004400; }"
-    "headerbar .title { color: #00FF41 ; font-family: 'Monospace'; }"
-    "headerbar button { color: #00FF41; background: #000000; border: 1px solid #004400; }"
-    "headerbar button:hover { background: #00FF41; color: #000000; }"
-    "headerbar text { color: #00FF41; background: #004400; }"
+static void on_matrix_run_done(GObject *source, GAsyncResult *result, gpointer data) {
+    BuildMatrix *matrix = data;
+    GSubprocess *process = G_SUBPROCESS(source);
+    gboolean ok = g_subprocess_wait_finish(process, result, NULL);
+    gint64 elapsed = g_get_monotonic_time();
     
-    "box, grid, paned { border: 1px solid #004400; }" /* Subtler cyan/green border */
-
-    /* 2. THE MENUBAR (The Top Bar) */
-    "menubar { background-color: #000000; color: #00FF41; border-bottom: 4px solid #004400; }"
+    matrix->run_process = NULL;
+    if (!matrix_release(matrix)) {
+        g_object_unref(process);
+        return;
+    }
+    MatrixJob *job = matrix->running;
+    gdouble ms = (elapsed - job->started) / 1000.0;
+    
+    if (!ok || !g_subprocess_get_successful(process)) {
+        gchar *status = g_strdup_printf("failed: exit %d", g_subprocess_get_if_exited(process) ?
+                                        g_subprocess_get_exit_status(process) : -1);
+        matrix_set_status(matrix, job, status);
+        g_free(status);
+    } else {
+        g_array_append_val(job->run_ms, ms);
+        if ((gint)job->run_ms->len < matrix->runs) {
+            g_object_unref(process);
+            matrix_run_next(matrix);
+            return;
+        }
+        g_array_sort(job->run_ms, compare_gdouble);
+        gtk_list_store_set(matrix->store, &job->iter, MATRIX_COL_RUN,
+                           g_array_index(job->run_ms, gdouble, job->run_ms->len / 2), -1);
+        matrix_set_status(matrix, job, "done");
+    }
+    g_object_unref(process);
+    matrix->running = NULL;
+    matrix_run_next(matrix);
+}
+
+/* Runs wait until no compiler is running; a running job repeats until it has all its runs */
+static void matrix_run_next(BuildMatrix *matrix) {
+    GError *error = NULL;
+    
+    if (!matrix->running) {
+        if (matrix->compiling > 0 || g_queue_is_empty(&matrix->run_queue)) return;
+        matrix->running = g_queue_pop_head(&matrix->run_queue);
+        matrix_set_status(matrix, matrix->running, "running");
+    }
+    MatrixJob *job = matrix->running;
+    
+    job->started = g_get_monotonic_time();
+    GSubprocess *process = g_subprocess_new(G_SUBPROCESS_FLAGS_STDOUT_SILENCE, &error,
+                                            job->binary, NULL);
+    if (!process) {
+        gchar *status = g_strdup_printf("failed: %s", error->message);
+        matrix_set_status(matrix, job, status);
+        g_free(status);
+        g_error_free(error);
+        matrix->running = NULL;
+        matrix_run_next(matrix);
+        return;
+    }
+    matrix->pending++;
+    matrix->run_process = process;
+    g_subprocess_wait_async(process, NULL, on_matrix_run_done, matrix);
+}
+
+static void on_matrix_compile_done(GObject *source, GAsyncResult *result, gpointer data) {
+    BuildMatrix *matrix = data;
+    GSubprocess *process = G_SUBPROCESS(source);
+    gchar *errors = NULL;
+    gboolean ok = g_subprocess_communicate_utf8_finish(process, result, NULL, &errors, NULL);
+    gint64 now = g_get_monotonic_time();
+    MatrixJob *job = g_object_get_data(G_OBJECT(process), "matrix-job");
+    
+    if (!matrix_release(matrix)) {
+        g_free(errors);
+        g_object_unref(process);
+        return;
+    }
+    matrix->compiling--;
+    gtk_list_store_set(matrix->store, &job->iter, MATRIX_COL_COMPILE,
+                       (now - job->started) / 1000.0, -1);
+    
+    GStatBuf st;
+    if (ok && g_subprocess_get_successful(process) && g_stat(job->binary, &st) == 0) {
+        gtk_list_store_set(matrix->store, &job->iter, MATRIX_COL_SIZE, st.st_size / 1024.0, -1);
+        g_queue_push_tail(&matrix->run_queue, job);
+        matrix_set_status(matrix, job, "queued to run");
+    } else {
+        /* First line of the compiler output is enough for the table, the rest goes to the terminal */
+        gchar *first = errors ? g_strndup(errors, strcspn(errors, "\n")) : g_strdup("");
+        gchar *status = g_strdup_printf("failed: %s", first);
+        matrix_set_status(matrix, job, status);
+        g_print("\n=== Matrix build failed: %s ===\n%s", job->flags, errors ? errors : "");
+        g_free(status);
+        g_free(first);
+    }
+    g_free(errors);
+    g_object_unref(process);
+    
+    matrix_compile_next(matrix);
+    matrix_run_next(matrix);
+}
+
+static void matrix_compile_next(BuildMatrix *matrix) {
+    while (matrix->compiling < matrix->max_parallel && matrix->next_compile < matrix->jobs->len) {
+        MatrixJob *job = g_ptr_array_index(matrix->jobs, matrix->next_compile++);
+        GPtrArray *argv = g_ptr_array_new();
+        gchar **flags = g_strsplit(job->flags, " ", -1);
+        GError *error = NULL;
+        
+        g_ptr_array_add(argv, "gcc");
+        for (gint i = 0; matrix->base_flags && matrix->base_flags[i]; i++)
+            g_ptr_array_add(argv, matrix->base_flags[i]);
+        for (gint i = 0; flags[i]; i++)
+            if (*flags[i]) g_ptr_array_add(argv, flags[i]);
+        g_ptr_array_add(argv, matrix->source);
+        g_ptr_array_add(argv, "-o");
+        g_ptr_array_add(argv, job->binary);
+        for (gint i = 0; matrix->linker_flags && matrix->linker_flags[i]; i++)
+            g_ptr_array_add(argv, matrix->linker_flags[i]);
+        g_ptr_array_add(argv, NULL);
+        
+        job->started = g_get_monotonic_time();
+        GSubprocess *process = g_subprocess_newv((const gchar * const *)argv->pdata,
+                                                 G_SUBPROCESS_FLAGS_STDERR_MERGE |
+                                                 G_SUBPROCESS_FLAGS_STDOUT_PIPE, &error);
+        g_ptr_array_free(argv, TRUE);
+        g_strfreev(flags);
+        if (!process) {
+            gchar *status = g_strdup_printf("failed: %s", error->message);
+            matrix_set_status(matrix, job, status);
+            g_free(status);
+            g_error_free(error);
+            continue;
+        }
+        g_object_set_data(G_OBJECT(process), "matrix-job", job);
+        matrix->compiling++;
+        matrix->pending++;
+        matrix_set_status(matrix, job, "compiling");
+        g_subprocess_communicate_utf8_async(process, NULL, NULL, on_matrix_compile_done, matrix);
+    }
+}
+
+static void on_matrix_window_destroy(GtkWidget *widget, gpointer data) {
+    BuildMatrix *matrix = data;
+    
+    /* Compiles are left to finish so their output can be deleted; the benchmark is not */
+    matrix->window = NULL;
+    if (matrix->run_process) g_subprocess_force_exit(matrix->run_process);
+    if (matrix->pending == 0) matrix_free(matrix);
+}
+
+static void matrix_cell_data(GtkTreeViewColumn *column, GtkCellRenderer *cell, GtkTreeModel *model,
+                             GtkTreeIter *iter, gpointer data) {
+    gint col = GPOINTER_TO_INT(data);
+    gdouble value;
+    gchar text[32] = "";
+    
+    gtk_tree_model_get(model, iter, col, &value, -1);
+    if (value >= 0) g_snprintf(text, sizeof(text), col == MATRIX_COL_SIZE ? "%.1f" : "%.2f", value);
+    g_object_set(cell, "text", text, NULL);
+}
+
+static void matrix_add_column(GtkWidget *tree, const gchar *title, gint col) {
+    GtkCellRenderer *cell = gtk_cell_renderer_text_new();
+    GtkTreeViewColumn *column;
+    
+    if (col == MATRIX_COL_FLAGS || col == MATRIX_COL_STATUS) {
+        column = gtk_tree_view_column_new_with_attributes(title, cell, "text", col, NULL);
+    } else {
+        g_object_set(cell, "xalign", 1.0, NULL);
+        column = gtk_tree_view_column_new_with_attributes(title, cell, NULL);
+        gtk_tree_view_column_set_cell_data_func(column, cell, matrix_cell_data, GINT_TO_POINTER(col), NULL);
+    }
+    gtk_tree_view_column_set_sort_column_id(column, col);
+    gtk_tree_view_column_set_resizable(column, TRUE);
+    gtk_tree_view_append_column(GTK_TREE_VIEW(tree), column);
+}
+
+/* Every combination of one level with each optional flag on and off */
+static void start_build_matrix(EditorApp *app, const gchar *base_flags, const gchar *linker_flags,
+                               GPtrArray *levels, GPtrArray *toggles, gint runs) {
+    BuildMatrix *matrix = g_new0(BuildMatrix, 1);
+    GError *error = NULL;
+    
+    matrix->dir = g_dir_make_tmp("scrible-matrix-XXXXXX", &error);
+    if (!matrix->dir ||
+        (*base_flags && !g_shell_parse_argv(base_flags, NULL, &matrix->base_flags, &error)) ||
+        (*linker_flags && !g_shell_parse_argv(linker_flags, NULL, &matrix->linker_flags, &error))) {
+        g_print("Matrix build: %s\n", error->message);
+        g_error_free(error);
+        if (matrix->dir) g_rmdir(matrix->dir);
+        g_strfreev(matrix->base_flags);
+        g_free(matrix->dir);
+        g_free(matrix);
+        return;
+    }
+    matrix->source = g_strdup(app->current_file);
+    matrix->runs = runs;
+    matrix->max_parallel = g_get_num_processors();
+    matrix->jobs = g_ptr_array_new();
+    g_queue_init(&matrix->run_queue);
+    matrix->store = gtk_list_store_new(MATRIX_NUM_COLS, G_TYPE_STRING, G_TYPE_DOUBLE,
+                                       G_TYPE_DOUBLE, G_TYPE_DOUBLE, G_TYPE_STRING);
+    
+    for (guint l = 0; l < levels->len; l++) {
+        for (guint mask = 0; mask < (1u << toggles->len); mask++) {
+            GString *flags = g_string_new(g_ptr_array_index(levels, l));
+            for (guint t = 0; t < toggles->len; t++)
+                if (mask & (1u << t)) g_string_append_printf(flags, " %s", (gchar *)g_ptr_array_index(toggles, t));
+            
+            MatrixJob *job = g_new0(MatrixJob, 1);
+            job->flags = g_string_free(flags, FALSE);
+            job->binary = g_strdup_printf("%s/build-%u", matrix->dir, matrix->jobs->len);
+            job->run_ms = g_array_new(FALSE, FALSE, sizeof(gdouble));
+            gtk_list_store_insert_with_values(matrix->store, &job->iter, -1,
+                                              MATRIX_COL_FLAGS, job->flags, MATRIX_COL_SIZE, -1.0,
+                                              MATRIX_COL_COMPILE, -1.0, MATRIX_COL_RUN, -1.0,
+                                              MATRIX_COL_STATUS, "waiting", -1);
+            g_ptr_array_add(matrix->jobs, job);
+        }
+    }
+    
+    GtkWidget *tree = gtk_tree_view_new_with_model(GTK_TREE_MODEL(matrix->store));
+    matrix_add_column(tree, "Flags", MATRIX_COL_FLAGS);
+    matrix_add_column(tree, "Size KB", MATRIX_COL_SIZE);
+    matrix_add_column(tree, "Compile ms", MATRIX_COL_COMPILE);
+    matrix_add_column(tree, "Run ms", MATRIX_COL_RUN);
+    matrix_add_column(tree, "Status", MATRIX_COL_STATUS);
+    
+    GtkWidget *scroll = gtk_scrolled_window_new(NULL, NULL);
+    gtk_container_add(GTK_CONTAINER(scroll), tree);
+    matrix->progress = gtk_progress_bar_new();
+    gtk_progress_bar_set_show_text(GTK_PROGRESS_BAR(matrix->progress), TRUE);
+    GtkWidget *vbox = gtk_box_new(GTK_ORIENTATION_VERTICAL, 6);
+    gtk_container_set_border_width(GTK_CONTAINER(vbox), 6);
+    gtk_box_pack_start(GTK_BOX(vbox), scroll, TRUE, TRUE, 0);
+    gtk_box_pack_start(GTK_BOX(vbox), matrix->progress, FALSE, FALSE, 0);
+    
+    gchar *basename = g_path_get_basename(app->current_file);
+    gchar *title = g_strdup_printf("Optimization Matrix: %s", basename);
+    matrix->window = gtk_window_new(GTK_WINDOW_TOPLEVEL);
+    gtk_window_set_title(GTK_WINDOW(matrix->window), title);
+    gtk_window_set_transient_for(GTK_WINDOW(matrix->window), GTK_WINDOW(app->window));
+    gtk_window_set_default_size(GTK_WINDOW(matrix->window), 720, 420);
+    gtk_container_add(GTK_CONTAINER(matrix->window), vbox);
+    g_signal_connect(matrix->window, "destroy", G_CALLBACK(on_matrix_window_destroy), matrix);
+    gtk_widget_show_all(matrix->window);
+    g_free(title);
+    g_free(basename);
+    
+    g_print("\n=== Matrix build: %u configurations, %u in parallel ===\n",
+            matrix->jobs->len, matrix->max_parallel);
+    matrix_compile_next(matrix);
+}
+
+/* Build: Optimization Matrix... dialog; flags default to the Build Options ones when called from there */
+static void show_build_matrix_dialog(EditorApp *app, const gchar *flags, const gchar *linker) {
+    static const gchar *levels[] = { "-O0", "-O1", "-O2", "-O3", "-Os" };
+    static const gchar *toggles[] = { "-march=native", "-flto", "-ffast-math" };
+    GtkWidget *level_checks[G_N_ELEMENTS(levels)], *toggle_checks[G_N_ELEMENTS(toggles)];
+    
+    if (!app->current_file) {
+        g_print("Save the file first before building!\n");
+        return;
+    }
+    
+    GtkWidget *dialog = gtk_dialog_new_with_buttons("Optimization Matrix",
+                                         GTK_WINDOW(app->window),
+                                         GTK_DIALOG_MODAL | GTK_DIALOG_DESTROY_WITH_PARENT,
+                                         "_Cancel", GTK_RESPONSE_CANCEL,
+                                         "_Build All", GTK_RESPONSE_ACCEPT,
+                                         NULL);
+    GtkWidget *content_area = gtk_dialog_get_content_area(GTK_DIALOG(dialog));
+    GtkWidget *grid = gtk_grid_new();
+    gtk_grid_set_column_spacing(GTK_GRID(grid), 10);
+    gtk_grid_set_row_spacing(GTK_GRID(grid), 6);
+    gtk_container_set_border_width(GTK_CONTAINER(grid), 15);
+    
+    GtkWidget *label = gtk_label_new("Levels:");
+    gtk_widget_set_halign(label, GTK_ALIGN_END);
+    gtk_grid_attach(GTK_GRID(grid), label, 0, 0, 1, 1);
+    GtkWidget *level_box = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 6);
+    for (guint i = 0; i < G_N_ELEMENTS(levels); i++) {
+        level_checks[i] = gtk_check_button_new_with_label(levels[i]);
+        gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(level_checks[i]), i != 1);
+        gtk_box_pack_start(GTK_BOX(level_box), level_checks[i], FALSE, FALSE, 0);
+    }
+    gtk_grid_attach(GTK_GRID(grid), level_box, 1, 0, 1, 1);
+    
+    label = gtk_label_new("With and without:");
+    gtk_widget_set_halign(label, GTK_ALIGN_END);
+    gtk_grid_attach(GTK_GRID(grid), label, 0, 1, 1, 1);
+    GtkWidget *toggle_box = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 6);
+    for (guint i = 0; i < G_N_ELEMENTS(toggles); i++) {
+        toggle_checks[i] = gtk_check_button_new_with_label(toggles[i]);
+        gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(toggle_checks[i]), TRUE);
+        gtk_box_pack_start(GTK_BOX(toggle_box), toggle_checks[i], FALSE, FALSE, 0);
+    }
+    gtk_grid_attach(GTK_GRID(grid), toggle_box, 1, 1, 1, 1);
+    
+    GtkWidget *flags_entry = gtk_entry_new();
+    gtk_entry_set_text(GTK_ENTRY(flags_entry), flags);
+    GtkWidget *linker_entry = gtk_entry_new();
+    gtk_entry_set_text(GTK_ENTRY(linker_entry), linker);
+    GtkWidget *runs_spin = gtk_spin_button_new_with_range(1, 100, 1);
+    gtk_spin_button_set_value(GTK_SPIN_BUTTON(runs_spin), 3);
+    const gchar *labels[] = { "Other Flags:", "Linker Flags:", "Runs Each:" };
+    GtkWidget *fields[] = { flags_entry, linker_entry, runs_spin };
+    for (guint i = 0; i < G_N_ELEMENTS(fields); i++) {
+        label = gtk_label_new(labels[i]);
+        gtk_widget_set_halign(label, GTK_ALIGN_END);
+        gtk_grid_attach(GTK_GRID(grid), label, 0, i + 2, 1, 1);
+        gtk_grid_attach(GTK_GRID(grid), fields[i], 1, i + 2, 1, 1);
+    }
+    gtk_container_add(GTK_CONTAINER(content_area), grid);
+    gtk_widget_show_all(content_area);
+    
+    if (gtk_dialog_run(GTK_DIALOG(dialog)) == GTK_RESPONSE_ACCEPT) {
+        GPtrArray *chosen_levels = g_ptr_array_new();
+        GPtrArray *chosen_toggles = g_ptr_array_new();
+        for (guint i = 0; i < G_N_ELEMENTS(levels); i++)
+            if (gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(level_checks[i])))
+                g_ptr_array_add(chosen_levels, (gpointer)levels[i]);
+        for (guint i = 0; i < G_N_ELEMENTS(toggles); i++)
+            if (gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(toggle_checks[i])))
+                g_ptr_array_add(chosen_toggles, (gpointer)toggles[i]);
+        if (chosen_levels->len == 0) g_ptr_array_add(chosen_levels, "");
+        
+        start_build_matrix(app, gtk_entry_get_text(GTK_ENTRY(flags_entry)),
+                           gtk_entry_get_text(GTK_ENTRY(linker_entry)), chosen_levels, chosen_toggles,
+                           gtk_spin_button_get_value_as_int(GTK_SPIN_BUTTON(runs_spin)));
+        g_ptr_array_free(chosen_levels, TRUE);
+        g_ptr_array_free(chosen_toggles, TRUE);
+    }
+    gtk_widget_destroy(dialog);
+}
+
+static void on_build_matrix(GtkWidget *widget, gpointer data) {
+    EditorApp *app = (EditorApp *)data;
+    show_build_matrix_dialog(app, app->build_flags ? app->build_flags : DEFAULT_BUILD_FLAGS, "");
+}
+
+/*
+ * Assembly View
+ * A pane beside the editor with the compiler's output for the saved file,
+ * built with the Build Options flags (plus -g) in the background on every
+ * save. Each assembly line carries the source line it came from, taken from
+ * the .loc directives (gcc -S) or the file:line markers (objdump -dl), so
+ * the cursor in either pane highlights the matching lines in the other.
+ * Results are cached by a hash of the text, flags and mode, so undoing back
+ * to an earlier version or switching modes shows the listing immediately.
+ */
+#define ASM_CACHE_SIZE 16
+
+enum {
+    ASM_MODE_GCC_S = 0,       /* gcc -S: compiler output with labels */
+    ASM_MODE_OBJDUMP          /* gcc -c then objdump -dl: what the assembler produced */
+};
+
+typedef struct {
+    gchar *text;              /* filtered listing shown in the pane */
+    GArray *lines;            /* gint source line for each listing line, 0 = none */
+} AsmListing;
+
+typedef struct AsmView {
+    GtkWidget *pane;
+    GtkWidget *view;
+    GtkSourceBuffer *buffer;
+    GtkWidget *mode_combo;
+    GtkWidget *status;
+    GHashTable *cache;        /* key -> AsmListing */
+    GQueue cache_order;       /* keys, oldest first */
+    AsmListing *shown;        /* owned by the cache */
+    GSubprocess *process;     /* compile in flight */
+    gchar *process_key;
+    gchar *object;            /* objdump mode: temporary object file */
+    gboolean again;           /* saved again while compiling */
+    gint source_line;         /* editor line whose assembly is highlighted */
+} AsmView;
+
+static void asm_listing_free(gpointer data) {
+    AsmListing *listing = data;
+    g_free(listing->text);
+    g_array_free(listing->lines, TRUE);
+    g_free(listing);
+}
+
+static void asm_listing_append(AsmListing *listing, GString *out, const gchar *line, gsize len,
+                               gint source) {
+    g_string_append_len(out, line, len);
+    g_string_append_c(out, '\n');
+    g_array_append_val(listing->lines, source);
+}
+
+/* The .file / file:line names that refer to the open file rather than a header */
+static gboolean asm_is_source_file(const gchar *name, gsize len, const gchar *basename) {
+    gsize n = strlen(basename);
+    return len >= n && strncmp(name + len - n, basename, n) == 0 &&
+           (len == n || name[len - n - 1] == '/');
+}
+
+/*
+ * gcc -S output: keep instructions and labels from code sections, drop
+ * directives and the compiler's own .LFB/.LVL style labels. A .loc applies
+ * to the instructions after it, until the next .loc.
+ */
+static AsmListing *asm_parse_gcc(const gchar *text, const gchar *basename) {
+    AsmListing *listing = g_new0(AsmListing, 1);
+    GString *out = g_string_new(NULL);
+    GArray *main_files = g_array_new(FALSE, FALSE, sizeof(gint));
+    gboolean in_code = FALSE;
+    gint source = 0;
+    
+    listing->lines = g_array_new(FALSE, FALSE, sizeof(gint));
+    for (const gchar *p = text; *p; ) {
+        const gchar *eol = strchr(p, '\n');
+        if (!eol) eol = p + strlen(p);
+        gsize len = eol - p;
+        const gchar *s = p;
+        while (s < eol && (*s == ' ' || *s == '\t')) s++;
+        
+        if (g_str_has_prefix(s, ".file ") && g_ascii_isdigit(s[6])) {
+            /* .file N "name" or .file N "dir" "name": the name is the last quoted string */
+            gint number = atoi(s + 6);
+            const gchar *close = eol;
+            while (close > s && *close != '"') close--;
+            const gchar *open = close - 1;
+            while (open > s && *open != '"') open--;
+            if (close > open && asm_is_source_file(open + 1, close - open - 1, basename))
+                g_array_append_val(main_files, number);
+        } else if (g_str_has_prefix(s, ".loc ")) {
+            gint file = atoi(s + 5);
+            const gchar *q = s + 5;
+            while (q < eol && g_ascii_isdigit(*q)) q++;
+            source = 0;
+            for (guint i = 0; i < main_files->len; i++)
+                if (g_array_index(main_files, gint, i) == file) source = atoi(q);
+        } else if (g_str_has_prefix(s, ".text") ||
+                   (g_str_has_prefix(s, ".section") && g_strstr_len(s, eol - s, ".text"))) {
+            in_code = TRUE;
+        } else if (g_str_has_prefix(s, ".section") || g_str_has_prefix(s, ".data") ||
+                   g_str_has_prefix(s, ".bss")) {
+            in_code = FALSE;
+        } else if (in_code && s < eol && *s != '#') {
+            gboolean label = s == p && eol[-1] == ':';
+            if (label && s[0] == '.' && s[1] == 'L' && !g_ascii_isdigit(s[2])) {
+                /* .LFB0:, .LVL3: and friends only exist for the debug info */
+            } else if (label) {
+                asm_listing_append(listing, out, p, len, 0);
+            } else if (*s != '.') {
+                asm_listing_append(listing, out, p, len, source);
+            }
+        }
+        p = *eol ? eol + 1 : eol;
+    }
+    g_array_free(main_files, TRUE);
+    listing->text = g_string_free(out, FALSE);
+    return listing;
+}
+
+/* objdump -dl --no-show-raw-insn: "<func>:" headers, "path:line" markers and instructions */
+static AsmListing *asm_parse_objdump(const gchar *text, const gchar *basename) {
+    AsmListing *listing = g_new0(AsmListing, 1);
+    GString *out = g_string_new(NULL);
+    gint source = 0;
+    
+    listing->lines = g_array_new(FALSE, FALSE, sizeof(gint));
+    for (const gchar *p = text; *p; ) {
+        const gchar *eol = strchr(p, '\n');
+        if (!eol) eol = p + strlen(p);
+        gsize len = eol - p;
+        const gchar *colon = memchr(p, ':', len);
+        
+        if (len > 0 && g_ascii_isxdigit(*p) && memchr(p, '<', len) && eol[-1] == ':') {
+            if (out->len > 0) asm_listing_append(listing, out, "", 0, 0);
+            asm_listing_append(listing, out, p, len, 0);
+            source = 0;
+        } else if (len > 0 && *p == ' ' && colon) {
+            asm_listing_append(listing, out, p, len, source);
+        } else if (colon && colon > p && g_ascii_isdigit(colon[1])) {
+            source = asm_is_source_file(p, colon - p, basename) ? atoi(colon + 1) : 0;
+        }
+        p = *eol ? eol + 1 : eol;
+    }
+    listing->text = g_string_free(out, FALSE);
+    return listing;
+}
+
+/* Apply tag to every run of listing lines that came from source line (0 = just remove it) */
+static gint asm_tag_block(AsmView *asm_view, gint source) {
+    GtkTextBuffer *buffer = GTK_TEXT_BUFFER(asm_view->buffer);
+    GtkTextIter start, end;
+    gint first = -1;
+    
+    gtk_text_buffer_get_bounds(buffer, &start, &end);
+    gtk_text_buffer_remove_tag_by_name(buffer, "asm_current", &start, &end);
+    if (!asm_view->shown || source <= 0) return -1;
+    
+    GArray *lines = asm_view->shown->lines;
+    for (guint i = 0; i < lines->len; i++) {
+        if (g_array_index(lines, gint, i) != source) continue;
+        guint j = i;
+        while (j + 1 < lines->len && g_array_index(lines, gint, j + 1) == source) j++;
+        gtk_text_buffer_get_iter_at_line(buffer, &start, i);
+        gtk_text_buffer_get_iter_at_line(buffer, &end, j);
+        gtk_text_iter_forward_to_line_end(&end);
+        gtk_text_buffer_apply_tag_by_name(buffer, "asm_current", &start, &end);
+        if (first < 0) first = i;
+        i = j;
+    }
+    return first;
+}
+
+static void asm_scroll_to_line(GtkWidget *view, gint line) {
+    GtkTextBuffer *buffer = gtk_text_view_get_buffer(GTK_TEXT_VIEW(view));
+    GtkTextIter iter;
+    
+    gtk_text_buffer_get_iter_at_line(buffer, &iter, line);
+    GtkTextMark *mark = gtk_text_buffer_get_mark(buffer, "asm-scroll");
+    if (mark) gtk_text_buffer_move_mark(buffer, mark, &iter);
+    else mark = gtk_text_buffer_create_mark(buffer, "asm-scroll", &iter, FALSE);
+    gtk_text_view_scroll_to_mark(GTK_TEXT_VIEW(view), mark, 0.1, FALSE, 0, 0);
+}
+
+/* Editor cursor moved: highlight and reveal its assembly */
+static void asm_view_follow_cursor(EditorApp *app) {
+    AsmView *asm_view = app->asm_view;
+    GtkTextIter cursor;
+    
+    gtk_text_buffer_get_iter_at_mark(GTK_TEXT_BUFFER(app->buffer), &cursor,
+                                     gtk_text_buffer_get_insert(GTK_TEXT_BUFFER(app->buffer)));
+    gint line = gtk_text_iter_get_line(&cursor) + 1;
+    if (line == asm_view->source_line) return;
+    asm_view->source_line = line;
+    
+    gint first = asm_tag_block(asm_view, line);
+    if (first >= 0) asm_scroll_to_line(asm_view->view, first);
+}
+
+/* Cursor moved in the listing: highlight the source line it came from, and its whole block */
+static void on_asm_cursor_moved(GtkTextBuffer *buffer, GtkTextIter *location, GtkTextMark *mark,
+                                gpointer data) {
+    EditorApp *app = (EditorApp *)data;
+    AsmView *asm_view = app->asm_view;
+    GtkTextBuffer *source_buffer = GTK_TEXT_BUFFER(app->buffer);
+    GtkTextIter start, end;
+    
+    if (mark != gtk_text_buffer_get_insert(buffer) || !asm_view->shown) return;
+    gint index = gtk_text_iter_get_line(location);
+    if (index < 0 || (guint)index >= asm_view->shown->lines->len) return;
+    gint source = g_array_index(asm_view->shown->lines, gint, index);
+    
+    gtk_text_buffer_get_bounds(source_buffer, &start, &end);
+    gtk_text_buffer_remove_tag_by_name(source_buffer, "asm_source", &start, &end);
+    if (source <= 0 || source > gtk_text_buffer_get_line_count(source_buffer)) return;
+    
+    gtk_text_buffer_get_iter_at_line(source_buffer, &start, source - 1);
+    end = start;
+    gtk_text_iter_forward_line(&end);
+    gtk_text_buffer_apply_tag_by_name(source_buffer, "asm_source", &start, &end);
+    asm_scroll_to_line(app->view, source - 1);
+    asm_tag_block(asm_view, source);
+    asm_view->source_line = source;
+}
+
+static void asm_view_show(EditorApp *app, AsmListing *listing, const gchar *status) {
+    AsmView *asm_view = app->asm_view;
+    
+    /* Not set until the text is in, so the cursor reset does not count as a click */
+    asm_view->shown = NULL;
+    asm_view->source_line = 0;
+    gtk_text_buffer_set_text(GTK_TEXT_BUFFER(asm_view->buffer), listing->text, -1);
+    asm_view->shown = listing;
+    gtk_label_set_text(GTK_LABEL(asm_view->status), status);
+    if (gtk_widget_get_visible(asm_view->pane)) asm_view_follow_cursor(app);
+}
+
+/* Failures are shown in the pane but not cached */
+static void asm_view_show_error(EditorApp *app, const gchar *what, const gchar *output) {
+    AsmView *asm_view = app->asm_view;
+    
+    asm_view->shown = NULL;
+    gtk_text_buffer_set_text(GTK_TEXT_BUFFER(asm_view->buffer), output ? output : "", -1);
+    gtk_label_set_text(GTK_LABEL(asm_view->status), what);
+}
+
+static void asm_view_finish(EditorApp *app, const gchar *output, const gchar *errors, gboolean ok) {
+    AsmView *asm_view = app->asm_view;
+    /* As they were when the compile started: the mode or file may have changed since */
+    gint64 start = GPOINTER_TO_SIZE(g_object_get_data(G_OBJECT(asm_view->process), "started"));
+    gint mode = GPOINTER_TO_INT(g_object_get_data(G_OBJECT(asm_view->process), "mode"));
+    gchar *basename = g_strdup(g_object_get_data(G_OBJECT(asm_view->process), "basename"));
+    
+    g_clear_object(&asm_view->process);
+    if (ok) {
+        AsmListing *listing = mode == ASM_MODE_OBJDUMP ? asm_parse_objdump(output, basename)
+                                                       : asm_parse_gcc(output, basename);
+        gchar *status = g_strdup_printf("%u lines, %.0f ms", listing->lines->len,
+                                        (g_get_monotonic_time() - start) / 1000.0);
+        
+        if (g_queue_get_length(&asm_view->cache_order) >= ASM_CACHE_SIZE)
+            g_hash_table_remove(asm_view->cache, g_queue_pop_head(&asm_view->cache_order));
+        g_hash_table_insert(asm_view->cache, asm_view->process_key, listing);
+        g_queue_push_tail(&asm_view->cache_order, asm_view->process_key);
+        asm_view->process_key = NULL;
+        asm_view_show(app, listing, status);
+        g_free(status);
+    } else {
+        asm_view_show_error(app, "Compile failed", errors);
+        g_clear_pointer(&asm_view->process_key, g_free);
+    }
+    g_free(basename);
+    
+    if (asm_view->again) {
+        asm_view->again = FALSE;
+        asm_view_refresh(app);
+    }
+}
+
+static void on_asm_objdump_done(GObject *source, GAsyncResult *result, gpointer data) {
+    EditorApp *app = (EditorApp *)data;
+    GSubprocess *process = G_SUBPROCESS(source);
+    gchar *output = NULL, *errors = NULL;
+    gboolean ok = g_subprocess_communicate_utf8_finish(process, result, &output, &errors, NULL) &&
+                  g_subprocess_get_successful(process);
+    
+    g_unlink(app->asm_view->object);
+    asm_view_finish(app, output, errors, ok);
+    g_free(output);
+    g_free(errors);
+}
+
+static void on_asm_compile_done(GObject *source, GAsyncResult *result, gpointer data) {
+    EditorApp *app = (EditorApp *)data;
+    AsmView *asm_view = app->asm_view;
+    GSubprocess *process = G_SUBPROCESS(source);
+    gchar *output = NULL, *errors = NULL;
+    gboolean ok = g_subprocess_communicate_utf8_finish(process, result, &output, &errors, NULL) &&
+                  g_subprocess_get_successful(process);
+    
+    if (ok && GPOINTER_TO_INT(g_object_get_data(G_OBJECT(process), "mode")) == ASM_MODE_OBJDUMP) {
+        /* Second stage: disassemble the object, keeping the start time of the first */
+        GError *error = NULL;
+        GSubprocess *objdump = g_subprocess_new(G_SUBPROCESS_FLAGS_STDOUT_PIPE |
+                                                G_SUBPROCESS_FLAGS_STDERR_PIPE, &error,
+                                                "objdump", "-dl", "--no-show-raw-insn",
+                                                asm_view->object, NULL);
+        if (objdump) {
+            g_object_set_data(G_OBJECT(objdump), "started",
+                              g_object_get_data(G_OBJECT(process), "started"));
+            g_object_set_data(G_OBJECT(objdump), "mode", GINT_TO_POINTER(ASM_MODE_OBJDUMP));
+            g_object_set_data_full(G_OBJECT(objdump), "basename",
+                                   g_strdup(g_object_get_data(G_OBJECT(process), "basename")), g_free);
+            g_object_unref(asm_view->process);
+            asm_view->process = objdump;
+            g_subprocess_communicate_utf8_async(objdump, NULL, NULL, on_asm_objdump_done, app);
+            g_free(output);
+            g_free(errors);
+            return;
+        }
+        g_free(errors);
+        errors = g_strdup(error->message);
+        g_error_free(error);
+        ok = FALSE;
+    }
+    if (asm_view->object) g_unlink(asm_view->object);
+    asm_view_finish(app, output, errors, ok);
+    g_free(output);
+    g_free(errors);
+}
+
+/* Keyed by the file as gcc will read it from disk, not the buffer, which may have unsaved edits */
+static gchar *asm_cache_key(EditorApp *app, const gchar *flags, gint mode) {
+    GChecksum *checksum = g_checksum_new(G_CHECKSUM_SHA256);
+    gchar *text = NULL;
+    gsize length = 0;
+    
+    if (!g_file_get_contents(app->current_file, &text, &length, NULL)) length = 0;
+    g_checksum_update(checksum, (const guchar *)(text ? text : ""), length);
+    g_checksum_update(checksum, (const guchar *)"\0", 1);
+    g_checksum_update(checksum, (const guchar *)flags, -1);
+    g_checksum_update(checksum, (const guchar *)"\0", 1);
+    g_checksum_update(checksum, (const guchar *)(mode == ASM_MODE_OBJDUMP ? "objdump" : "gcc-S"), -1);
+    g_checksum_update(checksum, (const guchar *)"\0", 1);
+    g_checksum_update(checksum, (const guchar *)app->current_file, -1);
+    gchar *key = g_strdup(g_checksum_get_string(checksum));
+    
+    g_checksum_free(checksum);
+    g_free(text);
+    return key;
+}
+
+/* Show the listing for the saved file, from the cache or by starting a compile */
+static void asm_view_refresh(EditorApp *app) {
+    AsmView *asm_view = app->asm_view;
+    const gchar *flags = app->build_flags ? app->build_flags : DEFAULT_BUILD_FLAGS;
+    GError *error = NULL;
+    gchar **user_flags = NULL;
+    
+    if (!asm_view || !gtk_widget_get_visible(asm_view->pane)) return;
+    if (!app->current_file) {
+        asm_view_show_error(app, "Save the file to see its assembly", NULL);
+        return;
+    }
+    if (asm_view->process) {
+        asm_view->again = TRUE;
+        return;
+    }
+    
+    gint mode = gtk_combo_box_get_active(GTK_COMBO_BOX(asm_view->mode_combo));
+    gchar *key = asm_cache_key(app, flags, mode);
+    AsmListing *cached = g_hash_table_lookup(asm_view->cache, key);
+    if (cached) {
+        g_free(key);
+        if (cached != asm_view->shown) asm_view_show(app, cached, "Cached");
+        return;
+    }
+    if (*flags && !g_shell_parse_argv(flags, NULL, &user_flags, &error)) {
+        asm_view_show_error(app, "Bad compiler flags", error->message);
+        g_error_free(error);
+        g_free(key);
+        return;
+    }
+    
+    GPtrArray *argv = g_ptr_array_new();
+    g_ptr_array_add(argv, "gcc");
+    for (gint i = 0; user_flags && user_flags[i]; i++)
+        g_ptr_array_add(argv, user_flags[i]);
+    g_ptr_array_add(argv, "-g");
+    if (mode == ASM_MODE_OBJDUMP) {
+        if (!asm_view->object) {
+            gint fd = g_file_open_tmp("scrible-asm-XXXXXX.o", &asm_view->object, NULL);
+            if (fd >= 0) close(fd);
+        }
+        g_ptr_array_add(argv, "-c");
+        g_ptr_array_add(argv, "-o");
+        g_ptr_array_add(argv, asm_view->object ? asm_view->object : "scrible-asm.o");
+    } else {
+        g_ptr_array_add(argv, "-S");
+        g_ptr_array_add(argv, "-fno-asynchronous-unwind-tables");
+        g_ptr_array_add(argv, "-o");
+        g_ptr_array_add(argv, "-");
+    }
+    g_ptr_array_add(argv, app->current_file);
+    g_ptr_array_add(argv, NULL);
+    
+    asm_view->process = g_subprocess_newv((const gchar * const *)argv->pdata,
+                                          G_SUBPROCESS_FLAGS_STDOUT_PIPE |
+                                          G_SUBPROCESS_FLAGS_STDERR_PIPE, &error);
+    g_ptr_array_free(argv, TRUE);
+    g_strfreev(user_flags);
+    if (!asm_view->process) {
+        asm_view_show_error(app, "Could not run gcc", error->message);
+        g_error_free(error);
+        g_free(key);
+        return;
+    }
+    g_object_set_data(G_OBJECT(asm_view->process), "started",
+                      GSIZE_TO_POINTER(g_get_monotonic_time()));
+    g_object_set_data(G_OBJECT(asm_view->process), "mode", GINT_TO_POINTER(mode));
+    g_object_set_data_full(G_OBJECT(asm_view->process), "basename",
+                           g_path_get_basename(app->current_file), g_free);
+    asm_view->process_key = key;
+    gtk_label_set_text(GTK_LABEL(asm_view->status), "Compiling...");
+    g_subprocess_communicate_utf8_async(asm_view->process, NULL, NULL, on_asm_compile_done, app);
+}
+
+static void on_asm_mode_changed(GtkComboBox *combo, gpointer data) {
+    asm_view_refresh((EditorApp *)data);
+}
+
+static void create_asm_view(EditorApp *app) {
+    AsmView *asm_view = g_new0(AsmView, 1);
+    
+    asm_view->cache = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, asm_listing_free);
+    g_queue_init(&asm_view->cache_order);
+    
+    asm_view->buffer = gtk_source_buffer_new(NULL);
+    GtkSourceLanguage *lang = gtk_source_language_manager_get_language(
+        gtk_source_language_manager_get_default(), "asm");
+    if (lang) gtk_source_buffer_set_language(asm_view->buffer, lang);
+    gtk_text_buffer_create_tag(GTK_TEXT_BUFFER(asm_view->buffer), "asm_current",
+                               "background", "#ffe97a", "foreground", "#000000", NULL);
+    g_signal_connect(asm_view->buffer, "mark-set", G_CALLBACK(on_asm_cursor_moved), app);
+    
+    asm_view->view = gtk_source_view_new_with_buffer(asm_view->buffer);
+    gtk_text_view_set_editable(GTK_TEXT_VIEW(asm_view->view), FALSE);
+    gtk_text_view_set_monospace(GTK_TEXT_VIEW(asm_view->view), TRUE);
+    gtk_source_view_set_tab_width(GTK_SOURCE_VIEW(asm_view->view), 8);
+    GtkWidget *scrolled = gtk_scrolled_window_new(NULL, NULL);
+    gtk_container_add(GTK_CONTAINER(scrolled), asm_view->view);
+    
+    asm_view->mode_combo = gtk_combo_box_text_new();
+    gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(asm_view->mode_combo), "gcc -S");
+    gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(asm_view->mode_combo), "objdump -dl");
+    gtk_combo_box_set_active(GTK_COMBO_BOX(asm_view->mode_combo), ASM_MODE_GCC_S);
+    g_signal_connect(asm_view->mode_combo, "changed", G_CALLBACK(on_asm_mode_changed), app);
+    asm_view->status = gtk_label_new("");
+    gtk_label_set_ellipsize(GTK_LABEL(asm_view->status), PANGO_ELLIPSIZE_END);
+    
+    GtkWidget *header = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 6);
+    gtk_box_pack_start(GTK_BOX(header), asm_view->mode_combo, FALSE, FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(header), asm_view->status, TRUE, TRUE, 0);
+    asm_view->pane = gtk_box_new(GTK_ORIENTATION_VERTICAL, 2);
+    gtk_box_pack_start(GTK_BOX(asm_view->pane), header, FALSE, FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(asm_view->pane), scrolled, TRUE, TRUE, 0);
+    
+    /* The editor's buffer gets the matching tag for lines picked in the listing */
+    gtk_text_buffer_create_tag(GTK_TEXT_BUFFER(app->buffer), "asm_source",
+                               "background", "#ffe97a", "foreground", "#000000", NULL);
+    
+    gtk_paned_pack2(GTK_PANED(app->editor_paned), asm_view->pane, FALSE, TRUE);
+    gtk_paned_set_position(GTK_PANED(app->editor_paned),
+                           gtk_widget_get_allocated_width(app->editor_paned) * 55 / 100);
+    app->asm_view = asm_view;
+}
+
+static void on_toggle_assembly_view(GtkCheckMenuItem *item, gpointer data) {
+    EditorApp *app = (EditorApp *)data;
+    GtkTextIter start, end;
+    
+    if (gtk_check_menu_item_get_active(item)) {
+        if (!app->asm_view) create_asm_view(app);
+        gtk_widget_show_all(app->asm_view->pane);
+        asm_view_refresh(app);
+    } else if (app->asm_view) {
+        gtk_widget_hide(app->asm_view->pane);
+        gtk_text_buffer_get_bounds(GTK_TEXT_BUFFER(app->buffer), &start, &end);
+        gtk_text_buffer_remove_tag_by_name(GTK_TEXT_BUFFER(app->buffer), "asm_source", &start, &end);
+    }
+}
+
+// Tool 1: Word & Character Count
+static void on_word_count(GtkWidget *widget, gpointer data) {
+    EditorApp *app = (EditorApp *)data;
+    GtkTextIter start, end;
+    gtk_text_buffer_get_bounds(GTK_TEXT_BUFFER(app->buffer), &start, &end);
+    gchar *text = gtk_text_buffer_get_text(GTK_TEXT_BUFFER(app->buffer), &start, &end, TRUE);
+    
+    sc_counts counts;
+    sc_count_words(text, strlen(text), &counts);
+    
+    gchar *msg = g_strdup_printf("Analysis Complete:\n- Words: %zu\n- Characters: %zu", counts.words, counts.chars);
+    GtkWidget *dialog = gtk_message_dialog_new(GTK_WINDOW(app->window),
+                        GTK_DIALOG_DESTROY_WITH_PARENT | GTK_DIALOG_MODAL,
+                        GTK_MESSAGE_INFO,
+                        GTK_BUTTONS_OK, "%s", msg);
+    gtk_dialog_run(GTK_DIALOG(dialog));
+    gtk_widget_destroy(dialog);  // Safe to destroy after gtk_dialog_run()
+    
+    g_free(msg); 
+    g_free(text); 
+}
+// Tool 2: Sort Selected Lines Alphabetically
+static void on_sort_selection(GtkWidget *widget, gpointer data) {
+    EditorApp *app = (EditorApp *)data;
+    GtkTextIter start, end;
+    if (gtk_text_buffer_get_selection_bounds(GTK_TEXT_BUFFER(app->buffer), &start, &end)) {
+        gchar *text = gtk_text_buffer_get_text(GTK_TEXT_BUFFER(app->buffer), &start, &end, TRUE);
+        size_t len = strlen(text);
+        gchar *sorted_text = g_malloc(len + 1);
+        
+        if (sc_sort_lines(text, len, sorted_text) == 0) {
+            gtk_text_buffer_begin_user_action(GTK_TEXT_BUFFER(app->buffer));
+            gtk_text_buffer_delete(GTK_TEXT_BUFFER(app->buffer), &start, &end);
+            gtk_text_buffer_insert(GTK_TEXT_BUFFER(app->buffer), &start, sorted_text, len);
+            gtk_text_buffer_end_user_action(GTK_TEXT_BUFFER(app->buffer));
+        }
+        
+        g_free(text); g_free(sorted_text);
+    }
+}
+// Convert Selection to Uppercase
+static void on_uppercase(GtkWidget *widget, gpointer data) {
+    EditorApp *app = (EditorApp *)data;
+    GtkTextIter start, end;
+    if (gtk_text_buffer_get_selection_bounds(GTK_TEXT_BUFFER(app->buffer), &start, &end)) {
+        gchar *text = gtk_text_buffer_get_text(GTK_TEXT_BUFFER(app->buffer), &start, &end, TRUE);
+        gchar *upper = g_utf8_strup(text, -1);
+        
+        gtk_text_buffer_begin_user_action(GTK_TEXT_BUFFER(app->buffer));
+        gtk_text_buffer_delete(GTK_TEXT_BUFFER(app->buffer), &start, &end);
+        gtk_text_buffer_insert(GTK_TEXT_BUFFER(app->buffer), &start, upper, -1);
+        gtk_text_buffer_end_user_action(GTK_TEXT_BUFFER(app->buffer));
+        
+        g_free(text); g_free(upper);
+    }
+}
+
+// Sort Lines Alphabetically
+static void on_sort_lines(GtkWidget *widget, gpointer data) {
+    EditorApp *app = (EditorApp *)data;
+    GtkTextIter start, end;
+    if (gtk_text_buffer_get_selection_bounds(GTK_TEXT_BUFFER(app->buffer), &start, &end)) {
+        gchar *text = gtk_text_buffer_get_text(GTK_TEXT_BUFFER(app->buffer), &start, &end, TRUE);
+        size_t len = strlen(text);
+        gchar *sorted = g_malloc(len + 1);
+        
+        if (sc_sort_lines(text, len, sorted) == 0) {
+            gtk_text_buffer_begin_user_action(GTK_TEXT_BUFFER(app->buffer));
+            gtk_text_buffer_delete(GTK_TEXT_BUFFER(app->buffer), &start, &end);
+            gtk_text_buffer_insert(GTK_TEXT_BUFFER(app->buffer), &start, sorted, len);
+            gtk_text_buffer_end_user_action(GTK_TEXT_BUFFER(app->buffer));
+        }
+        
+        g_free(text); g_free(sorted);
+    }
+}
+/*
+ * ScribleView: the editor's GtkSourceView
+ * Adds the jump highlight as an overlay painted in draw_layer instead of a
+ * buffer tag. The highlighted range is one pair of marks, so moving or
+ * clearing it never walks the tag tree, and only its visible part is drawn.
+ * It flashes bright, then fades to a resting tint while held (Focus Mode)
+ * or away completely.
+ */
+#define FLASH_HOLD_US      500000
+#define FLASH_FADE_US      1000000
+#define FLASH_PEAK_ALPHA   0.6
+#define FLASH_REST_ALPHA   0.25
+
+typedef struct {
+    GtkSourceView parent_instance;
+    GtkTextMark *flash_start; /* created on the first jump */
+    GtkTextMark *flash_end;
+    gboolean flash_active;
+    gboolean flash_hold;      /* settle at FLASH_REST_ALPHA rather than 0 */
+    gint64 flash_time;
+    guint flash_tick;         /* tick callback while fading, 0 when settled */
+} ScribleView;
+
+typedef struct {
+    GtkSourceViewClass parent_class;
+} ScribleViewClass;
+
+G_DEFINE_TYPE(ScribleView, scrible_view, GTK_SOURCE_TYPE_VIEW)
+
+static gdouble scrible_view_flash_alpha(ScribleView *self, gint64 now) {
+    gdouble rest = self->flash_hold ? FLASH_REST_ALPHA : 0.0;
+    gint64 t = now - self->flash_time;
+    
+    if (t <= FLASH_HOLD_US) return FLASH_PEAK_ALPHA;
+    if (t >= FLASH_HOLD_US + FLASH_FADE_US) return rest;
+    return FLASH_PEAK_ALPHA + (rest - FLASH_PEAK_ALPHA) * (t - FLASH_HOLD_US) / FLASH_FADE_US;
+}
+
+/* Highlighted lines in buffer coordinates, clipped to the visible area; FALSE if off screen */
+static gboolean scrible_view_flash_rect(ScribleView *self, GdkRectangle *rect) {
+    GtkTextView *text_view = GTK_TEXT_VIEW(self);
+    GtkTextBuffer *buffer = gtk_text_view_get_buffer(text_view);
+    GtkTextIter start, end;
+    GdkRectangle visible;
+    gint y, height, end_y, end_height;
+    
+    gtk_text_buffer_get_iter_at_mark(buffer, &start, self->flash_start);
+    gtk_text_buffer_get_iter_at_mark(buffer, &end, self->flash_end);
+    gtk_text_view_get_visible_rect(text_view, &visible);
+    gtk_text_view_get_line_yrange(text_view, &start, &y, &height);
+    gtk_text_view_get_line_yrange(text_view, &end, &end_y, &end_height);
+    
+    rect->x = visible.x;
+    rect->width = visible.width;
+    rect->y = MAX(y, visible.y);
+    rect->height = MIN(end_y + end_height, visible.y + visible.height) - rect->y;
+    return rect->height > 0;
+}
+
+static void scrible_view_queue_flash(ScribleView *self) {
+    GdkRectangle rect;
+    
+    if (!self->flash_start || !scrible_view_flash_rect(self, &rect)) return;
+    gtk_text_view_buffer_to_window_coords(GTK_TEXT_VIEW(self), GTK_TEXT_WINDOW_WIDGET,
+                                          rect.x, rect.y, &rect.x, &rect.y);
+    gtk_widget_queue_draw_area(GTK_WIDGET(self), rect.x, rect.y, rect.width, rect.height);
+}
+
+static void scrible_view_draw_layer(GtkTextView *text_view, GtkTextViewLayer layer, cairo_t *cr) {
+    ScribleView *self = (ScribleView *)text_view;
+    GdkRectangle rect;
+    
+    GTK_TEXT_VIEW_CLASS(scrible_view_parent_class)->draw_layer(text_view, layer, cr);
+    if (layer != GTK_TEXT_VIEW_LAYER_BELOW_TEXT || !self->flash_active) return;
+    
+    gdouble alpha = scrible_view_flash_alpha(self, g_get_monotonic_time());
+    if (alpha <= 0 || !scrible_view_flash_rect(self, &rect)) return;
+    cairo_set_source_rgba(cr, 1.0, 1.0, 0.0, alpha);
+    cairo_rectangle(cr, rect.x, rect.y, rect.width, rect.height);
+    cairo_fill(cr);
+}
+
+static gboolean scrible_view_flash_step(GtkWidget *widget, GdkFrameClock *clock, gpointer data) {
+    ScribleView *self = (ScribleView *)widget;
+    
+    scrible_view_queue_flash(self);
+    if (gdk_frame_clock_get_frame_time(clock) - self->flash_time < FLASH_HOLD_US + FLASH_FADE_US)
+        return G_SOURCE_CONTINUE;
+    if (!self->flash_hold) self->flash_active = FALSE;
+    self->flash_tick = 0;
+    return G_SOURCE_REMOVE;
+}
+
+/* Highlight start..end (whole lines) and fade it; hold keeps a resting tint afterwards */
+static void scrible_view_flash(ScribleView *self, const GtkTextIter *start, const GtkTextIter *end,
+                               gboolean hold) {
+    GtkTextBuffer *buffer = gtk_text_view_get_buffer(GTK_TEXT_VIEW(self));
+    
+    if (self->flash_active) scrible_view_queue_flash(self);
+    if (!self->flash_start) {
+        self->flash_start = gtk_text_buffer_create_mark(buffer, NULL, start, TRUE);
+        self->flash_end = gtk_text_buffer_create_mark(buffer, NULL, end, FALSE);
+    } else {
+        gtk_text_buffer_move_mark(buffer, self->flash_start, start);
+        gtk_text_buffer_move_mark(buffer, self->flash_end, end);
+    }
+    self->flash_active = TRUE;
+    self->flash_hold = hold;
+    self->flash_time = g_get_monotonic_time();
+    if (!self->flash_tick)
+        self->flash_tick = gtk_widget_add_tick_callback(GTK_WIDGET(self), scrible_view_flash_step,
+                                                        NULL, NULL);
+    scrible_view_queue_flash(self);
+}
+
+static void scrible_view_clear_flash(ScribleView *self) {
+    if (!self->flash_active) return;
+    scrible_view_queue_flash(self);
+    self->flash_active = FALSE;
+    if (self->flash_tick) {
+        gtk_widget_remove_tick_callback(GTK_WIDGET(self), self->flash_tick);
+        self->flash_tick = 0;
+    }
+}
+
+static void scrible_view_class_init(ScribleViewClass *klass) {
+    GTK_TEXT_VIEW_CLASS(klass)->draw_layer = scrible_view_draw_layer;
+}
+
+static void scrible_view_init(ScribleView *self) {
+}
+
+static GtkWidget *scrible_view_new(GtkSourceBuffer *buffer) {
+    return g_object_new(scrible_view_get_type(), "buffer", buffer, NULL);
+}
+
+/*
+ * Brace index
+ * Every '{' '}' and #if/#else/#endif of the buffer, found by sc_lex_line so
+ * comments and literals are skipped, with each opener paired to its closer.
+ * An edit only shifts the line numbers after it and marks the edited lines
+ * dirty; a low-priority idle re-lexes from there and stops as soon as the
+ * lexer state at a line start is the one recorded before, so typing inside
+ * a function never rescans the file. Commands flush pending work first, then
+ * answer from the index with a binary search.
+ * Folds hide whole lines with their own invisible tag, which only relayouts
+ * the hidden range.
+ */
+#define BRACE_CHUNK_LINES  512      /* lines fetched from the buffer at a time */
+#define BRACE_IDLE_LINES   20000    /* lines lexed per idle run */
+
+typedef struct {
+    gint line;
+    gint index;               /* byte index in the line */
+    gchar kind;               /* '{' '}', or 'i' 'e' 'n' for #if #else #endif */
+    gint partner;             /* matching token, the #if for an #else, -1 if none */
+} BraceToken;
+
+typedef struct {
+    GtkTextMark *start;       /* start of the first hidden line */
+    GtkTextMark *end;         /* start of the closing line */
+    GtkTextTag *tag;
+} Fold;
+
+typedef struct BraceIndex {
+    GArray *tokens;           /* BraceToken in buffer order */
+    GArray *states;           /* guint8 lexer state at the start of each line */
+    gint dirty_from;          /* lines to re-lex, clean when dirty_from > dirty_to */
+    gint dirty_to;
+    guint idle;
+    GList *folds;             /* Fold */
+    GtkSourceGutterRenderer *renderer;
+} BraceIndex;
+
+typedef struct {
+    GArray *tokens;
+    gint line;
+} BraceScan;
+
+static void brace_collect(gsize offset, gchar kind, gpointer data) {
+    BraceScan *scan = data;
+    BraceToken token = { scan->line, offset, kind, -1 };
+    g_array_append_val(scan->tokens, token);
+}
+
+static void unfold(EditorApp *app, GList *link) {
+    GtkTextBuffer *buffer = GTK_TEXT_BUFFER(app->buffer);
+    Fold *fold = link->data;
+
+    gtk_text_tag_table_remove(gtk_text_buffer_get_tag_table(buffer), fold->tag);
+    gtk_text_buffer_delete_mark(buffer, fold->start);
+    gtk_text_buffer_delete_mark(buffer, fold->end);
+    app->braces->folds = g_list_delete_link(app->braces->folds, link);
+    g_free(fold);
+}
+
+/* First token at or after line */
+static guint brace_lower_bound(BraceIndex *braces, gint line) {
+    guint lo = 0, hi = braces->tokens->len;
+    while (lo < hi) {
+        guint mid = (lo + hi) / 2;
+        if (g_array_index(braces->tokens, BraceToken, mid).line < line) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+/* Pairs braces, and #if with #endif, in one pass with a stack for each */
+static void brace_pair(BraceIndex *braces) {
+    GArray *open = g_array_new(FALSE, FALSE, sizeof(gint));
+    GArray *cond = g_array_new(FALSE, FALSE, sizeof(gint));
+
+    for (guint i = 0; i < braces->tokens->len; i++) {
+        BraceToken *token = &g_array_index(braces->tokens, BraceToken, i);
+        GArray *stack = token->kind == '{' || token->kind == '}' ? open : cond;
+        gint at = i;
+
+        token->partner = -1;
+        if (token->kind == '{' || token->kind == 'i') {
+            g_array_append_val(stack, at);
+        } else if (stack->len) {
+            gint other = g_array_index(stack, gint, stack->len - 1);
+            token->partner = other;
+            if (token->kind != 'e') {
+                g_array_index(braces->tokens, BraceToken, other).partner = at;
+                g_array_set_size(stack, stack->len - 1);
+            }
+        }
+    }
+    g_array_free(open, TRUE);
+    g_array_free(cond, TRUE);
+}
+
+/*
+ * Re-lex dirty lines, at most max_lines of them. Returns TRUE once the
+ * index is clean and paired.
+ */
+static gboolean brace_index_lex(EditorApp *app, gint max_lines) {
+    BraceIndex *braces = app->braces;
+    GtkTextBuffer *buffer = GTK_TEXT_BUFFER(app->buffer);
+    gint lines = gtk_text_buffer_get_line_count(buffer);
+
+    if (braces->dirty_from > braces->dirty_to) return TRUE;
+
+    TRACE_BEGIN("braces: lex");
+    BraceScan scan = { g_array_new(FALSE, FALSE, sizeof(BraceToken)), braces->dirty_from };
+    gint first = scan.line;
+    int state = g_array_index(braces->states, guint8, first);
+    gboolean done = FALSE;
+
+    while (!done && scan.line - first < max_lines) {
+        GtkTextIter start, end;
+        gint count = MIN(BRACE_CHUNK_LINES, lines - scan.line);
+        gtk_text_buffer_get_iter_at_line(buffer, &start, scan.line);
+        gtk_text_buffer_get_iter_at_line(buffer, &end, scan.line + count);
+        if (scan.line + count == lines) gtk_text_buffer_get_end_iter(buffer, &end);
+        gchar *text = gtk_text_buffer_get_slice(buffer, &start, &end, TRUE);
+        const gchar *p = text, *stop = text + strlen(text);
+
+        for (gint n = 0; n < count; n++) {
+            const gchar *eol = memchr(p, '\n', stop - p);
+            state = sc_lex_line(p, (eol ? eol : stop) - p, state, brace_collect, &scan);
+            scan.line++;
+            if (scan.line == lines ||
+                (scan.line > braces->dirty_to && g_array_index(braces->states, guint8, scan.line) == state)) {
+                done = TRUE;
+                break;
+            }
+            g_array_index(braces->states, guint8, scan.line) = state;
+            if (!eol || scan.line - first >= max_lines) break;
+            p = eol + 1;
+        }
+        g_free(text);
+    }
+
+    /* Lines first .. scan.line - 1 were lexed again, swap in their tokens */
+    guint lo = brace_lower_bound(braces, first);
+    guint hi = brace_lower_bound(braces, scan.line);
+    g_array_remove_range(braces->tokens, lo, hi - lo);
+    g_array_insert_vals(braces->tokens, lo, scan.tokens->data, scan.tokens->len);
+    g_array_free(scan.tokens, TRUE);
+
+    if (done) {
+        braces->dirty_from = G_MAXINT;
+        braces->dirty_to = -1;
+        brace_pair(braces);
+    } else {
+        braces->dirty_from = scan.line;
+        braces->dirty_to = MAX(braces->dirty_to, scan.line);
+    }
+    TRACE_END("braces: lex");
+    return done;
+}
+
+static void brace_index_flush(EditorApp *app) {
+    brace_index_lex(app, G_MAXINT);
+}
+
+static gboolean brace_index_idle(gpointer data) {
+    EditorApp *app = (EditorApp *)data;
+
+    if (!brace_index_lex(app, BRACE_IDLE_LINES)) return G_SOURCE_CONTINUE;
+    app->braces->idle = 0;
+    gtk_source_gutter_renderer_queue_draw(app->braces->renderer);
+    return G_SOURCE_REMOVE;
+}
+
+static void brace_index_mark_dirty(EditorApp *app, gint from, gint to) {
+    BraceIndex *braces = app->braces;
+
+    braces->dirty_from = MIN(braces->dirty_from, from);
+    braces->dirty_to = MAX(braces->dirty_to, to);
+    if (!braces->idle)
+        braces->idle = g_idle_add_full(G_PRIORITY_LOW, brace_index_idle, app, NULL);
+}
+
+/*
+ * Edits: the line count difference says how many lines came or went after
+ * the edited one. Only then do later tokens need their line moved.
+ */
+static void on_braces_insert_text(GtkTextBuffer *buffer, GtkTextIter *location, gchar *text,
+                                  gint len, gpointer data) {
+    EditorApp *app = (EditorApp *)data;
+    BraceIndex *braces = app->braces;
+    gint added = gtk_text_buffer_get_line_count(buffer) - (gint)braces->states->len;
+    gint last = gtk_text_iter_get_line(location);
+    gint first = last - added;
+
+    if (added > 0) {
+        for (guint i = brace_lower_bound(braces, first + 1); i < braces->tokens->len; i++)
+            g_array_index(braces->tokens, BraceToken, i).line += added;
+        guint8 *blank = g_new0(guint8, added);
+        g_array_insert_vals(braces->states, first + 1, blank, added);
+        g_free(blank);
+        if (braces->dirty_to > first) braces->dirty_to += added;
+        if (braces->dirty_from > first && braces->dirty_from != G_MAXINT) braces->dirty_from += added;
+    }
+    brace_index_mark_dirty(app, first, last);
+}
+
+static void on_braces_delete_range(GtkTextBuffer *buffer, GtkTextIter *start, GtkTextIter *end,
+                                   gpointer data) {
+    EditorApp *app = (EditorApp *)data;
+    BraceIndex *braces = app->braces;
+    gint removed = (gint)braces->states->len - gtk_text_buffer_get_line_count(buffer);
+    gint first = gtk_text_iter_get_line(start);
+
+    if (removed > 0) {
+        /* Tokens of the joined lines stay on first until it is lexed again */
+        for (guint i = brace_lower_bound(braces, first + 1); i < braces->tokens->len; i++) {
+            BraceToken *token = &g_array_index(braces->tokens, BraceToken, i);
+            token->line = token->line > first + removed ? token->line - removed : first;
+        }
+        g_array_remove_range(braces->states, first + 1, removed);
+        if (braces->dirty_to > first) braces->dirty_to = MAX(first, braces->dirty_to - removed);
+        if (braces->dirty_from > first && braces->dirty_from != G_MAXINT)
+            braces->dirty_from = MAX(first, braces->dirty_from - removed);
+    }
+    brace_index_mark_dirty(app, first, first);
+
+    /* A fold whose text was deleted has nothing left to hide */
+    for (GList *l = braces->folds; l; ) {
+        Fold *fold = l->data;
+        GtkTextIter fold_start, fold_end;
+        GList *next = l->next;
+        gtk_text_buffer_get_iter_at_mark(buffer, &fold_start, fold->start);
+        gtk_text_buffer_get_iter_at_mark(buffer, &fold_end, fold->end);
+        if (gtk_text_iter_compare(&fold_start, &fold_end) >= 0) unfold(app, l);
+        l = next;
+    }
+}
+
+static BraceToken *brace_token(EditorApp *app, gint i) {
+    return &g_array_index(app->braces->tokens, BraceToken, i);
+}
+
+static void brace_token_iter(EditorApp *app, const BraceToken *token, GtkTextIter *iter) {
+    gtk_text_buffer_get_iter_at_line(GTK_TEXT_BUFFER(app->buffer), iter, token->line);
+    gtk_text_iter_set_line_index(iter, token->index);
+}
+
+/* Index of the last token before (line, index), -1 if none */
+static gint brace_token_before(EditorApp *app, gint line, gint index) {
+    gint i = (gint)brace_lower_bound(app->braces, line + 1) - 1;
+    while (i >= 0 && brace_token(app, i)->line == line && brace_token(app, i)->index >= index) i--;
+    return i;
+}
+
+/*
+ * The '{' of the innermost block around [start, end]: walk back from start,
+ * jumping over blocks that close before it, to a brace that closes at or
+ * after end. Returns its token index or -1.
+ */
+static gint brace_enclosing(EditorApp *app, const GtkTextIter *start, const GtkTextIter *end) {
+    gint end_line = gtk_text_iter_get_line(end), end_index = gtk_text_iter_get_line_index(end);
+    gint i = brace_token_before(app, gtk_text_iter_get_line(start), gtk_text_iter_get_line_index(start));
+
+    while (i >= 0) {
+        BraceToken *token = brace_token(app, i);
+        if (token->kind == '}' && token->partner >= 0) {
+            i = token->partner - 1;
+            continue;
+        }
+        if (token->kind == '{' && token->partner >= 0) {
+            BraceToken *close = brace_token(app, token->partner);
+            if (close->line > end_line || (close->line == end_line && close->index + 1 >= end_index))
+                return i;
+        }
+        i--;
+    }
+    return -1;
+}
+
+/* An opener whose block spans more than one line, on the given line; -1 if none */
+static gint brace_opener_on_line(EditorApp *app, gint line) {
+    for (guint i = brace_lower_bound(app->braces, line); i < app->braces->tokens->len; i++) {
+        BraceToken *token = brace_token(app, i);
+        if (token->line != line) break;
+        if ((token->kind == '{' || token->kind == 'i') && token->partner >= 0 &&
+            brace_token(app, token->partner)->line > line + 1)
+            return i;
+    }
+    return -1;
+}
+
+/* Fold opening on line, NULL if that line is not folded */
+static GList *fold_at_line(EditorApp *app, gint line) {
+    for (GList *l = app->braces->folds; l; l = l->next) {
+        GtkTextIter iter;
+        gtk_text_buffer_get_iter_at_mark(GTK_TEXT_BUFFER(app->buffer), &iter, ((Fold *)l->data)->start);
+        if (gtk_text_iter_get_line(&iter) == line + 1) return l;
+    }
+    return NULL;
+}
+
+/* Unfold whatever hides iter, so a jump there is visible; iter is revalidated */
+static void unfold_around(EditorApp *app, GtkTextIter *iter) {
+    GtkTextBuffer *buffer = GTK_TEXT_BUFFER(app->buffer);
+    gint offset = gtk_text_iter_get_offset(iter);
+
+    for (GList *l = app->braces->folds; l; ) {
+        Fold *fold = l->data;
+        GtkTextIter start, end;
+        GList *next = l->next;
+        gtk_text_buffer_get_iter_at_mark(buffer, &start, fold->start);
+        gtk_text_buffer_get_iter_at_mark(buffer, &end, fold->end);
+        if (gtk_text_iter_compare(iter, &start) >= 0 && gtk_text_iter_compare(iter, &end) < 0)
+            unfold(app, l);
+        l = next;
+    }
+    /* Removing a tag invalidates every iterator */
+    gtk_text_buffer_get_iter_at_offset(buffer, iter, offset);
+}
+
+/* Fold the block opened by token, or unfold it if it already is */
+static void toggle_fold(EditorApp *app, gint opener) {
+    GtkTextBuffer *buffer = GTK_TEXT_BUFFER(app->buffer);
+    BraceToken *open = brace_token(app, opener);
+    BraceToken *close = brace_token(app, open->partner);
+    GList *folded = fold_at_line(app, open->line);
+
+    if (folded) {
+        unfold(app, folded);
+        gtk_source_gutter_renderer_queue_draw(app->braces->renderer);
+        return;
+    }
+
+    Fold *fold = g_new0(Fold, 1);
+    GtkTextIter start, end, cursor;
+    gtk_text_buffer_get_iter_at_line(buffer, &start, open->line + 1);
+    gtk_text_buffer_get_iter_at_line(buffer, &end, close->line);
+    fold->start = gtk_text_buffer_create_mark(buffer, NULL, &start, FALSE);
+    fold->end = gtk_text_buffer_create_mark(buffer, NULL, &end, TRUE);
+    fold->tag = gtk_text_buffer_create_tag(buffer, NULL, "invisible", TRUE, NULL);
+    gtk_text_buffer_apply_tag(buffer, fold->tag, &start, &end);
+    app->braces->folds = g_list_prepend(app->braces->folds, fold);
+
+    /* The cursor cannot stay in hidden text */
+    gtk_text_buffer_get_iter_at_mark(buffer, &cursor, gtk_text_buffer_get_insert(buffer));
+    if (gtk_text_iter_compare(&cursor, &start) >= 0 && gtk_text_iter_compare(&cursor, &end) < 0) {
+        gtk_text_buffer_get_iter_at_line(buffer, &cursor, open->line);
+        gtk_text_iter_forward_to_line_end(&cursor);
+        gtk_text_buffer_place_cursor(buffer, &cursor);
+    }
+    gtk_source_gutter_renderer_queue_draw(app->braces->renderer);
+}
+
+static void brace_place_cursor(EditorApp *app, GtkTextIter *iter) {
+    unfold_around(app, iter);
+    gtk_text_buffer_place_cursor(GTK_TEXT_BUFFER(app->buffer), iter);
+    gtk_text_view_scroll_to_iter(GTK_TEXT_VIEW(app->view), iter, 0.1, FALSE, 0.0, 0.5);
+}
+
+/* From a brace or conditional at or just before the cursor to its partner, else to the enclosing '{' */
+static void on_jump_matching_brace(GtkWidget *widget, gpointer data) {
+    EditorApp *app = (EditorApp *)data;
+    GtkTextBuffer *buffer = GTK_TEXT_BUFFER(app->buffer);
+    GtkTextIter cursor, target;
+
+    brace_index_flush(app);
+    gtk_text_buffer_get_iter_at_mark(buffer, &cursor, gtk_text_buffer_get_insert(buffer));
+    gint line = gtk_text_iter_get_line(&cursor), index = gtk_text_iter_get_line_index(&cursor);
+    gint i = brace_token_before(app, line, index + 1);
+
+    if (i >= 0 && (brace_token(app, i)->line != line || brace_token(app, i)->index < index - 1))
+        i = -1;
+    if (i >= 0 && brace_token(app, i)->partner >= 0) {
+        brace_token_iter(app, brace_token(app, brace_token(app, i)->partner), &target);
+    } else if ((i = brace_enclosing(app, &cursor, &cursor)) >= 0) {
+        brace_token_iter(app, brace_token(app, i), &target);
+    } else {
+        return;
+    }
+    brace_place_cursor(app, &target);
+}
+
+/* Select the innermost block around the selection, braces included; repeat to widen */
+static void on_select_enclosing_block(GtkWidget *widget, gpointer data) {
+    EditorApp *app = (EditorApp *)data;
+    GtkTextIter start, end;
+
+    brace_index_flush(app);
+    gtk_text_buffer_get_selection_bounds(GTK_TEXT_BUFFER(app->buffer), &start, &end);
+    gint i = brace_enclosing(app, &start, &end);
+    if (i < 0) return;
+
+    brace_token_iter(app, brace_token(app, i), &start);
+    brace_token_iter(app, brace_token(app, brace_token(app, i)->partner), &end);
+    gtk_text_iter_forward_char(&end);
+    gint end_offset = gtk_text_iter_get_offset(&end);
+    unfold_around(app, &start);
+    gtk_text_buffer_get_iter_at_offset(GTK_TEXT_BUFFER(app->buffer), &end, end_offset);
+    gtk_text_buffer_select_range(GTK_TEXT_BUFFER(app->buffer), &end, &start);
+    gtk_text_view_scroll_to_iter(GTK_TEXT_VIEW(app->view), &start, 0.1, FALSE, 0.0, 0.5);
+}
+
+/* Fold the block opened on the cursor line, else the one around the cursor */
+static void on_toggle_fold(GtkWidget *widget, gpointer data) {
+    EditorApp *app = (EditorApp *)data;
+    GtkTextBuffer *buffer = GTK_TEXT_BUFFER(app->buffer);
+    GtkTextIter cursor;
+
+    brace_index_flush(app);
+    gtk_text_buffer_get_iter_at_mark(buffer, &cursor, gtk_text_buffer_get_insert(buffer));
+    gint i = brace_opener_on_line(app, gtk_text_iter_get_line(&cursor));
+    if (i < 0) i = brace_enclosing(app, &cursor, &cursor);
+    if (i < 0 || brace_token(app, brace_token(app, i)->partner)->line <= brace_token(app, i)->line + 1)
+        return;
+    toggle_fold(app, i);
+}
+
+static void on_unfold_all(GtkWidget *widget, gpointer data) {
+    EditorApp *app = (EditorApp *)data;
+
+    while (app->braces->folds) unfold(app, app->braces->folds);
+    gtk_source_gutter_renderer_queue_draw(app->braces->renderer);
+}
+
+/* Gutter: a marker on every line that opens a multi-line block, click to fold */
+static void on_fold_query_data(GtkSourceGutterRenderer *renderer, GtkTextIter *start,
+                               GtkTextIter *end, GtkSourceGutterRendererState state, gpointer data) {
+    EditorApp *app = (EditorApp *)data;
+    gint line = gtk_text_iter_get_line(start);
+    const gchar *marker = "";
+
+    /* Drawn from the index as it is; the idle redraws once it caught up */
+    if (brace_opener_on_line(app, line) >= 0)
+        marker = fold_at_line(app, line) ? "▸" : "▾";
+    gtk_source_gutter_renderer_text_set_text(GTK_SOURCE_GUTTER_RENDERER_TEXT(renderer), marker, -1);
+}
+
+static gboolean on_fold_query_activatable(GtkSourceGutterRenderer *renderer, GtkTextIter *iter,
+                                          GdkRectangle *area, GdkEvent *event, gpointer data) {
+    EditorApp *app = (EditorApp *)data;
+    return brace_opener_on_line(app, gtk_text_iter_get_line(iter)) >= 0;
+}
+
+static void on_fold_activate(GtkSourceGutterRenderer *renderer, GtkTextIter *iter,
+                             GdkRectangle *area, GdkEvent *event, gpointer data) {
+    EditorApp *app = (EditorApp *)data;
+
+    brace_index_flush(app);
+    gint i = brace_opener_on_line(app, gtk_text_iter_get_line(iter));
+    if (i >= 0) toggle_fold(app, i);
+}
+
+static void setup_brace_index(EditorApp *app) {
+    BraceIndex *braces = g_new0(BraceIndex, 1);
+    GtkTextBuffer *buffer = GTK_TEXT_BUFFER(app->buffer);
+    GtkSourceGutter *gutter = gtk_source_view_get_gutter(GTK_SOURCE_VIEW(app->view), GTK_TEXT_WINDOW_LEFT);
+    guint8 code = SC_LEX_CODE;
+    gint width;
+
+    braces->tokens = g_array_new(FALSE, FALSE, sizeof(BraceToken));
+    braces->states = g_array_new(FALSE, FALSE, sizeof(guint8));
+    g_array_append_val(braces->states, code);
+    braces->dirty_from = G_MAXINT;
+    braces->dirty_to = -1;
+    app->braces = braces;
+
+    braces->renderer = gtk_source_gutter_renderer_text_new();
+    gtk_source_gutter_renderer_text_measure(GTK_SOURCE_GUTTER_RENDERER_TEXT(braces->renderer),
+                                            "▾", &width, NULL);
+    gtk_source_gutter_renderer_set_size(braces->renderer, width + 4);
+    g_signal_connect(braces->renderer, "query-data", G_CALLBACK(on_fold_query_data), app);
+    g_signal_connect(braces->renderer, "query-activatable", G_CALLBACK(on_fold_query_activatable), app);
+    g_signal_connect(braces->renderer, "activate", G_CALLBACK(on_fold_activate), app);
+    gtk_source_gutter_insert(gutter, braces->renderer, 10);
+
+    /* After the default handlers, when the buffer already has the new line count */
+    g_signal_connect_after(buffer, "insert-text", G_CALLBACK(on_braces_insert_text), app);
+    g_signal_connect_after(buffer, "delete-range", G_CALLBACK(on_braces_delete_range), app);
+}
+
+/*
+ * Semantic highlighting
+ * Colors identifiers by what they name (function, type, macro, enum
+ * constant, local) on top of the language's own highlighting. A worker
+ * thread builds a SemanticTable from a snapshot of the buffer with
+ * sc_scan_decls, kept until the next edit, and classifies the identifiers
+ * of the visible lines plus a margin; the main thread then retags exactly
+ * that range in one pass. Scrolling inside the range already tagged costs
+ * nothing. Only one job runs at a time: requests made meanwhile collapse
+ * into one more job when it finishes.
+ */
+#define SEMANTIC_MARGIN_LINES  100
+#define SEMANTIC_EDIT_DELAY    60     /* ms after the last edit */
+
+typedef struct {
+    gint line;
+    gint index;               /* byte index in the line */
+    gint length;
+    gint kind;                /* SC_SYM_* */
+} SemanticSpan;
+
+typedef struct {
+    gsize start, end;         /* byte range of a function body */
+    GHashTable *locals;       /* name -> kind, NULL if none */
+} SemanticBody;
+
+typedef struct {
+    gchar *text;              /* the snapshot it describes */
+    gsize len;
+    GArray *line_starts;      /* gsize byte offset of every line */
+    GArray *line_states;      /* guint8 sc_lex_idents state at every line start */
+    GHashTable *globals;      /* name -> kind */
+    GArray *bodies;           /* SemanticBody in buffer order */
+    GHashTable *locals;       /* collecting the current body's locals */
+} SemanticTable;
+
+typedef struct {
+    SemanticTable *table;     /* reused, or built by the job from text */
+    gboolean built;
+    gchar *text;
+    gsize len;
+    gint first, last;         /* lines to classify */
+    guint generation;
+    GArray *spans;            /* SemanticSpan, the result */
+} SemanticJob;
+
+typedef struct Semantic {
+    gboolean enabled;
+    GtkTextTag *tags[SC_SYM_LOCAL + 1];
+    SemanticTable *table;
+    guint table_generation;
+    guint generation;         /* bumped by every edit */
+    gboolean busy;            /* a job is running */
+    gboolean again;           /* and another was asked for meanwhile */
+    guint timeout;
+    guint tagged_generation;
+    gint tagged_first;        /* lines tagged, tagged_first > tagged_last when none */
+    gint tagged_last;
+} Semantic;
+
+static void semantic_table_free(SemanticTable *table) {
+    if (!table) return;
+    for (guint i = 0; i < table->bodies->len; i++) {
+        SemanticBody *body = &g_array_index(table->bodies, SemanticBody, i);
+        if (body->locals) g_hash_table_destroy(body->locals);
+    }
+    g_array_free(table->bodies, TRUE);
+    g_array_free(table->line_starts, TRUE);
+    g_array_free(table->line_states, TRUE);
+    g_hash_table_destroy(table->globals);
+    if (table->locals) g_hash_table_destroy(table->locals);
+    g_free(table->text);
+    g_free(table);
+}
+
+static void on_semantic_decl(gsize offset, gsize len, int kind, gsize scope, gpointer data) {
+    SemanticTable *table = data;
+
+    if (kind == SC_SYM_BODY) {
+        SemanticBody body = { offset, offset + len, table->locals };
+        g_array_append_val(table->bodies, body);
+        table->locals = NULL;
+    } else if (kind == SC_SYM_LOCAL) {
+        if (!table->locals) table->locals = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+        g_hash_table_replace(table->locals, g_strndup(table->text + offset, len), GINT_TO_POINTER(kind));
+    } else {
+        /* A name that is also a macro is colored as the macro */
+        gchar *name = g_strndup(table->text + offset, len);
+        if (kind == SC_SYM_MACRO || !g_hash_table_contains(table->globals, name))
+            g_hash_table_replace(table->globals, name, GINT_TO_POINTER(kind));
+        else
+            g_free(name);
+    }
+}
+
+static void semantic_skip_ident(gsize offset, gsize len, gpointer data) {
+}
+
+/* Worker thread: takes ownership of text */
+static SemanticTable *semantic_table_build(gchar *text, gsize len) {
+    SemanticTable *table = g_new0(SemanticTable, 1);
+    const gchar *p = text, *end = text + len;
+    int state = SC_LEX_CODE;
+
+    table->text = text;
+    table->len = len;
+    table->line_starts = g_array_new(FALSE, FALSE, sizeof(gsize));
+    table->line_states = g_array_new(FALSE, FALSE, sizeof(guint8));
+    table->globals = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    table->bodies = g_array_new(FALSE, FALSE, sizeof(SemanticBody));
+
+    for (;;) {
+        const gchar *eol = memchr(p, '\n', end - p);
+        gsize start = p - text;
+        guint8 at = state;
+        g_array_append_val(table->line_starts, start);
+        g_array_append_val(table->line_states, at);
+        state = sc_lex_idents(p, (eol ? eol : end) - p, state, semantic_skip_ident, NULL);
+        if (!eol) break;
+        p = eol + 1;
+    }
+    sc_scan_decls(text, len, on_semantic_decl, table);
+    return table;
+}
+
+/* Locals of the function body holding offset, NULL if none */
+static GHashTable *semantic_locals_at(SemanticTable *table, gsize offset) {
+    guint lo = 0, hi = table->bodies->len;
+    while (lo < hi) {
+        guint mid = (lo + hi) / 2;
+        if (g_array_index(table->bodies, SemanticBody, mid).end <= offset) lo = mid + 1;
+        else hi = mid;
+    }
+    if (lo == table->bodies->len) return NULL;
+    SemanticBody *body = &g_array_index(table->bodies, SemanticBody, lo);
+    return body->start <= offset ? body->locals : NULL;
+}
+
+typedef struct {
+    SemanticJob *job;
+    const gchar *line;
+    gsize line_len;
+    gsize line_start;
+    gint line_number;
+    GString *name;
+} SemanticClassify;
+
+static void on_semantic_ident(gsize offset, gsize len, gpointer data) {
+    static const gchar *const not_calls[] = {
+        "if", "while", "for", "switch", "return", "sizeof", "defined", "_Alignof", "_Generic", NULL
+    };
+    SemanticClassify *sc = data;
+    SemanticTable *table = sc->job->table;
+    GHashTable *locals = semantic_locals_at(table, sc->line_start + offset);
+    gpointer kind = NULL;
+
+    g_string_truncate(sc->name, 0);
+    g_string_append_len(sc->name, sc->line + offset, len);
+    if (!locals || !(kind = g_hash_table_lookup(locals, sc->name->str)))
+        kind = g_hash_table_lookup(table->globals, sc->name->str);
+    if (!kind) {
+        /* Not declared in this file: a call still says it is a function */
+        gsize i = offset + len;
+        while (i < sc->line_len && (sc->line[i] == ' ' || sc->line[i] == '\t')) i++;
+        if (i < sc->line_len && sc->line[i] == '(' && !g_strv_contains(not_calls, sc->name->str))
+            kind = GINT_TO_POINTER(SC_SYM_FUNCTION);
+    }
+    if (kind) {
+        SemanticSpan span = { sc->line_number, offset, len, GPOINTER_TO_INT(kind) };
+        g_array_append_val(sc->job->spans, span);
+    }
+}
+
+static void semantic_worker(GTask *task, gpointer source, gpointer task_data, GCancellable *cancellable) {
+    SemanticJob *job = task_data;
+
+    if (!job->table) {
+        job->table = semantic_table_build(job->text, job->len);
+        job->text = NULL;
+        job->built = TRUE;
+    }
+
+    SemanticTable *table = job->table;
+    SemanticClassify sc = { job, NULL, 0, 0, 0, g_string_new(NULL) };
+    gint last = MIN(job->last, (gint)table->line_starts->len - 1);
+
+    job->spans = g_array_new(FALSE, FALSE, sizeof(SemanticSpan));
+    for (gint line = job->first; line <= last; line++) {
+        gsize start = g_array_index(table->line_starts, gsize, line);
+        gsize end = line + 1 < (gint)table->line_starts->len ?
+                    g_array_index(table->line_starts, gsize, line + 1) - 1 : table->len;
+        sc.line = table->text + start;
+        sc.line_len = end - start;
+        sc.line_start = start;
+        sc.line_number = line;
+        sc_lex_idents(sc.line, sc.line_len, g_array_index(table->line_states, guint8, line),
+                      on_semantic_ident, &sc);
+    }
+    g_string_free(sc.name, TRUE);
+    g_task_return_pointer(task, job, NULL);
+}
+
+static void semantic_start(EditorApp *app);
+
+static void semantic_untag(EditorApp *app, GtkTextIter *start, GtkTextIter *end) {
+    for (gint kind = SC_SYM_FUNCTION; kind <= SC_SYM_LOCAL; kind++)
+        gtk_text_buffer_remove_tag(GTK_TEXT_BUFFER(app->buffer), app->semantic->tags[kind], start, end);
+}
+
+static void semantic_clear(EditorApp *app) {
+    GtkTextIter start, end;
+
+    gtk_text_buffer_get_bounds(GTK_TEXT_BUFFER(app->buffer), &start, &end);
+    semantic_untag(app, &start, &end);
+    app->semantic->tagged_first = 0;
+    app->semantic->tagged_last = -1;
+}
+
+/* The one buffer pass per job: untag the job's lines, then tag its spans */
+static void semantic_apply(EditorApp *app, SemanticJob *job) {
+    GtkTextBuffer *buffer = GTK_TEXT_BUFFER(app->buffer);
+    Semantic *semantic = app->semantic;
+    GtkTextIter start, end;
+
+    TRACE_BEGIN("semantic: tag");
+    gtk_text_buffer_get_iter_at_line(buffer, &start, job->first);
+    gtk_text_buffer_get_iter_at_line(buffer, &end, job->last + 1);
+    if (job->last + 1 >= gtk_text_buffer_get_line_count(buffer)) gtk_text_buffer_get_end_iter(buffer, &end);
+    semantic_untag(app, &start, &end);
+
+    for (guint i = 0; i < job->spans->len; i++) {
+        SemanticSpan *span = &g_array_index(job->spans, SemanticSpan, i);
+        gtk_text_buffer_get_iter_at_line_index(buffer, &start, span->line, span->index);
+        end = start;
+        gtk_text_iter_set_line_index(&end, span->index + span->length);
+        gtk_text_buffer_apply_tag(buffer, semantic->tags[span->kind], &start, &end);
+    }
+    semantic->tagged_generation = job->generation;
+    semantic->tagged_first = job->first;
+    semantic->tagged_last = job->last;
+    TRACE_END("semantic: tag");
+}
+
+static void on_semantic_done(GObject *source, GAsyncResult *result, gpointer data) {
+    EditorApp *app = (EditorApp *)data;
+    Semantic *semantic = app->semantic;
+    SemanticJob *job = g_task_propagate_pointer(G_TASK(result), NULL);
+
+    semantic->busy = FALSE;
+    if (job->built) {
+        semantic_table_free(semantic->table);
+        semantic->table = job->table;
+        semantic->table_generation = job->generation;
+    }
+    /* Edited while the job ran: its lines may no longer match the buffer, and the edit queued its own job */
+    if (job->generation == semantic->generation && semantic->enabled)
+        semantic_apply(app, job);
+
+    g_array_free(job->spans, TRUE);
+    g_free(job);
+    if (semantic->again) {
+        semantic->again = FALSE;
+        semantic_start(app);
+    }
+}
+
+static gboolean semantic_wanted(EditorApp *app) {
+    GtkSourceLanguage *lang = gtk_source_buffer_get_language(app->buffer);
+    const gchar *id = lang ? gtk_source_language_get_id(lang) : NULL;
+
+    return app->semantic->enabled && gtk_source_buffer_get_highlight_syntax(app->buffer) &&
+           (g_strcmp0(id, "c") == 0 || g_strcmp0(id, "chdr") == 0 || g_strcmp0(id, "cpp") == 0);
+}
+
+static void semantic_start(EditorApp *app) {
+    Semantic *semantic = app->semantic;
+    GtkTextBuffer *buffer = GTK_TEXT_BUFFER(app->buffer);
+    GdkRectangle visible;
+    GtkTextIter iter;
+    gint top, bottom;
+
+    if (semantic->busy) {
+        semantic->again = TRUE;
+        return;
+    }
+    if (!semantic_wanted(app)) {
+        if (semantic->tagged_first <= semantic->tagged_last) semantic_clear(app);
+        return;
+    }
+
+    gtk_text_view_get_visible_rect(GTK_TEXT_VIEW(app->view), &visible);
+    gtk_text_view_get_line_at_y(GTK_TEXT_VIEW(app->view), &iter, visible.y, NULL);
+    top = gtk_text_iter_get_line(&iter);
+    gtk_text_view_get_line_at_y(GTK_TEXT_VIEW(app->view), &iter, visible.y + visible.height, NULL);
+    bottom = gtk_text_iter_get_line(&iter);
+    if (semantic->tagged_generation == semantic->generation &&
+        top >= semantic->tagged_first && bottom <= semantic->tagged_last)
+        return;
+
+    SemanticJob *job = g_new0(SemanticJob, 1);
+    job->first = MAX(0, top - SEMANTIC_MARGIN_LINES);
+    job->last = MIN(gtk_text_buffer_get_line_count(buffer) - 1, bottom + SEMANTIC_MARGIN_LINES);
+    job->generation = semantic->generation;
+    if (semantic->table && semantic->table_generation == semantic->generation) {
+        job->table = semantic->table;
+    } else {
+        GtkTextIter start, end;
+        gtk_text_buffer_get_bounds(buffer, &start, &end);
+        job->text = gtk_text_buffer_get_slice(buffer, &start, &end, TRUE);
+        job->len = strlen(job->text);
+    }
+
+    GTask *task = g_task_new(NULL, NULL, on_semantic_done, app);
+    g_task_set_task_data(task, job, NULL);
+    semantic->busy = TRUE;
+    g_task_run_in_thread(task, semantic_worker);
+    g_object_unref(task);
+}
+
+static gboolean semantic_timeout(gpointer data) {
+    EditorApp *app = (EditorApp *)data;
+    app->semantic->timeout = 0;
+    semantic_start(app);
+    return G_SOURCE_REMOVE;
+}
+
+/* However many scroll or edit events arrive, one timeout is pending at a time */
+static void semantic_schedule(EditorApp *app, guint delay) {
+    if (app->semantic->timeout) return;
+    app->semantic->timeout = g_timeout_add(delay, semantic_timeout, app);
+}
+
+static void on_semantic_buffer_changed(GtkTextBuffer *buffer, gpointer data) {
+    EditorApp *app = (EditorApp *)data;
+    app->semantic->generation++;
+    semantic_schedule(app, SEMANTIC_EDIT_DELAY);
+}
+
+static void on_semantic_viewport_changed(GtkAdjustment *adjustment, gpointer data) {
+    EditorApp *app = (EditorApp *)data;
+    semantic_schedule(app, 0);
+}
+
+/* Language, highlighting or the toggle changed: retag even if the lines are covered */
+static void on_semantic_language_changed(GObject *object, GParamSpec *pspec, gpointer data) {
+    EditorApp *app = (EditorApp *)data;
+    app->semantic->generation++;
+    semantic_schedule(app, 0);
+}
+
+static void on_toggle_semantic(GtkCheckMenuItem *item, gpointer data) {
+    EditorApp *app = (EditorApp *)data;
+    app->semantic->enabled = gtk_check_menu_item_get_active(item);
+    on_semantic_language_changed(NULL, NULL, app);
+}
+
+static void setup_semantic(EditorApp *app) {
+    Semantic *semantic = g_new0(Semantic, 1);
+    GtkTextBuffer *buffer = GTK_TEXT_BUFFER(app->buffer);
+    GtkAdjustment *vadj = gtk_scrollable_get_vadjustment(GTK_SCROLLABLE(app->view));
+
+    semantic->enabled = TRUE;
+    semantic->tagged_last = -1;
+    semantic->tags[SC_SYM_FUNCTION] = gtk_text_buffer_create_tag(buffer, "sem_function", "foreground", "#4a8fd8", NULL);
+    semantic->tags[SC_SYM_TYPE] = gtk_text_buffer_create_tag(buffer, "sem_type", "foreground", "#2aa198", NULL);
+    semantic->tags[SC_SYM_MACRO] = gtk_text_buffer_create_tag(buffer, "sem_macro", "foreground", "#c7772e", NULL);
+    semantic->tags[SC_SYM_ENUM] = gtk_text_buffer_create_tag(buffer, "sem_enum", "foreground", "#a35cc5", NULL);
+    semantic->tags[SC_SYM_LOCAL] = gtk_text_buffer_create_tag(buffer, "sem_local", "foreground", "#8a9a3a", NULL);
+    app->semantic = semantic;
+
+    g_signal_connect(buffer, "changed", G_CALLBACK(on_semantic_buffer_changed), app);
+    g_signal_connect(buffer, "notify::language", G_CALLBACK(on_semantic_language_changed), app);
+    g_signal_connect(buffer, "notify::highlight-syntax", G_CALLBACK(on_semantic_language_changed), app);
+    g_signal_connect(vadj, "value-changed", G_CALLBACK(on_semantic_viewport_changed), app);
+    g_signal_connect(vadj, "changed", G_CALLBACK(on_semantic_viewport_changed), app);
+}
+
+/*
+ * Project index
+ * Definitions of every .c/.h file under the open file's directory, behind
+ * F12 Go to Definition and Shift+F12 Find References. The index is one
+ * file per tree in ~/.cache/scrible/index/ in the sc_index layout, used
+ * straight from a read-only mapping: on a tree indexed before, lookups
+ * work as soon as the file is mapped. A refresh then runs on a worker:
+ * files whose mtime and size did not change keep their entries, the rest
+ * are read and hashed on a thread pool and parsed again only if their
+ * contents changed. The new index replaces the old file atomically.
+ * References are found by checking each file's identifier hashes, then
+ * scanning only the files that may mention the name.
+ */
+#define PROJECT_MAX_FILES      200000
+#define PROJECT_MAX_FILE_SIZE  (16 << 20)   /* bytes, larger files are not indexed */
+
+typedef struct {
+    gchar *name;
+    guint line;
+    guint kind;
+    guint definition;
+} ProjectSymbol;
+
+typedef struct {
+    gchar *path;              /* relative to the root */
+    gint64 mtime;
+    guint64 size;
+    guint64 hash;
+    gint old;                 /* entry in the previous index, -1 if none */
+    gboolean reuse;           /* keep the previous entry's symbols and identifiers */
+    GArray *symbols;          /* ProjectSymbol, when parsed */
+    GArray *idents;           /* guint32, when parsed */
+} ProjectFile;
+
+typedef struct ProjectIndex {
+    gchar *root;
+    gchar *cache_path;
+    GMappedFile *mapped;      /* NULL until an index exists */
+    sc_index index;
+    gboolean refreshing;
+    gboolean refresh_again;
+} ProjectIndex;
+
+typedef struct {
+    gchar *root;
+    gchar *cache_path;
+    GMappedFile *old;         /* a reference to the index in use, or NULL */
+    sc_index old_index;
+    GPtrArray *files;         /* ProjectFile */
+    gint parsed;
+    GMappedFile *result;
+    gint64 started;
+} ProjectRefresh;
+
+typedef struct {
+    gchar *path;              /* absolute */
+    gint line;                /* 1-based, 0 until pattern is looked up */
+    gchar *text;              /* the line, trimmed */
+    gchar *pattern;           /* a tags file search pattern, still escaped */
+} ProjectLocation;
+
+static void project_file_free(gpointer data) {
+    ProjectFile *file = data;
+    if (file->symbols) {
+        for (guint i = 0; i < file->symbols->len; i++)
+            g_free(g_array_index(file->symbols, ProjectSymbol, i).name);
+        g_array_free(file->symbols, TRUE);
+    }
+    if (file->idents) g_array_free(file->idents, TRUE);
+    g_free(file->path);
+    g_free(file);
+}
+
+static gboolean project_wants_file(const gchar *name) {
+    return g_str_has_suffix(name, ".c") || g_str_has_suffix(name, ".h");
+}
+
+/* Worker: every source file under dir, hidden directories skipped */
+static void project_walk(ProjectRefresh *refresh, const gchar *dir, const gchar *relative) {
+    GDir *handle = g_dir_open(dir, 0, NULL);
+    const gchar *name;
+
+    if (!handle) return;
+    while ((name = g_dir_read_name(handle)) && refresh->files->len < PROJECT_MAX_FILES) {
+        if (name[0] == '.') continue;
+        gchar *path = g_build_filename(dir, name, NULL);
+        gchar *rel = relative ? g_build_filename(relative, name, NULL) : g_strdup(name);
+        GStatBuf st;
+        if (g_lstat(path, &st) == 0) {
+            if (S_ISDIR(st.st_mode)) {
+                project_walk(refresh, path, rel);
+            } else if (S_ISREG(st.st_mode) && project_wants_file(name) && st.st_size <= PROJECT_MAX_FILE_SIZE) {
+                ProjectFile *file = g_new0(ProjectFile, 1);
+                file->path = rel;
+                rel = NULL;
+                file->mtime = st.st_mtime;
+                file->size = st.st_size;
+                file->old = -1;
+                g_ptr_array_add(refresh->files, file);
+            }
+        }
+        g_free(rel);
+        g_free(path);
+    }
+    g_dir_close(handle);
+}
+
+typedef struct {
+    ProjectFile *file;
+    const gchar *text;
+    GArray *line_starts;      /* gsize */
+    gint pending_function;    /* symbol that a body would make a definition, -1 */
+} ProjectParse;
+
+static guint project_line_of(ProjectParse *parse, gsize offset) {
+    guint lo = 0, hi = parse->line_starts->len;
+    while (lo < hi) {
+        guint mid = (lo + hi) / 2;
+        if (g_array_index(parse->line_starts, gsize, mid) <= offset) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;                /* 1-based: the number of lines starting at or before offset */
+}
+
+static void on_project_decl(gsize offset, gsize len, int kind, gsize scope, gpointer data) {
+    ProjectParse *parse = data;
+
+    if (kind == SC_SYM_LOCAL) return;
+    if (kind == SC_SYM_BODY) {
+        /* A function is reported at its '{', and its body follows with only locals between */
+        if (parse->pending_function >= 0)
+            g_array_index(parse->file->symbols, ProjectSymbol, parse->pending_function).definition = 1;
+        parse->pending_function = -1;
+        return;
+    }
+    ProjectSymbol symbol = { g_strndup(parse->text + offset, len), project_line_of(parse, offset), kind,
+                             kind != SC_SYM_FUNCTION };
+    g_array_append_val(parse->file->symbols, symbol);
+    parse->pending_function = kind == SC_SYM_FUNCTION ? (gint)parse->file->symbols->len - 1 : -1;
+}
+
+static void on_project_ident(gsize offset, gsize len, gpointer data) {
+    ProjectParse *parse = data;
+    guint32 hash = sc_hash64(parse->text + offset, len);
+    g_array_append_val(parse->file->idents, hash);
+}
+
+static gint compare_guint32(gconstpointer a, gconstpointer b) {
+    guint32 x = *(const guint32 *)a, y = *(const guint32 *)b;
+    return x < y ? -1 : x > y;
+}
+
+/* Thread pool: hash one file and parse it if it is new or changed */
+static void project_parse_file(gpointer data, gpointer user_data) {
+    ProjectFile *file = data;
+    ProjectRefresh *refresh = user_data;
+    gchar *path = g_build_filename(refresh->root, file->path, NULL);
+    gchar *text;
+    gsize len;
+
+    if (!g_file_get_contents(path, &text, &len, NULL)) {
+        text = g_strdup("");
+        len = 0;
+    }
+    g_free(path);
+    file->hash = sc_hash64(text, len);
+    if (file->old >= 0 && refresh->old_index.files[file->old].hash == file->hash) {
+        file->reuse = TRUE;
+        g_free(text);
+        return;
+    }
+
+    ProjectParse parse = { file, text, g_array_new(FALSE, FALSE, sizeof(gsize)), -1 };
+    const gchar *p = text, *end = text + len;
+    int state = SC_LEX_CODE;
+
+    file->symbols = g_array_new(FALSE, FALSE, sizeof(ProjectSymbol));
+    file->idents = g_array_new(FALSE, FALSE, sizeof(guint32));
+    for (;;) {
+        const gchar *eol = memchr(p, '\n', end - p);
+        gsize start = p - text;
+        g_array_append_val(parse.line_starts, start);
+        state = sc_lex_idents(p, (eol ? eol : end) - p, state, on_project_ident, &parse);
+        if (!eol) break;
+        p = eol + 1;
+    }
+    sc_scan_decls(text, len, on_project_decl, &parse);
+
+    /* Sorted and distinct, for sc_index_mentions */
+    g_array_sort(file->idents, compare_guint32);
+    guint kept = 0;
+    for (guint i = 0; i < file->idents->len; i++)
+        if (kept == 0 || g_array_index(file->idents, guint32, i) != g_array_index(file->idents, guint32, kept - 1))
+            g_array_index(file->idents, guint32, kept++) = g_array_index(file->idents, guint32, i);
+    g_array_set_size(file->idents, kept);
+
+    g_array_free(parse.line_starts, TRUE);
+    g_free(text);
+    g_atomic_int_inc(&refresh->parsed);
+}
+
+/* Symbols and identifier hashes of reused files, copied out of the previous index */
+static void project_copy_reused(ProjectRefresh *refresh) {
+    const sc_index *old = &refresh->old_index;
+    GPtrArray *by_old = g_ptr_array_new();
+
+    g_ptr_array_set_size(by_old, old->nfiles);
+    for (guint i = 0; i < refresh->files->len; i++) {
+        ProjectFile *file = g_ptr_array_index(refresh->files, i);
+        if (!file->reuse) continue;
+        const sc_index_file *entry = &old->files[file->old];
+        file->symbols = g_array_new(FALSE, FALSE, sizeof(ProjectSymbol));
+        file->idents = g_array_new(FALSE, FALSE, sizeof(guint32));
+        g_array_append_vals(file->idents, old->hashes + entry->idents, entry->nidents);
+        g_ptr_array_index(by_old, file->old) = file;
+    }
+    for (gsize i = 0; i < old->nsymbols; i++) {
+        const sc_index_symbol *sym = &old->symbols[i];
+        ProjectFile *file = g_ptr_array_index(by_old, sym->file);
+        if (!file) continue;
+        ProjectSymbol symbol = { g_strdup(old->strings + sym->name), sym->line, sym->kind, sym->definition };
+        g_array_append_val(file->symbols, symbol);
+    }
+    g_ptr_array_free(by_old, TRUE);
+}
+
+static gint compare_index_symbols(gconstpointer a, gconstpointer b) {
+    const sc_index_symbol *x = a, *y = b;
+    if (x->name != y->name) return x->name < y->name ? -1 : 1;
+    if (x->file != y->file) return x->file < y->file ? -1 : 1;
+    return x->line < y->line ? -1 : x->line > y->line;
+}
+
+static gint compare_names(gconstpointer a, gconstpointer b) {
+    return strcmp(*(const gchar *const *)a, *(const gchar *const *)b);
+}
+
+/* Lay the files out as an sc_index image and write it over the cache file */
+static gboolean project_write(ProjectRefresh *refresh) {
+    GHashTable *offsets = g_hash_table_new(g_str_hash, g_str_equal);
+    GPtrArray *names = g_ptr_array_new();
+    GString *pool = g_string_new(NULL);
+    GArray *files = g_array_new(FALSE, TRUE, sizeof(sc_index_file));
+    GArray *symbols = g_array_new(FALSE, FALSE, sizeof(sc_index_symbol));
+    GArray *hashes = g_array_new(FALSE, FALSE, sizeof(guint32));
+
+    for (guint i = 0; i < refresh->files->len; i++) {
+        ProjectFile *file = g_ptr_array_index(refresh->files, i);
+        for (guint k = 0; k < file->symbols->len; k++) {
+            gchar *name = g_array_index(file->symbols, ProjectSymbol, k).name;
+            if (!g_hash_table_contains(offsets, name)) {
+                g_hash_table_add(offsets, name);
+                g_ptr_array_add(names, name);
+            }
+        }
+    }
+    /* Names first and sorted, so offsets order like the names */
+    g_ptr_array_sort(names, compare_names);
+    for (guint i = 0; i < names->len; i++) {
+        gchar *name = g_ptr_array_index(names, i);
+        g_hash_table_insert(offsets, name, GSIZE_TO_POINTER(pool->len));
+        g_string_append_len(pool, name, strlen(name) + 1);
+    }
+
+    for (guint i = 0; i < refresh->files->len; i++) {
+        ProjectFile *file = g_ptr_array_index(refresh->files, i);
+        sc_index_file entry = { pool->len, file->mtime, file->size, file->hash, hashes->len, file->idents->len, 0 };
+        g_string_append_len(pool, file->path, strlen(file->path) + 1);
+        g_array_append_val(files, entry);
+        g_array_append_vals(hashes, file->idents->data, file->idents->len);
+        for (guint k = 0; k < file->symbols->len; k++) {
+            ProjectSymbol *symbol = &g_array_index(file->symbols, ProjectSymbol, k);
+            sc_index_symbol sym = { GPOINTER_TO_SIZE(g_hash_table_lookup(offsets, symbol->name)), i,
+                                    symbol->line, symbol->kind, symbol->definition };
+            g_array_append_val(symbols, sym);
+        }
+    }
+    g_array_sort(symbols, compare_index_symbols);
+    if (pool->len == 0) g_string_append_c(pool, '\0');
+
+    sc_index index = { (const sc_index_file *)files->data, files->len,
+                       (const sc_index_symbol *)symbols->data, symbols->len,
+                       (const unsigned int *)hashes->data, hashes->len, pool->str, pool->len };
+    gsize size = sc_index_size(&index);
+    gchar *image = g_malloc(size);
+    sc_index_store(&index, image);
+
+    gchar *dir = g_path_get_dirname(refresh->cache_path);
+    g_mkdir_with_parents(dir, 0755);
+    gboolean ok = g_file_set_contents(refresh->cache_path, image, size, NULL);
+    g_free(dir);
+    g_free(image);
+    g_array_free(hashes, TRUE);
+    g_array_free(symbols, TRUE);
+    g_array_free(files, TRUE);
+    g_string_free(pool, TRUE);
+    g_ptr_array_free(names, TRUE);
+    g_hash_table_destroy(offsets);
+    return ok;
+}
+
+static void project_refresh_worker(GTask *task, gpointer source, gpointer task_data, GCancellable *cancellable) {
+    ProjectRefresh *refresh = task_data;
+    GHashTable *old_paths = g_hash_table_new(g_str_hash, g_str_equal);
+
+    project_walk(refresh, refresh->root, NULL);
+    for (gsize i = 0; i < refresh->old_index.nfiles; i++)
+        g_hash_table_insert(old_paths, (gpointer)(refresh->old_index.strings + refresh->old_index.files[i].path),
+                            GSIZE_TO_POINTER(i + 1));
+
+    /* Unchanged mtime and size: keep the entry without reading the file */
+    GThreadPool *pool = g_thread_pool_new(project_parse_file, refresh, g_get_num_processors(), FALSE, NULL);
+    for (guint i = 0; i < refresh->files->len; i++) {
+        ProjectFile *file = g_ptr_array_index(refresh->files, i);
+        gsize old = GPOINTER_TO_SIZE(g_hash_table_lookup(old_paths, file->path));
+        if (old) {
+            const sc_index_file *entry = &refresh->old_index.files[old - 1];
+            file->old = old - 1;
+            if (entry->mtime == file->mtime && entry->size == file->size) {
+                file->hash = entry->hash;
+                file->reuse = TRUE;
+                continue;
+            }
+        }
+        g_thread_pool_push(pool, file, NULL);
+    }
+    g_thread_pool_free(pool, FALSE, TRUE);
+    g_hash_table_destroy(old_paths);
+
+    project_copy_reused(refresh);
+    if (project_write(refresh))
+        refresh->result = g_mapped_file_new(refresh->cache_path, FALSE, NULL);
+    g_task_return_boolean(task, refresh->result != NULL);
+}
+
+static void project_refresh_free(ProjectRefresh *refresh) {
+    g_ptr_array_free(refresh->files, TRUE);
+    if (refresh->old) g_mapped_file_unref(refresh->old);
+    if (refresh->result) g_mapped_file_unref(refresh->result);
+    g_free(refresh->root);
+    g_free(refresh->cache_path);
+    g_free(refresh);
+}
+
+/* Take a mapping of an index file if it is valid */
+static gboolean project_use_mapping(ProjectIndex *project, GMappedFile *mapped) {
+    sc_index index;
+
+    if (!mapped || sc_index_open(g_mapped_file_get_contents(mapped), g_mapped_file_get_length(mapped), &index) != 0)
+        return FALSE;
+    if (project->mapped) g_mapped_file_unref(project->mapped);
+    project->mapped = g_mapped_file_ref(mapped);
+    project->index = index;
+    return TRUE;
+}
+
+static void project_refresh(EditorApp *app);
+
+static void on_project_refreshed(GObject *source, GAsyncResult *result, gpointer data) {
+    EditorApp *app = (EditorApp *)data;
+    ProjectIndex *project = app->project;
+    ProjectRefresh *refresh = g_task_get_task_data(G_TASK(result));
+
+    project->refreshing = FALSE;
+    /* The root may have changed meanwhile, then this index is not the one in use */
+    if (g_task_propagate_boolean(G_TASK(result), NULL) && g_strcmp0(refresh->root, project->root) == 0 &&
+        project_use_mapping(project, refresh->result))
+        g_print("Project index: %u files, %d parsed, %" G_GSIZE_FORMAT " symbols in %.0f ms\n",
+                refresh->files->len, refresh->parsed, project->index.nsymbols,
+                (g_get_monotonic_time() - refresh->started) / 1000.0);
+    if (project->refresh_again) {
+        project->refresh_again = FALSE;
+        project_refresh(app);
+    }
+}
+
+static void project_refresh(EditorApp *app) {
+    ProjectIndex *project = app->project;
+
+    if (!project) return;
+    if (project->refreshing) {
+        project->refresh_again = TRUE;
+        return;
+    }
+
+    ProjectRefresh *refresh = g_new0(ProjectRefresh, 1);
+    refresh->root = g_strdup(project->root);
+    refresh->cache_path = g_strdup(project->cache_path);
+    refresh->files = g_ptr_array_new_with_free_func(project_file_free);
+    refresh->started = g_get_monotonic_time();
+    if (project->mapped) {
+        refresh->old = g_mapped_file_ref(project->mapped);
+        refresh->old_index = project->index;
+    }
+
+    GTask *task = g_task_new(NULL, NULL, on_project_refreshed, app);
+    g_task_set_task_data(task, refresh, (GDestroyNotify)project_refresh_free);
+    project->refreshing = TRUE;
+    g_task_run_in_thread(task, project_refresh_worker);
+    g_object_unref(task);
+}
+
+/* Index the tree of the file just opened or saved; map a previous index of it at once */
+static void project_index_file(EditorApp *app, const gchar *filename) {
+    gchar *root = g_path_get_dirname(filename);
+    ProjectIndex *project = app->project;
+
+    if (!project) project = app->project = g_new0(ProjectIndex, 1);
+    if (g_strcmp0(project->root, root) != 0) {
+        gchar name[32];
+        g_snprintf(name, sizeof(name), "%016llx.idx", sc_hash64(root, strlen(root)));
+        g_free(project->root);
+        g_free(project->cache_path);
+        project->root = root;
+        project->cache_path = g_build_filename(g_get_user_cache_dir(), "scrible", "index", name, NULL);
+        if (project->mapped) g_mapped_file_unref(project->mapped);
+        project->mapped = NULL;
+
+        GMappedFile *mapped = g_mapped_file_new(project->cache_path, FALSE, NULL);
+        project_use_mapping(project, mapped);
+        if (mapped) g_mapped_file_unref(mapped);
+    } else {
+        g_free(root);
+    }
+    project_refresh(app);
+}
+
+static gchar *identifier_at_cursor(EditorApp *app) {
+    GtkTextBuffer *buffer = GTK_TEXT_BUFFER(app->buffer);
+    GtkTextIter start, end;
+
+    gtk_text_buffer_get_iter_at_mark(buffer, &start, gtk_text_buffer_get_insert(buffer));
+    end = start;
+    while (!gtk_text_iter_is_start(&start)) {
+        GtkTextIter prev = start;
+        gtk_text_iter_backward_char(&prev);
+        gunichar c = gtk_text_iter_get_char(&prev);
+        if (!g_unichar_isalnum(c) && c != '_') break;
+        start = prev;
+    }
+    while (g_unichar_isalnum(gtk_text_iter_get_char(&end)) || gtk_text_iter_get_char(&end) == '_')
+        gtk_text_iter_forward_char(&end);
+    if (gtk_text_iter_equal(&start, &end)) return NULL;
+    return gtk_text_buffer_get_text(buffer, &start, &end, TRUE);
+}
+
+static void project_location_clear(gpointer data) {
+    ProjectLocation *location = data;
+    g_free(location->path);
+    g_free(location->text);
+    g_free(location->pattern);
+}
+
+static void open_location(EditorApp *app, const gchar *path, gint line) {
+    if (g_strcmp0(path, app->current_file) != 0 && !load_file(app, path)) {
+        g_print("Could not open %s\n", path);
+        return;
+    }
+    jump_to_line(app, line);
+}
+
+enum {
+    LOC_COL_PLACE = 0,
+    LOC_COL_TEXT,
+    LOC_COL_PATH,
+    LOC_COL_LINE,
+    LOC_NUM_COLS
+};
+
+static void on_location_activated(GtkTreeView *tree, GtkTreePath *path, GtkTreeViewColumn *column,
+                                  gpointer data) {
+    EditorApp *app = (EditorApp *)data;
+    GtkTreeModel *model = gtk_tree_view_get_model(tree);
+    GtkTreeIter iter;
+    gchar *file;
+    gint line;
+
+    if (!gtk_tree_model_get_iter(model, &iter, path)) return;
+    gtk_tree_model_get(model, &iter, LOC_COL_PATH, &file, LOC_COL_LINE, &line, -1);
+    open_location(app, file, line);
+    g_free(file);
+}
+
+/* A window listing locations (ProjectLocation), activate a row to go there */
+static void show_locations(EditorApp *app, const gchar *title, GArray *locations) {
+    GtkListStore *store = gtk_list_store_new(LOC_NUM_COLS, G_TYPE_STRING, G_TYPE_STRING,
+                                             G_TYPE_STRING, G_TYPE_INT);
+    gsize root_len = app->project ? strlen(app->project->root) : 0;
+
+    for (guint i = 0; i < locations->len; i++) {
+        ProjectLocation *location = &g_array_index(locations, ProjectLocation, i);
+        const gchar *shown = location->path;
+        if (root_len && g_str_has_prefix(shown, app->project->root) && shown[root_len] == G_DIR_SEPARATOR)
+            shown += root_len + 1;
+        gchar *place = g_strdup_printf("%s:%d", shown, location->line);
+        GtkTreeIter iter;
+        gtk_list_store_append(store, &iter);
+        gtk_list_store_set(store, &iter, LOC_COL_PLACE, place, LOC_COL_TEXT, location->text,
+                           LOC_COL_PATH, location->path, LOC_COL_LINE, location->line, -1);
+        g_free(place);
+    }
+
+    GtkWidget *tree = gtk_tree_view_new_with_model(GTK_TREE_MODEL(store));
+    g_object_unref(store);
+    gtk_tree_view_append_column(GTK_TREE_VIEW(tree),
+        gtk_tree_view_column_new_with_attributes("Location", gtk_cell_renderer_text_new(),
+                                                 "text", LOC_COL_PLACE, NULL));
+    gtk_tree_view_append_column(GTK_TREE_VIEW(tree),
+        gtk_tree_view_column_new_with_attributes("Line", gtk_cell_renderer_text_new(),
+                                                 "text", LOC_COL_TEXT, NULL));
+    g_signal_connect(tree, "row-activated", G_CALLBACK(on_location_activated), app);
+
+    GtkWidget *scroll = gtk_scrolled_window_new(NULL, NULL);
+    gtk_container_add(GTK_CONTAINER(scroll), tree);
+    GtkWidget *window = gtk_window_new(GTK_WINDOW_TOPLEVEL);
+    gtk_window_set_title(GTK_WINDOW(window), title);
+    gtk_window_set_transient_for(GTK_WINDOW(window), GTK_WINDOW(app->window));
+    gtk_window_set_default_size(GTK_WINDOW(window), 640, 360);
+    gtk_container_add(GTK_CONTAINER(window), scroll);
+    gtk_widget_show_all(window);
+}
+
+static gchar *project_path(ProjectIndex *project, guint file) {
+    return g_build_filename(project->root, project->index.strings + project->index.files[file].path, NULL);
+}
+
+/* Line number'th line of text, trimmed */
+static gchar *line_of_text(const gchar *text, gsize len, gint line) {
+    const gchar *p = text, *end = text + len;
+
+    for (gint i = 1; i < line && p < end; i++) {
+        const gchar *eol = memchr(p, '\n', end - p);
+        p = eol ? eol + 1 : end;
+    }
+    const gchar *eol = memchr(p, '\n', end - p);
+    return g_strstrip(g_strndup(p, (eol ? eol : end) - p));
+}
+
+static gboolean project_ready(EditorApp *app) {
+    if (app->project && app->project->mapped) return TRUE;
+    g_print(app->project && app->project->refreshing ? "Project index: still indexing\n"
+                                                     : "Project index: open a file of the project first\n");
+    return FALSE;
+}
+
+typedef struct {
+    gchar *name;
+    GArray *found;            /* ProjectLocation */
+    GHashTable *files;        /* path -> GBytes of its contents, each file read once */
+} DefinitionSearch;
+
+static void definition_search_free(gpointer data) {
+    DefinitionSearch *search = data;
+    g_array_free(search->found, TRUE);
+    g_hash_table_destroy(search->files);
+    g_free(search->name);
+    g_free(search);
+}
+
+/* Contents of path, read on first use; empty if it cannot be read */
+static GBytes *definition_file(DefinitionSearch *search, const gchar *path) {
+    GBytes *bytes = g_hash_table_lookup(search->files, path);
+    gchar *text;
+    gsize len;
+
+    if (bytes) return bytes;
+    bytes = g_file_get_contents(path, &text, &len, NULL) ? g_bytes_new_take(text, len) : g_bytes_new(NULL, 0);
+    g_hash_table_insert(search->files, g_strdup(path), bytes);
+    return bytes;
+}
+
+/* Worker: line numbers for tags given by pattern, duplicates dropped, and each line's text for the list */
+static void definition_worker(GTask *task, gpointer source, gpointer task_data, GCancellable *cancellable) {
+    DefinitionSearch *search = task_data;
+    GArray *found = search->found;
+
+    for (guint i = 0; i < found->len; i++) {
+        ProjectLocation *location = &g_array_index(found, ProjectLocation, i);
+        if (location->pattern) {
+            gsize len;
+            const gchar *text = g_bytes_get_data(definition_file(search, location->path), &len);
+            location->line = MAX(text ? sc_tag_find_pattern(text, len, location->pattern, strlen(location->pattern)) : 0, 1);
+        }
+        gboolean seen = FALSE;
+        for (guint j = 0; j < i && !seen; j++) {
+            ProjectLocation *other = &g_array_index(found, ProjectLocation, j);
+            seen = other->line == location->line && g_strcmp0(other->path, location->path) == 0;
+        }
+        if (seen) g_array_remove_index(found, i--);
+    }
+    for (guint i = 0; found->len > 1 && i < found->len; i++) {
+        ProjectLocation *location = &g_array_index(found, ProjectLocation, i);
+        gsize len;
+        const gchar *text = g_bytes_get_data(definition_file(search, location->path), &len);
+        location->text = text ? line_of_text(text, len, location->line) : g_strdup("");
+    }
+    g_task_return_boolean(task, TRUE);
+}
+
+static void on_definitions_found(GObject *source, GAsyncResult *result, gpointer data) {
+    EditorApp *app = (EditorApp *)data;
+    DefinitionSearch *search = g_task_get_task_data(G_TASK(result));
+
+    if (search->found->len == 1) {
+        ProjectLocation *location = &g_array_index(search->found, ProjectLocation, 0);
+        open_location(app, location->path, location->line);
+    } else {
+        gchar *title = g_strdup_printf("Definitions of %s", search->name);
+        show_locations(app, title, search->found);
+        g_free(title);
+    }
+}
+
+/* F12: definitions of the identifier at the cursor, from the project index and any tags file */
+static void on_goto_definition(GtkWidget *widget, gpointer data) {
+    EditorApp *app = (EditorApp *)data;
+    gchar *name = identifier_at_cursor(app);
+    ProjectIndex *project = app->project;
+
+    if (!name) return;
+    GArray *found = g_array_new(FALSE, FALSE, sizeof(ProjectLocation));
+    g_array_set_clear_func(found, project_location_clear);
+
+    /* Prototypes only when there is no body anywhere */
+    if (project && project->mapped) {
+        gsize first, count = sc_index_lookup(&project->index, name, strlen(name), &first);
+        for (gint pass = 0; pass < 2 && found->len == 0; pass++) {
+            for (gsize i = first; i < first + count; i++) {
+                const sc_index_symbol *sym = &project->index.symbols[i];
+                if (pass == 0 && !sym->definition) continue;
+                ProjectLocation location = { project_path(project, sym->file), sym->line, NULL };
+                g_array_append_val(found, location);
+            }
+        }
+    }
+    gboolean searched_tags = tags_lookup(app, name, found);
+
+    if (found->len == 0) {
+        if (searched_tags || project_ready(app))
+            g_print("No definition of %s found\n", name);
+        g_array_free(found, TRUE);
+        g_free(name);
+        return;
+    }
+
+    /* Pattern lines and the listed text need the files read, off the UI thread */
+    DefinitionSearch *search = g_new0(DefinitionSearch, 1);
+    search->name = name;
+    search->found = found;
+    search->files = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GDestroyNotify)g_bytes_unref);
+    GTask *task = g_task_new(NULL, NULL, on_definitions_found, app);
+    g_task_set_task_data(task, search, definition_search_free);
+    g_task_run_in_thread(task, definition_worker);
+    g_object_unref(task);
+}
+
+typedef struct {
+    gchar *name;
+    GPtrArray *paths;         /* files that may mention name */
+    gchar *current;           /* the open file, searched in buffer text */
+    gchar *current_text;
+    GArray *found;            /* ProjectLocation */
+} ReferenceSearch;
+
+typedef struct {
+    ReferenceSearch *search;
+    const gchar *line;
+    gint line_number;
+    gboolean hit;
+} ReferenceLine;
+
+static void on_reference_ident(gsize offset, gsize len, gpointer data) {
+    ReferenceLine *rl = data;
+    if (len == strlen(rl->search->name) && memcmp(rl->line + offset, rl->search->name, len) == 0)
+        rl->hit = TRUE;
+}
+
+static void reference_search_free(gpointer data) {
+    ReferenceSearch *search = data;
+    g_ptr_array_free(search->paths, TRUE);
+    if (search->found) g_array_free(search->found, TRUE);
+    g_free(search->current_text);
+    g_free(search->current);
+    g_free(search->name);
+    g_free(search);
+}
+
+static void reference_worker(GTask *task, gpointer source, gpointer task_data, GCancellable *cancellable) {
+    ReferenceSearch *search = task_data;
+
+    for (guint i = 0; i < search->paths->len; i++) {
+        const gchar *path = g_ptr_array_index(search->paths, i);
+        gchar *text;
+        gsize len;
+
+        if (g_strcmp0(path, search->current) == 0) {
+            text = g_strdup(search->current_text);
+            len = strlen(text);
+        } else if (!g_file_get_contents(path, &text, &len, NULL)) {
+            continue;
+        }
+
+        const gchar *p = text, *end = text + len;
+        int state = SC_LEX_CODE;
+        ReferenceLine rl = { search, NULL, 0, FALSE };
+        for (;;) {
+            const gchar *eol = memchr(p, '\n', end - p);
+            gsize n = (eol ? eol : end) - p;
+            rl.line = p;
+            rl.line_number++;
+            rl.hit = FALSE;
+            state = sc_lex_idents(p, n, state, on_reference_ident, &rl);
+            if (rl.hit) {
+                ProjectLocation location = { g_strdup(path), rl.line_number, g_strstrip(g_strndup(p, n)) };
+                g_array_append_val(search->found, location);
+            }
+            if (!eol) break;
+            p = eol + 1;
+        }
+        g_free(text);
+    }
+    g_task_return_boolean(task, TRUE);
+}
+
+static void on_references_found(GObject *source, GAsyncResult *result, gpointer data) {
+    EditorApp *app = (EditorApp *)data;
+    ReferenceSearch *search = g_task_get_task_data(G_TASK(result));
+
+    if (search->found->len == 0) {
+        g_print("No references to %s\n", search->name);
+        return;
+    }
+    gchar *title = g_strdup_printf("References to %s (%u)", search->name, search->found->len);
+    show_locations(app, title, search->found);
+    g_free(title);
+}
+
+/* Shift+F12: every line of the project naming the identifier at the cursor */
+static void on_find_references(GtkWidget *widget, gpointer data) {
+    EditorApp *app = (EditorApp *)data;
+    gchar *name = identifier_at_cursor(app);
+
+    if (!name || !project_ready(app)) {
+        g_free(name);
+        return;
+    }
+    ProjectIndex *project = app->project;
+    ReferenceSearch *search = g_new0(ReferenceSearch, 1);
+    search->name = name;
+    search->paths = g_ptr_array_new_with_free_func(g_free);
+    search->found = g_array_new(FALSE, FALSE, sizeof(ProjectLocation));
+    g_array_set_clear_func(search->found, project_location_clear);
+    for (gsize i = 0; i < project->index.nfiles; i++)
+        if (sc_index_mentions(&project->index, i, name, strlen(name)))
+            g_ptr_array_add(search->paths, project_path(project, i));
+
+    /* The open file as edited, not as last saved */
+    if (app->current_file) {
+        search->current = g_strdup(app->current_file);
+        search->current_text = get_save_text(app);
+        gboolean listed = FALSE;
+        for (guint i = 0; i < search->paths->len && !listed; i++)
+            listed = g_strcmp0(g_ptr_array_index(search->paths, i), app->current_file) == 0;
+        if (!listed) g_ptr_array_add(search->paths, g_strdup(app->current_file));
+    }
+
+    GTask *task = g_task_new(NULL, NULL, on_references_found, app);
+    g_task_set_task_data(task, search, reference_search_free);
+    g_task_run_in_thread(task, reference_worker);
+    g_object_unref(task);
+}
+
+/*
+ * Tags files
+ * A ctags "tags" file in the open file's directory or above (as CI builds
+ * tend to produce) is mapped read-only and searched in place, never copied:
+ * a sorted file is binary searched, so a lookup touches a few pages of even
+ * a very large one. Go to Definition consults it next to the project index,
+ * and a worker scanning the mapping fills a Tags group in the Symbols
+ * sidebar with the open file's tags. File > Export Tags writes the project
+ * index back out in the same format.
+ */
+#define TAGS_UNSORTED_MAX   (64 << 20)   /* bytes, larger unsorted files are not scanned for lookups */
+#define TAGS_MAX_RESULTS    1000
+#define TAGS_MAX_FILE_TAGS  20000
+
+typedef struct {
+    gchar *name;
+    gint line;
+} TagEntry;
+
+typedef struct Tags {
+    gchar *path;              /* the tags file, NULL if none was found */
+    gchar *dir;               /* its directory, relative names are relative to it */
+    GMappedFile *mapped;
+    int sorted;               /* sc_tags_sorted of the mapping */
+    gint64 mtime;             /* of the mapping, to notice the file being regenerated */
+    goffset size;
+    gchar *file;              /* the file file_tags belong to */
+    GArray *file_tags;        /* TagEntry, the sidebar's Tags group */
+    GCancellable *scan;       /* the running sidebar scan */
+} Tags;
+
+typedef struct {
+    GMappedFile *mapped;
+    gchar *relative;          /* the scanned file as the tags file may name it */
+    gchar *absolute;
+    GArray *entries;          /* TagEntry */
+} TagsScan;
+
+static void tag_entry_clear(gpointer data) {
+    g_free(((TagEntry *)data)->name);
+}
+
+/* The nearest file called "tags" in the directory of filename or above */
+static gchar *tags_locate(const gchar *filename) {
+    gchar *dir = g_path_get_dirname(filename);
+
+    for (;;) {
+        gchar *path = g_build_filename(dir, "tags", NULL);
+        if (g_file_test(path, G_FILE_TEST_IS_REGULAR)) {
+            g_free(dir);
+            return path;
+        }
+        g_free(path);
+        gchar *parent = g_path_get_dirname(dir);
+        gboolean top = strcmp(parent, dir) == 0;
+        g_free(dir);
+        dir = parent;
+        if (top) break;
+    }
+    g_free(dir);
+    return NULL;
+}
+
+/* Map the tags file, again if it changed since; FALSE if there is none */
+static gboolean tags_map(Tags *tags) {
+    GStatBuf st;
+
+    if (!tags->path || g_stat(tags->path, &st) != 0) return FALSE;
+    if (tags->mapped && st.st_mtime == tags->mtime && st.st_size == tags->size) return TRUE;
+
+    if (tags->mapped) g_mapped_file_unref(tags->mapped);
+    tags->mapped = g_mapped_file_new(tags->path, FALSE, NULL);
+    if (!tags->mapped) return FALSE;
+    tags->mtime = st.st_mtime;
+    tags->size = st.st_size;
+    tags->sorted = sc_tags_sorted(g_mapped_file_get_contents(tags->mapped),
+                                  g_mapped_file_get_length(tags->mapped));
+    if (!tags->sorted)
+        g_print("Tags: %s is not sorted, lookups scan it and skip it above %d MB (ctags --sort=yes)\n",
+                tags->path, TAGS_UNSORTED_MAX >> 20);
+    return TRUE;
+}
+
+static gchar *tag_file_path(Tags *tags, const sc_tag *tag) {
+    gchar *file = g_strndup(tag->file, tag->file_len);
+    if (g_path_is_absolute(file)) return file;
+    gchar *path = g_build_filename(tags->dir, file, NULL);
+    g_free(file);
+    return path;
+}
+
+/* Line of a tag, looking a search pattern up in text (the tagged file's contents) */
+static gint tag_line(const sc_tag *tag, const gchar *text, gsize len) {
+    unsigned int line = tag->line;
+
+    if (line == 0 && tag->pattern)
+        line = sc_tag_find_pattern(text, len, tag->pattern, tag->pattern_len);
+    return MAX(line, 1);
+}
+
+/*
+ * Append the tags called name to found (ProjectLocation), skipping places
+ * already there. Tags addressed by a pattern get line 0 and the pattern,
+ * for the caller to look up away from the UI thread. FALSE if there is no
+ * tags file to search.
+ */
+static gboolean tags_lookup(EditorApp *app, const gchar *name, GArray *found) {
+    Tags *tags = app->tags;
+
+    if (!tags || !tags_map(tags)) return FALSE;
+    const gchar *data = g_mapped_file_get_contents(tags->mapped);
+    gsize len = g_mapped_file_get_length(tags->mapped), nlen = strlen(name);
+    if (!tags->sorted && len > TAGS_UNSORTED_MAX) return FALSE;
+
+    guint before = found->len, added = 0;
+    for (gsize pos = sc_tags_find(data, len, tags->sorted, name, nlen, 0); pos < len && added < TAGS_MAX_RESULTS;
+         pos = sc_tags_find(data, len, tags->sorted, name, nlen, pos)) {
+        const gchar *nl = memchr(data + pos, '\n', len - pos);
+        gsize end = nl ? (gsize)(nl - data) : len;
+        sc_tag tag;
+
+        if (sc_tag_parse(data + pos, end - pos, &tag) == 0) {
+            gchar *path = tag_file_path(tags, &tag);
+            gint line = tag.line ? (gint)tag.line : tag.pattern ? 0 : 1;
+            gboolean seen = FALSE;
+            for (guint i = 0; i < before && line && !seen; i++) {
+                ProjectLocation *other = &g_array_index(found, ProjectLocation, i);
+                seen = other->line == line && g_strcmp0(other->path, path) == 0;
+            }
+            if (seen) {
+                g_free(path);
+            } else {
+                ProjectLocation location = { path, line, NULL,
+                                             line ? NULL : g_strndup(tag.pattern, tag.pattern_len) };
+                g_array_append_val(found, location);
+                added++;
+            }
+        }
+        pos = nl ? end + 1 : len;
+    }
+    return TRUE;
+}
+
+/* The Tags group of the Symbols sidebar, after whatever parse_symbols put there */
+static void tags_fill_sidebar(EditorApp *app) {
+    Tags *tags = app->tags;
+    GtkTreeModel *model = GTK_TREE_MODEL(app->tree_store);
+    GtkTreeIter group, child;
+
+    if (gtk_tree_model_get_iter_first(model, &group)) {
+        gboolean more = TRUE;
+        while (more) {
+            gchar *name;
+            gtk_tree_model_get(model, &group, COL_NAME, &name, -1);
+            more = g_strcmp0(name, "Tags") == 0 ? gtk_tree_store_remove(app->tree_store, &group)
+                                                : gtk_tree_model_iter_next(model, &group);
+            g_free(name);
+        }
+    }
+    if (!tags || !tags->file_tags || tags->file_tags->len == 0 || g_strcmp0(tags->file, app->current_file) != 0)
+        return;
+
+    gtk_tree_store_append(app->tree_store, &group, NULL);
+    gtk_tree_store_set(app->tree_store, &group, COL_NAME, "Tags", COL_LINE, 0, -1);
+    for (guint i = 0; i < tags->file_tags->len; i++) {
+        TagEntry *entry = &g_array_index(tags->file_tags, TagEntry, i);
+        gtk_tree_store_append(app->tree_store, &child, &group);
+        gtk_tree_store_set(app->tree_store, &child, COL_NAME, entry->name, COL_LINE, entry->line, -1);
+    }
+    GtkTreePath *path = gtk_tree_model_get_path(model, &group);
+    gtk_tree_view_expand_row(GTK_TREE_VIEW(app->tree_view), path, FALSE);
+    gtk_tree_path_free(path);
+}
+
+static gint compare_tag_entries(gconstpointer a, gconstpointer b) {
+    return ((const TagEntry *)a)->line - ((const TagEntry *)b)->line;
+}
+
+/* Worker: every tag of one file, found by its file field without parsing other lines */
+static void tags_scan_worker(GTask *task, gpointer source, gpointer task_data, GCancellable *cancellable) {
+    TagsScan *scan = task_data;
+    const gchar *data = g_mapped_file_get_contents(scan->mapped);
+    gsize len = g_mapped_file_get_length(scan->mapped);
+    gsize rel_len = strlen(scan->relative), abs_len = strlen(scan->absolute);
+    gchar *text = NULL;
+    gsize text_len = 0;
+    guint lines = 0;
+
+    for (gsize pos = 0; pos < len && scan->entries->len < TAGS_MAX_FILE_TAGS; lines++) {
+        const gchar *nl = memchr(data + pos, '\n', len - pos);
+        gsize end = nl ? (gsize)(nl - data) : len;
+        const gchar *tab = memchr(data + pos, '\t', end - pos);
+
+        if ((lines & 0xffff) == 0 && g_cancellable_is_cancelled(cancellable)) break;
+        if (tab) {
+            gsize rest = data + end - (tab + 1);
+            gboolean match = (rest > rel_len && memcmp(tab + 1, scan->relative, rel_len) == 0 && tab[1 + rel_len] == '\t') ||
+                             (rest > abs_len && memcmp(tab + 1, scan->absolute, abs_len) == 0 && tab[1 + abs_len] == '\t');
+            sc_tag tag;
+            if (match && sc_tag_parse(data + pos, end - pos, &tag) == 0) {
+                if (!text && tag.pattern && !g_file_get_contents(scan->absolute, &text, &text_len, NULL))
+                    text = g_strdup("");
+                TagEntry entry = { g_strndup(tag.name, tag.name_len), tag_line(&tag, text, text_len) };
+                g_array_append_val(scan->entries, entry);
+            }
+        }
+        pos = nl ? end + 1 : len;
+    }
+    g_array_sort(scan->entries, compare_tag_entries);
+    g_free(text);
+    g_task_return_boolean(task, !g_cancellable_is_cancelled(cancellable));
+}
+
+static void tags_scan_free(gpointer data) {
+    TagsScan *scan = data;
+    g_mapped_file_unref(scan->mapped);
+    if (scan->entries) g_array_free(scan->entries, TRUE);
+    g_free(scan->relative);
+    g_free(scan->absolute);
+    g_free(scan);
+}
+
+static void on_tags_scanned(GObject *source, GAsyncResult *result, gpointer data) {
+    EditorApp *app = (EditorApp *)data;
+    Tags *tags = app->tags;
+    TagsScan *scan = g_task_get_task_data(G_TASK(result));
+
+    /* Cancelled scans were for a file no longer open */
+    if (!g_task_propagate_boolean(G_TASK(result), NULL)) return;
+    if (tags->file_tags) g_array_free(tags->file_tags, TRUE);
+    tags->file_tags = scan->entries;
+    scan->entries = NULL;
+    g_clear_object(&tags->scan);
+    tags_fill_sidebar(app);
+}
+
+/* Find the tags file for a file just opened or saved under a new name and scan it for the sidebar */
+static void tags_open_file(EditorApp *app, const gchar *filename) {
+    Tags *tags = app->tags;
+    gchar *path = tags_locate(filename);
+
+    if (!tags) tags = app->tags = g_new0(Tags, 1);
+    if (tags->scan) {
+        g_cancellable_cancel(tags->scan);
+        g_clear_object(&tags->scan);
+    }
+    if (tags->file_tags) g_array_free(tags->file_tags, TRUE);
+    tags->file_tags = NULL;
+    g_free(tags->file);
+    tags->file = g_strdup(filename);
+
+    if (g_strcmp0(path, tags->path) != 0) {
+        g_free(tags->path);
+        g_free(tags->dir);
+        tags->path = path;
+        tags->dir = path ? g_path_get_dirname(path) : NULL;
+        if (tags->mapped) g_mapped_file_unref(tags->mapped);
+        tags->mapped = NULL;
+    } else {
+        g_free(path);
+    }
+    if (!tags_map(tags)) return;
+
+    TagsScan *scan = g_new0(TagsScan, 1);
+    scan->mapped = g_mapped_file_ref(tags->mapped);
+    scan->absolute = g_strdup(filename);
+    scan->relative = g_str_has_prefix(filename, tags->dir) && filename[strlen(tags->dir)] == G_DIR_SEPARATOR
+                   ? g_strdup(filename + strlen(tags->dir) + 1) : g_strdup(filename);
+    scan->entries = g_array_new(FALSE, FALSE, sizeof(TagEntry));
+    g_array_set_clear_func(scan->entries, tag_entry_clear);
+
+    tags->scan = g_cancellable_new();
+    GTask *task = g_task_new(NULL, tags->scan, on_tags_scanned, app);
+    g_task_set_task_data(task, scan, tags_scan_free);
+    g_task_run_in_thread(task, tags_scan_worker);
+    g_object_unref(task);
+}
+
+typedef struct {
+    GMappedFile *mapped;      /* the project index */
+    sc_index index;
+    gchar *root;
+    gchar *path;              /* the tags file to write */
+} TagsExport;
+
+static char tag_kind_letter(const sc_index_symbol *sym) {
+    switch (sym->kind) {
+    case SC_SYM_FUNCTION: return sym->definition ? 'f' : 'p';
+    case SC_SYM_TYPE:     return 't';
+    case SC_SYM_MACRO:    return 'd';
+    default:              return 'e';
+    }
+}
+
+/* Worker: the index as a sorted ctags file, names relative to it when it sits at the root */
+static void tags_export_worker(GTask *task, gpointer source, gpointer task_data, GCancellable *cancellable) {
+    TagsExport *export = task_data;
+    const sc_index *index = &export->index;
+    gchar *dir = g_path_get_dirname(export->path);
+    gboolean relative = strcmp(dir, export->root) == 0;
+    GString *out = g_string_new("!_TAG_FILE_FORMAT\t2\t/extended format; --format=1 will not append ;\" to lines/\n"
+                                "!_TAG_FILE_SORTED\t1\t/0=unsorted, 1=sorted, 2=foldcase/\n"
+                                "!_TAG_PROGRAM_NAME\tscrible\t//\n");
+    GPtrArray *paths = g_ptr_array_new_with_free_func(g_free);
+    GError *error = NULL;
+
+    for (gsize i = 0; i < index->nfiles; i++) {
+        const gchar *path = index->strings + index->files[i].path;
+        g_ptr_array_add(paths, relative ? g_strdup(path) : g_build_filename(export->root, path, NULL));
+    }
+    /* The index is in name order already, which is what sorted means */
+    for (gsize i = 0; i < index->nsymbols; i++) {
+        const sc_index_symbol *sym = &index->symbols[i];
+        g_string_append_printf(out, "%s\t%s\t%u;\"\t%c\n", index->strings + sym->name,
+                               (const gchar *)g_ptr_array_index(paths, sym->file), sym->line, tag_kind_letter(sym));
+    }
+    if (g_file_set_contents(export->path, out->str, out->len, &error)) {
+        g_task_return_pointer(task, g_strdup_printf("%" G_GSIZE_FORMAT " tags written to %s",
+                                                    index->nsymbols, export->path), g_free);
+    } else {
+        g_task_return_error(task, error);
+    }
+    g_ptr_array_free(paths, TRUE);
+    g_string_free(out, TRUE);
+    g_free(dir);
+}
+
+static void tags_export_free(gpointer data) {
+    TagsExport *export = data;
+    g_mapped_file_unref(export->mapped);
+    g_free(export->root);
+    g_free(export->path);
+    g_free(export);
+}
+
+static void on_tags_exported(GObject *source, GAsyncResult *result, gpointer data) {
+    EditorApp *app = (EditorApp *)data;
+    GError *error = NULL;
+    gchar *message = g_task_propagate_pointer(G_TASK(result), &error);
+
+    if (!message) {
+        g_print("Export Tags: %s\n", error->message);
+        g_error_free(error);
+        return;
+    }
+    g_print("Export Tags: %s\n", message);
+    g_free(message);
+    /* The new file may be the one lookups should use now */
+    if (app->current_file) tags_open_file(app, app->current_file);
+}
+
+static void on_export_tags(GtkWidget *widget, gpointer data) {
+    EditorApp *app = (EditorApp *)data;
+
+    if (!project_ready(app)) return;
+    GtkWidget *dialog = gtk_file_chooser_dialog_new("Export Tags", GTK_WINDOW(app->window),
+                                                    GTK_FILE_CHOOSER_ACTION_SAVE, "_Cancel", GTK_RESPONSE_CANCEL,
+                                                    "_Export", GTK_RESPONSE_ACCEPT, NULL);
+    GtkFileChooser *chooser = GTK_FILE_CHOOSER(dialog);
+    gtk_file_chooser_set_do_overwrite_confirmation(chooser, TRUE);
+    gtk_file_chooser_set_current_folder(chooser, app->project->root);
+    gtk_file_chooser_set_current_name(chooser, "tags");
+
+    if (gtk_dialog_run(GTK_DIALOG(dialog)) == GTK_RESPONSE_ACCEPT) {
+        TagsExport *export = g_new0(TagsExport, 1);
+        export->mapped = g_mapped_file_ref(app->project->mapped);
+        export->index = app->project->index;
+        export->root = g_strdup(app->project->root);
+        export->path = gtk_file_chooser_get_filename(chooser);
+
+        GTask *task = g_task_new(NULL, NULL, on_tags_exported, app);
+        g_task_set_task_data(task, export, tags_export_free);
+        g_task_run_in_thread(task, tags_export_worker);
+        g_object_unref(task);
+    }
+    gtk_widget_destroy(dialog);
+}
+
+/*
+ * Minimap
+ * An overview strip beside the editor drawn from a per-line summary
+ * (indent, length, kind of line, markers) that is patched on every edit
+ * instead of being read back from the text. The summary is rendered into
+ * an image at most once per frame, and only after it changed; scrolling
+ * just paints that image and moves the viewport rectangle over it.
+ * Lines are MINIMAP_ROW pixels high until the file no longer fits, then
+ * several lines share a pixel row.
+ */
+#define MINIMAP_WIDTH      100
+#define MINIMAP_ROW        2
+#define MINIMAP_MAX_HITS   20000     /* search hits marked, the rest are ignored */
+#define MINIMAP_MARKER_W   4         /* marker strip on the right edge */
+
+enum {
+    MINIMAP_CODE = 0,
+    MINIMAP_COMMENT,
+    MINIMAP_PREPROC
+};
+
+enum {
+    MINIMAP_MARK_BOOKMARK = 1 << 0,
+    MINIMAP_MARK_SEARCH   = 1 << 1
+};
+
+typedef struct {
+    guint8 indent;            /* leading columns, a tab counts 4 */
+    guint8 length;            /* bytes after the indent, trailing blanks excluded */
+    guint8 kind;              /* MINIMAP_CODE, _COMMENT or _PREPROC */
+    guint8 markers;           /* MINIMAP_MARK_* */
+} MinimapLine;
+
+typedef struct Minimap {
+    GtkWidget *area;
+    GArray *lines;            /* MinimapLine per buffer line, empty while hidden */
+    cairo_surface_t *image;   /* rendered summary, NULL when out of date */
+    GtkAdjustment *vadj;      /* the editor's */
+    guint search_idle;
+    gboolean dragging;
+} Minimap;
+
+static MinimapLine minimap_summarize(const gchar *p, gsize n) {
+    MinimapLine line = { 0 };
+    gsize i = 0;
+    guint indent = 0;
+    
+    for (; i < n && (p[i] == ' ' || p[i] == '\t'); i++)
+        indent += p[i] == '\t' ? 4 : 1;
+    while (n > i && (p[n - 1] == ' ' || p[n - 1] == '\t' || p[n - 1] == '\r')) n--;
+    line.indent = MIN(indent, 255);
+    line.length = MIN(n - i, 255);
+    if (i < n && p[i] == '#')
+        line.kind = MINIMAP_PREPROC;
+    else if (i < n && (p[i] == '*' || (n - i >= 2 && p[i] == '/' && (p[i + 1] == '/' || p[i + 1] == '*'))))
+        line.kind = MINIMAP_COMMENT;
+    return line;
+}
+
+static void minimap_invalidate(Minimap *minimap) {
+    g_clear_pointer(&minimap->image, cairo_surface_destroy);
+    gtk_widget_queue_draw(minimap->area);
+}
+
+/* Summary of one buffer line, keeping its markers */
+static void minimap_update_line(EditorApp *app, gint line) {
+    Minimap *minimap = app->minimap;
+    GtkTextIter start, end;
+    
+    if (line < 0 || (guint)line >= minimap->lines->len) return;
+    gtk_text_buffer_get_iter_at_line(GTK_TEXT_BUFFER(app->buffer), &start, line);
+    end = start;
+    if (!gtk_text_iter_ends_line(&end)) gtk_text_iter_forward_to_line_end(&end);
+    gchar *text = gtk_text_iter_get_slice(&start, &end);
+    MinimapLine *entry = &g_array_index(minimap->lines, MinimapLine, line);
+    guint8 markers = entry->markers;
+    
+    *entry = minimap_summarize(text, strlen(text));
+    entry->markers = markers;
+    g_free(text);
+}
+
+static void minimap_apply_markers(EditorApp *app);
+
+/* Whole-buffer summary, for loads and when the minimap is shown */
+static void minimap_rebuild(EditorApp *app) {
+    Minimap *minimap = app->minimap;
+    GtkTextIter start, end;
+    
+    TRACE_BEGIN("minimap: rebuild");
+    gtk_text_buffer_get_bounds(GTK_TEXT_BUFFER(app->buffer), &start, &end);
+    gchar *text = gtk_text_buffer_get_slice(GTK_TEXT_BUFFER(app->buffer), &start, &end, TRUE);
+    const gchar *p = text, *stop = text + strlen(text);
+    
+    g_array_set_size(minimap->lines, 0);
+    for (;;) {
+        const gchar *eol = memchr(p, '\n', stop - p);
+        MinimapLine line = minimap_summarize(p, (eol ? eol : stop) - p);
+        g_array_append_val(minimap->lines, line);
+        if (!eol) break;
+        p = eol + 1;
+    }
+    g_free(text);
+    minimap_apply_markers(app);
+    TRACE_END("minimap: rebuild");
+}
+
+static gboolean minimap_active(EditorApp *app) {
+    return app->minimap && gtk_widget_get_visible(app->minimap->area);
+}
+
+/* Edits: the line count difference says how many summaries to add or drop */
+static void on_minimap_insert_text(GtkTextBuffer *buffer, GtkTextIter *location, gchar *text,
+                                   gint len, gpointer data) {
+    EditorApp *app = (EditorApp *)data;
+    
+    if (!minimap_active(app)) return;
+    Minimap *minimap = app->minimap;
+    gint added = gtk_text_buffer_get_line_count(buffer) - (gint)minimap->lines->len;
+    gint last = gtk_text_iter_get_line(location);
+    
+    if (added > 1024) {
+        minimap_rebuild(app);
+    } else {
+        if (added > 0) {
+            MinimapLine *blank = g_new0(MinimapLine, added);
+            g_array_insert_vals(minimap->lines, last - added + 1, blank, added);
+            g_free(blank);
+        }
+        for (gint line = last - MAX(added, 0); line <= last; line++)
+            minimap_update_line(app, line);
+    }
+    minimap_invalidate(minimap);
+}
+
+static void on_minimap_delete_range(GtkTextBuffer *buffer, GtkTextIter *start, GtkTextIter *end,
+                                    gpointer data) {
+    EditorApp *app = (EditorApp *)data;
+    
+    if (!minimap_active(app)) return;
+    Minimap *minimap = app->minimap;
+    gint line = gtk_text_iter_get_line(start);
+    gint removed = (gint)minimap->lines->len - gtk_text_buffer_get_line_count(buffer);
+    
+    if (removed > 0) g_array_remove_range(minimap->lines, line + 1, removed);
+    minimap_update_line(app, line);
+    minimap_invalidate(minimap);
+}
+
+/* Bookmarks and search hits; search hits are collected from the search context */
+static void minimap_apply_markers(EditorApp *app) {
+    Minimap *minimap = app->minimap;
+    GArray *lines = minimap->lines;
+    
+    for (guint i = 0; i < lines->len; i++)
+        g_array_index(lines, MinimapLine, i).markers = 0;
+    for (GList *l = app->bookmarks; l; l = l->next) {
+        guint line = GPOINTER_TO_INT(l->data);
+        if (line < lines->len) g_array_index(lines, MinimapLine, line).markers |= MINIMAP_MARK_BOOKMARK;
+    }
+    
+    if (!app->search_context || gtk_source_search_context_get_occurrences_count(app->search_context) <= 0)
+        return;
+    GtkTextIter iter, start, end;
+    gboolean wrapped = FALSE;
+    gtk_text_buffer_get_start_iter(GTK_TEXT_BUFFER(app->buffer), &iter);
+    for (guint hits = 0; hits < MINIMAP_MAX_HITS; hits++) {
+        if (!gtk_source_search_context_forward2(app->search_context, &iter, &start, &end, &wrapped) ||
+            wrapped)
+            break;
+        guint line = gtk_text_iter_get_line(&start);
+        if (line < lines->len) g_array_index(lines, MinimapLine, line).markers |= MINIMAP_MARK_SEARCH;
+        iter = end;
+        if (gtk_text_iter_equal(&start, &end) && !gtk_text_iter_forward_char(&iter)) break;
+    }
+}
+
+static void minimap_markers_changed(EditorApp *app) {
+    if (!minimap_active(app)) return;
+    minimap_apply_markers(app);
+    minimap_invalidate(app->minimap);
+}
+
+static gboolean minimap_search_idle(gpointer data) {
+    EditorApp *app = (EditorApp *)data;
+    app->minimap->search_idle = 0;
+    minimap_markers_changed(app);
+    return G_SOURCE_REMOVE;
+}
+
+/* The count goes to -1 while the context rescans, then to the new total */
+static void on_search_occurrences_changed(GObject *object, GParamSpec *pspec, gpointer data) {
+    EditorApp *app = (EditorApp *)data;
+    
+    if (!minimap_active(app) || app->minimap->search_idle ||
+        gtk_source_search_context_get_occurrences_count(app->search_context) < 0)
+        return;
+    app->minimap->search_idle = g_idle_add(minimap_search_idle, app);
+}
+
+static guint32 minimap_pixel(const GdkRGBA *color, gdouble alpha) {
+    guint a = alpha * 255;
+    return (a << 24) | ((guint)(color->red * a) << 16) | ((guint)(color->green * a) << 8) |
+           (guint)(color->blue * a);
+}
+
+static void minimap_fill(guchar *data, gint stride, gint y, gint x0, gint x1, guint32 pixel) {
+    guint32 *row = (guint32 *)(data + y * stride);
+    for (gint x = x0; x < x1; x++) row[x] = pixel;
+}
+
+/* Pixel rows the lines take: MINIMAP_ROW each, squeezed to the height if needed */
+static gint minimap_content_height(Minimap *minimap, gint height) {
+    return MIN(height, (gint)minimap->lines->len * MINIMAP_ROW);
+}
+
+static void minimap_render(EditorApp *app) {
+    Minimap *minimap = app->minimap;
+    gint width = gtk_widget_get_allocated_width(minimap->area);
+    gint height = gtk_widget_get_allocated_height(minimap->area);
+    gint rows = minimap_content_height(minimap, height);
+    guint n = minimap->lines->len;
+    GdkRGBA fg, comment = { 0.42, 0.6, 0.42, 1 }, preproc = { 0.62, 0.45, 0.75, 1 };
+    GdkRGBA bookmark = { 0.21, 0.52, 0.89, 1 }, search = { 0.96, 0.65, 0.14, 1 };
+    
+    TRACE_BEGIN("minimap: render");
+    gtk_style_context_get_color(gtk_widget_get_style_context(app->view), GTK_STATE_FLAG_NORMAL, &fg);
+    guint32 kinds[] = { minimap_pixel(&fg, 0.45), minimap_pixel(&comment, 0.6), minimap_pixel(&preproc, 0.6) };
+    guint32 marks[] = { minimap_pixel(&bookmark, 1), minimap_pixel(&search, 1) };
+    
+    minimap->image = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, MAX(width, 1), MAX(height, 1));
+    guchar *data = cairo_image_surface_get_data(minimap->image);
+    gint stride = cairo_image_surface_get_stride(minimap->image);
+    gint text_width = width - MINIMAP_MARKER_W;
+    
+    /* Merge the lines that land on each pixel row: widest extent, strongest kind, all markers */
+    for (guint i = 0; i < n && rows > 0; ) {
+        gint y = (gint64)i * rows / n;
+        gint y_end = MAX(y + 1, (gint)((gint64)(i + 1) * rows / n));
+        gint x0 = G_MAXINT, x1 = 0, kind = MINIMAP_CODE, markers = 0;
+        
+        for (; i < n && (gint)((gint64)i * rows / n) < y_end; i++) {
+            const MinimapLine *line = &g_array_index(minimap->lines, MinimapLine, i);
+            if (line->length == 0 && !line->markers) continue;
+            x0 = MIN(x0, line->indent);
+            x1 = MAX(x1, line->indent + line->length);
+            kind = MAX(kind, line->kind);
+            markers |= line->markers;
+        }
+        for (gint row = y; row < MIN(y_end, height); row++) {
+            /* Leave a gap between lines while they are MINIMAP_ROW pixels high */
+            if (rows == (gint)n * MINIMAP_ROW && row == y_end - 1 && y_end - y > 1) continue;
+            if (x1 > x0) minimap_fill(data, stride, row, MIN(x0, text_width), MIN(x1, text_width), kinds[kind]);
+            if (markers & MINIMAP_MARK_BOOKMARK) minimap_fill(data, stride, row, text_width, width, marks[0]);
+            else if (markers & MINIMAP_MARK_SEARCH) minimap_fill(data, stride, row, text_width, width, marks[1]);
+        }
+    }
+    cairo_surface_mark_dirty(minimap->image);
+    TRACE_END("minimap: render");
+}
+
+static gboolean on_minimap_draw(GtkWidget *widget, cairo_t *cr, gpointer data) {
+    EditorApp *app = (EditorApp *)data;
+    Minimap *minimap = app->minimap;
+    gdouble upper = gtk_adjustment_get_upper(minimap->vadj);
+    gint rows = minimap_content_height(minimap, gtk_widget_get_allocated_height(widget));
+    
+    if (!minimap->image) minimap_render(app);
+    cairo_set_source_surface(cr, minimap->image, 0, 0);
+    cairo_paint(cr);
+    
+    if (upper > 0) {
+        gdouble top = gtk_adjustment_get_value(minimap->vadj) / upper * rows;
+        gdouble size = MAX(gtk_adjustment_get_page_size(minimap->vadj) / upper * rows, 4);
+        cairo_set_source_rgba(cr, 0.5, 0.5, 0.5, 0.25);
+        cairo_rectangle(cr, 0, top, gtk_widget_get_allocated_width(widget), size);
+        cairo_fill(cr);
+    }
+    return FALSE;
+}
+
+/* Center the editor on the line under y */
+static void minimap_scroll_to(EditorApp *app, gdouble y) {
+    Minimap *minimap = app->minimap;
+    gint rows = minimap_content_height(minimap, gtk_widget_get_allocated_height(minimap->area));
+    gdouble fraction = rows > 0 ? CLAMP(y / rows, 0, 1) : 0;
+    
+    gtk_adjustment_set_value(minimap->vadj, fraction * gtk_adjustment_get_upper(minimap->vadj) -
+                                            gtk_adjustment_get_page_size(minimap->vadj) / 2);
+}
+
+static gboolean on_minimap_button(GtkWidget *widget, GdkEventButton *event, gpointer data) {
+    EditorApp *app = (EditorApp *)data;
+    
+    if (event->button != GDK_BUTTON_PRIMARY) return FALSE;
+    app->minimap->dragging = event->type != GDK_BUTTON_RELEASE;
+    if (app->minimap->dragging) minimap_scroll_to(app, event->y);
+    return TRUE;
+}
+
+static gboolean on_minimap_motion(GtkWidget *widget, GdkEventMotion *event, gpointer data) {
+    EditorApp *app = (EditorApp *)data;
+    
+    if (app->minimap->dragging) minimap_scroll_to(app, event->y);
+    return TRUE;
+}
+
+static void on_minimap_size_allocate(GtkWidget *widget, GdkRectangle *allocation, gpointer data) {
+    EditorApp *app = (EditorApp *)data;
+    g_clear_pointer(&app->minimap->image, cairo_surface_destroy);
+}
+
+static void on_minimap_viewport_changed(GtkAdjustment *adjustment, gpointer data) {
+    EditorApp *app = (EditorApp *)data;
+    if (minimap_active(app)) gtk_widget_queue_draw(app->minimap->area);
+}
+
+/* Created with the editor, hidden until View > Minimap */
+static GtkWidget *create_minimap(EditorApp *app) {
+    Minimap *minimap = g_new0(Minimap, 1);
+    GtkTextBuffer *buffer = GTK_TEXT_BUFFER(app->buffer);
+    
+    minimap->lines = g_array_new(FALSE, FALSE, sizeof(MinimapLine));
+    minimap->vadj = gtk_scrollable_get_vadjustment(GTK_SCROLLABLE(app->view));
+    minimap->area = gtk_drawing_area_new();
+    gtk_widget_set_size_request(minimap->area, MINIMAP_WIDTH, -1);
+    gtk_widget_add_events(minimap->area, GDK_BUTTON_PRESS_MASK | GDK_BUTTON_RELEASE_MASK |
+                                         GDK_BUTTON1_MOTION_MASK);
+    gtk_widget_set_no_show_all(minimap->area, TRUE);
+    g_signal_connect(minimap->area, "draw", G_CALLBACK(on_minimap_draw), app);
+    g_signal_connect(minimap->area, "button-press-event", G_CALLBACK(on_minimap_button), app);
+    g_signal_connect(minimap->area, "button-release-event", G_CALLBACK(on_minimap_button), app);
+    g_signal_connect(minimap->area, "motion-notify-event", G_CALLBACK(on_minimap_motion), app);
+    g_signal_connect(minimap->area, "size-allocate", G_CALLBACK(on_minimap_size_allocate), app);
+    g_signal_connect(minimap->vadj, "value-changed", G_CALLBACK(on_minimap_viewport_changed), app);
+    g_signal_connect(minimap->vadj, "changed", G_CALLBACK(on_minimap_viewport_changed), app);
+    
+    /* After the default handlers, when the buffer already has the new line count */
+    g_signal_connect_after(buffer, "insert-text", G_CALLBACK(on_minimap_insert_text), app);
+    g_signal_connect_after(buffer, "delete-range", G_CALLBACK(on_minimap_delete_range), app);
+    
+    app->minimap = minimap;
+    return minimap->area;
+}
+
+static void on_toggle_minimap(GtkCheckMenuItem *item, gpointer data) {
+    EditorApp *app = (EditorApp *)data;
+    Minimap *minimap = app->minimap;
+    
+    if (gtk_check_menu_item_get_active(item)) {
+        gtk_widget_show(minimap->area);
+        minimap_rebuild(app);
+        minimap_invalidate(minimap);
+    } else {
+        gtk_widget_hide(minimap->area);
+        g_array_set_size(minimap->lines, 0);
+        g_clear_pointer(&minimap->image, cairo_surface_destroy);
+    }
+}
+
+/* Search context shared by the search bar and Find & Replace */
+static void ensure_search_context(EditorApp *app) {
+    if (app->search_settings) return;
+    app->search_settings = gtk_source_search_settings_new();
+    app->search_context = gtk_source_search_context_new(app->buffer, app->search_settings);
+    gtk_source_search_context_set_highlight(app->search_context, TRUE);
+    g_signal_connect(app->search_context, "notify::occurrences-count",
+                     G_CALLBACK(on_search_occurrences_changed), app);
+}
+
+static void on_toggle_focus_mode(GtkCheckMenuItem *item, gpointer data) {
+    EditorApp *app = (EditorApp *)data;
+    app->focus_mode = gtk_check_menu_item_get_active(item);
+    
+    if (!app->focus_mode) {
+        /* Remove the jump highlight when turning off Focus Mode */
+        scrible_view_clear_flash((ScribleView *)app->view);
+    }
+    
+    update_status(app);
+}
+
+static void on_restart_editor(GtkWidget *widget, gpointer data) {
+    EditorApp *app = (EditorApp *)data;
+    
+    /* 1. Save work first */
+    on_save(NULL, app);
+    
+    /* 2. Prepare arguments for restart */
+    /* We assume the executable is named 'scrible' in the current directory */
+    char *args[] = {"./scrible", app->current_file, NULL};
+    
+    /* 3. Restart the process */
+    g_print("Restarting editor...\n");
+    execvp(args[0], args);
+    
+    /* If execvp returns, it failed */
+    perror("execvp failed");
+}
+
+/* Find/Replace Callback classic function */
+static void on_find_replace(GtkWidget *widget, gpointer data) {
+    EditorApp *app = (EditorApp *)data;
+    GtkWidget *dialog, *content_area, *grid;
+    GtkWidget *find_entry, *replace_entry;
+    GtkWidget *check_case, *check_word, *check_regex;
+
+    dialog = gtk_dialog_new_with_buttons("Advanced Search & Replace", GTK_WINDOW(app->window),
+                                         GTK_DIALOG_MODAL | GTK_DIALOG_DESTROY_WITH_PARENT,
+                                         "Find Next", 1,
+                                         "Replace All", 4, // Added Replace All
+                                         "Replace", 2,
+                                         "Close", GTK_RESPONSE_CLOSE, NULL);
+
+    content_area = gtk_dialog_get_content_area(GTK_DIALOG(dialog));
+    grid = gtk_grid_new();
+    gtk_grid_set_column_spacing(GTK_GRID(grid), 10);
+    gtk_grid_set_row_spacing(GTK_GRID(grid), 10);
+    gtk_container_set_border_width(GTK_CONTAINER(grid), 15);
+
+    // Entry Fields
+    find_entry = gtk_entry_new();
+    gtk_entry_set_placeholder_text(GTK_ENTRY(find_entry), "Search term...");
+    replace_entry = gtk_entry_new();
+    gtk_entry_set_placeholder_text(GTK_ENTRY(replace_entry), "Replace with...");
+
+    // Option Toggles
+    check_case = gtk_check_button_new_with_label("Match Case");
+    check_word = gtk_check_button_new_with_label("Whole Words Only");
+    check_regex = gtk_check_button_new_with_label("Use Regular Expressions");
+
+    // Layout
+    gtk_grid_attach(GTK_GRID(grid), gtk_label_new("Find:"), 0, 0, 1, 1);
+    gtk_grid_attach(GTK_GRID(grid), find_entry, 1, 0, 1, 1);
+    gtk_grid_attach(GTK_GRID(grid), gtk_label_new("Replace:"), 0, 1, 1, 1);
+    gtk_grid_attach(GTK_GRID(grid), replace_entry, 1, 1, 1, 1);
+    gtk_grid_attach(GTK_GRID(grid), check_case, 1, 2, 1, 1);
+    gtk_grid_attach(GTK_GRID(grid), check_word, 1, 3, 1, 1);
+    gtk_grid_attach(GTK_GRID(grid), check_regex, 1, 4, 1, 1);
+
+    gtk_box_pack_start(GTK_BOX(content_area), grid, TRUE, TRUE, 0);
+    gtk_widget_show_all(dialog);
+
+    ensure_search_context(app);
+
+    gint result;
+    while ((result = gtk_dialog_run(GTK_DIALOG(dialog))) > 0) {
+        const gchar *find_text = gtk_entry_get_text(GTK_ENTRY(find_entry));
+        const gchar *replace_text = gtk_entry_get_text(GTK_ENTRY(replace_entry));
+        
+        // Apply Settings
+        gtk_source_search_settings_set_search_text(app->search_settings, find_text);
+        gtk_source_search_settings_set_case_sensitive(app->search_settings, gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(check_case)));
+        gtk_source_search_settings_set_at_word_boundaries(app->search_settings, gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(check_word)));
+        gtk_source_search_settings_set_regex_enabled(app->search_settings, gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(check_regex)));
+
+        GtkTextIter start, end, iter;
+        gtk_text_buffer_get_iter_at_mark(GTK_TEXT_BUFFER(app->buffer), &iter, 
+                                         gtk_text_buffer_get_insert(GTK_TEXT_BUFFER(app->buffer)));
+
+        TRACE_BEGIN("search: find/replace");
+        if (result == 1) { // Find Next
+            if (gtk_source_search_context_forward2(app->search_context, &iter, &start, &end, NULL)) {
+                gtk_text_buffer_select_range(GTK_TEXT_BUFFER(app->buffer), &start, &end);
+                gtk_text_view_scroll_to_iter(GTK_TEXT_VIEW(app->view), &start, 0.0, FALSE, 0.0, 0.0);
+            }
+        } else if (result == 2) { // Replace
+            if (gtk_source_search_context_forward2(app->search_context, &iter, &start, &end, NULL)) {
+                gtk_source_search_context_replace2(app->search_context, &start, &end, replace_text, -1, NULL);
+            }
+        } else if (result == 4) { // Replace All
+            gtk_source_search_context_replace_all(app->search_context, replace_text, -1, NULL);
+        }
+        TRACE_END("search: find/replace");
+    }
+    gtk_widget_destroy(dialog);
+}
+
+/* Clear Highlighting */
+static void on_clear_search(GtkWidget *widget, gpointer data) {
+    EditorApp *app = (EditorApp *)data;
+    if (app->search_settings) {
+        gtk_source_search_settings_set_search_text(app->search_settings, NULL);
+    }
+}
+
+/* Fine selection */
+static void on_find_selection(GtkWidget *widget, gpointer data) {
+    EditorApp *app = (EditorApp *)data;
+    GtkTextIter start, end;
+
+    if (gtk_text_buffer_get_selection_bounds(GTK_TEXT_BUFFER(app->buffer), &start, &end)) {
+        gchar *selected_text = gtk_text_buffer_get_text(GTK_TEXT_BUFFER(app->buffer), &start, &end, TRUE);
+        
+        ensure_search_context(app);
+
+        gtk_source_search_settings_set_search_text(app->search_settings, selected_text);
+        g_free(selected_text);
+    }
+}
+
+static void on_search_entry_changed(GtkSearchEntry *entry, gpointer data) {
+    EditorApp *app = (EditorApp *)data;
+    const gchar *text = gtk_entry_get_text(GTK_ENTRY(entry));
+    
+    ensure_search_context(app);
+    
+    TRACE_BEGIN("search");
+    gtk_source_search_settings_set_search_text(app->search_settings, text);
+    TRACE_END("search");
+}
+
+/* find all */
+static void on_find_all(GtkWidget *widget, gpointer data) {
+    EditorApp *app = (EditorApp *)data;
+    if (!app->search_settings || !app->search_context) return;
+
+    const gchar *text = gtk_source_search_settings_get_search_text(app->search_settings);
+    if (!text || strlen(text) == 0) return;
+
+    TRACE_BEGIN("search: count");
+    int count = gtk_source_search_context_get_occurrences_count(app->search_context);
+    TRACE_END("search: count");
+    
+    gchar *msg = g_strdup_printf("Found %d occurrences of '%s'", count, text);
+    gtk_label_set_text(GTK_LABEL(app->status_label), msg);
+    g_free(msg);
+
+    // Ensure highlighting is forced on
+    gtk_source_search_context_set_highlight(app->search_context, TRUE);
+}
+/* Quick find */
+static void on_toggle_search_bar(GtkWidget *widget, gpointer data) {
+    EditorApp *app = (EditorApp *)data;
+    // Note: This assumes you added GtkWidget *search_bar to your EditorApp struct
+    gboolean revealed = gtk_search_bar_get_search_mode(GTK_SEARCH_BAR(app->search_bar));
+    gtk_search_bar_set_search_mode(GTK_SEARCH_BAR(app->search_bar), !revealed);
+}
+
+
+/* Apply dark theme using GTK CSS */
+static GtkCssProvider *create_light_theme(void) {
+    GtkCssProvider *css = gtk_css_provider_new();
+
+    const gchar *data =
+        "window { background-color: #ffffff; }"
+
+        "GtkSourceView {"
+        "  background-color: #ffffff;"
+        "  color: #000000;"
+        "  caret-color: #000000;"
+        "}"
+
+        "GtkSourceView text:selected {"
+        "  background-color: #cce4ff;"
+        "  color: #000000;"
+        "}"
+
+        "GtkSourceView gutter {"
+        "  background-color: #f0f0f0;"
+        "}"
+
+        "GtkSourceView gutter text {"
+        "  color: #555555;"
+        "}"
+
+        "GtkSourceView gutter text.current-line {"
+        "  color: #000000;"
+        "  font-weight: bold;"
+        "}"
+
+        "GtkSourceView text.current-line {"
+        "  background-color: #e6e6e6;"
+        "}";
+
+    gtk_css_provider_load_from_data(css, data, -1, NULL);
+    return css;
+}
+
+static GtkCssProvider *create_dark_theme(void) {
+    GtkCssProvider *css = gtk_css_provider_new();
+    const gchar *data =
+        /* 1. Base Window & Panels - Using deep charcoal instead of pure black */
+        "window, .background { background-color: #1e1e1e; color: #eeeeec; }"
+        
+        /* TITLE BAR STYLING */
+        "headerbar { background-color: #2d2d2d; border-bottom: 1px solid #3f3f3f; box-shadow: none; color:#eeeeec;}"
+        "headerbar .title { color: #97a69b; font-weight: bold; border: 3px double #FFFFFF; }"
+        "headerbar button { color: #eeeeec; background: #383838; border: 1px solid #484848;  }"
+        "headerbar button:hover { background: #454545; }"
+        "headerbar text { color: #4948FF; background: #3584e4; }"
+        /* Buttons in the header */
+        /* Window control buttons (minimize, maximize, close) */
+        "headerbar button { "
+        "  background-color: #2d2d2d; "
+        "  border: none; "
+        "  color: #686b69; " 
+        "  min-width: 16px; "
+        "  min-height: 16px; "
+        "}"
+        
+        /* Button icon color */
+        "headerbar button image { "
+        "  color: #686b69; "  
+        "}"
+        /* Hover state for buttons and their icons */
+        "headerbar button:hover { "
+        "  background-color: #162118; "
+        "}"
+     
+        "box, grid, paned { border: 1px solid #333333; }" 
+
+        /* 2. THE MENUBAR */
+        "menubar { background-color: #68767d; color: #eeeeec; border-bottom: 1px solid #3f3f3f; }"
+        "menubar > menuitem { padding: 4px 8px; }" 
+        "menubar > menuitem:hover { background-color: #3584e4; color: #ffffff; }"
+
+        /* 3. THE DROPDOWN MENUS (Floating Boxes) */
+        "menu { "
+        "  background-color: #2d2d2d; "
+        "  border: 1px dotted #454545; "
+        "  margin: 5px; "
+        "}"
+        "menu menuitem { background-color: #2d2d2d; color: #eeeeec; padding: 5px; }"
+        "menu menuitem:hover { background-color: #3584e4; color: #ffffff; }"
+
+        /* 4. THE EDITOR & GUTTER (GtkSourceView) */
+        "GtkSourceView, text { background-color: #1e1e1e; color: #d4d4d4; font-family: 'Monospace'; }"
+        "gutter, GtkSourceView gutter text { background-color: #1e1e1e; color: #858585; border-right: 1px solid #333333; }"
+        "GtkSourceView gutter text.current-line { color: #ffffff; font-weight: bold; }"
+        "GtkSourceView text.current-line { background-color: #2a2a2a; }"
+        "GtkSourceView { caret-color: #ffffff; }"
+        "GtkSourceView text:selected { background-color: #264f78; color: #ffffff; }"
+
+        /* 5. THE SIDEBAR (Treeview) */
+        "treeview { background-color: #252526; color: #cccccc; }"
+        "treeview:selected { background-color: #37373d; color: #ffffff; }"
+        "treeview:hover { background-color: #2a2d2e; }";
+
+    gtk_css_provider_load_from_data(css, data, -1, NULL);
+    return css;
+}
+
+static GtkCssProvider *create_green_theme(void) {
+    GtkCssProvider *css = gtk_css_provider_new();
+const gchar *data =
+    /* 1. Base Window & Panels */
+    "window, .background { background-color: #000000; }"
+    /* TITLE BAR STYLING */
+    "headerbar { background-color: #000000; border-bottom: 2px solid #004400; }"
+    "headerbar .title { color: #00FF41 ; font-family: 'Monospace'; }"
+    "headerbar button { color: #00FF41; background: #000000; border: 1px solid #004400; }"
+    "headerbar button:hover { background: #00FF41; color: #000000; }"
+    "headerbar text { color: #00FF41; background: #004400; }"
+    
+    "box, grid, paned { border: 1px solid #004400; }" /* Subtler cyan/green border */
+
+    /* 2. THE MENUBAR (The Top Bar) */
+    "menubar { background-color: #000000; color: #00FF41; border-bottom: 4px solid #004400; }"
     "menubar > menuitem { color: #00FF41; }" 
     "menubar > menuitem label { color: #00FF41; }"
     "menubar > menuitem:hover { background-color: #004400; }"
@@ -1226,1103 +5688,3868 @@ const gchar *data =
     "menu menuitem:hover { background-color: #004400; color: #000fff; }"
     "menu menuitem label { color: #00FF41; }" /* Inherit green/black from item */
 
-    /* 4. THE EDITOR & GUTTER */
-    "GtkSourceView, text { background-color: #000000; color: #00FF41; }"
-    "gutter, GtkSourceView gutter text { background-color: #000000; color: #003B00; border: none; }"
-    "GtkSourceView gutter text.current-line { color: #00FF41; font-weight: bold; }"
-    "GtkSourceView text.current-line { background-color: #001100; }"
-    "GtkSourceView { caret-color: #FFFFFF; outline: none; }"
-    "GtkSourceView text:selected { background-color: #00FF41; color: #000000; }"
+    /* 4. THE EDITOR & GUTTER */
+    "GtkSourceView, text { background-color: #000000; color: #00FF41; }"
+    "gutter, GtkSourceView gutter text { background-color: #000000; color: #003B00; border: none; }"
+    "GtkSourceView gutter text.current-line { color: #00FF41; font-weight: bold; }"
+    "GtkSourceView text.current-line { background-color: #001100; }"
+    "GtkSourceView { caret-color: #FFFFFF; outline: none; }"
+    "GtkSourceView text:selected { background-color: #00FF41; color: #000000; }"
+
+    /* 5. THE SIDEBAR (Treeview) */
+    "treeview { background-color: #000000; color: #008800; }"
+    "treeview:selected { background-color: #00ff41; color: #000000; }";
+        /* The Active Line (The "Yellow" equivalent in Green Mode) */
+        "GtkSourceView gutter text.current-line {"
+        "  color: #00FF41;"
+        "  font-weight: bold;"
+        "  border: 1px solid #00ffff;"
+        "}"   
+        /* Specifically show boxes with a different color */
+        "box, grid, paned {"
+        "  border: 1px solid #00ffff;" /* Cyan for containers */
+        "}"
+        "*:treeview {"
+        "  background-color: #000000;"
+        "  color: #008800;" /* Muted green for sidebar names */
+        "}"
+        "treeview:selected {"
+        "  background-color: #00ff41;"
+        "  color: #000000;"
+        "}"
+        "GtkSourceView text.current-line {"
+        "  background-color: #001A00;"
+        "}";
+
+    gtk_css_provider_load_from_data(css, data, -1, NULL);
+    return css;
+}
+
+/* Theme providers are only parsed the first time they are selected */
+static GtkCssProvider *get_theme_provider(EditorApp *app, int mode) {
+    if (mode == 1) {
+        if (!app->dark_css) app->dark_css = create_dark_theme();
+        return app->dark_css;
+    }
+    if (mode == 2) {
+        if (!app->green_css) app->green_css = create_green_theme();
+        return app->green_css;
+    }
+    if (!app->light_css) app->light_css = create_light_theme();
+    return app->light_css;
+}
+
+static void apply_theme(EditorApp *app) {
+    GdkScreen *screen = gdk_screen_get_default();
+    TRACE_BEGIN("apply_theme");
+
+    /* Safety Check: Only remove if the pointer is actually a valid provider */
+    if (app->dark_css && GTK_IS_STYLE_PROVIDER(app->dark_css))
+        gtk_style_context_remove_provider_for_screen(screen, GTK_STYLE_PROVIDER(app->dark_css));
+        
+    if (app->light_css && GTK_IS_STYLE_PROVIDER(app->light_css))
+        gtk_style_context_remove_provider_for_screen(screen, GTK_STYLE_PROVIDER(app->light_css));
+        
+    if (app->green_css && GTK_IS_STYLE_PROVIDER(app->green_css))
+        gtk_style_context_remove_provider_for_screen(screen, GTK_STYLE_PROVIDER(app->green_css));
+
+    GtkCssProvider *active = get_theme_provider(app, app->theme_mode);
+
+    /* Final safety check before adding */
+    if (active && GTK_IS_STYLE_PROVIDER(active)) {
+        gtk_style_context_add_provider_for_screen(
+            screen,
+            GTK_STYLE_PROVIDER(active),
+            GTK_STYLE_PROVIDER_PRIORITY_APPLICATION
+        );
+    }
+    TRACE_END("apply_theme");
+}
+
+static void insert_at_cursor(EditorApp *app, const gchar *text) {
+    GtkTextIter iter;
+    gtk_text_buffer_get_iter_at_mark(GTK_TEXT_BUFFER(app->buffer), &iter,
+                                     gtk_text_buffer_get_insert(GTK_TEXT_BUFFER(app->buffer)));
+    gtk_text_buffer_insert(GTK_TEXT_BUFFER(app->buffer), &iter, text, -1);
+}
+
+static void on_theme_change(GtkCheckMenuItem *item, gpointer data) {
+    EditorApp *app = (EditorApp *)data;
+    if (gtk_check_menu_item_get_active(item)) {
+        const gchar *label = gtk_menu_item_get_label(GTK_MENU_ITEM(item));
+        
+        if (g_strcmp0(label, "Light") == 0) app->theme_mode = 0;
+        else if (g_strcmp0(label, "Dark") == 0) app->theme_mode = 1;
+        else if (g_strcmp0(label, "Matrix Green") == 0) app->theme_mode = 2;
+        
+        apply_theme(app);
+    }
+}
+
+static void on_toggle_dark_mode(GtkCheckMenuItem *item, gpointer data) {
+    EditorApp *app = data;
+    app->dark_mode = gtk_check_menu_item_get_active(item);
+    apply_theme(app);
+    // Refresh the gutter explicitly (helps stop line bug in on_tree_selection_changed) 
+    gtk_source_view_set_show_line_numbers(GTK_SOURCE_VIEW(app->view), TRUE);
+}
+
+static void on_comment_selection(GtkWidget *widget, gpointer data) {
+    EditorApp *app = (EditorApp *)data;
+    GtkTextIter start, end;
+    
+    if (!gtk_text_buffer_get_selection_bounds(GTK_TEXT_BUFFER(app->buffer), &start, &end)) {
+        /* No selection, comment current line */
+        gtk_text_buffer_get_iter_at_mark(GTK_TEXT_BUFFER(app->buffer), &start,
+                                         gtk_text_buffer_get_insert(GTK_TEXT_BUFFER(app->buffer)));
+        end = start;
+        gtk_text_iter_set_line_offset(&start, 0);
+        if (!gtk_text_iter_ends_line(&end))
+            gtk_text_iter_forward_to_line_end(&end);
+    }
+    
+    gint start_line = gtk_text_iter_get_line(&start);
+    gint end_line = gtk_text_iter_get_line(&end);
+    
+    /* Comment each line */
+    for (gint line = start_line; line <= end_line; line++) {
+        GtkTextIter line_start;
+        gtk_text_buffer_get_iter_at_line(GTK_TEXT_BUFFER(app->buffer), &line_start, line);
+        gtk_text_buffer_insert(GTK_TEXT_BUFFER(app->buffer), &line_start, "// ", -1);
+    }
+}
+
+static void on_uncomment_selection(GtkWidget *widget, gpointer data) {
+    EditorApp *app = (EditorApp *)data;
+    GtkTextIter start, end;
+    
+    if (!gtk_text_buffer_get_selection_bounds(GTK_TEXT_BUFFER(app->buffer), &start, &end)) {
+        /* No selection, uncomment current line */
+        gtk_text_buffer_get_iter_at_mark(GTK_TEXT_BUFFER(app->buffer), &start,
+                                         gtk_text_buffer_get_insert(GTK_TEXT_BUFFER(app->buffer)));
+        end = start;
+        gtk_text_iter_set_line_offset(&start, 0);
+        if (!gtk_text_iter_ends_line(&end))
+            gtk_text_iter_forward_to_line_end(&end);
+    }
+    
+    gint start_line = gtk_text_iter_get_line(&start);
+    gint end_line = gtk_text_iter_get_line(&end);
+    
+    /* Uncomment each line: drop "//" and one following space */
+    for (gint line = start_line; line <= end_line; line++) {
+        GtkTextIter line_start, line_end;
+        gtk_text_buffer_get_iter_at_line(GTK_TEXT_BUFFER(app->buffer), &line_start, line);
+        line_end = line_start;
+        if (!gtk_text_iter_ends_line(&line_end))
+            gtk_text_iter_forward_to_line_end(&line_end);
+        
+        gchar *text = gtk_text_buffer_get_text(GTK_TEXT_BUFFER(app->buffer), &line_start, &line_end, TRUE);
+        size_t at;
+        size_t cut = sc_uncomment_span(text, strlen(text), &at);
+        
+        if (cut > 0) {
+            GtkTextIter delete_start = line_start, delete_end;
+            gtk_text_iter_forward_chars(&delete_start, g_utf8_pointer_to_offset(text, text + at));
+            delete_end = delete_start;
+            gtk_text_iter_forward_chars(&delete_end, cut);
+            gtk_text_buffer_delete(GTK_TEXT_BUFFER(app->buffer), &delete_start, &delete_end);
+        }
+        g_free(text);
+    }
+}
+
+static void on_block_comment(GtkWidget *widget, gpointer data) {
+    EditorApp *app = (EditorApp *)data;
+    GtkTextIter start, end;
+
+    if (gtk_text_buffer_get_selection_bounds(
+            GTK_TEXT_BUFFER(app->buffer), &start, &end)) {
+
+        gtk_text_buffer_insert(
+            GTK_TEXT_BUFFER(app->buffer), &start, "/*\n", -1);
+
+        /* Re-fetch end iterator AFTER insertion */
+        gtk_text_buffer_get_iter_at_mark(
+            GTK_TEXT_BUFFER(app->buffer),
+            &end,
+            gtk_text_buffer_get_selection_bound(GTK_TEXT_BUFFER(app->buffer))
+        );
+
+        gtk_text_buffer_insert(
+            GTK_TEXT_BUFFER(app->buffer), &end, "\n*/", -1);
+    } else {
+        insert_at_cursor(app, "/* */");
+    }
+}
+
+/*
+ * Long-line mode
+ * GtkTextView lays out a whole line at once, so a single multi-megabyte
+ * line (minified JSON, generated tables) stalls it. Files with such lines
+ * can be opened with those lines cut into display segments: the offsets of
+ * the inserted newlines are kept in a sorted array, moved along by the
+ * buffer's insert and delete handlers, so they are dropped again on save
+ * and skipped when the status bar reports the line and column. Undo does
+ * not know which newlines were soft, so deleted breaks are remembered for
+ * a while and put back when an undo reinserts the same text.
+ */
+#define LONG_LINE_LIMIT          10000      /* offer the mode above this many bytes in one line */
+#define LONG_LINE_SEGMENT        2000       /* display segment length */
+#define LONG_LINE_HIGHLIGHT_MAX  (1 << 20)  /* no syntax highlighting above this file size */
+
+static gboolean ask_long_line_mode(EditorApp *app, const gchar *filename, gsize longest) {
+    /* Nobody to ask during a replay or before the window is up */
+    if (app->replay || !gtk_widget_get_visible(app->window)) return TRUE;
+    
+    gchar *basename = g_path_get_basename(filename);
+    GtkWidget *dialog = gtk_message_dialog_new(GTK_WINDOW(app->window),
+                            GTK_DIALOG_DESTROY_WITH_PARENT | GTK_DIALOG_MODAL,
+                            GTK_MESSAGE_QUESTION, GTK_BUTTONS_NONE,
+                            "%s has a line of %" G_GSIZE_FORMAT " bytes.", basename, longest);
+    gtk_message_dialog_format_secondary_text(GTK_MESSAGE_DIALOG(dialog),
+        "Long-line mode shows it in segments of %d bytes so the editor stays responsive; "
+        "the file is saved unchanged.", LONG_LINE_SEGMENT);
+    gtk_dialog_add_buttons(GTK_DIALOG(dialog), "Open _Normally", GTK_RESPONSE_REJECT,
+                           "_Long-Line Mode", GTK_RESPONSE_ACCEPT, NULL);
+    gtk_dialog_set_default_response(GTK_DIALOG(dialog), GTK_RESPONSE_ACCEPT);
+    gint response = gtk_dialog_run(GTK_DIALOG(dialog));
+    gtk_widget_destroy(dialog);
+    g_free(basename);
+    return response != GTK_RESPONSE_REJECT;
+}
+
+#define LONG_LINE_UNDO_CUTS      100        /* deletions remembered, as many as undo levels */
+
+typedef struct {
+    gint offset;              /* where the deleted text started */
+    gint length;              /* its length in chars */
+    GArray *breaks;           /* gint offsets of its soft breaks, relative to offset */
+} SoftBreakCut;
+
+static void soft_break_cut_free(gpointer data) {
+    SoftBreakCut *cut = data;
+    g_array_free(cut->breaks, TRUE);
+    g_free(cut);
+}
+
+static void long_lines_reset(EditorApp *app) {
+    g_array_set_size(app->soft_breaks, 0);
+    g_list_free_full(app->soft_break_cuts, soft_break_cut_free);
+    app->soft_break_cuts = NULL;
+}
+
+/* Number of soft breaks before char offset */
+static guint soft_breaks_before(EditorApp *app, gint offset) {
+    guint lo = 0, hi = app->soft_breaks->len;
+    while (lo < hi) {
+        guint mid = lo + (hi - lo) / 2;
+        if (g_array_index(app->soft_breaks, gint, mid) < offset) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+/* Before the insertion: later breaks move along, and an undone deletion gets its breaks back */
+static void on_long_lines_insert(GtkTextBuffer *buffer, GtkTextIter *location, gchar *text, gint len,
+                                 gpointer data) {
+    EditorApp *app = (EditorApp *)data;
+    if (!app->long_lines) return;
+    gint offset = gtk_text_iter_get_offset(location);
+    gint chars = g_utf8_strlen(text, len);
+    guint i = soft_breaks_before(app, offset);
+
+    for (guint j = i; j < app->soft_breaks->len; j++)
+        g_array_index(app->soft_breaks, gint, j) += chars;
+    if (!app->soft_break_undo) return;
+    for (GList *l = app->soft_break_cuts; l; l = l->next) {
+        SoftBreakCut *cut = l->data;
+        if (cut->offset != offset || cut->length != chars) continue;
+        for (guint j = 0; j < cut->breaks->len; j++) {
+            gint at = offset + g_array_index(cut->breaks, gint, j);
+            g_array_insert_val(app->soft_breaks, i + j, at);
+        }
+        app->soft_break_cuts = g_list_delete_link(app->soft_break_cuts, l);
+        soft_break_cut_free(cut);
+        break;
+    }
+}
+
+/* Before the deletion: breaks inside it are dropped (and remembered for undo), later ones move back */
+static void on_long_lines_delete(GtkTextBuffer *buffer, GtkTextIter *start, GtkTextIter *end, gpointer data) {
+    EditorApp *app = (EditorApp *)data;
+    if (!app->long_lines || app->soft_breaks->len == 0) return;
+    gint from = gtk_text_iter_get_offset(start), to = gtk_text_iter_get_offset(end);
+    guint i = soft_breaks_before(app, from), k = soft_breaks_before(app, to);
+
+    if (k > i) {
+        SoftBreakCut *cut = g_new(SoftBreakCut, 1);
+        cut->offset = from;
+        cut->length = to - from;
+        cut->breaks = g_array_sized_new(FALSE, FALSE, sizeof(gint), k - i);
+        for (guint j = i; j < k; j++) {
+            gint at = g_array_index(app->soft_breaks, gint, j) - from;
+            g_array_append_val(cut->breaks, at);
+        }
+        app->soft_break_cuts = g_list_prepend(app->soft_break_cuts, cut);
+        GList *last = g_list_nth(app->soft_break_cuts, LONG_LINE_UNDO_CUTS);
+        if (last) {
+            last->prev->next = NULL;
+            g_list_free_full(last, soft_break_cut_free);
+        }
+        g_array_remove_range(app->soft_breaks, i, k - i);
+    }
+    for (guint j = i; j < app->soft_breaks->len; j++)
+        g_array_index(app->soft_breaks, gint, j) -= to - from;
+}
+
+static void on_long_lines_undo(GtkSourceBuffer *buffer, gpointer data) {
+    ((EditorApp *)data)->soft_break_undo = TRUE;
+}
+
+static void on_long_lines_undo_done(GtkSourceBuffer *buffer, gpointer data) {
+    ((EditorApp *)data)->soft_break_undo = FALSE;
+}
+
+/* Before any other buffer handler, so the offsets are current when they run */
+static void setup_long_lines(EditorApp *app) {
+    app->soft_breaks = g_array_new(FALSE, FALSE, sizeof(gint));
+    g_signal_connect(app->buffer, "insert-text", G_CALLBACK(on_long_lines_insert), app);
+    g_signal_connect(app->buffer, "delete-range", G_CALLBACK(on_long_lines_delete), app);
+    g_signal_connect(app->buffer, "undo", G_CALLBACK(on_long_lines_undo), app);
+    g_signal_connect_after(app->buffer, "undo", G_CALLBACK(on_long_lines_undo_done), app);
+    g_signal_connect(app->buffer, "redo", G_CALLBACK(on_long_lines_undo), app);
+    g_signal_connect_after(app->buffer, "redo", G_CALLBACK(on_long_lines_undo_done), app);
+}
+
+/* Load contents with long lines cut into segments, recording where each inserted newline went */
+static void set_text_long_lines(EditorApp *app, const gchar *contents, gsize length) {
+    GtkTextBuffer *buffer = GTK_TEXT_BUFFER(app->buffer);
+    size_t n = sc_split_long_lines(contents, length, LONG_LINE_SEGMENT, NULL, NULL);
+    gchar *split = g_malloc(length + n);
+    size_t *breaks = g_new(size_t, n);
+    
+    sc_split_long_lines(contents, length, LONG_LINE_SEGMENT, split, breaks);
+    gtk_text_buffer_set_text(buffer, split, length + n);
+    long_lines_reset(app);
+    g_array_set_size(app->soft_breaks, n);
+    for (size_t i = 0; i < n; i++) {
+        GtkTextIter iter;
+        gtk_text_buffer_get_iter_at_line(buffer, &iter, breaks[i] + 1);
+        g_array_index(app->soft_breaks, gint, i) = gtk_text_iter_get_offset(&iter) - 1;
+    }
+    g_print("Long-line mode: %zu segment breaks\n", n);
+    g_free(breaks);
+    g_free(split);
+}
+
+/* Buffer text as it goes to disk, without the soft breaks of long-line mode */
+static gchar *get_save_text(EditorApp *app) {
+    GtkTextBuffer *buffer = GTK_TEXT_BUFFER(app->buffer);
+    GtkTextIter start, end;
+    
+    gtk_text_buffer_get_bounds(buffer, &start, &end);
+    gchar *text = gtk_text_buffer_get_text(buffer, &start, &end, TRUE);
+    if (!app->long_lines || app->soft_breaks->len == 0) return text;
+    
+    /* One pass over the text, counting chars to find each break */
+    gchar *out = g_malloc(strlen(text) + 1), *o = out;
+    const gchar *p = text;
+    gint offset = 0;
+    for (guint i = 0; i < app->soft_breaks->len; i++) {
+        gint at = g_array_index(app->soft_breaks, gint, i);
+        const gchar *q = g_utf8_offset_to_pointer(p, at - offset);
+        memcpy(o, p, q - p);
+        o += q - p;
+        if (*q == '\n') q++;      /* always, unless the offsets went wrong */
+        else if (*q) *o++ = *q++;
+        p = q;
+        offset = at + 1;
+    }
+    strcpy(o, p);
+    g_free(text);
+    return out;
+}
+
+/* File line and column (0-based) of iter and the file's line count, not counting soft breaks */
+static void long_lines_position(EditorApp *app, const GtkTextIter *iter, gint *line, gint *col,
+                                gint *total) {
+    GtkTextBuffer *buffer = GTK_TEXT_BUFFER(app->buffer);
+    GArray *breaks = app->soft_breaks;
+    gint offset = gtk_text_iter_get_offset(iter);
+    guint k = soft_breaks_before(app, offset);
+    
+    *line = gtk_text_iter_get_line(iter) - k;
+    *total = gtk_text_buffer_get_line_count(buffer) - breaks->len;
+    *col = gtk_text_iter_get_line_offset(iter);
+    if (k == 0 || g_array_index(breaks, gint, k - 1) != offset - *col - 1) return;
+    
+    /*
+     * The segment continues a file line: find the first break of that line.
+     * Breaks j..k-1 are consecutive segments exactly when line - index is
+     * the same for all of them, which holds for a suffix, so binary search.
+     */
+    GtkTextIter walk;
+    gtk_text_buffer_get_iter_at_offset(buffer, &walk, g_array_index(breaks, gint, k - 1));
+    gint key = gtk_text_iter_get_line(&walk) - (gint)(k - 1);
+    guint lo = 0, hi = k - 1;
+    while (lo < hi) {
+        guint mid = lo + (hi - lo) / 2;
+        gtk_text_buffer_get_iter_at_offset(buffer, &walk, g_array_index(breaks, gint, mid));
+        if (gtk_text_iter_get_line(&walk) - (gint)mid < key) lo = mid + 1;
+        else hi = mid;
+    }
+    gtk_text_buffer_get_iter_at_offset(buffer, &walk, g_array_index(breaks, gint, lo));
+    gtk_text_iter_set_line_offset(&walk, 0);
+    *col = offset - gtk_text_iter_get_offset(&walk) - (gint)(k - lo);
+}
+
+/* Status bar text for the cursor; the label is only touched when a field changed */
+static void flush_status(EditorApp *app) {
+    GtkTextIter iter;
+    gtk_text_buffer_get_iter_at_mark(GTK_TEXT_BUFFER(app->buffer), &iter, 
+                                     gtk_text_buffer_get_insert(GTK_TEXT_BUFFER(app->buffer)));
+
+    int line = gtk_text_iter_get_line(&iter) + 1;
+    int col = gtk_text_iter_get_line_offset(&iter) + 1;
+    int total_lines = gtk_text_buffer_get_line_count(GTK_TEXT_BUFFER(app->buffer));
+    if (app->long_lines) {
+        long_lines_position(app, &iter, &line, &col, &total_lines);
+        line++;
+        col++;
+    }
+
+    if (line == app->status_line && col == app->status_col &&
+        total_lines == app->status_total && app->focus_mode == app->status_focus)
+        return;
+    app->status_line = line;
+    app->status_col = col;
+    app->status_total = total_lines;
+    app->status_focus = app->focus_mode;
+
+    gchar *status;
+    if (app->focus_mode) {
+        status = g_strdup_printf("Line: %d, Col: %d | Total Lines: %d | [FOCUS MODE]%s", 
+                                 line, col, total_lines, app->long_lines ? " [LONG LINES]" : "");
+    } else {
+        status = g_strdup_printf("Line: %d, Col: %d | Total Lines: %d%s", 
+                                 line, col, total_lines, app->long_lines ? " | [LONG LINES]" : "");
+    }
+
+    gtk_label_set_text(GTK_LABEL(app->status_label), status);
+    g_free(status);
+}
+
+static gboolean on_status_tick(GtkWidget *widget, GdkFrameClock *clock, gpointer data) {
+    EditorApp *app = (EditorApp *)data;
+    app->status_tick = 0;
+    flush_status(app);
+    return G_SOURCE_REMOVE;
+}
+
+/*
+ * Mark the status bar out of date. However often this is called (every
+ * mark-set and buffer change while a key repeats), it is recomputed once,
+ * on the next frame.
+ */
+static void update_status(EditorApp *app) {
+    if (app->status_tick) return;
+    if (!gtk_widget_get_realized(app->status_label)) {
+        flush_status(app);
+        return;
+    }
+    app->status_tick = gtk_widget_add_tick_callback(app->status_label, on_status_tick, app, NULL);
+}
+
+static void on_buffer_changed_status(GtkTextBuffer *buffer, gpointer data) {
+    update_status((EditorApp *)data);
+}
+/*major bug fix: Missing line numbers due to app repaint */ 
+static void on_tree_selection_changed(GtkTreeSelection *selection, gpointer data) {
+    EditorApp *app = (EditorApp *)data;
+    GtkTreeIter iter;
+    GtkTreeModel *model;
+    
+    if (gtk_tree_selection_get_selected(selection, &model, &iter)) {
+        gint line_num;
+        gtk_tree_model_get(model, &iter, COL_LINE, &line_num, -1);
+        
+        if (line_num > 0) {
+            app->focus_mode = TRUE;
+
+            GtkTextIter start;
+            /* GTK uses 0-indexed line numbers */
+            gtk_text_buffer_get_iter_at_line(GTK_TEXT_BUFFER(app->buffer), &start, line_num - 1);
+            unfold_around(app, &start);
+            
+            /* 1. Flash the row; it replaces the previous highlight and stays while in Focus Mode */
+            scrible_view_flash((ScribleView *)app->view, &start, &start, app->focus_mode);
+
+            /* 2. Move cursor and scroll to center (0.5 yalign) */
+            gtk_text_buffer_place_cursor(GTK_TEXT_BUFFER(app->buffer), &start);
+            gtk_text_view_scroll_to_iter(GTK_TEXT_VIEW(app->view), &start, 0.0, TRUE, 0.0, 0.5);
+
+            update_status(app);
+            gtk_widget_grab_focus(app->view);
+        }
+    }
+}
+
+typedef struct {
+    EditorApp *app;
+    GtkTreeIter func_iter;
+    gboolean has_funcs;
+} SymbolSink;
+
+static void add_symbol(const char *text, size_t len, int line, void *data) {
+    SymbolSink *sink = (SymbolSink *)data;
+    GtkTreeIter child;
+    
+    if (!sink->has_funcs) {
+        gtk_tree_store_append(sink->app->tree_store, &sink->func_iter, NULL);
+        gtk_tree_store_set(sink->app->tree_store, &sink->func_iter, COL_NAME, "Functions", COL_LINE, 0, -1);
+        sink->has_funcs = TRUE;
+    }
+    gchar *name = g_strndup(text, len);
+    gtk_tree_store_append(sink->app->tree_store, &child, &sink->func_iter);
+    gtk_tree_store_set(sink->app->tree_store, &child, COL_NAME, name, COL_LINE, line, -1);
+    g_free(name);
+}
+
+/* Function list for the sidebar, detection lives in sc_parse_symbols() */
+static void parse_symbols(EditorApp *app) {
+    GtkTextIter start, end;
+    SymbolSink sink = { app };
+    
+    TRACE_BEGIN("parse_symbols");
+    gtk_text_buffer_get_bounds(GTK_TEXT_BUFFER(app->buffer), &start, &end);
+    gchar *text = gtk_text_buffer_get_text(GTK_TEXT_BUFFER(app->buffer), &start, &end, TRUE);
+    
+    gtk_tree_store_clear(app->tree_store);
+    sc_parse_symbols(text, strlen(text), add_symbol, &sink);
+    gtk_tree_view_expand_all(GTK_TREE_VIEW(app->tree_view));
+    tags_fill_sidebar(app);
+    g_free(text);
+    TRACE_END("parse_symbols");
+}
+
+static void on_new(GtkWidget *widget, gpointer data) {
+    EditorApp *app = (EditorApp *)data;
+    gtk_text_buffer_set_text(GTK_TEXT_BUFFER(app->buffer), "", -1);
+    gtk_text_buffer_set_modified(GTK_TEXT_BUFFER(app->buffer), FALSE);
+    file_watch_stop(app);
+    if (app->long_lines) {
+        app->long_lines = FALSE;
+        long_lines_reset(app);
+        app->status_line = 0;
+        gtk_source_buffer_set_highlight_syntax(app->buffer, TRUE);
+        gtk_source_buffer_set_highlight_matching_brackets(app->buffer, TRUE);
+    }
+    if (app->current_file) {
+        g_free(app->current_file);
+        app->current_file = NULL;
+    }
+    gtk_tree_store_clear(app->tree_store);
+    update_status(app);
+}
+
+/* Load a file into the buffer, detect its language and refresh the symbols */
+static gboolean load_file(EditorApp *app, const gchar *filename) {
+    gchar *contents;
+    gsize length;
+    
+    TRACE_BEGIN("load_file");
+    if (!g_file_get_contents(filename, &contents, &length, NULL)) {
+        TRACE_END("load_file");
+        return FALSE;
+    }
+    
+    gsize longest = sc_longest_line(contents, length);
+    app->long_lines = longest > LONG_LINE_LIMIT && ask_long_line_mode(app, filename, longest);
+    if (app->long_lines) {
+        set_text_long_lines(app, contents, length);
+    } else {
+        gtk_text_buffer_set_text(GTK_TEXT_BUFFER(app->buffer), contents, length);
+        long_lines_reset(app);
+    }
+    gtk_text_buffer_set_modified(GTK_TEXT_BUFFER(app->buffer), FALSE);
+    app->status_line = 0;     /* the mode shows in the status bar */
+    file_watch_start(app, filename, contents, length);
+    g_free(contents);
+    TRACE_END("load_file");
+    
+    /* Copy first: filename may be app->current_file itself */
+    gchar *path = g_strdup(filename);
+    g_free(app->current_file);
+    app->current_file = path;
+    if (app->profile) on_clear_profile(NULL, app);
+    
+    /* Auto-detect language */
+    GtkSourceLanguageManager *lm = gtk_source_language_manager_get_default();
+    GtkSourceLanguage *lang = gtk_source_language_manager_guess_language(lm, path, NULL);
+    gtk_source_buffer_set_language(app->buffer, lang);
+    gtk_source_buffer_set_highlight_syntax(app->buffer,
+                                           !app->long_lines || length <= LONG_LINE_HIGHLIGHT_MAX);
+    gtk_source_buffer_set_highlight_matching_brackets(app->buffer, !app->long_lines);
+    
+    parse_symbols(app);
+    update_status(app);
+    project_index_file(app, path);
+    tags_open_file(app, path);
+    file_tree_open_file(app, path);
+    return TRUE;
+}
+
+/* Move the cursor to a 1-indexed line and center it */
+static void jump_to_line(EditorApp *app, gint line) {
+    GtkTextIter iter;
+    gint total_lines = gtk_text_buffer_get_line_count(GTK_TEXT_BUFFER(app->buffer));
+    
+    line = CLAMP(line, 1, total_lines);
+    gtk_text_buffer_get_iter_at_line(GTK_TEXT_BUFFER(app->buffer), &iter, line - 1);
+    unfold_around(app, &iter);
+    gtk_text_buffer_place_cursor(GTK_TEXT_BUFFER(app->buffer), &iter);
+    gtk_text_view_scroll_to_iter(GTK_TEXT_VIEW(app->view), &iter, 0.0, TRUE, 0.0, 0.5);
+    update_status(app);
+}
+
+/* Single-instance mode: "open-location" activated by another scrible process */
+static void on_remote_open(GSimpleAction *action, GVariant *parameter, gpointer data) {
+    EditorApp *app = (EditorApp *)data;
+    const gchar *path;
+    gint line;
+    
+    g_variant_get(parameter, "(&si)", &path, &line);
+    if (*path) {
+        if (!load_file(app, path)) {
+            g_print("Could not open %s\n", path);
+            return;
+        }
+        if (line > 0) jump_to_line(app, line);
+    }
+    gtk_window_present(GTK_WINDOW(app->window));
+}
+
+static void on_open(GtkWidget *widget, gpointer data) {
+    EditorApp *app = (EditorApp *)data;
+    GtkWidget *dialog;
+    GtkFileChooserAction action = GTK_FILE_CHOOSER_ACTION_OPEN;
+    gint res;
+    
+    dialog = gtk_file_chooser_dialog_new("Open File", GTK_WINDOW(app->window),
+                                         action, "_Cancel", GTK_RESPONSE_CANCEL,
+                                         "_Open", GTK_RESPONSE_ACCEPT, NULL);
+    
+    res = gtk_dialog_run(GTK_DIALOG(dialog));
+    if (res == GTK_RESPONSE_ACCEPT) {
+        GtkFileChooser *chooser = GTK_FILE_CHOOSER(dialog);
+        gchar *filename = gtk_file_chooser_get_filename(chooser);
+        load_file(app, filename);
+        g_free(filename);
+    }
+    gtk_widget_destroy(dialog);
+}
+
+static void on_save(GtkWidget *widget, gpointer data) {
+    EditorApp *app = (EditorApp *)data;
+    
+    if (!app->current_file) {
+        on_save_as(widget, data);
+        return;
+    }
+    
+    if (!file_watch_confirm_save(app)) return;
+    
+    TRACE_BEGIN("save");
+    gchar *text = get_save_text(app);
+    
+    if (g_file_set_contents(app->current_file, text, -1, NULL)) {
+        gtk_text_buffer_set_modified(GTK_TEXT_BUFFER(app->buffer), FALSE);
+        file_watch_start(app, app->current_file, text, -1);
+    }
+    g_free(text);
+    TRACE_END("save");
+    
+    parse_symbols(app);
+    asm_view_refresh(app);
+    project_index_file(app, app->current_file);
+}
+
+static void on_save_as(GtkWidget *widget, gpointer data) {
+    EditorApp *app = (EditorApp *)data;
+    GtkWidget *dialog;
+    GtkFileChooser *chooser;
+    GtkFileChooserAction action = GTK_FILE_CHOOSER_ACTION_SAVE;
+    gint res;
+    
+    dialog = gtk_file_chooser_dialog_new("Save File", GTK_WINDOW(app->window),
+                                         action, "_Cancel", GTK_RESPONSE_CANCEL,
+                                         "_Save", GTK_RESPONSE_ACCEPT, NULL);
+    chooser = GTK_FILE_CHOOSER(dialog);
+    
+    gtk_file_chooser_set_do_overwrite_confirmation(chooser, TRUE);
+    
+    res = gtk_dialog_run(GTK_DIALOG(dialog));
+    if (res == GTK_RESPONSE_ACCEPT) {
+        gchar *filename = gtk_file_chooser_get_filename(chooser);
+        
+        TRACE_BEGIN("save");
+        gchar *text = get_save_text(app);
+        
+        if (g_file_set_contents(filename, text, -1, NULL)) {
+            gtk_text_buffer_set_modified(GTK_TEXT_BUFFER(app->buffer), FALSE);
+            file_watch_start(app, filename, text, -1);
+        }
+        g_free(text);
+        TRACE_END("save");
+        
+        if (app->current_file)
+            g_free(app->current_file);
+        app->current_file = g_strdup(filename);
+        
+        parse_symbols(app);
+        update_status(app);
+        asm_view_refresh(app);
+        project_index_file(app, app->current_file);
+        tags_open_file(app, app->current_file);
+        g_free(filename);
+    }
+    gtk_widget_destroy(dialog);
+}
+
+static void on_quit(GtkWidget *widget, gpointer data) {
+    gtk_main_quit();
+}
+
+static void on_refresh_symbols(GtkWidget *widget, gpointer data) {
+    EditorApp *app = (EditorApp *)data;
+    parse_symbols(app);
+}
+
+/* Function to show the updates in a popup */
+static void show_update_notes(GtkWidget *widget, gpointer data) {
+    GtkWidget *parent = (GtkWidget *)data;
+    GtkWidget *msg_dialog = gtk_message_dialog_new(GTK_WINDOW(parent),
+        GTK_DIALOG_MODAL | GTK_DIALOG_DESTROY_WITH_PARENT,
+        GTK_MESSAGE_INFO,
+        GTK_BUTTONS_OK,
+        "Scrible Sketch Book - v2.9 Updates");
+
+    gtk_message_dialog_format_secondary_text(GTK_MESSAGE_DIALOG(msg_dialog),
+        "• Added GCC Quick Build & Run system.\n"
+        "• Integrated ANSI C syntax highlighting.\n"
+        "• Font size and safe font dialog update.\n"
+        "• Improved symbol browser navigation.\n\n"
+        "Note: fixed library header bug in this version "
+        "of Scrible. \n"
+        " ");
+
+    gtk_dialog_run(GTK_DIALOG(msg_dialog));
+    gtk_widget_destroy(msg_dialog);
+}
+
+static void on_about(GtkWidget *widget, gpointer data) {
+    EditorApp *app = (EditorApp *)data;
+    GtkWidget *dialog;
+    GtkCssProvider *provider;
+    GtkStyleContext *context;
+    
+    dialog = gtk_about_dialog_new();
+    
+    /*  Add the "Update Notes" Button at the top */
+    GtkWidget *content_area = gtk_dialog_get_content_area(GTK_DIALOG(dialog));
+    GtkWidget *update_btn = gtk_button_new_with_label("✨ View What's New");
+    
+    // Pack it at the top (index 0)
+    gtk_box_pack_start(GTK_BOX(content_area), update_btn, FALSE, FALSE, 10);
+    gtk_box_reorder_child(GTK_BOX(content_area), update_btn, 0);
+    
+    // Connect the click signal
+    g_signal_connect(update_btn, "clicked", G_CALLBACK(show_update_notes), dialog);
+
+    /*  Standard Info */
+    gtk_about_dialog_set_program_name(GTK_ABOUT_DIALOG(dialog), "Scrible Sketch Book");
+    gtk_about_dialog_set_version(GTK_ABOUT_DIALOG(dialog), "Version 2.9");
+    gtk_about_dialog_set_logo_icon_name(GTK_ABOUT_DIALOG(dialog), "accessories-text-editor");
+    gtk_about_dialog_set_license_type(GTK_ABOUT_DIALOG(dialog), GTK_LICENSE_GPL_3_0);
+    gtk_about_dialog_set_website(GTK_ABOUT_DIALOG(dialog), "https://github.com/oneneoncoffee/");
+   
+    gtk_about_dialog_set_comments(GTK_ABOUT_DIALOG(dialog), 
+        "A GTK+ 3 code editor with syntax highlighting.\n"
+        "This software is 100% free and open source.");
+
+    const gchar *authors[] = {"Johnny Buckallew Stroud", "Contributor Name", "Special thanks to Jesus!", NULL};
+    gtk_about_dialog_set_authors(GTK_ABOUT_DIALOG(dialog), authors);
+
+    /* Apply Black & Gold Theme ONLY to this dialog */
+    provider = gtk_css_provider_new();
+    const gchar *css = 
+        "dialog, grid, box, stack, scrolledwindow, viewport, list, row { background-color: #000000; }"
+        "label { color: #ffffff; font-weight: bold; }"
+        "label.title { color: #ffa600; font-size: 1.2em; }"
+        "button { background-color: #222222; color: #ffa600; border: 1px solid #ffa600; }";
+    
+    gtk_css_provider_load_from_data(provider, css, -1, NULL);
+    
+    context = gtk_widget_get_style_context(dialog);
+    gtk_style_context_add_provider(context, GTK_STYLE_PROVIDER(provider), 
+                                   GTK_STYLE_PROVIDER_PRIORITY_APPLICATION);
+    
+    /* Show and Run */
+    gtk_window_set_transient_for(GTK_WINDOW(dialog), GTK_WINDOW(app->window));
+    gtk_widget_show_all(dialog); // Necessary to make the manually added button appear
+    gtk_dialog_run(GTK_DIALOG(dialog));
+    
+    /* Cleanup */
+    g_object_unref(provider);
+    gtk_widget_destroy(dialog);
+}
+
+
+/* Editor menu call backs */
+static void on_undo(GtkWidget *widget, gpointer data) {
+    EditorApp *app = (EditorApp *)data;
+    /* Use GTK_SOURCE_IS_BUFFER instead of GTK_IS_SOURCE_BUFFER */
+    if (GTK_SOURCE_IS_BUFFER(app->buffer) && gtk_source_buffer_can_undo(app->buffer)) {
+        gtk_source_buffer_undo(app->buffer);
+    }
+}
+
+static void on_redo(GtkWidget *widget, gpointer data) {
+    EditorApp *app = (EditorApp *)data;
+    /* Use GTK_SOURCE_IS_BUFFER instead of GTK_IS_SOURCE_BUFFER */
+    if (GTK_SOURCE_IS_BUFFER(app->buffer) && gtk_source_buffer_can_redo(app->buffer)) {
+        gtk_source_buffer_redo(app->buffer);
+    }
+}
+static void on_cut(GtkWidget *widget, gpointer data) {
+    EditorApp *app = (EditorApp *)data;
+    gtk_text_buffer_cut_clipboard(GTK_TEXT_BUFFER(app->buffer), gtk_clipboard_get(GDK_SELECTION_CLIPBOARD), TRUE);
+}
+
+static void on_copy(GtkWidget *widget, gpointer data) {
+    EditorApp *app = (EditorApp *)data;
+    gtk_text_buffer_copy_clipboard(GTK_TEXT_BUFFER(app->buffer), gtk_clipboard_get(GDK_SELECTION_CLIPBOARD));
+}
+
+static void on_paste(GtkWidget *widget, gpointer data) {
+    EditorApp *app = (EditorApp *)data;
+    gtk_text_buffer_paste_clipboard(GTK_TEXT_BUFFER(app->buffer), gtk_clipboard_get(GDK_SELECTION_CLIPBOARD), NULL, TRUE);
+}
 
-    /* 5. THE SIDEBAR (Treeview) */
-    "treeview { background-color: #000000; color: #008800; }"
-    "treeview:selected { background-color: #00ff41; color: #000000; }";
-        /* The Active Line (The "Yellow" equivalent in Green Mode) */
-        "GtkSourceView gutter text.current-line {"
-        "  color: #00FF41;"
-        "  font-weight: bold;"
-        "  border: 1px solid #00ffff;"
-        "}"   
-        /* Specifically show boxes with a different color */
-        "box, grid, paned {"
-        "  border: 1px solid #00ffff;" /* Cyan for containers */
-        "}"
-        "*:treeview {"
-        "  background-color: #000000;"
-        "  color: #008800;" /* Muted green for sidebar names */
-        "}"
-        "treeview:selected {"
-        "  background-color: #00ff41;"
-        "  color: #000000;"
-        "}"
-        "GtkSourceView text.current-line {"
-        "  background-color: #001A00;"
-        "}";
+static void on_delete(GtkWidget *widget, gpointer data) {
+    EditorApp *app = (EditorApp *)data;
+    gtk_text_buffer_delete_selection(GTK_TEXT_BUFFER(app->buffer), TRUE, TRUE);
+}
+
+static void on_select_all(GtkWidget *widget, gpointer data) {
+    EditorApp *app = (EditorApp *)data;
+    GtkTextIter start, end;
+    gtk_text_buffer_get_bounds(GTK_TEXT_BUFFER(app->buffer), &start, &end);
+    gtk_text_buffer_select_range(GTK_TEXT_BUFFER(app->buffer), &start, &end);
+}
+
+/*
+ * Identifier completion
+ * Every identifier in the buffer is counted in a hash table, kept up to date
+ * line by line from the buffer's insert-text / delete-range signals. Prefix
+ * lookups binary search a sorted snapshot of the keys plus a short list of
+ * words added since the snapshot; the snapshot is rebuilt from an idle.
+ */
+#define WORD_MIN_LENGTH     3
+#define WORD_MERGE_RECENT   256
+#define WORD_MAX_PROPOSALS  64
+
+static const gchar *c_builtin_words[] = {
+    /* C keywords */
+    "auto", "break", "case", "char", "const", "continue", "default", "do",
+    "double", "else", "enum", "extern", "float", "for", "goto", "if", "inline",
+    "int", "long", "register", "restrict", "return", "short", "signed",
+    "sizeof", "static", "struct", "switch", "typedef", "union", "unsigned",
+    "void", "volatile", "while",
+    "_Bool", "_Complex", "_Alignas", "_Alignof", "_Atomic", "_Generic",
+    "_Noreturn", "_Static_assert", "_Thread_local",
+    /* Common types and macros */
+    "size_t", "ssize_t", "ptrdiff_t", "intptr_t", "uintptr_t", "int8_t",
+    "int16_t", "int32_t", "int64_t", "uint8_t", "uint16_t", "uint32_t",
+    "uint64_t", "bool", "true", "false", "NULL", "FILE", "EOF", "time_t",
+    "va_list", "errno", "stdin", "stdout", "stderr", "EXIT_SUCCESS", "EXIT_FAILURE",
+    "SEEK_SET", "SEEK_CUR", "SEEK_END", "BUFSIZ", "INT_MAX", "INT_MIN",
+    "UINT_MAX", "LONG_MAX", "LONG_MIN", "SIZE_MAX", "RAND_MAX", "CHAR_BIT",
+    /* stdio.h */
+    "printf", "fprintf", "sprintf", "snprintf", "vprintf", "vfprintf",
+    "vsprintf", "vsnprintf", "scanf", "fscanf", "sscanf", "fopen", "freopen",
+    "fclose", "fflush", "fread", "fwrite", "fgetc", "fgets", "fputc", "fputs",
+    "getc", "getchar", "putc", "putchar", "puts", "ungetc", "fseek", "ftell",
+    "rewind", "fgetpos", "fsetpos", "feof", "ferror", "clearerr", "perror",
+    "remove", "rename", "tmpfile", "tmpnam", "setbuf", "setvbuf",
+    /* stdlib.h */
+    "malloc", "calloc", "realloc", "free", "abort", "exit", "atexit",
+    "getenv", "system", "atoi", "atol", "atof", "strtol", "strtoul",
+    "strtoll", "strtoull", "strtod", "strtof", "qsort", "bsearch", "abs",
+    "labs", "div", "ldiv", "rand", "srand",
+    /* string.h */
+    "memcpy", "memmove", "memset", "memcmp", "memchr", "strcpy", "strncpy",
+    "strcat", "strncat", "strcmp", "strncmp", "strcoll", "strchr", "strrchr",
+    "strstr", "strspn", "strcspn", "strpbrk", "strtok", "strlen", "strerror",
+    "strdup", "strndup",
+    /* ctype.h */
+    "isalnum", "isalpha", "isdigit", "isxdigit", "islower", "isupper",
+    "isspace", "ispunct", "isprint", "iscntrl", "isgraph", "tolower", "toupper",
+    /* math.h */
+    "sqrt", "pow", "fabs", "floor", "ceil", "fmod", "exp", "log", "log10",
+    "sin", "cos", "tan", "asin", "acos", "atan", "atan2", "round",
+    /* time.h, stdarg.h, assert.h, signal.h, setjmp.h */
+    "time", "clock", "difftime", "mktime", "localtime", "gmtime", "strftime",
+    "asctime", "ctime", "va_start", "va_arg", "va_end", "va_copy", "assert",
+    "signal", "raise", "setjmp", "longjmp",
+    NULL
+};
+
+typedef struct {
+    guint count;              /* occurrences in the buffer, 0 = stale */
+    gchar word[];
+} WordEntry;
+
+/* Identifier counts for the current buffer */
+typedef struct WordIndex {
+    GHashTable *counts;       /* word -> owned WordEntry */
+    GPtrArray *sorted;        /* WordEntry, sorted by word at the last merge */
+    GPtrArray *recent;        /* WordEntry added since the last merge */
+    guint stale;              /* keys with a count of 0 */
+    guint merge_source;
+    const gchar **builtins;   /* c_builtin_words, sorted */
+    guint n_builtins;
+} WordIndex;
+
+typedef struct {
+    const gchar *word;
+    guint score;
+} WordMatch;
+
+static int compare_strings(const void *a, const void *b) {
+    return strcmp(*(const gchar * const *)a, *(const gchar * const *)b);
+}
+
+static gint compare_word_entries(gconstpointer a, gconstpointer b) {
+    return strcmp((*(const WordEntry * const *)a)->word, (*(const WordEntry * const *)b)->word);
+}
+
+static WordIndex *word_index_new(void) {
+    WordIndex *index = g_new0(WordIndex, 1);
+    index->counts = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, g_free);
+    index->sorted = g_ptr_array_new();
+    index->recent = g_ptr_array_new();
+    
+    index->n_builtins = G_N_ELEMENTS(c_builtin_words) - 1;
+    index->builtins = g_new(const gchar *, index->n_builtins);
+    memcpy(index->builtins, c_builtin_words, index->n_builtins * sizeof(gchar *));
+    qsort(index->builtins, index->n_builtins, sizeof(gchar *), compare_strings);
+    return index;
+}
+
+static void word_index_free(WordIndex *index) {
+    if (!index) return;
+    if (index->merge_source) g_source_remove(index->merge_source);
+    g_ptr_array_free(index->sorted, TRUE);
+    g_ptr_array_free(index->recent, TRUE);
+    g_hash_table_destroy(index->counts);
+    g_free(index->builtins);
+    g_free(index);
+}
+
+/* Drop stale words and fold the recent list into a new sorted snapshot */
+static gboolean word_index_merge(gpointer data) {
+    WordIndex *index = (WordIndex *)data;
+    GHashTableIter iter;
+    gpointer value;
+    
+    index->merge_source = 0;
+    TRACE_BEGIN("idle: word_index_merge");
+    g_ptr_array_set_size(index->sorted, 0);
+    g_ptr_array_set_size(index->recent, 0);
+    
+    g_hash_table_iter_init(&iter, index->counts);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        if (((WordEntry *)value)->count == 0) g_hash_table_iter_remove(&iter);
+        else g_ptr_array_add(index->sorted, value);
+    }
+    index->stale = 0;
+    g_ptr_array_sort(index->sorted, compare_word_entries);
+    TRACE_END("idle: word_index_merge");
+    return G_SOURCE_REMOVE;
+}
+
+static void word_index_schedule_merge(WordIndex *index) {
+    if (index->merge_source) return;
+    if (index->recent->len > WORD_MERGE_RECENT ||
+        (index->stale > 4096 && index->stale > index->sorted->len / 4))
+        index->merge_source = g_idle_add(word_index_merge, index);
+}
+
+static void word_index_update(WordIndex *index, const gchar *word, gsize len, gint delta) {
+    gchar key[128];
+    
+    if (len < WORD_MIN_LENGTH || len >= sizeof(key)) return;
+    memcpy(key, word, len);
+    key[len] = '\0';
+    
+    WordEntry *entry = g_hash_table_lookup(index->counts, key);
+    if (entry) {
+        if (delta < 0 && entry->count == 0) return;
+        if (delta > 0 && entry->count == 0) index->stale--;
+        entry->count += delta;
+        if (entry->count == 0) index->stale++;
+    } else if (delta > 0) {
+        entry = g_malloc(sizeof(WordEntry) + len + 1);
+        entry->count = 1;
+        memcpy(entry->word, key, len + 1);
+        g_hash_table_insert(index->counts, entry->word, entry);
+        g_ptr_array_add(index->recent, entry);
+    }
+}
+
+/* Count (delta = 1) or uncount (delta = -1) every identifier in text */
+static void word_index_scan(WordIndex *index, const gchar *text, gint delta) {
+    const gchar *p = text;
+    
+    while (*p) {
+        if (g_ascii_isalpha(*p) || *p == '_') {
+            const gchar *start = p;
+            while (g_ascii_isalnum(*p) || *p == '_') p++;
+            word_index_update(index, start, p - start, delta);
+        } else if (g_ascii_isdigit(*p)) {
+            while (g_ascii_isalnum(*p) || *p == '_') p++;
+        } else {
+            p++;
+        }
+    }
+    word_index_schedule_merge(index);
+}
+
+/* Keep the WORD_MAX_PROPOSALS best matches, best first */
+static void word_match_offer(WordMatch *best, guint *n_best, const gchar *word, guint score) {
+    guint n = *n_best;
+    gsize len = strlen(word);
+    
+    if (n == WORD_MAX_PROPOSALS) {
+        WordMatch *last = &best[n - 1];
+        if (score < last->score || (score == last->score && len >= strlen(last->word)))
+            return;
+        n--;
+    }
+    guint i = n;
+    while (i > 0 && (best[i - 1].score < score ||
+                     (best[i - 1].score == score && strlen(best[i - 1].word) > len))) {
+        best[i] = best[i - 1];
+        i--;
+    }
+    best[i].word = word;
+    best[i].score = score;
+    *n_best = n + 1;
+}
+
+static guint builtin_lower_bound(const gchar **words, guint n, const gchar *prefix) {
+    guint lo = 0, hi = n;
+    while (lo < hi) {
+        guint mid = (lo + hi) / 2;
+        if (strcmp(words[mid], prefix) < 0) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+static guint entry_lower_bound(WordEntry **entries, guint n, const gchar *prefix) {
+    guint lo = 0, hi = n;
+    while (lo < hi) {
+        guint mid = (lo + hi) / 2;
+        if (strcmp(entries[mid]->word, prefix) < 0) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+/* Ranked completions for prefix: buffer words by frequency, then keywords and libc */
+static guint word_index_lookup(WordIndex *index, const gchar *prefix, WordMatch *best) {
+    gsize plen = strlen(prefix);
+    guint n_best = 0;
+    WordEntry **sorted = (WordEntry **)index->sorted->pdata;
+    
+    for (guint i = entry_lower_bound(sorted, index->sorted->len, prefix);
+         i < index->sorted->len && strncmp(sorted[i]->word, prefix, plen) == 0; i++) {
+        if (sorted[i]->count > 0 && sorted[i]->word[plen] != '\0')
+            word_match_offer(best, &n_best, sorted[i]->word, sorted[i]->count + 1);
+    }
+    for (guint i = 0; i < index->recent->len; i++) {
+        WordEntry *entry = g_ptr_array_index(index->recent, i);
+        if (entry->count > 0 && entry->word[plen] != '\0' &&
+            strncmp(entry->word, prefix, plen) == 0)
+            word_match_offer(best, &n_best, entry->word, entry->count + 1);
+    }
+    for (guint i = builtin_lower_bound(index->builtins, index->n_builtins, prefix);
+         i < index->n_builtins && strncmp(index->builtins[i], prefix, plen) == 0; i++) {
+        const gchar *word = index->builtins[i];
+        WordEntry *entry = g_hash_table_lookup(index->counts, word);
+        if (word[plen] == '\0' || (entry && entry->count > 0)) continue;
+        word_match_offer(best, &n_best, word, 1);
+    }
+    return n_best;
+}
+
+/* Text of whole lines first_line..last_line, including hidden text */
+static gchar *get_lines_text(GtkTextBuffer *buffer, gint first_line, gint last_line) {
+    GtkTextIter start, end;
+    gtk_text_buffer_get_iter_at_line(buffer, &start, first_line);
+    gtk_text_buffer_get_iter_at_line(buffer, &end, last_line);
+    if (!gtk_text_iter_ends_line(&end)) gtk_text_iter_forward_to_line_end(&end);
+    return gtk_text_buffer_get_text(buffer, &start, &end, TRUE);
+}
+
+/* Uncount the line being edited before the change ... */
+static void on_words_insert_text(GtkTextBuffer *buffer, GtkTextIter *location,
+                                 gchar *text, gint len, gpointer data) {
+    EditorApp *app = (EditorApp *)data;
+    gint line = gtk_text_iter_get_line(location);
+    gchar *old = get_lines_text(buffer, line, line);
+    word_index_scan(app->words, old, -1);
+    g_free(old);
+}
+
+/* ... and count the lines it became afterwards; location now ends the inserted text */
+static void on_words_insert_text_after(GtkTextBuffer *buffer, GtkTextIter *location,
+                                       gchar *text, gint len, gpointer data) {
+    EditorApp *app = (EditorApp *)data;
+    gint last = gtk_text_iter_get_line(location);
+    gint newlines = 0;
+    
+    for (gint i = 0; i < len; i++)
+        if (text[i] == '\n') newlines++;
+    
+    gchar *lines = get_lines_text(buffer, last - newlines, last);
+    word_index_scan(app->words, lines, 1);
+    g_free(lines);
+}
+
+static void on_words_delete_range(GtkTextBuffer *buffer, GtkTextIter *start,
+                                  GtkTextIter *end, gpointer data) {
+    EditorApp *app = (EditorApp *)data;
+    gchar *old = get_lines_text(buffer, gtk_text_iter_get_line(start), gtk_text_iter_get_line(end));
+    word_index_scan(app->words, old, -1);
+    g_free(old);
+}
+
+static void on_words_delete_range_after(GtkTextBuffer *buffer, GtkTextIter *start,
+                                        GtkTextIter *end, gpointer data) {
+    EditorApp *app = (EditorApp *)data;
+    gint line = gtk_text_iter_get_line(start);
+    gchar *lines = get_lines_text(buffer, line, line);
+    word_index_scan(app->words, lines, 1);
+    g_free(lines);
+}
+
+/* GtkSourceCompletionProvider over app->words */
+typedef struct {
+    GObject parent_instance;
+    EditorApp *app;
+} ScribleCompletion;
+
+typedef struct {
+    GObjectClass parent_class;
+} ScribleCompletionClass;
+
+static void scrible_completion_iface_init(GtkSourceCompletionProviderIface *iface);
+
+G_DEFINE_TYPE_WITH_CODE(ScribleCompletion, scrible_completion, G_TYPE_OBJECT,
+                        G_IMPLEMENT_INTERFACE(GTK_SOURCE_TYPE_COMPLETION_PROVIDER,
+                                              scrible_completion_iface_init))
+
+static gchar *scrible_completion_get_name(GtkSourceCompletionProvider *provider) {
+    return g_strdup("Identifiers");
+}
+
+static void scrible_completion_populate(GtkSourceCompletionProvider *provider,
+                                        GtkSourceCompletionContext *context) {
+    ScribleCompletion *self = (ScribleCompletion *)provider;
+    GtkTextIter end, start;
+    GList *proposals = NULL;
+    
+    if (!gtk_source_completion_context_get_iter(context, &end)) {
+        gtk_source_completion_context_add_proposals(context, provider, NULL, TRUE);
+        return;
+    }
+    
+    /* Identifier being typed, up to the cursor */
+    start = end;
+    while (gtk_text_iter_backward_char(&start)) {
+        gunichar c = gtk_text_iter_get_char(&start);
+        if (!g_ascii_isalnum(c) && c != '_') {
+            gtk_text_iter_forward_char(&start);
+            break;
+        }
+    }
+    gchar *prefix = gtk_text_iter_get_text(&start, &end);
+    gboolean interactive = gtk_source_completion_context_get_activation(context) ==
+                           GTK_SOURCE_COMPLETION_ACTIVATION_INTERACTIVE;
+    
+    if (strlen(prefix) >= (interactive ? 2 : 1) && !g_ascii_isdigit(prefix[0])) {
+        WordMatch best[WORD_MAX_PROPOSALS];
+        guint n = word_index_lookup(self->app->words, prefix, best);
+        
+        for (guint i = n; i > 0; i--) {
+            GtkSourceCompletionItem *item = gtk_source_completion_item_new2();
+            gtk_source_completion_item_set_label(item, best[i - 1].word);
+            gtk_source_completion_item_set_text(item, best[i - 1].word);
+            proposals = g_list_prepend(proposals, item);
+        }
+    }
+    
+    gtk_source_completion_context_add_proposals(context, provider, proposals, TRUE);
+    g_list_free_full(proposals, g_object_unref);
+    g_free(prefix);
+}
+
+static void scrible_completion_iface_init(GtkSourceCompletionProviderIface *iface) {
+    iface->get_name = scrible_completion_get_name;
+    iface->populate = scrible_completion_populate;
+}
+
+static void scrible_completion_class_init(ScribleCompletionClass *klass) {
+}
+
+static void scrible_completion_init(ScribleCompletion *self) {
+}
+
+static GtkSourceCompletionProvider *scrible_completion_new(EditorApp *app) {
+    ScribleCompletion *self = g_object_new(scrible_completion_get_type(), NULL);
+    self->app = app;
+    return GTK_SOURCE_COMPLETION_PROVIDER(self);
+}
+
+/* Track buffer identifiers and register the completion provider on the view */
+static void setup_completion(EditorApp *app) {
+    GtkSourceCompletion *completion = gtk_source_view_get_completion(GTK_SOURCE_VIEW(app->view));
+    GtkSourceCompletionProvider *provider = scrible_completion_new(app);
+    
+    app->words = word_index_new();
+    g_signal_connect(app->buffer, "insert-text", G_CALLBACK(on_words_insert_text), app);
+    g_signal_connect_after(app->buffer, "insert-text", G_CALLBACK(on_words_insert_text_after), app);
+    g_signal_connect(app->buffer, "delete-range", G_CALLBACK(on_words_delete_range), app);
+    g_signal_connect_after(app->buffer, "delete-range", G_CALLBACK(on_words_delete_range_after), app);
+    
+    gtk_source_completion_add_provider(completion, provider, NULL);
+    g_object_unref(provider);
+}
+
+/*
+ * Snippet engine
+ * Snippets are read once at startup from snippets.conf into a table kept in
+ * file order (for the Insert menu) plus a trigger-sorted index with a
+ * first-byte bucket table, so a trigger lookup is one bucket + binary search.
+ */
+static SnippetTable *snippet_table_new(void) {
+    SnippetTable *table = g_new0(SnippetTable, 1);
+    table->strings = g_string_chunk_new(4096);
+    return table;
+}
+
+static int compare_snippet_triggers(const void *a, const void *b) {
+    const Snippet *sa = *(const Snippet * const *)a;
+    const Snippet *sb = *(const Snippet * const *)b;
+    return strcmp(sa->trigger, sb->trigger);
+}
+
+static SnippetTable *snippet_table_load(const gchar *path) {
+    GError *error = NULL;
+    GKeyFile *kf = g_key_file_new();
+    
+    if (!g_key_file_load_from_file(kf, path, G_KEY_FILE_NONE, &error)) {
+        g_print("Snippets: %s: %s\n", path, error->message);
+        g_error_free(error);
+        g_key_file_free(kf);
+        return NULL;
+    }
+    
+    gsize n_groups;
+    gchar **groups = g_key_file_get_groups(kf, &n_groups);
+    SnippetTable *table = snippet_table_new();
+    table->items = g_new0(Snippet, n_groups);
+    
+    for (gsize i = 0; i < n_groups; i++) {
+        gchar *body = g_key_file_get_string(kf, groups[i], "body", NULL);
+        if (!body) continue;
+        
+        gchar *menu = g_key_file_get_string(kf, groups[i], "menu", NULL);
+        gchar *label = g_key_file_get_string(kf, groups[i], "label", NULL);
+        Snippet *snip = &table->items[table->n_items++];
+        
+        snip->trigger = g_string_chunk_insert_const(table->strings, groups[i]);
+        /* Menu names are interned so they can be compared by pointer */
+        snip->menu = menu && *menu ? g_string_chunk_insert_const(table->strings, menu) : NULL;
+        snip->label = label ? g_string_chunk_insert(table->strings, label) : snip->trigger;
+        snip->body = g_string_chunk_insert(table->strings, body);
+        snip->separator = g_key_file_get_boolean(kf, groups[i], "separator", NULL);
+        
+        g_free(body);
+        g_free(menu);
+        g_free(label);
+    }
+    g_strfreev(groups);
+    g_key_file_free(kf);
+    
+    table->by_trigger = g_new(const Snippet *, table->n_items + 1);
+    for (guint i = 0; i < table->n_items; i++)
+        table->by_trigger[i] = &table->items[i];
+    qsort(table->by_trigger, table->n_items, sizeof(const Snippet *), compare_snippet_triggers);
+    
+    /* first[c] = index of the first trigger starting with a byte >= c */
+    guint k = 0;
+    for (guint c = 0; c < 256; c++) {
+        while (k < table->n_items && (guchar)table->by_trigger[k]->trigger[0] < c) k++;
+        table->first[c] = k;
+    }
+    table->first[256] = table->n_items;
+    
+    g_print("Loaded %u snippets from %s\n", table->n_items, path);
+    return table;
+}
+
+static void snippet_table_free(SnippetTable *table) {
+    if (!table) return;
+    g_string_chunk_free(table->strings);
+    g_free(table->items);
+    g_free(table->by_trigger);
+    g_free(table);
+}
+
+static const Snippet *snippet_lookup(const SnippetTable *table, const gchar *trigger) {
+    if (!table || !*trigger) return NULL;
+    
+    guchar c = (guchar)trigger[0];
+    guint lo = table->first[c], hi = table->first[c + 1];
+    while (lo < hi) {
+        guint mid = (lo + hi) / 2;
+        int cmp = strcmp(trigger, table->by_trigger[mid]->trigger);
+        if (cmp == 0) return table->by_trigger[mid];
+        if (cmp < 0) hi = mid;
+        else lo = mid + 1;
+    }
+    return NULL;
+}
+
+/* $SCRIBLE_SNIPPETS, then the user config dir, the binary's dir and the install dir */
+static SnippetTable *load_snippets(void) {
+    gchar *candidates[4] = { NULL, NULL, NULL, NULL };
+    SnippetTable *table = NULL;
+    
+    if (g_getenv("SCRIBLE_SNIPPETS"))
+        candidates[0] = g_strdup(g_getenv("SCRIBLE_SNIPPETS"));
+    candidates[1] = g_build_filename(g_get_user_config_dir(), "scrible", "snippets.conf", NULL);
+    gchar *exe = g_file_read_link("/proc/self/exe", NULL);
+    if (exe) {
+        gchar *dir = g_path_get_dirname(exe);
+        candidates[2] = g_build_filename(dir, "snippets.conf", NULL);
+        g_free(dir);
+        g_free(exe);
+    }
+    candidates[3] = g_build_filename(SCRIBLE_DATADIR, "snippets.conf", NULL);
+    
+    for (int i = 0; i < 4 && !table; i++) {
+        if (candidates[i] && g_file_test(candidates[i], G_FILE_TEST_IS_REGULAR))
+            table = snippet_table_load(candidates[i]);
+    }
+    for (int i = 0; i < 4; i++) g_free(candidates[i]);
+    
+    if (!table) g_print("No snippets.conf found, Insert menu is empty\n");
+    return table;
+}
+
+/* Value for ${NAME}; returns NULL for unknown or unset variables */
+static gchar *snippet_variable(EditorApp *app, const gchar *name) {
+    time_t now = time(NULL);
+    struct tm *t = localtime(&now);
+    char buf[128];
+    
+    if (strcmp(name, "DATE") == 0) strftime(buf, sizeof(buf), "%Y-%m-%d", t);
+    else if (strcmp(name, "TIME") == 0) strftime(buf, sizeof(buf), "%H:%M:%S", t);
+    else if (strcmp(name, "DATETIME") == 0) strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", t);
+    else if (strcmp(name, "FILENAME") == 0)
+        return app->current_file ? g_path_get_basename(app->current_file) : NULL;
+    else return NULL;
+    return g_strdup(buf);
+}
+
+/*
+ * Expand a snippet body into plain text. Tab stops are returned as
+ * character offsets into the text, ordered 1..n with $0 last.
+ * Every new line is prefixed with the indentation of the insertion line.
+ */
+static gchar *snippet_render(EditorApp *app, const gchar *body, const gchar *indent, GArray *stops) {
+    GString *out = g_string_new(NULL);
+    GArray *raw = g_array_new(FALSE, FALSE, sizeof(SnippetStopSpec));
+    const gchar *p = body;
+    
+    while (*p) {
+        if (*p == '\n') {
+            g_string_append_c(out, '\n');
+            g_string_append(out, indent);
+            p++;
+        } else if (p[0] == '$' && p[1] == '$') {
+            g_string_append_c(out, '$');
+            p += 2;
+        } else if (p[0] == '$' && g_ascii_isdigit(p[1])) {
+            SnippetStopSpec spec = { atoi(p + 1), out->len, out->len };
+            g_array_append_val(raw, spec);
+            p++;
+            while (g_ascii_isdigit(*p)) p++;
+        } else if (p[0] == '$' && p[1] == '{' && strchr(p, '}')) {
+            const gchar *close = strchr(p, '}');
+            gchar *inner = g_strndup(p + 2, close - p - 2);
+            gchar *colon = strchr(inner, ':');
+            const gchar *fallback = "";
+            if (colon) {
+                *colon = '\0';
+                fallback = colon + 1;
+            }
+            if (g_ascii_isdigit(inner[0])) {
+                SnippetStopSpec spec = { atoi(inner), out->len, 0 };
+                g_string_append(out, fallback);
+                spec.end = out->len;
+                g_array_append_val(raw, spec);
+            } else {
+                gchar *value = snippet_variable(app, inner);
+                g_string_append(out, value ? value : fallback);
+                g_free(value);
+            }
+            g_free(inner);
+            p = close + 1;
+        } else {
+            g_string_append_c(out, *p);
+            p++;
+        }
+    }
+    
+    /* Byte offsets -> character offsets, then order $1..$n and $0 last */
+    for (guint i = 0; i < raw->len; i++) {
+        SnippetStopSpec *spec = &g_array_index(raw, SnippetStopSpec, i);
+        spec->start = g_utf8_pointer_to_offset(out->str, out->str + spec->start);
+        spec->end = g_utf8_pointer_to_offset(out->str, out->str + spec->end);
+    }
+    for (int index = 1; index <= 9; index++) {
+        for (guint i = 0; i < raw->len; i++) {
+            SnippetStopSpec *spec = &g_array_index(raw, SnippetStopSpec, i);
+            if (spec->index == index) g_array_append_val(stops, *spec);
+        }
+    }
+    for (guint i = 0; i < raw->len; i++) {
+        SnippetStopSpec *spec = &g_array_index(raw, SnippetStopSpec, i);
+        if (spec->index == 0) g_array_append_val(stops, *spec);
+    }
+    g_array_free(raw, TRUE);
+    return g_string_free(out, FALSE);
+}
+
+static void snippet_session_end(EditorApp *app) {
+    if (!app->snippet_stops) return;
+    
+    for (guint i = 0; i < app->snippet_stops->len; i++) {
+        SnippetStop *stop = &g_array_index(app->snippet_stops, SnippetStop, i);
+        gtk_text_buffer_delete_mark(GTK_TEXT_BUFFER(app->buffer), stop->start);
+        gtk_text_buffer_delete_mark(GTK_TEXT_BUFFER(app->buffer), stop->end);
+    }
+    g_array_free(app->snippet_stops, TRUE);
+    app->snippet_stops = NULL;
+}
+
+/* The cursor moved to location: a session is over once it leaves the snippet's stops */
+static void snippet_session_follow_cursor(EditorApp *app, const GtkTextIter *location) {
+    if (!app->snippet_stops) return;
+    
+    GtkTextIter first, last, iter;
+    for (guint i = 0; i < app->snippet_stops->len; i++) {
+        SnippetStop *stop = &g_array_index(app->snippet_stops, SnippetStop, i);
+        gtk_text_buffer_get_iter_at_mark(GTK_TEXT_BUFFER(app->buffer), &iter, stop->start);
+        if (i == 0 || gtk_text_iter_compare(&iter, &first) < 0) first = iter;
+        gtk_text_buffer_get_iter_at_mark(GTK_TEXT_BUFFER(app->buffer), &iter, stop->end);
+        if (i == 0 || gtk_text_iter_compare(&iter, &last) > 0) last = iter;
+    }
+    if (!gtk_text_iter_in_range(location, &first, &last) && !gtk_text_iter_equal(location, &last))
+        snippet_session_end(app);
+}
+
+/* Select tab stop number i of the active session; the last stop ends it */
+static void snippet_session_select(EditorApp *app, guint i) {
+    SnippetStop *stop = &g_array_index(app->snippet_stops, SnippetStop, i);
+    GtkTextIter start, end;
+    
+    gtk_text_buffer_get_iter_at_mark(GTK_TEXT_BUFFER(app->buffer), &start, stop->start);
+    gtk_text_buffer_get_iter_at_mark(GTK_TEXT_BUFFER(app->buffer), &end, stop->end);
+    gtk_text_buffer_select_range(GTK_TEXT_BUFFER(app->buffer), &end, &start);
+    gtk_text_view_scroll_mark_onscreen(GTK_TEXT_VIEW(app->view), stop->end);
+    app->snippet_stop = i;
+    
+    if (i + 1 == app->snippet_stops->len)
+        snippet_session_end(app);
+}
+
+/* Insert a snippet at the cursor, replacing [replace_start, cursor) if given */
+static void expand_snippet(EditorApp *app, const Snippet *snip, GtkTextIter *replace_start) {
+    GtkTextBuffer *buffer = GTK_TEXT_BUFFER(app->buffer);
+    GtkTextIter iter, line_start, indent_end;
+    
+    snippet_session_end(app);
+    gtk_text_buffer_begin_user_action(buffer);
+    
+    gtk_text_buffer_get_iter_at_mark(buffer, &iter, gtk_text_buffer_get_insert(buffer));
+    if (replace_start) {
+        gtk_text_buffer_delete(buffer, replace_start, &iter);
+        gtk_text_buffer_get_iter_at_mark(buffer, &iter, gtk_text_buffer_get_insert(buffer));
+    }
+    
+    /* Indentation of the insertion line */
+    line_start = iter;
+    gtk_text_iter_set_line_offset(&line_start, 0);
+    indent_end = line_start;
+    while (gtk_text_iter_compare(&indent_end, &iter) < 0 &&
+           (gtk_text_iter_get_char(&indent_end) == ' ' || gtk_text_iter_get_char(&indent_end) == '\t'))
+        gtk_text_iter_forward_char(&indent_end);
+    gchar *indent = gtk_text_buffer_get_text(buffer, &line_start, &indent_end, TRUE);
+    
+    GArray *specs = g_array_new(FALSE, FALSE, sizeof(SnippetStopSpec));
+    gchar *text = snippet_render(app, snip->body, indent, specs);
+    gint base = gtk_text_iter_get_offset(&iter);
+    
+    gtk_text_buffer_insert(buffer, &iter, text, -1);
+    
+    if (specs->len > 0) {
+        app->snippet_stops = g_array_sized_new(FALSE, FALSE, sizeof(SnippetStop), specs->len);
+        for (guint i = 0; i < specs->len; i++) {
+            SnippetStopSpec *spec = &g_array_index(specs, SnippetStopSpec, i);
+            GtkTextIter s, e;
+            SnippetStop stop;
+            gtk_text_buffer_get_iter_at_offset(buffer, &s, base + (gint)spec->start);
+            gtk_text_buffer_get_iter_at_offset(buffer, &e, base + (gint)spec->end);
+            stop.start = gtk_text_buffer_create_mark(buffer, NULL, &s, TRUE);
+            stop.end = gtk_text_buffer_create_mark(buffer, NULL, &e, FALSE);
+            g_array_append_val(app->snippet_stops, stop);
+        }
+        snippet_session_select(app, 0);
+    }
+    
+    gtk_text_buffer_end_user_action(buffer);
+    g_array_free(specs, TRUE);
+    g_free(text);
+    g_free(indent);
+}
+
+/* Tab after a trigger word expands it */
+static gboolean expand_trigger_at_cursor(EditorApp *app) {
+    GtkTextBuffer *buffer = GTK_TEXT_BUFFER(app->buffer);
+    GtkTextIter start, end;
+    
+    if (!app->snippets || gtk_text_buffer_get_has_selection(buffer))
+        return FALSE;
+    
+    gtk_text_buffer_get_iter_at_mark(buffer, &end, gtk_text_buffer_get_insert(buffer));
+    gunichar next = gtk_text_iter_get_char(&end);
+    if (g_unichar_isalnum(next) || next == '_')
+        return FALSE;
+    
+    start = end;
+    while (gtk_text_iter_backward_char(&start)) {
+        gunichar c = gtk_text_iter_get_char(&start);
+        if (!g_unichar_isalnum(c) && c != '_') {
+            gtk_text_iter_forward_char(&start);
+            break;
+        }
+    }
+    if (gtk_text_iter_equal(&start, &end))
+        return FALSE;
+    
+    gchar *word = gtk_text_buffer_get_text(buffer, &start, &end, TRUE);
+    const Snippet *snip = snippet_lookup(app->snippets, word);
+    g_free(word);
+    if (!snip)
+        return FALSE;
+    
+    expand_snippet(app, snip, &start);
+    return TRUE;
+}
+
+/* Tab / Shift+Tab / Escape handling for trigger expansion and tab stops */
+static gboolean on_view_key_press(GtkWidget *widget, GdkEventKey *event, gpointer data) {
+    EditorApp *app = (EditorApp *)data;
+    guint mods = event->state & gtk_accelerator_get_default_mod_mask();
+    
+    if (event->keyval == GDK_KEY_Tab && mods == 0) {
+        if (app->snippet_stops) {
+            snippet_session_select(app, app->snippet_stop + 1);
+            return TRUE;
+        }
+        return expand_trigger_at_cursor(app);
+    }
+    if (event->keyval == GDK_KEY_ISO_Left_Tab && app->snippet_stops) {
+        if (app->snippet_stop > 0)
+            snippet_session_select(app, app->snippet_stop - 1);
+        return TRUE;
+    }
+    if (event->keyval == GDK_KEY_Escape && app->snippet_stops) {
+        snippet_session_end(app);
+        return TRUE;
+    }
+    return FALSE;
+}
+
+static void on_snippet_activate(GtkMenuItem *item, gpointer data) {
+    EditorApp *app = (EditorApp *)data;
+    const Snippet *snip = g_object_get_data(G_OBJECT(item), "snippet");
+    expand_snippet(app, snip, NULL);
+}
+
+static GtkWidget *create_snippet_item(EditorApp *app, const Snippet *snip) {
+    GtkWidget *item = gtk_menu_item_new_with_label(snip->label);
+    g_object_set_data(G_OBJECT(item), "snippet", (gpointer)snip);
+    g_signal_connect(item, "activate", G_CALLBACK(on_snippet_activate), app);
+    return item;
+}
+
+/* Build the items of a snippet submenu the first time its parent item is selected */
+static void on_lazy_submenu_select(GtkMenuItem *parent, gpointer data) {
+    EditorApp *app = (EditorApp *)data;
+    GtkWidget *menu = gtk_menu_item_get_submenu(parent);
+    const gchar *name = g_object_get_data(G_OBJECT(parent), "snippet-menu");
+    
+    g_signal_handlers_disconnect_by_func(parent, G_CALLBACK(on_lazy_submenu_select), app);
+    
+    for (guint i = 0; i < app->snippets->n_items; i++) {
+        const Snippet *snip = &app->snippets->items[i];
+        if (snip->menu != name) continue;
+        if (snip->separator) {
+            GtkWidget *sep = gtk_separator_menu_item_new();
+            gtk_menu_shell_append(GTK_MENU_SHELL(menu), sep);
+            gtk_widget_show(sep);
+        }
+        GtkWidget *item = create_snippet_item(app, snip);
+        gtk_menu_shell_append(GTK_MENU_SHELL(menu), item);
+        gtk_widget_show(item);
+    }
+}
+
+static GtkWidget *create_lazy_submenu(EditorApp *app, const gchar *name) {
+    GtkWidget *item = gtk_menu_item_new_with_label(name);
+    gtk_menu_item_set_submenu(GTK_MENU_ITEM(item), gtk_menu_new());
+    g_object_set_data(G_OBJECT(item), "snippet-menu", (gpointer)name);
+    g_signal_connect(item, "select", G_CALLBACK(on_lazy_submenu_select), app);
+    return item;
+}
+
+/* Insert menu generated from the snippet table: top level items, then one submenu per menu name */
+static void build_insert_menu(EditorApp *app, GtkWidget *insert_menu) {
+    SnippetTable *table = app->snippets;
+    GPtrArray *menus = g_ptr_array_new();
+    gboolean has_top = FALSE;
+    
+    if (!table || table->n_items == 0) {
+        GtkWidget *empty = gtk_menu_item_new_with_label("No snippets (snippets.conf not found)");
+        gtk_widget_set_sensitive(empty, FALSE);
+        gtk_menu_shell_append(GTK_MENU_SHELL(insert_menu), empty);
+        g_ptr_array_free(menus, TRUE);
+        return;
+    }
+    
+    for (guint i = 0; i < table->n_items; i++) {
+        const Snippet *snip = &table->items[i];
+        if (!snip->menu) {
+            gtk_menu_shell_append(GTK_MENU_SHELL(insert_menu), create_snippet_item(app, snip));
+            has_top = TRUE;
+        } else if (!g_ptr_array_find(menus, snip->menu, NULL)) {
+            g_ptr_array_add(menus, (gpointer)snip->menu);
+        }
+    }
+    if (has_top && menus->len > 0)
+        gtk_menu_shell_append(GTK_MENU_SHELL(insert_menu), gtk_separator_menu_item_new());
+    
+    for (guint i = 0; i < menus->len; i++)
+        gtk_menu_shell_append(GTK_MENU_SHELL(insert_menu),
+                              create_lazy_submenu(app, g_ptr_array_index(menus, i)));
+    g_ptr_array_free(menus, TRUE);
+}
 
-    gtk_style_context_add_provider_for_screen(gdk_screen_get_default(),
-                                             GTK_STYLE_PROVIDER(css),
-                                             GTK_STYLE_PROVIDER_PRIORITY_APPLICATION);
-    gtk_css_provider_load_from_data(css, data, -1, NULL);
-    return css;
+/*
+ * Command palette (Ctrl+Shift+P)
+ * Every menu item is indexed once after the first paint. Each entry keeps its
+ * lowercased label and a 64-bit mask of the characters in it, so most entries
+ * are rejected with one AND before the subsequence scorer runs.
+ * "@name" searches the functions listed in the Symbols sidebar.
+ */
+#define PALETTE_MAX_RESULTS 50
+
+static guint64 palette_char_bit(guchar c) {
+    if (c >= 'a' && c <= 'z') return G_GUINT64_CONSTANT(1) << (c - 'a');
+    if (c >= '0' && c <= '9') return G_GUINT64_CONSTANT(1) << (26 + c - '0');
+    return G_GUINT64_CONSTANT(1) << (36 + c % 28);
 }
 
-static void insert_at_cursor(EditorApp *app, const gchar *text) {
-    GtkTextIter iter;
-    gtk_text_buffer_get_iter_at_mark(GTK_TEXT_BUFFER(app->buffer), &iter,
-                                     gtk_text_buffer_get_insert(GTK_TEXT_BUFFER(app->buffer)));
-    gtk_text_buffer_insert(GTK_TEXT_BUFFER(app->buffer), &iter, text, -1);
+static guint64 palette_mask(const gchar *folded) {
+    guint64 mask = 0;
+    for (const guchar *p = (const guchar *)folded; *p; p++)
+        if (*p != ' ') mask |= palette_char_bit(*p);
+    return mask;
 }
 
-static void on_theme_change(GtkCheckMenuItem *item, gpointer data) {
-    EditorApp *app = (EditorApp *)data;
-    if (gtk_check_menu_item_get_active(item)) {
-        const gchar *label = gtk_menu_item_get_label(GTK_MENU_ITEM(item));
+static void palette_entry_init(PaletteEntry *entry, const gchar *label, const gchar *match) {
+    entry->label = g_strdup(label);
+    entry->folded = g_ascii_strdown(match, -1);
+    entry->mask = palette_mask(entry->folded);
+}
+
+static void palette_entry_clear(gpointer data) {
+    PaletteEntry *entry = (PaletteEntry *)data;
+    g_free(entry->label);
+    g_free(entry->folded);
+}
+
+/*
+ * Subsequence score of query (lowercase, spaces ignored) in text, -1 if
+ * some character is missing. Matches at the start of a word and runs of
+ * consecutive characters score higher, gaps cost a little.
+ */
+static gint palette_score(const gchar *text, const gchar *query) {
+    gint score = 0;
+    gint last = -2;
+    gint i = 0;
+    
+    for (const gchar *q = query; *q; q++) {
+        if (*q == ' ') continue;
+        while (text[i] && text[i] != *q) i++;
+        if (!text[i]) return -1;
         
-        if (g_strcmp0(label, "Light") == 0) app->theme_mode = 0;
-        else if (g_strcmp0(label, "Dark") == 0) app->theme_mode = 1;
-        else if (g_strcmp0(label, "Matrix Green") == 0) app->theme_mode = 2;
+        score += 1;
+        if (i == 0) score += 10;
+        else if (!g_ascii_isalnum(text[i - 1])) score += 8;
+        if (i == last + 1) score += 5;
+        else if (last >= 0) score -= MIN(i - last - 1, 5);
+        last = i++;
+    }
+    return score;
+}
+
+/* Strip mnemonic underscores from a menu item's label */
+static gchar *menu_item_plain_label(GtkWidget *item) {
+    const gchar *label = gtk_menu_item_get_label(GTK_MENU_ITEM(item));
+    if (!label) return NULL;
+    if (!gtk_menu_item_get_use_underline(GTK_MENU_ITEM(item))) return g_strdup(label);
+    
+    GString *plain = g_string_new(NULL);
+    for (const gchar *p = label; *p; p++) {
+        if (*p == '_' && p[1] != '_') continue;
+        if (*p == '_') p++;
+        g_string_append_c(plain, *p);
+    }
+    return g_string_free(plain, FALSE);
+}
+
+static void index_menu_shell(EditorApp *app, GtkWidget *shell, const gchar *path) {
+    GList *children = gtk_container_get_children(GTK_CONTAINER(shell));
+    
+    for (GList *l = children; l; l = l->next) {
+        GtkWidget *item = l->data;
+        if (!GTK_IS_MENU_ITEM(item) || GTK_IS_SEPARATOR_MENU_ITEM(item)) continue;
         
-        apply_theme(app);
+        gchar *label = menu_item_plain_label(item);
+        if (!label || !*label) {
+            g_free(label);
+            continue;
+        }
+        gchar *full = path ? g_strdup_printf("%s > %s", path, label) : g_strdup(label);
+        const gchar *snippet_menu = g_object_get_data(G_OBJECT(item), "snippet-menu");
+        GtkWidget *submenu = gtk_menu_item_get_submenu(GTK_MENU_ITEM(item));
+        
+        if (snippet_menu) {
+            /* Index the snippets directly so the submenu stays unbuilt */
+            for (guint i = 0; i < app->snippets->n_items; i++) {
+                const Snippet *snip = &app->snippets->items[i];
+                if (snip->menu != snippet_menu) continue;
+                gchar *entry_label = g_strdup_printf("%s > %s", full, snip->label);
+                PaletteEntry entry = { 0 };
+                palette_entry_init(&entry, entry_label, entry_label);
+                entry.snippet = snip;
+                g_array_append_val(app->commands, entry);
+                g_free(entry_label);
+            }
+        } else if (submenu) {
+            index_menu_shell(app, submenu, full);
+        } else if (g_object_get_data(G_OBJECT(item), "command-palette") == NULL) {
+            PaletteEntry entry = { 0 };
+            palette_entry_init(&entry, full, full);
+            entry.item = item;
+            g_array_append_val(app->commands, entry);
+        }
+        g_free(full);
+        g_free(label);
     }
+    g_list_free(children);
 }
 
-static void on_insert_time(GtkWidget *widget, gpointer data) {
+static gboolean build_command_index(gpointer data) {
     EditorApp *app = (EditorApp *)data;
-    time_t now = time(NULL);
-    struct tm *t = localtime(&now);
-    char buf[64];
-    strftime(buf, sizeof(buf), "%H:%M:%S", t);
-    insert_at_cursor(app, buf);
+    gint64 t0 = g_get_monotonic_time();
+    
+    if (app->commands) return G_SOURCE_REMOVE;
+    TRACE_BEGIN("idle: build_command_index");
+    app->commands = g_array_new(FALSE, TRUE, sizeof(PaletteEntry));
+    g_array_set_clear_func(app->commands, palette_entry_clear);
+    index_menu_shell(app, app->menubar, NULL);
+    TRACE_END("idle: build_command_index");
+    
+    if (app->startup_stats)
+        g_print("Command palette: indexed %u actions in %.2f ms\n", app->commands->len,
+                (g_get_monotonic_time() - t0) / 1000.0);
+    return G_SOURCE_REMOVE;
 }
 
-static void on_insert_date(GtkWidget *widget, gpointer data) {
-    EditorApp *app = (EditorApp *)data;
-    time_t now = time(NULL);
-    struct tm *t = localtime(&now);
-    char buf[64];
-    strftime(buf, sizeof(buf), "%Y-%m-%d", t);
-    insert_at_cursor(app, buf);
+/* "@" entries: function names from the Symbols sidebar */
+static GArray *collect_symbol_entries(EditorApp *app) {
+    GArray *symbols = g_array_new(FALSE, TRUE, sizeof(PaletteEntry));
+    GtkTreeModel *model = GTK_TREE_MODEL(app->tree_store);
+    GtkTreeIter group, child;
+    
+    g_array_set_clear_func(symbols, palette_entry_clear);
+    if (!gtk_tree_model_get_iter_first(model, &group)) return symbols;
+    
+    do {
+        if (!gtk_tree_model_iter_children(model, &child, &group)) continue;
+        do {
+            gchar *text;
+            gint line;
+            gtk_tree_model_get(model, &child, COL_NAME, &text, COL_LINE, &line, -1);
+            
+            /* Name is the identifier right before the first '(' */
+            const gchar *paren = strchr(text, '(');
+            const gchar *end = paren ? paren : text + strlen(text);
+            while (end > text && g_ascii_isspace(end[-1])) end--;
+            const gchar *start = end;
+            while (start > text && (g_ascii_isalnum(start[-1]) || start[-1] == '_')) start--;
+            
+            if (end > start) {
+                gchar *name = g_strndup(start, end - start);
+                gchar *label = g_strdup_printf("@%s    line %d", name, line);
+                PaletteEntry entry = { 0 };
+                palette_entry_init(&entry, label, name);
+                entry.line = line;
+                g_array_append_val(symbols, entry);
+                g_free(label);
+                g_free(name);
+            }
+            g_free(text);
+        } while (gtk_tree_model_iter_next(model, &child));
+    } while (gtk_tree_model_iter_next(model, &group));
+    
+    return symbols;
 }
 
-static void on_toggle_dark_mode(GtkCheckMenuItem *item, gpointer data) {
-    EditorApp *app = data;
-    app->dark_mode = gtk_check_menu_item_get_active(item);
-    apply_theme(app);
-    // Refresh the gutter explicitly (helps stop line bug in on_tree_selection_changed) 
-    gtk_source_view_set_show_line_numbers(GTK_SOURCE_VIEW(app->view), TRUE);
+typedef struct {
+    PaletteEntry *entry;
+    gint score;
+} PaletteMatch;
+
+static gint compare_palette_matches(gconstpointer a, gconstpointer b) {
+    const PaletteMatch *ma = a, *mb = b;
+    if (ma->score != mb->score) return mb->score - ma->score;
+    return strcmp(ma->entry->label, mb->entry->label);
 }
 
-static void on_insert_datetime(GtkWidget *widget, gpointer data) {
-    EditorApp *app = (EditorApp *)data;
-    time_t now = time(NULL);
-    struct tm *t = localtime(&now);
-    char buf[128];
-    strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", t);
-    insert_at_cursor(app, buf);
+typedef struct {
+    EditorApp *app;
+    GtkWidget *dialog;
+    GtkWidget *tree;
+    GtkListStore *store;
+    GArray *symbols;
+} PaletteDialog;
+
+static void palette_refilter(GtkSearchEntry *search, gpointer data) {
+    PaletteDialog *pd = (PaletteDialog *)data;
+    const gchar *text = gtk_entry_get_text(GTK_ENTRY(search));
+    GArray *source = pd->app->commands;
+    
+    if (text[0] == '@') {
+        source = pd->symbols;
+        text++;
+    }
+    
+    gchar *query = g_ascii_strdown(text, -1);
+    guint64 qmask = palette_mask(query);
+    GArray *matches = g_array_new(FALSE, FALSE, sizeof(PaletteMatch));
+    
+    for (guint i = 0; i < source->len; i++) {
+        PaletteEntry *entry = &g_array_index(source, PaletteEntry, i);
+        if ((entry->mask & qmask) != qmask) continue;
+        PaletteMatch match = { entry, palette_score(entry->folded, query) };
+        if (match.score >= 0) g_array_append_val(matches, match);
+    }
+    g_array_sort(matches, compare_palette_matches);
+    
+    gtk_list_store_clear(pd->store);
+    for (guint i = 0; i < matches->len && i < PALETTE_MAX_RESULTS; i++) {
+        PaletteMatch *match = &g_array_index(matches, PaletteMatch, i);
+        gtk_list_store_insert_with_values(pd->store, NULL, -1,
+                                          0, match->entry->label, 1, match->entry, -1);
+    }
+    
+    GtkTreePath *first = gtk_tree_path_new_first();
+    if (matches->len > 0)
+        gtk_tree_view_set_cursor(GTK_TREE_VIEW(pd->tree), first, NULL, FALSE);
+    gtk_tree_path_free(first);
+    g_array_free(matches, TRUE);
+    g_free(query);
 }
 
-static void on_insert_header_comment(GtkWidget *widget, gpointer data) {
-    EditorApp *app = (EditorApp *)data;
-    time_t now = time(NULL);
-    struct tm *t = localtime(&now);
-    char date_buf[64];
-    strftime(date_buf, sizeof(date_buf), "%Y-%m-%d", t);
+static void palette_accept(GtkWidget *widget, gpointer data) {
+    PaletteDialog *pd = (PaletteDialog *)data;
+    gtk_dialog_response(GTK_DIALOG(pd->dialog), GTK_RESPONSE_ACCEPT);
+}
+
+static void palette_row_activated(GtkTreeView *tree_view, GtkTreePath *path,
+                                  GtkTreeViewColumn *column, gpointer data) {
+    palette_accept(GTK_WIDGET(tree_view), data);
+}
+
+/* Up/Down in the entry move the selection in the result list */
+static gboolean palette_entry_key_press(GtkWidget *widget, GdkEventKey *event, gpointer data) {
+    PaletteDialog *pd = (PaletteDialog *)data;
+    GtkTreePath *path = NULL;
+    
+    if (event->keyval != GDK_KEY_Down && event->keyval != GDK_KEY_Up)
+        return FALSE;
     
-    char buf[512];
-    snprintf(buf, sizeof(buf),
-        "/*\n"
-        " * File: %s\n"
-        " * Author: \n"
-        " * Date: %s\n"
-        " * Description: \n"
-        " */\n\n",
-        app->current_file ? g_path_get_basename(app->current_file) : "untitled.c",
-        date_buf);
+    gtk_tree_view_get_cursor(GTK_TREE_VIEW(pd->tree), &path, NULL);
+    if (!path) return TRUE;
     
-    insert_at_cursor(app, buf);
+    if (event->keyval == GDK_KEY_Down) gtk_tree_path_next(path);
+    else gtk_tree_path_prev(path);
+    
+    GtkTreeIter iter;
+    if (gtk_tree_model_get_iter(GTK_TREE_MODEL(pd->store), &iter, path))
+        gtk_tree_view_set_cursor(GTK_TREE_VIEW(pd->tree), path, NULL, FALSE);
+    gtk_tree_path_free(path);
+    return TRUE;
 }
 
-static void on_insert_function_comment(GtkWidget *widget, gpointer data) {
-    EditorApp *app = (EditorApp *)data;
-    const char *comment = 
-        "/*\n"
-        " * Function: \n"
-        " * Description: \n"
-        " * Parameters: \n"
-        " * Returns: \n"
-        " */\n";
-    insert_at_cursor(app, comment);
+/* Run a palette entry; recorded by its label, which is how replay finds it */
+static void palette_entry_run(EditorApp *app, const PaletteEntry *entry) {
+    if (entry->line > 0) record_action(app, "goto %d", entry->line);
+    else record_action(app, "menu %s", entry->label);
+    
+    app->record_muted = TRUE;
+    if (entry->item) gtk_menu_item_activate(GTK_MENU_ITEM(entry->item));
+    else if (entry->snippet) expand_snippet(app, entry->snippet, NULL);
+    else if (entry->line > 0) jump_to_line(app, entry->line);
+    app->record_muted = FALSE;
 }
 
-static void on_insert_main(GtkWidget *widget, gpointer data) {
+static void on_command_palette(GtkWidget *widget, gpointer data) {
     EditorApp *app = (EditorApp *)data;
-    const char *code = 
-        "int main(int argc, char *argv[]) {\n"
-        "    \n"
-        "    return 0;\n"
-        "}\n";
-    insert_at_cursor(app, code);
+    PaletteDialog pd = { app };
+    
+    build_command_index(app);
+    pd.symbols = collect_symbol_entries(app);
+    
+    pd.dialog = gtk_dialog_new_with_buttons("Command Palette",
+                                            GTK_WINDOW(app->window),
+                                            GTK_DIALOG_MODAL | GTK_DIALOG_DESTROY_WITH_PARENT,
+                                            NULL);
+    gtk_window_set_default_size(GTK_WINDOW(pd.dialog), 500, 360);
+    GtkWidget *content_area = gtk_dialog_get_content_area(GTK_DIALOG(pd.dialog));
+    
+    GtkWidget *entry = gtk_search_entry_new();
+    gtk_entry_set_placeholder_text(GTK_ENTRY(entry), "Type a command, or @ for a function");
+    gtk_box_pack_start(GTK_BOX(content_area), entry, FALSE, FALSE, 0);
+    
+    pd.store = gtk_list_store_new(2, G_TYPE_STRING, G_TYPE_POINTER);
+    pd.tree = gtk_tree_view_new_with_model(GTK_TREE_MODEL(pd.store));
+    gtk_tree_view_set_headers_visible(GTK_TREE_VIEW(pd.tree), FALSE);
+    gtk_tree_view_append_column(GTK_TREE_VIEW(pd.tree),
+        gtk_tree_view_column_new_with_attributes("Command", gtk_cell_renderer_text_new(), "text", 0, NULL));
+    
+    GtkWidget *scroll = gtk_scrolled_window_new(NULL, NULL);
+    gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(scroll), GTK_POLICY_NEVER, GTK_POLICY_AUTOMATIC);
+    gtk_container_add(GTK_CONTAINER(scroll), pd.tree);
+    gtk_box_pack_start(GTK_BOX(content_area), scroll, TRUE, TRUE, 0);
+    
+    g_signal_connect(entry, "search-changed", G_CALLBACK(palette_refilter), &pd);
+    g_signal_connect(entry, "activate", G_CALLBACK(palette_accept), &pd);
+    g_signal_connect(entry, "key-press-event", G_CALLBACK(palette_entry_key_press), &pd);
+    g_signal_connect(pd.tree, "row-activated", G_CALLBACK(palette_row_activated), &pd);
+    
+    palette_refilter(GTK_SEARCH_ENTRY(entry), &pd);
+    gtk_widget_show_all(content_area);
+    
+    PaletteEntry chosen = { 0 };
+    if (gtk_dialog_run(GTK_DIALOG(pd.dialog)) == GTK_RESPONSE_ACCEPT) {
+        GtkTreeSelection *selection = gtk_tree_view_get_selection(GTK_TREE_VIEW(pd.tree));
+        GtkTreeModel *model;
+        GtkTreeIter iter;
+        if (gtk_tree_selection_get_selected(selection, &model, &iter)) {
+            PaletteEntry *entry_ptr;
+            gtk_tree_model_get(model, &iter, 1, &entry_ptr, -1);
+            chosen = *entry_ptr;
+        }
+    }
+    gtk_widget_destroy(pd.dialog);
+    
+    /* Act once the dialog is gone so dialogs opened by the command are not nested */
+    if (chosen.label) palette_entry_run(app, &chosen);
+    
+    g_array_free(pd.symbols, TRUE);
+    g_object_unref(pd.store);
 }
 
-static void on_insert_for_loop(GtkWidget *widget, gpointer data) {
-    EditorApp *app = (EditorApp *)data;
-    const char *code = "for (int i = 0; i < n; i++) {\n    \n}\n";
-    insert_at_cursor(app, code);
+/*
+ * File tree
+ * The Files page of the sidebar. Directories are listed only when first
+ * expanded, with GFileEnumerator requests of FILE_TREE_BATCH entries
+ * answered on the main loop, so a directory of any size never blocks it:
+ * rows appear batch by batch under a "Loading..." placeholder. The store
+ * is wrapped in a GtkTreeModelSort (directories first, then by name), so
+ * batches need no sorting of their own. Hidden entries are not shown.
+ */
+#define FILE_TREE_BATCH 256
+#define FILE_TREE_ATTRIBUTES "standard::name,standard::type,standard::is-hidden"
+
+enum {
+    FILE_COL_NAME = 0,
+    FILE_COL_PATH,            /* NULL for the placeholder */
+    FILE_COL_IS_DIR,
+    FILE_COL_LISTED,          /* directory listing started */
+    FILE_NUM_COLS
+};
+
+typedef struct FileTree {
+    gchar *root;              /* NULL until a file or folder is opened */
+    GtkTreeStore *store;
+    GtkTreeModel *sorted;
+    GtkWidget *view;
+    GCancellable *cancel;     /* every listing under root */
+} FileTree;
+
+typedef struct {
+    EditorApp *app;
+    GtkTreeRowReference *row; /* the directory's row, NULL for the root */
+    GCancellable *cancel;
+} FileListing;
+
+static void quick_open_set_root(EditorApp *app, const gchar *root);
+
+static void file_listing_free(FileListing *listing) {
+    if (listing->row) gtk_tree_row_reference_free(listing->row);
+    g_object_unref(listing->cancel);
+    g_free(listing);
+}
+
+/* The listed directory's row in the store; FALSE if it is gone (or is the root) */
+static gboolean file_listing_parent(FileListing *listing, GtkTreeIter *parent) {
+    if (!listing->row || !gtk_tree_row_reference_valid(listing->row)) return FALSE;
+    GtkTreePath *path = gtk_tree_row_reference_get_path(listing->row);
+    gboolean ok = gtk_tree_model_get_iter(GTK_TREE_MODEL(listing->app->files->store), parent, path);
+    gtk_tree_path_free(path);
+    return ok;
+}
+
+static void file_tree_append(GtkTreeStore *store, GtkTreeIter *parent, const gchar *name,
+                             const gchar *path, gboolean is_dir) {
+    GtkTreeIter iter, placeholder;
+
+    gtk_tree_store_insert_with_values(store, &iter, parent, -1, FILE_COL_NAME, name, FILE_COL_PATH, path,
+                                      FILE_COL_IS_DIR, is_dir, FILE_COL_LISTED, FALSE, -1);
+    /* Gives the directory an expander before it is listed */
+    if (is_dir)
+        gtk_tree_store_insert_with_values(store, &placeholder, &iter, -1, FILE_COL_NAME, "Loading...",
+                                          FILE_COL_PATH, NULL, FILE_COL_IS_DIR, FALSE, -1);
+}
+
+static void on_file_tree_batch(GObject *source, GAsyncResult *result, gpointer data) {
+    GFileEnumerator *enumerator = G_FILE_ENUMERATOR(source);
+    FileListing *listing = data;
+    FileTree *tree = listing->app->files;
+    GtkTreeIter parent, child;
+    GList *infos = g_file_enumerator_next_files_finish(enumerator, result, NULL);
+    gboolean has_parent = file_listing_parent(listing, &parent);
+
+    if (g_cancellable_is_cancelled(listing->cancel) || (listing->row && !has_parent)) {
+        g_list_free_full(infos, g_object_unref);
+        g_object_unref(enumerator);
+        file_listing_free(listing);
+        return;
+    }
+
+    GFile *dir = g_file_enumerator_get_container(enumerator);
+    for (GList *l = infos; l; l = l->next) {
+        GFileInfo *info = l->data;
+        if (g_file_info_get_is_hidden(info)) continue;
+        const gchar *name = g_file_info_get_name(info);
+        GFile *file = g_file_get_child(dir, name);
+        gchar *path = g_file_get_path(file);
+        gchar *display = g_filename_display_name(name);
+        file_tree_append(tree->store, has_parent ? &parent : NULL, display, path,
+                         g_file_info_get_file_type(info) == G_FILE_TYPE_DIRECTORY);
+        g_free(display);
+        g_free(path);
+        g_object_unref(file);
+    }
+
+    if (infos) {
+        g_list_free_full(infos, g_object_unref);
+        g_file_enumerator_next_files_async(enumerator, FILE_TREE_BATCH, G_PRIORITY_LOW, listing->cancel,
+                                           on_file_tree_batch, listing);
+        return;
+    }
+
+    /* Done (or failed): the placeholder goes, sorted first as it has no path */
+    if (has_parent && gtk_tree_model_iter_children(GTK_TREE_MODEL(tree->store), &child, &parent)) {
+        do {
+            gchar *path;
+            gtk_tree_model_get(GTK_TREE_MODEL(tree->store), &child, FILE_COL_PATH, &path, -1);
+            if (!path) {
+                gtk_tree_store_remove(tree->store, &child);
+                break;
+            }
+            g_free(path);
+        } while (gtk_tree_model_iter_next(GTK_TREE_MODEL(tree->store), &child));
+    }
+    g_object_unref(enumerator);
+    file_listing_free(listing);
+}
+
+static void on_file_tree_enumerated(GObject *source, GAsyncResult *result, gpointer data) {
+    FileListing *listing = data;
+    GFileEnumerator *enumerator = g_file_enumerate_children_finish(G_FILE(source), result, NULL);
+
+    if (!enumerator) {
+        file_listing_free(listing);
+        return;
+    }
+    g_file_enumerator_next_files_async(enumerator, FILE_TREE_BATCH, G_PRIORITY_LOW, listing->cancel,
+                                       on_file_tree_batch, listing);
+}
+
+/* List a directory under parent (a store row), or the root if parent is NULL */
+static void file_tree_list(EditorApp *app, GtkTreeIter *parent, const gchar *path) {
+    FileTree *tree = app->files;
+    FileListing *listing = g_new0(FileListing, 1);
+    GFile *dir = g_file_new_for_path(path);
+
+    listing->app = app;
+    listing->cancel = g_object_ref(tree->cancel);
+    if (parent) {
+        GtkTreePath *row = gtk_tree_model_get_path(GTK_TREE_MODEL(tree->store), parent);
+        listing->row = gtk_tree_row_reference_new(GTK_TREE_MODEL(tree->store), row);
+        gtk_tree_path_free(row);
+        gtk_tree_store_set(tree->store, parent, FILE_COL_LISTED, TRUE, -1);
+    }
+    g_file_enumerate_children_async(dir, FILE_TREE_ATTRIBUTES, G_FILE_QUERY_INFO_NONE, G_PRIORITY_LOW,
+                                    listing->cancel, on_file_tree_enumerated, listing);
+    g_object_unref(dir);
+}
+
+/* Show the tree of a directory; quick open searches it too */
+static void file_tree_set_root(EditorApp *app, const gchar *root) {
+    FileTree *tree = app->files;
+
+    if (g_strcmp0(tree->root, root) == 0) return;
+    g_free(tree->root);
+    tree->root = g_strdup(root);
+    g_cancellable_cancel(tree->cancel);
+    g_object_unref(tree->cancel);
+    tree->cancel = g_cancellable_new();
+    gtk_tree_store_clear(tree->store);
+    file_tree_list(app, NULL, root);
+    quick_open_set_root(app, root);
+}
+
+/* The first file opened roots the tree in its directory, unless a folder was opened */
+static void file_tree_open_file(EditorApp *app, const gchar *filename) {
+    if (app->files->root) return;
+    gchar *dir = g_path_get_dirname(filename);
+    file_tree_set_root(app, dir);
+    g_free(dir);
+}
+
+/* The root for quick open and the Files page when nothing set one: the current directory */
+static void file_tree_ensure_root(EditorApp *app) {
+    if (app->files->root) return;
+    gchar *cwd = g_get_current_dir();
+    file_tree_set_root(app, cwd);
+    g_free(cwd);
 }
 
-static void on_insert_while_loop(GtkWidget *widget, gpointer data) {
+static void on_file_tree_expanded(GtkTreeView *view, GtkTreeIter *iter, GtkTreePath *path, gpointer data) {
     EditorApp *app = (EditorApp *)data;
-    const char *code = "while (condition) {\n    \n}\n";
-    insert_at_cursor(app, code);
+    FileTree *tree = app->files;
+    GtkTreeIter child;
+    gboolean listed;
+    gchar *dir;
+
+    gtk_tree_model_sort_convert_iter_to_child_iter(GTK_TREE_MODEL_SORT(tree->sorted), &child, iter);
+    gtk_tree_model_get(GTK_TREE_MODEL(tree->store), &child, FILE_COL_PATH, &dir, FILE_COL_LISTED, &listed, -1);
+    if (dir && !listed) file_tree_list(app, &child, dir);
+    g_free(dir);
 }
 
-static void on_insert_if_else(GtkWidget *widget, gpointer data) {
+static void on_file_tree_activated(GtkTreeView *view, GtkTreePath *path, GtkTreeViewColumn *column,
+                                   gpointer data) {
     EditorApp *app = (EditorApp *)data;
-    const char *code = "if (condition) {\n    \n} else {\n    \n}\n";
-    insert_at_cursor(app, code);
+    GtkTreeModel *model = gtk_tree_view_get_model(view);
+    GtkTreeIter iter;
+    gchar *file;
+    gboolean is_dir;
+
+    if (!gtk_tree_model_get_iter(model, &iter, path)) return;
+    gtk_tree_model_get(model, &iter, FILE_COL_PATH, &file, FILE_COL_IS_DIR, &is_dir, -1);
+    if (is_dir) {
+        if (gtk_tree_view_row_expanded(view, path)) gtk_tree_view_collapse_row(view, path);
+        else gtk_tree_view_expand_row(view, path, FALSE);
+    } else if (file && !load_file(app, file)) {
+        g_print("Could not open %s\n", file);
+    }
+    g_free(file);
+}
+
+static gint compare_file_rows(GtkTreeModel *model, GtkTreeIter *a, GtkTreeIter *b, gpointer data) {
+    gchar *name_a, *name_b, *path_a, *path_b;
+    gboolean dir_a, dir_b;
+    gint result;
+
+    gtk_tree_model_get(model, a, FILE_COL_NAME, &name_a, FILE_COL_PATH, &path_a, FILE_COL_IS_DIR, &dir_a, -1);
+    gtk_tree_model_get(model, b, FILE_COL_NAME, &name_b, FILE_COL_PATH, &path_b, FILE_COL_IS_DIR, &dir_b, -1);
+    if (!path_a || !path_b) result = (path_a != NULL) - (path_b != NULL);
+    else if (dir_a != dir_b) result = dir_a ? -1 : 1;
+    else result = g_utf8_collate(name_a, name_b);
+    g_free(name_a);
+    g_free(name_b);
+    g_free(path_a);
+    g_free(path_b);
+    return result;
 }
 
-static void on_insert_switch(GtkWidget *widget, gpointer data) {
+static void on_sidebar_page(GtkNotebook *notebook, GtkWidget *page, guint number, gpointer data) {
     EditorApp *app = (EditorApp *)data;
-    const char *code = 
-        "switch (variable) {\n"
-        "    case value1:\n"
-        "        break;\n"
-        "    case value2:\n"
-        "        break;\n"
-        "    default:\n"
-        "        break;\n"
-        "}\n";
-    insert_at_cursor(app, code);
+    if (page == gtk_widget_get_parent(app->files->view)) file_tree_ensure_root(app);
+}
+
+/* The Files page of the sidebar */
+static GtkWidget *setup_file_tree(EditorApp *app) {
+    FileTree *tree = g_new0(FileTree, 1);
+
+    app->files = tree;
+    tree->cancel = g_cancellable_new();
+    tree->store = gtk_tree_store_new(FILE_NUM_COLS, G_TYPE_STRING, G_TYPE_STRING, G_TYPE_BOOLEAN, G_TYPE_BOOLEAN);
+    tree->sorted = gtk_tree_model_sort_new_with_model(GTK_TREE_MODEL(tree->store));
+    gtk_tree_sortable_set_default_sort_func(GTK_TREE_SORTABLE(tree->sorted), compare_file_rows, NULL, NULL);
+    gtk_tree_sortable_set_sort_column_id(GTK_TREE_SORTABLE(tree->sorted),
+                                         GTK_TREE_SORTABLE_DEFAULT_SORT_COLUMN_ID, GTK_SORT_ASCENDING);
+
+    tree->view = gtk_tree_view_new_with_model(tree->sorted);
+    gtk_tree_view_set_headers_visible(GTK_TREE_VIEW(tree->view), FALSE);
+    gtk_tree_view_set_enable_search(GTK_TREE_VIEW(tree->view), TRUE);
+    gtk_tree_view_set_search_column(GTK_TREE_VIEW(tree->view), FILE_COL_NAME);
+    gtk_tree_view_append_column(GTK_TREE_VIEW(tree->view),
+        gtk_tree_view_column_new_with_attributes("Files", gtk_cell_renderer_text_new(),
+                                                 "text", FILE_COL_NAME, NULL));
+    g_signal_connect(tree->view, "row-expanded", G_CALLBACK(on_file_tree_expanded), app);
+    g_signal_connect(tree->view, "row-activated", G_CALLBACK(on_file_tree_activated), app);
+
+    GtkWidget *scroll = gtk_scrolled_window_new(NULL, NULL);
+    gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(scroll), GTK_POLICY_AUTOMATIC, GTK_POLICY_AUTOMATIC);
+    gtk_container_add(GTK_CONTAINER(scroll), tree->view);
+    return scroll;
 }
 
-static void on_insert_struct(GtkWidget *widget, gpointer data) {
+static void on_open_folder(GtkWidget *widget, gpointer data) {
     EditorApp *app = (EditorApp *)data;
-    const char *code = 
-        "typedef struct {\n"
-        "    \n"
-        "} name_t;\n";
-    insert_at_cursor(app, code);
+    GtkWidget *dialog = gtk_file_chooser_dialog_new("Open Folder", GTK_WINDOW(app->window),
+                                                    GTK_FILE_CHOOSER_ACTION_SELECT_FOLDER,
+                                                    "_Cancel", GTK_RESPONSE_CANCEL,
+                                                    "_Open", GTK_RESPONSE_ACCEPT, NULL);
+
+    if (gtk_dialog_run(GTK_DIALOG(dialog)) == GTK_RESPONSE_ACCEPT) {
+        gchar *folder = gtk_file_chooser_get_filename(GTK_FILE_CHOOSER(dialog));
+        file_tree_set_root(app, folder);
+        gtk_notebook_set_current_page(GTK_NOTEBOOK(app->sidebar),
+                                      gtk_notebook_page_num(GTK_NOTEBOOK(app->sidebar),
+                                                            gtk_widget_get_parent(app->files->view)));
+        gtk_widget_show(app->sidebar);
+        g_free(folder);
+    }
+    gtk_widget_destroy(dialog);
 }
 
-static void on_comment_selection(GtkWidget *widget, gpointer data) {
+/*
+ * Quick open (Ctrl+P)
+ * Every file under the tree's root, collected once by the same kind of
+ * batched enumeration, one directory at a time, and kept in memory with
+ * the lowercased path and character mask the command palette uses. Each
+ * keystroke ranks the list with palette_score in chunks on a thread pool
+ * and waits for them, which stays well inside a frame for a few hundred
+ * thousand paths; when the query only grew, only the previous matches and
+ * paths found since are ranked again. A match in the file name beats one
+ * spread over the directories.
+ */
+#define QUICK_OPEN_MAX_PATHS   500000
+#define QUICK_OPEN_MAX_RESULTS 50
+#define QUICK_OPEN_CHUNK       8192     /* paths per thread pool job */
+
+typedef struct {
+    const gchar *path;        /* relative to the root */
+    const gchar *folded;      /* lowercase path */
+    guint64 mask;             /* palette_mask of folded */
+    guint len;
+    guint base;               /* offset of the file name */
+} QuickPath;
+
+typedef struct {
+    guint index;
+    gint score;
+} QuickMatch;
+
+typedef struct QuickOpen {
+    gchar *root;
+    GStringChunk *strings;
+    GArray *paths;            /* QuickPath */
+    GQueue dirs;              /* relative directories still to list */
+    GCancellable *crawl;
+    gboolean crawling;
+    gint64 crawl_started;
+    GThreadPool *pool;
+    GMutex lock;
+    GCond done;
+    gint remaining;           /* jobs of the ranking in progress */
+    gchar *last_query;        /* what candidates matched */
+    GArray *candidates;       /* guint, indexes matching last_query */
+    guint ranked;             /* paths->len when candidates were found */
+    GtkWidget *dialog;        /* while open */
+    GtkWidget *entry;
+    GtkWidget *tree;
+    GtkListStore *store;
+    guint refresh;            /* timeout ranking paths found while the dialog is open */
+} QuickOpen;
+
+typedef struct {
+    QuickOpen *quick;
+    const guint *indexes;     /* candidates, or NULL for paths[begin, end) */
+    guint begin, end;
+    const gchar *query;
+    guint64 mask;
+    GArray *matches;          /* guint, every matching index */
+    GArray *best;             /* QuickMatch, the best QUICK_OPEN_MAX_RESULTS, best first */
+} QuickJob;
+
+static void quick_crawl_next(EditorApp *app);
+
+static void quick_open_reset(QuickOpen *quick) {
+    g_free(quick->last_query);
+    quick->last_query = NULL;
+    g_array_set_size(quick->candidates, 0);
+    quick->ranked = 0;
+}
+
+static void quick_add_path(QuickOpen *quick, const gchar *relative) {
+    QuickPath entry;
+    gchar *folded = g_ascii_strdown(relative, -1);
+    const gchar *slash = strrchr(relative, G_DIR_SEPARATOR);
+
+    entry.path = g_string_chunk_insert(quick->strings, relative);
+    entry.folded = g_string_chunk_insert(quick->strings, folded);
+    entry.mask = palette_mask(folded);
+    entry.len = strlen(relative);
+    entry.base = slash ? slash - relative + 1 : 0;
+    g_array_append_val(quick->paths, entry);
+    g_free(folded);
+}
+
+static void quick_open_rank(EditorApp *app);
+
+static gboolean quick_open_refresh(gpointer data) {
     EditorApp *app = (EditorApp *)data;
-    GtkTextIter start, end;
-    
-    if (!gtk_text_buffer_get_selection_bounds(GTK_TEXT_BUFFER(app->buffer), &start, &end)) {
-        /* No selection, comment current line */
-        gtk_text_buffer_get_iter_at_mark(GTK_TEXT_BUFFER(app->buffer), &start,
-                                         gtk_text_buffer_get_insert(GTK_TEXT_BUFFER(app->buffer)));
-        end = start;
-        gtk_text_iter_set_line_offset(&start, 0);
-        if (!gtk_text_iter_ends_line(&end))
-            gtk_text_iter_forward_to_line_end(&end);
+    app->quick->refresh = 0;
+    if (app->quick->dialog) quick_open_rank(app);
+    return G_SOURCE_REMOVE;
+}
+
+typedef struct {
+    EditorApp *app;
+    gchar *dir;               /* relative, "" for the root */
+    GCancellable *crawl;      /* the crawl it belongs to, cancelled when the root changes */
+} QuickListing;
+
+static void quick_listing_free(QuickListing *listing) {
+    g_object_unref(listing->crawl);
+    g_free(listing->dir);
+    g_free(listing);
+}
+
+static void on_quick_batch(GObject *source, GAsyncResult *result, gpointer data) {
+    GFileEnumerator *enumerator = G_FILE_ENUMERATOR(source);
+    QuickListing *listing = data;
+    EditorApp *app = listing->app;
+    QuickOpen *quick = app->quick;
+    GList *infos = g_file_enumerator_next_files_finish(enumerator, result, NULL);
+
+    /* A crawl of a previous root */
+    if (g_cancellable_is_cancelled(listing->crawl)) {
+        g_list_free_full(infos, g_object_unref);
+        g_object_unref(enumerator);
+        quick_listing_free(listing);
+        return;
     }
-    
-    gint start_line = gtk_text_iter_get_line(&start);
-    gint end_line = gtk_text_iter_get_line(&end);
-    
-    /* Comment each line */
-    for (gint line = start_line; line <= end_line; line++) {
-        GtkTextIter line_start;
-        gtk_text_buffer_get_iter_at_line(GTK_TEXT_BUFFER(app->buffer), &line_start, line);
-        gtk_text_buffer_insert(GTK_TEXT_BUFFER(app->buffer), &line_start, "// ", -1);
+
+    for (GList *l = infos; l; l = l->next) {
+        GFileInfo *info = l->data;
+        const gchar *name = g_file_info_get_name(info);
+        if (g_file_info_get_is_hidden(info)) continue;
+        gchar *relative = *listing->dir ? g_build_filename(listing->dir, name, NULL) : g_strdup(name);
+        GFileType type = g_file_info_get_file_type(info);    /* G_FILE_TYPE_SYMBOLIC_LINK for links */
+        if (type == G_FILE_TYPE_DIRECTORY) {
+            g_queue_push_tail(&quick->dirs, relative);
+            continue;
+        }
+        if (type == G_FILE_TYPE_REGULAR && quick->paths->len < QUICK_OPEN_MAX_PATHS)
+            quick_add_path(quick, relative);
+        g_free(relative);
+    }
+    if (infos && quick->dialog && !quick->refresh)
+        quick->refresh = g_timeout_add(100, quick_open_refresh, app);
+
+    if (infos) {
+        g_list_free_full(infos, g_object_unref);
+        g_file_enumerator_next_files_async(enumerator, FILE_TREE_BATCH, G_PRIORITY_LOW, listing->crawl,
+                                           on_quick_batch, listing);
+        return;
     }
+    g_object_unref(enumerator);
+    quick_listing_free(listing);
+    quick_crawl_next(app);
 }
 
-static void on_uncomment_selection(GtkWidget *widget, gpointer data) {
-    EditorApp *app = (EditorApp *)data;
-    GtkTextIter start, end;
-    
-    if (!gtk_text_buffer_get_selection_bounds(GTK_TEXT_BUFFER(app->buffer), &start, &end)) {
-        /* No selection, uncomment current line */
-        gtk_text_buffer_get_iter_at_mark(GTK_TEXT_BUFFER(app->buffer), &start,
-                                         gtk_text_buffer_get_insert(GTK_TEXT_BUFFER(app->buffer)));
-        end = start;
-        gtk_text_iter_set_line_offset(&start, 0);
-        if (!gtk_text_iter_ends_line(&end))
-            gtk_text_iter_forward_to_line_end(&end);
+static void on_quick_enumerated(GObject *source, GAsyncResult *result, gpointer data) {
+    QuickListing *listing = data;
+    EditorApp *app = listing->app;
+    GFileEnumerator *enumerator = g_file_enumerate_children_finish(G_FILE(source), result, NULL);
+
+    if (g_cancellable_is_cancelled(listing->crawl)) {
+        if (enumerator) g_object_unref(enumerator);
+        quick_listing_free(listing);
+        return;
     }
-    
-    gint start_line = gtk_text_iter_get_line(&start);
-    gint end_line = gtk_text_iter_get_line(&end);
-    
-    /* Uncomment each line */
-    for (gint line = start_line; line <= end_line; line++) {
-        GtkTextIter line_start, line_end;
-        gtk_text_buffer_get_iter_at_line(GTK_TEXT_BUFFER(app->buffer), &line_start, line);
-        line_end = line_start;
-        
-        /* Skip whitespace */
-        while (!gtk_text_iter_ends_line(&line_end) && 
-               g_unichar_isspace(gtk_text_iter_get_char(&line_end))) {
-            gtk_text_iter_forward_char(&line_end);
+    if (!enumerator) {
+        quick_listing_free(listing);
+        quick_crawl_next(app);
+        return;
+    }
+    g_file_enumerator_next_files_async(enumerator, FILE_TREE_BATCH, G_PRIORITY_LOW, listing->crawl,
+                                       on_quick_batch, listing);
+}
+
+/* List the next directory of the crawl; only one listing is in flight */
+static void quick_crawl_next(EditorApp *app) {
+    QuickOpen *quick = app->quick;
+    gchar *dir = g_queue_pop_head(&quick->dirs);
+
+    if (!dir || quick->paths->len >= QUICK_OPEN_MAX_PATHS) {
+        g_free(dir);
+        g_queue_clear_full(&quick->dirs, g_free);
+        quick->crawling = FALSE;
+        g_print("Quick open: %u files under %s in %.0f ms\n", quick->paths->len, quick->root,
+                (g_get_monotonic_time() - quick->crawl_started) / 1000.0);
+        if (quick->dialog && !quick->refresh) quick->refresh = g_idle_add(quick_open_refresh, app);
+        return;
+    }
+
+    QuickListing *listing = g_new0(QuickListing, 1);
+    listing->app = app;
+    listing->dir = dir;
+    listing->crawl = g_object_ref(quick->crawl);
+    gchar *path = g_build_filename(quick->root, dir, NULL);
+    GFile *file = g_file_new_for_path(path);
+    /* Links are not followed, as in project_walk, so a loop or a link to / is not crawled */
+    g_file_enumerate_children_async(file, FILE_TREE_ATTRIBUTES, G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+                                    G_PRIORITY_LOW, quick->crawl, on_quick_enumerated, listing);
+    g_object_unref(file);
+    g_free(path);
+}
+
+static void quick_open_set_root(EditorApp *app, const gchar *root) {
+    QuickOpen *quick = app->quick;
+
+    if (quick->crawl) {
+        g_cancellable_cancel(quick->crawl);
+        g_object_unref(quick->crawl);
+        quick->crawl = NULL;
+    }
+    g_queue_clear_full(&quick->dirs, g_free);
+    g_free(quick->root);
+    quick->root = g_strdup(root);
+    g_array_set_size(quick->paths, 0);
+    g_string_chunk_clear(quick->strings);
+    quick_open_reset(quick);
+    quick->crawling = FALSE;
+}
+
+/* Start collecting paths the first time quick open needs them */
+static void quick_open_crawl(EditorApp *app) {
+    QuickOpen *quick = app->quick;
+
+    if (quick->crawl) return;
+    quick->crawl = g_cancellable_new();
+    quick->crawling = TRUE;
+    quick->crawl_started = g_get_monotonic_time();
+    g_queue_push_tail(&quick->dirs, g_strdup(""));
+    quick_crawl_next(app);
+}
+
+/* Shorter paths first among equal scores, then by name */
+static gint compare_quick_matches(gconstpointer a, gconstpointer b, gpointer data) {
+    const QuickMatch *x = a, *y = b;
+    const QuickPath *paths = data;
+
+    if (x->score != y->score) return y->score - x->score;
+    if (paths[x->index].len != paths[y->index].len) return paths[x->index].len < paths[y->index].len ? -1 : 1;
+    return strcmp(paths[x->index].path, paths[y->index].path);
+}
+
+/* Thread pool or inline: score one range of paths, keeping the best few in order */
+static void quick_job_run(gpointer data, gpointer user_data) {
+    QuickJob *job = data;
+    QuickOpen *quick = job->quick;
+    const QuickPath *paths = (const QuickPath *)quick->paths->data;
+
+    for (guint i = job->begin; i < job->end; i++) {
+        guint index = job->indexes ? job->indexes[i] : i;
+        const QuickPath *path = &paths[index];
+        if ((path->mask & job->mask) != job->mask) continue;
+        gint score = palette_score(path->folded, job->query);
+        if (score < 0) continue;
+        g_array_append_val(job->matches, index);
+
+        gint in_name = palette_score(path->folded + path->base, job->query);
+        QuickMatch match = { index, in_name >= 0 ? in_name + 100 : score };
+        guint at = job->best->len;
+        while (at > 0 && compare_quick_matches(&match, &g_array_index(job->best, QuickMatch, at - 1),
+                                               (gpointer)paths) < 0)
+            at--;
+        if (at < QUICK_OPEN_MAX_RESULTS) {
+            g_array_insert_val(job->best, at, match);
+            if (job->best->len > QUICK_OPEN_MAX_RESULTS) g_array_set_size(job->best, QUICK_OPEN_MAX_RESULTS);
         }
-        
-        /* Check for // comment */
-        if (gtk_text_iter_get_char(&line_end) == '/' && 
-            gtk_text_iter_forward_char(&line_end) &&
-            gtk_text_iter_get_char(&line_end) == '/') {
-            
-            GtkTextIter delete_start = line_end;
-            gtk_text_iter_backward_char(&delete_start);
-            gtk_text_iter_forward_char(&line_end);
-            
-            /* Also remove space after // if present */
-            if (gtk_text_iter_get_char(&line_end) == ' ') {
-                gtk_text_iter_forward_char(&line_end);
-            }
-            
-            gtk_text_buffer_delete(GTK_TEXT_BUFFER(app->buffer), &delete_start, &line_end);
+    }
+
+    if (user_data) {
+        g_mutex_lock(&quick->lock);
+        if (--quick->remaining == 0) g_cond_signal(&quick->done);
+        g_mutex_unlock(&quick->lock);
+    }
+}
+
+/* Rank the paths for the entry's text and show the best; returns once every chunk is done */
+static void quick_open_rank(EditorApp *app) {
+    QuickOpen *quick = app->quick;
+    gchar *query = g_ascii_strdown(gtk_entry_get_text(GTK_ENTRY(quick->entry)), -1);
+    gint64 t0 = g_get_monotonic_time();
+
+    /* A longer query only matches a subset: rank the previous matches and the paths found since */
+    gboolean refine = quick->last_query && g_str_has_prefix(query, quick->last_query);
+    guint extra = quick->paths->len - (refine ? quick->ranked : 0);
+    guint total = (refine ? quick->candidates->len : 0) + extra;
+    guint njobs = MAX(1, (total + QUICK_OPEN_CHUNK - 1) / QUICK_OPEN_CHUNK);
+    QuickJob *jobs = g_new0(QuickJob, njobs + 1);
+    GArray *candidates = refine ? quick->candidates : NULL;
+    guint n = 0;
+
+    for (guint begin = 0; candidates && begin < candidates->len; begin += QUICK_OPEN_CHUNK) {
+        QuickJob job = { quick, (const guint *)candidates->data, begin,
+                         MIN(begin + QUICK_OPEN_CHUNK, candidates->len), query, palette_mask(query) };
+        jobs[n++] = job;
+    }
+    for (guint begin = quick->paths->len - extra; begin < quick->paths->len; begin += QUICK_OPEN_CHUNK) {
+        QuickJob job = { quick, NULL, begin, MIN(begin + QUICK_OPEN_CHUNK, quick->paths->len),
+                         query, palette_mask(query) };
+        jobs[n++] = job;
+    }
+    for (guint i = 0; i < n; i++) {
+        jobs[i].matches = g_array_new(FALSE, FALSE, sizeof(guint));
+        jobs[i].best = g_array_new(FALSE, FALSE, sizeof(QuickMatch));
+    }
+
+    if (n == 1) {
+        quick_job_run(&jobs[0], NULL);
+    } else if (n > 1) {
+        quick->remaining = n;
+        for (guint i = 0; i < n; i++) g_thread_pool_push(quick->pool, &jobs[i], NULL);
+        g_mutex_lock(&quick->lock);
+        while (quick->remaining > 0) g_cond_wait(&quick->done, &quick->lock);
+        g_mutex_unlock(&quick->lock);
+    }
+
+    /* Every match is a candidate for the next keystroke, the best of each job a result */
+    GArray *matched = g_array_new(FALSE, FALSE, sizeof(guint));
+    GArray *best = g_array_new(FALSE, FALSE, sizeof(QuickMatch));
+    for (guint i = 0; i < n; i++) {
+        g_array_append_vals(matched, jobs[i].matches->data, jobs[i].matches->len);
+        g_array_append_vals(best, jobs[i].best->data, jobs[i].best->len);
+        g_array_free(jobs[i].matches, TRUE);
+        g_array_free(jobs[i].best, TRUE);
+    }
+    g_array_sort_with_data(best, compare_quick_matches, quick->paths->data);
+    g_array_free(quick->candidates, TRUE);
+    quick->candidates = matched;
+    quick->ranked = quick->paths->len;
+    g_free(quick->last_query);
+    quick->last_query = query;
+
+    gtk_list_store_clear(quick->store);
+    for (guint i = 0; i < best->len && i < QUICK_OPEN_MAX_RESULTS; i++) {
+        const QuickPath *path = &g_array_index(quick->paths, QuickPath, g_array_index(best, QuickMatch, i).index);
+        gtk_list_store_insert_with_values(quick->store, NULL, -1, 0, path->path, -1);
+    }
+    GtkTreePath *first = gtk_tree_path_new_first();
+    if (best->len > 0) gtk_tree_view_set_cursor(GTK_TREE_VIEW(quick->tree), first, NULL, FALSE);
+    gtk_tree_path_free(first);
+
+    gchar *title = g_strdup_printf("Quick Open: %u of %u files%s, %.1f ms", matched->len, quick->paths->len,
+                                   quick->crawling ? " so far" : "", (g_get_monotonic_time() - t0) / 1000.0);
+    gtk_window_set_title(GTK_WINDOW(quick->dialog), title);
+    g_free(title);
+    g_array_free(best, TRUE);
+    g_free(jobs);
+}
+
+static void on_quick_open_changed(GtkSearchEntry *entry, gpointer data) {
+    quick_open_rank((EditorApp *)data);
+}
+
+static void quick_open_accept(GtkWidget *widget, gpointer data) {
+    EditorApp *app = (EditorApp *)data;
+    gtk_dialog_response(GTK_DIALOG(app->quick->dialog), GTK_RESPONSE_ACCEPT);
+}
+
+static void quick_open_row_activated(GtkTreeView *tree_view, GtkTreePath *path,
+                                     GtkTreeViewColumn *column, gpointer data) {
+    quick_open_accept(GTK_WIDGET(tree_view), data);
+}
+
+/* Up/Down in the entry move the selection in the result list */
+static gboolean quick_open_key_press(GtkWidget *widget, GdkEventKey *event, gpointer data) {
+    EditorApp *app = (EditorApp *)data;
+    QuickOpen *quick = app->quick;
+    GtkTreePath *path = NULL;
+    GtkTreeIter iter;
+
+    if (event->keyval != GDK_KEY_Down && event->keyval != GDK_KEY_Up)
+        return FALSE;
+    gtk_tree_view_get_cursor(GTK_TREE_VIEW(quick->tree), &path, NULL);
+    if (!path) return TRUE;
+    if (event->keyval == GDK_KEY_Down) gtk_tree_path_next(path);
+    else gtk_tree_path_prev(path);
+    if (gtk_tree_model_get_iter(GTK_TREE_MODEL(quick->store), &iter, path))
+        gtk_tree_view_set_cursor(GTK_TREE_VIEW(quick->tree), path, NULL, FALSE);
+    gtk_tree_path_free(path);
+    return TRUE;
+}
+
+static void on_quick_open(GtkWidget *widget, gpointer data) {
+    EditorApp *app = (EditorApp *)data;
+    QuickOpen *quick = app->quick;
+
+    file_tree_ensure_root(app);
+    quick_open_crawl(app);
+    if (!quick->pool)
+        quick->pool = g_thread_pool_new(quick_job_run, quick, g_get_num_processors(), FALSE, NULL);
+    quick_open_reset(quick);
+
+    quick->dialog = gtk_dialog_new_with_buttons("Quick Open", GTK_WINDOW(app->window),
+                                                GTK_DIALOG_MODAL | GTK_DIALOG_DESTROY_WITH_PARENT, NULL);
+    gtk_window_set_default_size(GTK_WINDOW(quick->dialog), 560, 380);
+    GtkWidget *content_area = gtk_dialog_get_content_area(GTK_DIALOG(quick->dialog));
+
+    quick->entry = gtk_search_entry_new();
+    gtk_entry_set_placeholder_text(GTK_ENTRY(quick->entry), "File name");
+    gtk_box_pack_start(GTK_BOX(content_area), quick->entry, FALSE, FALSE, 0);
+
+    quick->store = gtk_list_store_new(1, G_TYPE_STRING);
+    quick->tree = gtk_tree_view_new_with_model(GTK_TREE_MODEL(quick->store));
+    gtk_tree_view_set_headers_visible(GTK_TREE_VIEW(quick->tree), FALSE);
+    gtk_tree_view_append_column(GTK_TREE_VIEW(quick->tree),
+        gtk_tree_view_column_new_with_attributes("Path", gtk_cell_renderer_text_new(), "text", 0, NULL));
+
+    GtkWidget *scroll = gtk_scrolled_window_new(NULL, NULL);
+    gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(scroll), GTK_POLICY_NEVER, GTK_POLICY_AUTOMATIC);
+    gtk_container_add(GTK_CONTAINER(scroll), quick->tree);
+    gtk_box_pack_start(GTK_BOX(content_area), scroll, TRUE, TRUE, 0);
+
+    g_signal_connect(quick->entry, "search-changed", G_CALLBACK(on_quick_open_changed), app);
+    g_signal_connect(quick->entry, "activate", G_CALLBACK(quick_open_accept), app);
+    g_signal_connect(quick->entry, "key-press-event", G_CALLBACK(quick_open_key_press), app);
+    g_signal_connect(quick->tree, "row-activated", G_CALLBACK(quick_open_row_activated), app);
+
+    quick_open_rank(app);
+    gtk_widget_show_all(content_area);
+
+    gchar *chosen = NULL;
+    if (gtk_dialog_run(GTK_DIALOG(quick->dialog)) == GTK_RESPONSE_ACCEPT) {
+        GtkTreeSelection *selection = gtk_tree_view_get_selection(GTK_TREE_VIEW(quick->tree));
+        GtkTreeModel *model;
+        GtkTreeIter iter;
+        if (gtk_tree_selection_get_selected(selection, &model, &iter)) {
+            gchar *relative;
+            gtk_tree_model_get(model, &iter, 0, &relative, -1);
+            chosen = g_build_filename(quick->root, relative, NULL);
+            g_free(relative);
         }
     }
+    if (quick->refresh) g_source_remove(quick->refresh);
+    quick->refresh = 0;
+    gtk_widget_destroy(quick->dialog);
+    quick->dialog = NULL;
+    g_object_unref(quick->store);
+    quick->store = NULL;
+
+    if (chosen && !load_file(app, chosen)) g_print("Could not open %s\n", chosen);
+    g_free(chosen);
 }
 
-static void on_block_comment(GtkWidget *widget, gpointer data) {
-    EditorApp *app = (EditorApp *)data;
-    GtkTextIter start, end;
+static void setup_quick_open(EditorApp *app) {
+    QuickOpen *quick = g_new0(QuickOpen, 1);
 
-    if (gtk_text_buffer_get_selection_bounds(
-            GTK_TEXT_BUFFER(app->buffer), &start, &end)) {
+    quick->strings = g_string_chunk_new(64 << 10);
+    quick->paths = g_array_new(FALSE, FALSE, sizeof(QuickPath));
+    quick->candidates = g_array_new(FALSE, FALSE, sizeof(guint));
+    g_queue_init(&quick->dirs);
+    g_mutex_init(&quick->lock);
+    g_cond_init(&quick->done);
+    app->quick = quick;
+}
 
-        gtk_text_buffer_insert(
-            GTK_TEXT_BUFFER(app->buffer), &start, "/*\n", -1);
+/*
+ * External changes
+ * The open file is watched with a GFileMonitor (inotify on Linux). Events
+ * are coalesced for a moment, then a worker reads the file and, if its
+ * contents differ from what was last read or written, diffs it against
+ * the buffer line by line (sc_diff_lines). An unmodified buffer takes just
+ * the changed hunks, as one undo step, so the cursor, bookmarks and scroll
+ * position stay where they were. A modified buffer gets an info bar
+ * offering a three-way merge against the text last read or written, with
+ * conflict markers where both sides changed the same lines.
+ */
+#define WATCH_SETTLE_DELAY 200    /* ms after the last monitor event */
 
-        /* Re-fetch end iterator AFTER insertion */
-        gtk_text_buffer_get_iter_at_mark(
-            GTK_TEXT_BUFFER(app->buffer),
-            &end,
-            gtk_text_buffer_get_selection_bound(GTK_TEXT_BUFFER(app->buffer))
-        );
+enum { WATCH_MERGE = 1, WATCH_RELOAD, WATCH_KEEP };
 
-        gtk_text_buffer_insert(
-            GTK_TEXT_BUFFER(app->buffer), &end, "\n*/", -1);
-    } else {
-        insert_at_cursor(app, "/* */");
-    }
+typedef struct {
+    gint line;                /* first buffer line replaced */
+    gint count;               /* buffer lines replaced, 0 = insert before line */
+    gchar *text;              /* replacement lines, joined by '\n' */
+    gint text_lines;          /* lines in text, 0 = delete */
+} WatchEdit;
+
+typedef struct {
+    gchar *path;
+    guint serial;             /* watch generation the job was started for */
+    guint64 edits;            /* buffer edit count when the text was taken */
+    gchar *buffer_text;       /* NULL: long-line mode, only compare */
+    gchar *base_text;
+    guint64 known_hash;
+    gchar *disk_text;         /* results */
+    gsize disk_len;
+    gboolean changed;
+    gboolean deleted;
+    gboolean whole;           /* no edits, reload with load_file */
+    GArray *reload;           /* WatchEdit turning the buffer into the disk text */
+    GArray *merge;            /* WatchEdit merging the disk changes into the buffer */
+    gint conflicts;
+} WatchJob;
+
+typedef struct FileWatch {
+    GFileMonitor *monitor;
+    gchar *path;
+    guint serial;
+    gchar *base;              /* text last read from or written to disk */
+    guint64 hash;             /* sc_hash64 of base */
+    gint64 mtime;             /* disk state base matches */
+    gint64 size;
+    guint64 edits;            /* buffer "changed" count */
+    guint settle;             /* pending check timeout, 0 = none */
+    gboolean busy;
+    gboolean again;
+    WatchJob *pending;        /* change the info bar offers to apply */
+    GtkWidget *bar;
+    GtkWidget *label;
+    GtkWidget *merge_button;
+    GtkWidget *reload_button;
+} FileWatch;
+
+static void watch_edits_free(GArray *edits) {
+    if (!edits) return;
+    for (guint i = 0; i < edits->len; i++) g_free(g_array_index(edits, WatchEdit, i).text);
+    g_array_free(edits, TRUE);
 }
 
-static void update_status(EditorApp *app) {
-    GtkTextIter iter;
-    gtk_text_buffer_get_iter_at_mark(GTK_TEXT_BUFFER(app->buffer), &iter, 
-                                     gtk_text_buffer_get_insert(GTK_TEXT_BUFFER(app->buffer)));
+static void watch_job_free(WatchJob *job) {
+    g_free(job->path);
+    g_free(job->buffer_text);
+    g_free(job->base_text);
+    g_free(job->disk_text);
+    watch_edits_free(job->reload);
+    watch_edits_free(job->merge);
+    g_free(job);
+}
 
-    int line = gtk_text_iter_get_line(&iter) + 1;
-    int col = gtk_text_iter_get_line_offset(&iter) + 1;
-    int total_lines = gtk_text_buffer_get_line_count(GTK_TEXT_BUFFER(app->buffer));
+/* Byte offset of the start of every line, plus one past the end */
+static GArray *watch_line_starts(const gchar *text, gsize len) {
+    GArray *starts = g_array_new(FALSE, FALSE, sizeof(gsize));
+    gsize start = 0;
 
-    gchar *status;
-    if (app->focus_mode) {
-        status = g_strdup_printf("Line: %d, Col: %d | Total Lines: %d | [FOCUS MODE]", 
-                                 line, col, total_lines);
-    } else {
-        status = g_strdup_printf("Line: %d, Col: %d | Total Lines: %d", 
-                                 line, col, total_lines);
+    g_array_append_val(starts, start);
+    for (const gchar *p = text; (p = memchr(p, '\n', text + len - p)); p++) {
+        start = p - text + 1;
+        g_array_append_val(starts, start);
     }
+    start = len + 1;
+    g_array_append_val(starts, start);
+    return starts;
+}
 
-    gtk_label_set_text(GTK_LABEL(app->status_label), status);
-    g_free(status);
+/* Lines first .. first + count - 1 of text, without the last newline */
+static gchar *watch_lines(const gchar *text, GArray *starts, gint first, gint count) {
+    if (count == 0) return g_strdup("");
+    gsize from = g_array_index(starts, gsize, first);
+    return g_strndup(text + from, g_array_index(starts, gsize, first + count) - 1 - from);
 }
-/*major bug fix: Missing line numbers due to app repaint */ 
-static void on_tree_selection_changed(GtkTreeSelection *selection, gpointer data) {
-    EditorApp *app = (EditorApp *)data;
-    GtkTreeIter iter;
-    GtkTreeModel *model;
-    
-    if (gtk_tree_selection_get_selected(selection, &model, &iter)) {
-        gint line_num;
-        gtk_tree_model_get(model, &iter, COL_LINE, &line_num, -1);
-        
-        if (line_num > 0) {
-            app->focus_mode = TRUE;
 
-            GtkTextIter start, end;
-            /* GTK uses 0-indexed line numbers */
-            gtk_text_buffer_get_iter_at_line(GTK_TEXT_BUFFER(app->buffer), &start, line_num - 1);
-            
-            /* 1. Clear ALL previous yellow highlights from the buffer */
-            GtkTextIter buf_start, buf_end;
-            gtk_text_buffer_get_bounds(GTK_TEXT_BUFFER(app->buffer), &buf_start, &buf_end);
-            gtk_text_buffer_remove_tag_by_name(GTK_TEXT_BUFFER(app->buffer), "jump_highlight", &buf_start, &buf_end);
-
-            /* 2. Find the end of the line to highlight the whole row */
-            end = start;
-            if (!gtk_text_iter_ends_line(&end)) {
-                gtk_text_iter_forward_to_line_end(&end);
-            }
+static void watch_add_edit(GArray *edits, gint line, gint count, gchar *text, gint text_lines) {
+    WatchEdit edit = { line, count, text, text_lines };
+    g_array_append_val(edits, edit);
+}
 
-            /* 3. Apply the 'jump_highlight' tag (defined as yellow in main) */
-            gtk_text_buffer_apply_tag_by_name(GTK_TEXT_BUFFER(app->buffer), "jump_highlight", &start, &end);
+/* Hunks are kept as four gints: a line, a count, b line, b count */
+static void on_watch_hunk(size_t a_line, size_t a_count, size_t b_line, size_t b_count, void *user) {
+    gint hunk[4] = { (gint)a_line, (gint)a_count, (gint)b_line, (gint)b_count };
+    g_array_append_vals(user, hunk, 4);
+}
 
-            /* 4. Move cursor and scroll to center (0.5 yalign) */
-            gtk_text_buffer_place_cursor(GTK_TEXT_BUFFER(app->buffer), &start);
-            gtk_text_view_scroll_to_iter(GTK_TEXT_VIEW(app->view), &start, 0.0, TRUE, 0.0, 0.5);
+static GArray *watch_diff(const gchar *a, const gchar *b, gsize blen) {
+    GArray *hunks = g_array_new(FALSE, FALSE, sizeof(gint));
+    if (sc_diff_lines(a, strlen(a), b, blen, on_watch_hunk, hunks) == (size_t)-1) {
+        g_array_free(hunks, TRUE);
+        return NULL;
+    }
+    return hunks;
+}
 
-            update_status(app);
-            gtk_widget_grab_focus(app->view);
-            gtk_widget_queue_draw(app->view);
+/*
+ * Three-way merge of base -> buffer (mine) and base -> disk (theirs), as
+ * edits to the buffer. Hunks of both diffs are clustered by the base lines
+ * they cover; a cluster only theirs touch takes their lines, one both touch
+ * differently becomes a conflict.
+ */
+static GArray *watch_merge(WatchJob *job, GArray *mine, GArray *theirs, GArray *buf_starts, GArray *disk_starts) {
+    GArray *edits = g_array_new(FALSE, FALSE, sizeof(WatchEdit));
+    guint i = 0, j = 0, nm = mine->len / 4, nt = theirs->len / 4;
+    gint delta_mine = 0, delta_theirs = 0;    /* line shift of each side before the cluster */
+    const gint *m = (const gint *)mine->data, *t = (const gint *)theirs->data;
+
+    while (i < nm || j < nt) {
+        gboolean take_mine = j == nt || (i < nm && m[4 * i] <= t[4 * j]);
+        gint lo = take_mine ? m[4 * i] : t[4 * j];
+        gint hi = take_mine ? m[4 * i] + m[4 * i + 1] : t[4 * j] + t[4 * j + 1];
+        guint i0 = i, j0 = j;
+
+        /* Absorb every hunk that overlaps or touches the cluster */
+        for (;;) {
+            if (i < nm && m[4 * i] <= hi) {
+                hi = MAX(hi, m[4 * i] + m[4 * i + 1]);
+                i++;
+            } else if (j < nt && t[4 * j] <= hi) {
+                hi = MAX(hi, t[4 * j] + t[4 * j + 1]);
+                j++;
+            } else {
+                break;
+            }
+        }
+
+        /* The cluster's lines on each side */
+        gint a_lo = lo + delta_mine, a_hi = hi + delta_mine;
+        if (i > i0) {
+            a_lo = m[4 * i0 + 2] - (m[4 * i0] - lo);
+            a_hi = m[4 * (i - 1) + 2] + m[4 * (i - 1) + 3] + (hi - m[4 * (i - 1)] - m[4 * (i - 1) + 1]);
+        }
+        gint b_lo = lo + delta_theirs, b_hi = hi + delta_theirs;
+        if (j > j0) {
+            b_lo = t[4 * j0 + 2] - (t[4 * j0] - lo);
+            b_hi = t[4 * (j - 1) + 2] + t[4 * (j - 1) + 3] + (hi - t[4 * (j - 1)] - t[4 * (j - 1) + 1]);
+        }
+        delta_mine = a_hi - hi;
+        delta_theirs = b_hi - hi;
+        if (j == j0) continue;    /* only mine: the buffer already has it */
+
+        gchar *ours = watch_lines(job->buffer_text, buf_starts, a_lo, a_hi - a_lo);
+        gchar *theirs_text = watch_lines(job->disk_text, disk_starts, b_lo, b_hi - b_lo);
+        if (i == i0) {
+            watch_add_edit(edits, a_lo, a_hi - a_lo, theirs_text, b_hi - b_lo);
+            g_free(ours);
+        } else if (a_hi - a_lo == b_hi - b_lo && strcmp(ours, theirs_text) == 0) {
+            g_free(ours);         /* both made the same change */
+            g_free(theirs_text);
+        } else {
+            GString *conflict = g_string_new("<<<<<<< buffer\n");
+            if (a_hi > a_lo) g_string_append_printf(conflict, "%s\n", ours);
+            g_string_append(conflict, "=======\n");
+            if (b_hi > b_lo) g_string_append_printf(conflict, "%s\n", theirs_text);
+            g_string_append(conflict, ">>>>>>> disk");
+            watch_add_edit(edits, a_lo, a_hi - a_lo, g_string_free(conflict, FALSE),
+                           (a_hi - a_lo) + (b_hi - b_lo) + 3);
+            g_free(ours);
+            g_free(theirs_text);
+            job->conflicts++;
         }
     }
+    return edits;
 }
 
-static gboolean is_identifier_char(char c) {
-    return isalnum(c) || c == '_';
-}
+static void watch_worker(GTask *task, gpointer source, gpointer task_data, GCancellable *cancellable) {
+    WatchJob *job = task_data;
+    GError *error = NULL;
+
+    TRACE_BEGIN("watch: diff");
+    if (!g_file_get_contents(job->path, &job->disk_text, &job->disk_len, &error)) {
+        job->deleted = g_error_matches(error, G_FILE_ERROR, G_FILE_ERROR_NOENT);
+        job->changed = job->deleted;
+        g_error_free(error);
+    } else if (sc_hash64(job->disk_text, job->disk_len) != job->known_hash) {
+        job->changed = TRUE;
+        job->whole = !job->buffer_text || !g_utf8_validate(job->disk_text, job->disk_len, NULL);
+    }
+    if (!job->changed || job->whole) {
+        TRACE_END("watch: diff");
+        g_task_return_pointer(task, job, NULL);
+        return;
+    }
 
-static gboolean skip_whitespace(const char **ptr) {
-    while (**ptr && isspace(**ptr)) {
-        (*ptr)++;
+    GArray *buf_starts = watch_line_starts(job->buffer_text, strlen(job->buffer_text));
+    GArray *disk_starts = watch_line_starts(job->disk_text, job->disk_len);
+    GArray *hunks = watch_diff(job->buffer_text, job->disk_text, job->disk_len);
+    if (!hunks) {
+        job->whole = TRUE;
+    } else {
+        job->reload = g_array_new(FALSE, FALSE, sizeof(WatchEdit));
+        for (guint h = 0; h < hunks->len; h += 4) {
+            gint *hunk = &g_array_index(hunks, gint, h);
+            watch_add_edit(job->reload, hunk[0], hunk[1],
+                           watch_lines(job->disk_text, disk_starts, hunk[2], hunk[3]), hunk[3]);
+        }
+        g_array_free(hunks, TRUE);
     }
-    return **ptr != '\0';
-}
 
-static void extract_identifier(const char **ptr, char *buf, size_t size) {
-    size_t i = 0;
-    while (**ptr && is_identifier_char(**ptr) && i < size - 1) {
-        buf[i++] = **ptr;
-        (*ptr)++;
+    /* The merge is only needed when the buffer has changes of its own */
+    if (job->reload && job->base_text && strcmp(job->base_text, job->buffer_text) != 0) {
+        GArray *mine = watch_diff(job->base_text, job->buffer_text, strlen(job->buffer_text));
+        GArray *theirs = watch_diff(job->base_text, job->disk_text, job->disk_len);
+        if (mine && theirs) job->merge = watch_merge(job, mine, theirs, buf_starts, disk_starts);
+        if (mine) g_array_free(mine, TRUE);
+        if (theirs) g_array_free(theirs, TRUE);
     }
-    buf[i] = '\0';
+    g_array_free(buf_starts, TRUE);
+    g_array_free(disk_starts, TRUE);
+    TRACE_END("watch: diff");
+    g_task_return_pointer(task, job, NULL);
 }
-/* 
- * The current logic increments line_num every time strtok finds a token, 
- * but if your code has multiple consecutive newlines (empty lines), strtok treats them 
- * as a single delimiter and "jumps" over them without incrementing your counter.
- *
 
-static void parse_symbols(EditorApp *app) {
+/* Edits are in increasing line order and applied from the last, so earlier line numbers hold */
+static void watch_apply(EditorApp *app, GArray *edits) {
+    GtkTextBuffer *buffer = GTK_TEXT_BUFFER(app->buffer);
     GtkTextIter start, end;
-    gtk_text_buffer_get_bounds(GTK_TEXT_BUFFER(app->buffer), &start, &end);
-    gchar *text = gtk_text_buffer_get_text(GTK_TEXT_BUFFER(app->buffer), &start, &end, FALSE);
-    
-    gtk_tree_store_clear(app->tree_store);
-    
-    GtkTreeIter func_iter, struct_iter, typedef_iter, enum_iter;
-    gboolean has_funcs = FALSE, has_structs = FALSE, has_typedefs = FALSE, has_enums = FALSE;
-    
-    char *line = strtok(text, "\n");
-    int line_num = 1;
-    
-    while (line != NULL) {
-        const char *ptr = line;
-        
-        // Skip leading whitespace and comments 
-        while (*ptr && isspace(*ptr)) ptr++;
-        
-        if (strncmp(ptr, "//", 2) == 0 || *ptr == '#') {
-            line = strtok(NULL, "\n");
-            line_num++;
-            continue;
-        }
-        
-        // Check for typedef 
-        if (strncmp(ptr, "typedef", 7) == 0 && !is_identifier_char(ptr[7])) {
-            ptr += 7;
-            if (!skip_whitespace(&ptr)) goto next_line;
-            
-            char type_buf[256];
-            
-            // Handle typedef struct 
-            if (strncmp(ptr, "struct", 6) == 0 && !is_identifier_char(ptr[6])) {
-                ptr += 6;
-                if (!skip_whitespace(&ptr)) goto next_line;
-                
-                // Skip struct name if present 
-                if (is_identifier_char(*ptr)) {
-                    while (*ptr && is_identifier_char(*ptr)) ptr++;
-                    if (!skip_whitespace(&ptr)) goto next_line;
-                }
-                
-                // Skip to closing brace and typedef name 
-                char *brace = strchr(ptr, '}');
-                if (brace) {
-                    ptr = brace + 1;
-                    if (!skip_whitespace(&ptr)) goto next_line;
-                    extract_identifier(&ptr, type_buf, sizeof(type_buf));
-                    
-                    if (type_buf[0]) {
-                        if (!has_typedefs) {
-                            gtk_tree_store_append(app->tree_store, &typedef_iter, NULL);
-                            gtk_tree_store_set(app->tree_store, &typedef_iter, 
-                                             COL_NAME, "Typedefs", COL_LINE, 0, -1);
-                            has_typedefs = TRUE;
-                        }
-                        GtkTreeIter child;
-                        gtk_tree_store_append(app->tree_store, &child, &typedef_iter);
-                        gtk_tree_store_set(app->tree_store, &child, 
-                                         COL_NAME, type_buf, COL_LINE, line_num, -1);
-                    }
-                }
-            }
-            // Handle typedef enum 
-            else if (strncmp(ptr, "enum", 4) == 0 && !is_identifier_char(ptr[4])) {
-                ptr += 4;
-                if (!skip_whitespace(&ptr)) goto next_line;
-                
-                char *brace = strchr(ptr, '}');
-                if (brace) {
-                    ptr = brace + 1;
-                    if (!skip_whitespace(&ptr)) goto next_line;
-                    extract_identifier(&ptr, type_buf, sizeof(type_buf));
-                    
-                    if (type_buf[0]) {
-                        if (!has_typedefs) {
-                            gtk_tree_store_append(app->tree_store, &typedef_iter, NULL);
-                            gtk_tree_store_set(app->tree_store, &typedef_iter, 
-                                             COL_NAME, "Typedefs", COL_LINE, 0, -1);
-                            has_typedefs = TRUE;
-                        }
-                        GtkTreeIter child;
-                        gtk_tree_store_append(app->tree_store, &child, &typedef_iter);
-                        gtk_tree_store_set(app->tree_store, &child, 
-                                         COL_NAME, type_buf, COL_LINE, line_num, -1);
-                    }
-                }
-            }
-        }
-        // Check for struct 
-        else if (strncmp(ptr, "struct", 6) == 0 && !is_identifier_char(ptr[6])) {
-            ptr += 6;
-            if (!skip_whitespace(&ptr)) goto next_line;
-            
-            char struct_name[256];
-            extract_identifier(&ptr, struct_name, sizeof(struct_name));
-            
-            if (struct_name[0]) {
-                if (!has_structs) {
-                    gtk_tree_store_append(app->tree_store, &struct_iter, NULL);
-                    gtk_tree_store_set(app->tree_store, &struct_iter, 
-                                     COL_NAME, "Structures", COL_LINE, 0, -1);
-                    has_structs = TRUE;
-                }
-                GtkTreeIter child;
-                gtk_tree_store_append(app->tree_store, &child, &struct_iter);
-                gtk_tree_store_set(app->tree_store, &child, 
-                                 COL_NAME, struct_name, COL_LINE, line_num, -1);
-            }
-        }
-        // Check for enum 
-        else if (strncmp(ptr, "enum", 4) == 0 && !is_identifier_char(ptr[4])) {
-            ptr += 4;
-            if (!skip_whitespace(&ptr)) goto next_line;
-            
-            char enum_name[256];
-            extract_identifier(&ptr, enum_name, sizeof(enum_name));
-            
-            if (enum_name[0]) {
-                if (!has_enums) {
-                    gtk_tree_store_append(app->tree_store, &enum_iter, NULL);
-                    gtk_tree_store_set(app->tree_store, &enum_iter, 
-                                     COL_NAME, "Enums", COL_LINE, 0, -1);
-                    has_enums = TRUE;
-                }
-                GtkTreeIter child;
-                gtk_tree_store_append(app->tree_store, &child, &enum_iter);
-                gtk_tree_store_set(app->tree_store, &child, 
-                                 COL_NAME, enum_name, COL_LINE, line_num, -1);
+
+    TRACE_BEGIN("watch: apply");
+    gtk_text_buffer_begin_user_action(buffer);
+    for (guint i = edits->len; i-- > 0;) {
+        WatchEdit *edit = &g_array_index(edits, WatchEdit, i);
+        gint lines = gtk_text_buffer_get_line_count(buffer);
+
+        /* A changed block inside a fold is shown rather than left half hidden */
+        gtk_text_buffer_get_iter_at_line(buffer, &start, MIN(edit->line, lines - 1));
+        unfold_around(app, &start);
+        if (edit->count == 0) {
+            if (edit->line < lines) {
+                gchar *text = g_strconcat(edit->text, "\n", NULL);
+                gtk_text_buffer_get_iter_at_line(buffer, &start, edit->line);
+                gtk_text_buffer_insert(buffer, &start, text, -1);
+                g_free(text);
+            } else {
+                gchar *text = g_strconcat("\n", edit->text, NULL);
+                gtk_text_buffer_get_end_iter(buffer, &start);
+                gtk_text_buffer_insert(buffer, &start, text, -1);
+                g_free(text);
             }
+            continue;
         }
-        // Check for functions - look for pattern: type name(...) 
-        else {
-            const char *scan = ptr;
-            
-            // Skip static keyword if present 
-            if (strncmp(scan, "static", 6) == 0 && isspace(scan[6])) {
-                scan += 6;
-                while (*scan && isspace(*scan)) scan++;
-            }
-            
-            // Look for a potential return type followed by identifier and ( 
-            const char *maybe_func = scan;
-            int paren_pos = -1;
-            
-            // Scan the line for identifier followed by ( 
-            for (int i = 0; maybe_func[i] && i < 200; i++) {
-                if (maybe_func[i] == '(') {
-                    paren_pos = i;
-                    break;
-                }
-            }
-            
-            if (paren_pos > 0) {
-                // Work backwards from ( to find function name 
-                int name_end = paren_pos - 1;
-                while (name_end >= 0 && isspace(maybe_func[name_end])) name_end--;
-                
-                if (name_end >= 0 && is_identifier_char(maybe_func[name_end])) {
-                    int name_start = name_end;
-                    while (name_start > 0 && is_identifier_char(maybe_func[name_start - 1])) {
-                        name_start--;
-                    }
-                    
-                    char func_name[256];
-                    int len = name_end - name_start + 1;
-                    if (len > 0 && len < (int)sizeof(func_name)) {
-                        strncpy(func_name, &maybe_func[name_start], len);
-                        func_name[len] = '\0';
-                        
-                        // Filter out keywords 
-                        if (strcmp(func_name, "if") != 0 && 
-                            strcmp(func_name, "while") != 0 && 
-                            strcmp(func_name, "for") != 0 && 
-                            strcmp(func_name, "switch") != 0 &&
-                            strcmp(func_name, "sizeof") != 0 &&
-                            strcmp(func_name, "return") != 0) {
-                            
-                            // Check if there's a return type before the name 
-                            int has_return_type = 0;
-                            if (name_start > 0) {
-                                int check = name_start - 1;
-                                while (check >= 0 && isspace(maybe_func[check])) check--;
-                                if (check >= 0 && (is_identifier_char(maybe_func[check]) || 
-                                                   maybe_func[check] == '*')) {
-                                    has_return_type = 1;
-                                }
-                            }
-                            
-                            if (has_return_type) {
-                                if (!has_funcs) {
-                                    gtk_tree_store_append(app->tree_store, &func_iter, NULL);
-                                    gtk_tree_store_set(app->tree_store, &func_iter, 
-                                                     COL_NAME, "Functions", COL_LINE, 0, -1);
-                                    has_funcs = TRUE;
-                                }
-                                GtkTreeIter child;
-                                gtk_tree_store_append(app->tree_store, &child, &func_iter);
-                                gtk_tree_store_set(app->tree_store, &child, 
-                                                 COL_NAME, func_name, COL_LINE, line_num, -1);
-                            }
-                        }
-                    }
-                }
+
+        gtk_text_buffer_get_iter_at_line(buffer, &start, edit->line);
+        if (edit->text_lines == 0) {
+            /* Whole lines go with a newline: the one after them, or before them at the end */
+            if (edit->line + edit->count < lines) {
+                gtk_text_buffer_get_iter_at_line(buffer, &end, edit->line + edit->count);
+            } else {
+                gtk_text_buffer_get_end_iter(buffer, &end);
+                gtk_text_iter_backward_char(&start);
             }
+            gtk_text_buffer_delete(buffer, &start, &end);
+        } else {
+            gtk_text_buffer_get_iter_at_line(buffer, &end, edit->line + edit->count - 1);
+            if (!gtk_text_iter_ends_line(&end)) gtk_text_iter_forward_to_line_end(&end);
+            gtk_text_buffer_delete(buffer, &start, &end);
+            gtk_text_buffer_insert(buffer, &start, edit->text, -1);
         }
-        
-next_line:
-        line = strtok(NULL, "\n");
-        line_num++;
     }
-    
-    g_free(text);
-    
-    // Expand all categories 
-    gtk_tree_view_expand_all(GTK_TREE_VIEW(app->tree_view));
+    gtk_text_buffer_end_user_action(buffer);
+    TRACE_END("watch: apply");
 }
-* 
-* Next Version update: Key Improvements
-* Direct Buffer Access: Using gtk_text_iter_get_line ensures the line number exactly matches what is displayed in the gutter.
-* No more strtok: By using gtk_text_iter_forward_line, empty lines are accounted for correctly, keeping your "Symbols" tree in 
-* sync with the source code.
-*/
-static void parse_symbols(EditorApp *app) {
-    GtkTextIter iter;
-    gtk_text_buffer_get_start_iter(GTK_TEXT_BUFFER(app->buffer), &iter);
-    
-    gtk_tree_store_clear(app->tree_store);
-    GtkTreeIter func_iter;
-    gboolean has_funcs = FALSE;
-    
-    while (TRUE) {
-        // Get the actual line number from the editor (0-indexed, so add 1)
-        int line_num = gtk_text_iter_get_line(&iter) + 1;
-        
-        GtkTextIter line_end = iter;
-        if (!gtk_text_iter_ends_line(&line_end)) gtk_text_iter_forward_to_line_end(&line_end);
-        
-        // Use the buffer to get text, avoiding the "too many arguments" error
-        gchar *line_text = gtk_text_buffer_get_text(GTK_TEXT_BUFFER(app->buffer), &iter, &line_end, FALSE);
-        const char *ptr = line_text;
-        while (*ptr && isspace(*ptr)) ptr++;
-        
-        // Simple C function detection
-        if (*ptr != '\0' && strstr(ptr, "(") && !strstr(ptr, ";") && 
-            !strstr(ptr, "if") && !strstr(ptr, "while") && !strstr(ptr, "for")) {
-            
-            if (!has_funcs) {
-                gtk_tree_store_append(app->tree_store, &func_iter, NULL);
-                gtk_tree_store_set(app->tree_store, &func_iter, COL_NAME, "Functions", COL_LINE, 0, -1);
-                has_funcs = TRUE;
-            }
-            GtkTreeIter child;
-            gtk_tree_store_append(app->tree_store, &child, &func_iter);
-            gtk_tree_store_set(app->tree_store, &child, COL_NAME, ptr, COL_LINE, line_num, -1);
-        }
-        g_free(line_text);
-        if (!gtk_text_iter_forward_line(&iter)) break;
+
+static void watch_stat(FileWatch *watch) {
+    GStatBuf st;
+
+    watch->mtime = watch->size = -1;
+    if (watch->path && g_stat(watch->path, &st) == 0) {
+        watch->mtime = st.st_mtime;
+        watch->size = st.st_size;
     }
-    gtk_tree_view_expand_all(GTK_TREE_VIEW(app->tree_view));
 }
 
-static void on_new(GtkWidget *widget, gpointer data) {
-    EditorApp *app = (EditorApp *)data;
-    gtk_text_buffer_set_text(GTK_TEXT_BUFFER(app->buffer), "", -1);
-    if (app->current_file) {
-        g_free(app->current_file);
-        app->current_file = NULL;
-    }
-    gtk_tree_store_clear(app->tree_store);
+/* The disk now holds text (read or written): merge against it from here on */
+static void watch_set_base(FileWatch *watch, gchar *text, gsize len) {
+    g_free(watch->base);
+    watch->base = text;
+    watch->hash = sc_hash64(text, len);
+    watch_stat(watch);
+}
+
+static void watch_hide_bar(FileWatch *watch) {
+    if (watch->pending) watch_job_free(watch->pending);
+    watch->pending = NULL;
+    gtk_widget_hide(watch->bar);
+}
+
+static void watch_check(EditorApp *app);
+
+/* After a reload or merge: the sidebar and status bar follow the new text */
+static void watch_applied(EditorApp *app, WatchJob *job) {
+    watch_set_base(app->watch, job->disk_text, job->disk_len);
+    job->disk_text = NULL;
+    parse_symbols(app);
     update_status(app);
 }
 
-static void on_open(GtkWidget *widget, gpointer data) {
+static void on_watch_done(GObject *source, GAsyncResult *result, gpointer data) {
     EditorApp *app = (EditorApp *)data;
-    GtkWidget *dialog;
-    GtkFileChooserAction action = GTK_FILE_CHOOSER_ACTION_OPEN;
-    gint res;
-    
-    dialog = gtk_file_chooser_dialog_new("Open File", GTK_WINDOW(app->window),
-                                         action, "_Cancel", GTK_RESPONSE_CANCEL,
-                                         "_Open", GTK_RESPONSE_ACCEPT, NULL);
-    
-    res = gtk_dialog_run(GTK_DIALOG(dialog));
-    if (res == GTK_RESPONSE_ACCEPT) {
-        GtkFileChooser *chooser = GTK_FILE_CHOOSER(dialog);
-        gchar *filename = gtk_file_chooser_get_filename(chooser);
-        gchar *contents;
-        gsize length;
-        
-        if (g_file_get_contents(filename, &contents, &length, NULL)) {
-            gtk_text_buffer_set_text(GTK_TEXT_BUFFER(app->buffer), contents, length);
-            g_free(contents);
-            
-            if (app->current_file)
-                g_free(app->current_file);
-            app->current_file = g_strdup(filename);
-            
-            /* Auto-detect language */
-            GtkSourceLanguageManager *lm = gtk_source_language_manager_get_default();
-            GtkSourceLanguage *lang = gtk_source_language_manager_guess_language(lm, filename, NULL);
-            gtk_source_buffer_set_language(app->buffer, lang);
-            
-            parse_symbols(app);
-            update_status(app);
-        }
-        g_free(filename);
+    FileWatch *watch = app->watch;
+    WatchJob *job = g_task_propagate_pointer(G_TASK(result), NULL);
+
+    watch->busy = FALSE;
+    /* Another file, a save, or an edit since the text was taken: the result is stale */
+    if (job->serial != watch->serial || job->edits != watch->edits) {
+        if (job->serial == watch->serial) watch->again = TRUE;
+        watch_job_free(job);
+    } else if (!job->changed) {
+        watch_hide_bar(watch);    /* changed back, or never really changed */
+        watch_job_free(job);
+    } else if (!job->deleted && !job->whole &&
+               !gtk_text_buffer_get_modified(GTK_TEXT_BUFFER(app->buffer))) {
+        watch_apply(app, job->reload);
+        gtk_text_buffer_set_modified(GTK_TEXT_BUFFER(app->buffer), FALSE);
+        g_print("Reloaded %s: %u changed block(s)\n", job->path, job->reload->len);
+        watch_applied(app, job);
+        watch_hide_bar(watch);
+        watch_job_free(job);
+    } else {
+        gchar *basename = g_path_get_basename(job->path);
+        gchar *message;
+        if (job->deleted)
+            message = g_strdup_printf("%s was deleted on disk. Save to write it again.", basename);
+        else if (job->merge && job->conflicts)
+            message = g_strdup_printf("%s changed on disk. Merging leaves %d conflict(s) to resolve.",
+                                      basename, job->conflicts);
+        else
+            message = g_strdup_printf("%s changed on disk.", basename);
+        gtk_label_set_text(GTK_LABEL(watch->label), message);
+        gtk_widget_set_visible(watch->merge_button, job->merge != NULL);
+        gtk_widget_set_visible(watch->reload_button, !job->deleted);
+        if (watch->pending) watch_job_free(watch->pending);
+        watch->pending = job;
+        gtk_widget_show(watch->bar);
+        g_free(message);
+        g_free(basename);
+    }
+
+    if (watch->again) {
+        watch->again = FALSE;
+        watch_check(app);
     }
-    gtk_widget_destroy(dialog);
 }
 
-static void on_save(GtkWidget *widget, gpointer data) {
+static void watch_check(EditorApp *app) {
+    FileWatch *watch = app->watch;
+
+    if (!watch->path) return;
+    if (watch->busy) {
+        watch->again = TRUE;
+        return;
+    }
+
+    WatchJob *job = g_new0(WatchJob, 1);
+    job->path = g_strdup(watch->path);
+    job->serial = watch->serial;
+    job->edits = watch->edits;
+    job->known_hash = watch->hash;
+    if (!app->long_lines) {
+        /* Folded lines included: the hunks are applied to the whole buffer */
+        job->buffer_text = get_save_text(app);
+        job->base_text = g_strdup(watch->base);
+    }
+
+    GTask *task = g_task_new(NULL, NULL, on_watch_done, app);
+    g_task_set_task_data(task, job, NULL);
+    watch->busy = TRUE;
+    g_task_run_in_thread(task, watch_worker);
+    g_object_unref(task);
+}
+
+static gboolean watch_settle_timeout(gpointer data) {
     EditorApp *app = (EditorApp *)data;
-    
-    if (!app->current_file) {
-        on_save_as(widget, data);
+    app->watch->settle = 0;
+    watch_check(app);
+    return G_SOURCE_REMOVE;
+}
+
+/* An editor saving writes, renames and touches: one check once the events stop */
+static void on_watch_event(GFileMonitor *monitor, GFile *file, GFile *other, GFileMonitorEvent event, gpointer data) {
+    EditorApp *app = (EditorApp *)data;
+    FileWatch *watch = app->watch;
+
+    if (event == G_FILE_MONITOR_EVENT_ATTRIBUTE_CHANGED) return;
+    if (watch->settle) g_source_remove(watch->settle);
+    watch->settle = g_timeout_add(WATCH_SETTLE_DELAY, watch_settle_timeout, app);
+}
+
+static void on_watch_response(GtkInfoBar *bar, gint response, gpointer data) {
+    EditorApp *app = (EditorApp *)data;
+    FileWatch *watch = app->watch;
+    WatchJob *job = watch->pending;
+
+    gtk_widget_hide(watch->bar);
+    if (!job) return;
+    /* Typed into since the diff: redo it rather than apply line numbers that moved */
+    if (job->edits != watch->edits && response != WATCH_KEEP) {
+        watch_check(app);
         return;
     }
-    
-    GtkTextIter start, end;
-    gtk_text_buffer_get_bounds(GTK_TEXT_BUFFER(app->buffer), &start, &end);
-    gchar *text = gtk_text_buffer_get_text(GTK_TEXT_BUFFER(app->buffer), &start, &end, FALSE);
-    
-    g_file_set_contents(app->current_file, text, -1, NULL);
-    g_free(text);
-    
-    parse_symbols(app);
+    /* load_file below replaces the watch, and with it anything still pending */
+    watch->pending = NULL;
+
+    if (response == WATCH_KEEP) {
+        /* The next save overwrites the disk version without asking */
+        if (job->disk_text) {
+            watch_set_base(watch, job->disk_text, job->disk_len);
+            job->disk_text = NULL;
+        } else {
+            watch->hash = 0;
+            watch_stat(watch);
+        }
+    } else if (response == WATCH_RELOAD && job->whole) {
+        load_file(app, job->path);
+    } else if (response == WATCH_RELOAD && job->reload) {
+        watch_apply(app, job->reload);
+        gtk_text_buffer_set_modified(GTK_TEXT_BUFFER(app->buffer), FALSE);
+        watch_applied(app, job);
+    } else if (response == WATCH_MERGE && job->merge) {
+        watch_apply(app, job->merge);
+        g_print("Merged %s: %u block(s), %d conflict(s)\n", job->path, job->merge->len, job->conflicts);
+        watch_applied(app, job);
+    }
+    watch_job_free(job);
 }
 
-static void on_save_as(GtkWidget *widget, gpointer data) {
+static void on_watch_buffer_changed(GtkTextBuffer *buffer, gpointer data) {
     EditorApp *app = (EditorApp *)data;
-    GtkWidget *dialog;
-    GtkFileChooser *chooser;
-    GtkFileChooserAction action = GTK_FILE_CHOOSER_ACTION_SAVE;
-    gint res;
-    
-    dialog = gtk_file_chooser_dialog_new("Save File", GTK_WINDOW(app->window),
-                                         action, "_Cancel", GTK_RESPONSE_CANCEL,
-                                         "_Save", GTK_RESPONSE_ACCEPT, NULL);
-    chooser = GTK_FILE_CHOOSER(dialog);
-    
-    gtk_file_chooser_set_do_overwrite_confirmation(chooser, TRUE);
-    
-    res = gtk_dialog_run(GTK_DIALOG(dialog));
-    if (res == GTK_RESPONSE_ACCEPT) {
-        gchar *filename = gtk_file_chooser_get_filename(chooser);
-        
-        GtkTextIter start, end;
-        gtk_text_buffer_get_bounds(GTK_TEXT_BUFFER(app->buffer), &start, &end);
-        gchar *text = gtk_text_buffer_get_text(GTK_TEXT_BUFFER(app->buffer), &start, &end, FALSE);
-        
-        g_file_set_contents(filename, text, -1, NULL);
-        g_free(text);
-        
-        if (app->current_file)
-            g_free(app->current_file);
-        app->current_file = g_strdup(filename);
-        
-        parse_symbols(app);
-        update_status(app);
-        g_free(filename);
+    app->watch->edits++;
+}
+
+/* Watch path, whose contents (as on disk) were just loaded into or saved from the buffer */
+static void file_watch_start(EditorApp *app, const gchar *path, const gchar *text, gssize len) {
+    FileWatch *watch = app->watch;
+
+    if (len < 0) len = strlen(text);
+    watch->serial++;
+    watch_hide_bar(watch);
+    if (g_strcmp0(path, watch->path) != 0) {
+        if (watch->monitor) {
+            g_file_monitor_cancel(watch->monitor);
+            g_object_unref(watch->monitor);
+            watch->monitor = NULL;
+        }
+        g_free(watch->path);
+        watch->path = g_strdup(path);
+        if (path) {
+            GFile *file = g_file_new_for_path(path);
+            watch->monitor = g_file_monitor_file(file, G_FILE_MONITOR_NONE, NULL, NULL);
+            if (watch->monitor)
+                g_signal_connect(watch->monitor, "changed", G_CALLBACK(on_watch_event), app);
+            g_object_unref(file);
+        }
     }
-    gtk_widget_destroy(dialog);
+    watch_set_base(watch, g_strndup(text, len), len);
 }
 
-static void on_quit(GtkWidget *widget, gpointer data) {
-    gtk_main_quit();
+static void file_watch_stop(EditorApp *app) {
+    file_watch_start(app, NULL, "", 0);
 }
 
-static void on_refresh_symbols(GtkWidget *widget, gpointer data) {
-    EditorApp *app = (EditorApp *)data;
-    parse_symbols(app);
+/* Before on_save overwrites the file: TRUE unless it changed on disk and the user backs out */
+static gboolean file_watch_confirm_save(EditorApp *app) {
+    FileWatch *watch = app->watch;
+    GStatBuf st;
+    gchar *contents;
+    gsize length;
+
+    if (!watch->path || g_strcmp0(watch->path, app->current_file) != 0) return TRUE;
+    if (g_stat(watch->path, &st) != 0) return TRUE;
+    if (st.st_mtime == watch->mtime && st.st_size == watch->size) return TRUE;
+    if (!g_file_get_contents(watch->path, &contents, &length, NULL)) return TRUE;
+    gboolean same = sc_hash64(contents, length) == watch->hash;
+    g_free(contents);
+    if (same || app->replay) return TRUE;
+
+    gchar *basename = g_path_get_basename(watch->path);
+    GtkWidget *dialog = gtk_message_dialog_new(GTK_WINDOW(app->window),
+                            GTK_DIALOG_DESTROY_WITH_PARENT | GTK_DIALOG_MODAL,
+                            GTK_MESSAGE_WARNING, GTK_BUTTONS_NONE,
+                            "%s changed on disk since it was opened.", basename);
+    gtk_message_dialog_format_secondary_text(GTK_MESSAGE_DIALOG(dialog),
+        "Saving replaces those changes with the buffer.");
+    gtk_dialog_add_buttons(GTK_DIALOG(dialog), "_Cancel", GTK_RESPONSE_CANCEL,
+                           "_Overwrite", GTK_RESPONSE_ACCEPT, NULL);
+    gtk_dialog_set_default_response(GTK_DIALOG(dialog), GTK_RESPONSE_CANCEL);
+    gint response = gtk_dialog_run(GTK_DIALOG(dialog));
+    gtk_widget_destroy(dialog);
+    g_free(basename);
+    return response == GTK_RESPONSE_ACCEPT;
 }
 
-/* Function to show the updates in a popup */
-static void show_update_notes(GtkWidget *widget, gpointer data) {
-    GtkWidget *parent = (GtkWidget *)data;
-    GtkWidget *msg_dialog = gtk_message_dialog_new(GTK_WINDOW(parent),
-        GTK_DIALOG_MODAL | GTK_DIALOG_DESTROY_WITH_PARENT,
-        GTK_MESSAGE_INFO,
-        GTK_BUTTONS_OK,
-        "Scrible Sketch Book - v2.9 Updates");
+/* Info bar under the menu bar; buffer edits are counted so stale diffs are noticed */
+static void setup_file_watch(EditorApp *app, GtkWidget *vbox) {
+    FileWatch *watch = g_new0(FileWatch, 1);
+
+    watch->bar = gtk_info_bar_new();
+    gtk_info_bar_set_message_type(GTK_INFO_BAR(watch->bar), GTK_MESSAGE_WARNING);
+    watch->label = gtk_label_new(NULL);
+    gtk_label_set_xalign(GTK_LABEL(watch->label), 0.0);
+    gtk_container_add(GTK_CONTAINER(gtk_info_bar_get_content_area(GTK_INFO_BAR(watch->bar))), watch->label);
+    watch->merge_button = gtk_info_bar_add_button(GTK_INFO_BAR(watch->bar), "_Merge", WATCH_MERGE);
+    watch->reload_button = gtk_info_bar_add_button(GTK_INFO_BAR(watch->bar), "_Reload", WATCH_RELOAD);
+    gtk_info_bar_add_button(GTK_INFO_BAR(watch->bar), "_Keep Mine", WATCH_KEEP);
+    g_signal_connect(watch->bar, "response", G_CALLBACK(on_watch_response), app);
+    gtk_widget_show_all(watch->bar);
+    gtk_widget_hide(watch->bar);
+    gtk_widget_set_no_show_all(watch->bar, TRUE);
+    gtk_box_pack_start(GTK_BOX(vbox), watch->bar, FALSE, FALSE, 0);
+    gtk_box_reorder_child(GTK_BOX(vbox), watch->bar, 1);
+    watch->mtime = watch->size = -1;
+    app->watch = watch;
+
+    g_signal_connect(app->buffer, "changed", G_CALLBACK(on_watch_buffer_changed), app);
+}
+
+/*
+ * Latency instrumentation
+ * Off unless --latency-report / --latency-hud or View > Latency HUD turns it
+ * on; until then none of the hooks below are connected. When on, each hook
+ * is a g_get_monotonic_time() call and a histogram bucket increment.
+ * Turned on from the menu, the buffer hooks are connected after the editor's
+ * own handlers, so those three metrics then miss the earlier handlers.
+ *   key to paint   key-press on the view until the next frame's after-paint
+ *   insert/delete  insert-text / delete-range emission, all handlers included
+ *   mark-set       mark-set emission (cursor moves, status bar updates)
+ *   layout, paint  GdkFrameClock phases of the editor window
+ */
+static const gchar *latency_names[N_LATENCY] = {
+    "key to paint", "insert-text", "delete-range", "mark-set", "frame layout", "frame paint"
+};
+
+static inline void latency_begin(LatencyStats *stats, gint which) {
+    stats->start[which] = g_get_monotonic_time();
+}
 
-    gtk_message_dialog_format_secondary_text(GTK_MESSAGE_DIALOG(msg_dialog),
-        "• Added GCC Quick Build & Run system.\n"
-        "• Integrated ANSI C syntax highlighting.\n"
-        "• Font size and safe font dialog update.\n"
-        "• Improved symbol browser navigation.\n\n"
-        "Note: fixed library header bug in this version "
-        "of Scrible. \n"
-        " ");
+static inline void latency_end(LatencyStats *stats, gint which) {
+    if (stats->start[which] == 0) return;
+    sc_hist_add(&stats->hist[which], g_get_monotonic_time() - stats->start[which]);
+    stats->start[which] = 0;
+}
 
-    gtk_dialog_run(GTK_DIALOG(msg_dialog));
-    gtk_widget_destroy(msg_dialog);
+static gboolean on_latency_key_press(GtkWidget *widget, GdkEventKey *event, gpointer data) {
+    LatencyStats *stats = ((EditorApp *)data)->latency;
+    if (stats->start[LATENCY_KEY_TO_PAINT] == 0)
+        latency_begin(stats, LATENCY_KEY_TO_PAINT);
+    return FALSE;
 }
 
-static void on_about(GtkWidget *widget, gpointer data) {
-    EditorApp *app = (EditorApp *)data;
-    GtkWidget *dialog;
-    GtkCssProvider *provider;
-    GtkStyleContext *context;
-    
-    dialog = gtk_about_dialog_new();
-    
-    /*  Add the "Update Notes" Button at the top */
-    GtkWidget *content_area = gtk_dialog_get_content_area(GTK_DIALOG(dialog));
-    GtkWidget *update_btn = gtk_button_new_with_label("✨ View What's New");
-    
-    // Pack it at the top (index 0)
-    gtk_box_pack_start(GTK_BOX(content_area), update_btn, FALSE, FALSE, 10);
-    gtk_box_reorder_child(GTK_BOX(content_area), update_btn, 0);
-    
-    // Connect the click signal
-    g_signal_connect(update_btn, "clicked", G_CALLBACK(show_update_notes), dialog);
+static void on_latency_insert_begin(GtkTextBuffer *buffer, GtkTextIter *location,
+                                    gchar *text, gint len, gpointer data) {
+    latency_begin(((EditorApp *)data)->latency, LATENCY_INSERT_TEXT);
+}
 
-    /*  Standard Info */
-    gtk_about_dialog_set_program_name(GTK_ABOUT_DIALOG(dialog), "Scrible Sketch Book");
-    gtk_about_dialog_set_version(GTK_ABOUT_DIALOG(dialog), "Version 2.9");
-    gtk_about_dialog_set_logo_icon_name(GTK_ABOUT_DIALOG(dialog), "accessories-text-editor");
-    gtk_about_dialog_set_license_type(GTK_ABOUT_DIALOG(dialog), GTK_LICENSE_GPL_3_0);
-    gtk_about_dialog_set_website(GTK_ABOUT_DIALOG(dialog), "https://github.com/oneneoncoffee/");
-   
-    gtk_about_dialog_set_comments(GTK_ABOUT_DIALOG(dialog), 
-        "A GTK+ 3 code editor with syntax highlighting.\n"
-        "This software is 100% free and open source.");
+static void on_latency_insert_end(GtkTextBuffer *buffer, GtkTextIter *location,
+                                  gchar *text, gint len, gpointer data) {
+    latency_end(((EditorApp *)data)->latency, LATENCY_INSERT_TEXT);
+}
 
-    const gchar *authors[] = {"Johnny Buckallew Stroud", "Contributor Name", "Special thanks to Jesus!", NULL};
-    gtk_about_dialog_set_authors(GTK_ABOUT_DIALOG(dialog), authors);
+static void on_latency_delete_begin(GtkTextBuffer *buffer, GtkTextIter *start,
+                                    GtkTextIter *end, gpointer data) {
+    latency_begin(((EditorApp *)data)->latency, LATENCY_DELETE_RANGE);
+}
 
-    /* Apply Black & Gold Theme ONLY to this dialog */
-    provider = gtk_css_provider_new();
-    const gchar *css = 
-        "dialog, grid, box, stack, scrolledwindow, viewport, list, row { background-color: #000000; }"
-        "label { color: #ffffff; font-weight: bold; }"
-        "label.title { color: #ffa600; font-size: 1.2em; }"
-        "button { background-color: #222222; color: #ffa600; border: 1px solid #ffa600; }";
-    
-    gtk_css_provider_load_from_data(provider, css, -1, NULL);
-    
-    context = gtk_widget_get_style_context(dialog);
-    gtk_style_context_add_provider(context, GTK_STYLE_PROVIDER(provider), 
-                                   GTK_STYLE_PROVIDER_PRIORITY_APPLICATION);
-    
-    /* Show and Run */
-    gtk_window_set_transient_for(GTK_WINDOW(dialog), GTK_WINDOW(app->window));
-    gtk_widget_show_all(dialog); // Necessary to make the manually added button appear
-    gtk_dialog_run(GTK_DIALOG(dialog));
-    
-    /* Cleanup */
-    g_object_unref(provider);
-    gtk_widget_destroy(dialog);
+static void on_latency_delete_end(GtkTextBuffer *buffer, GtkTextIter *start,
+                                  GtkTextIter *end, gpointer data) {
+    latency_end(((EditorApp *)data)->latency, LATENCY_DELETE_RANGE);
 }
 
+static void on_latency_mark_begin(GtkTextBuffer *buffer, GtkTextIter *location,
+                                  GtkTextMark *mark, gpointer data) {
+    latency_begin(((EditorApp *)data)->latency, LATENCY_MARK_SET);
+}
 
-/* Editor menu call backs */
-static void on_undo(GtkWidget *widget, gpointer data) {
-    EditorApp *app = (EditorApp *)data;
-    /* Use GTK_SOURCE_IS_BUFFER instead of GTK_IS_SOURCE_BUFFER */
-    if (GTK_SOURCE_IS_BUFFER(app->buffer) && gtk_source_buffer_can_undo(app->buffer)) {
-        gtk_source_buffer_undo(app->buffer);
-    }
+static void on_latency_mark_end(GtkTextBuffer *buffer, GtkTextIter *location,
+                                GtkTextMark *mark, gpointer data) {
+    latency_end(((EditorApp *)data)->latency, LATENCY_MARK_SET);
 }
 
-static void on_redo(GtkWidget *widget, gpointer data) {
-    EditorApp *app = (EditorApp *)data;
-    /* Use GTK_SOURCE_IS_BUFFER instead of GTK_IS_SOURCE_BUFFER */
-    if (GTK_SOURCE_IS_BUFFER(app->buffer) && gtk_source_buffer_can_redo(app->buffer)) {
-        gtk_source_buffer_redo(app->buffer);
-    }
+static void on_latency_layout(GdkFrameClock *clock, gpointer data) {
+    latency_begin(((EditorApp *)data)->latency, LATENCY_LAYOUT);
 }
-static void on_cut(GtkWidget *widget, gpointer data) {
-    EditorApp *app = (EditorApp *)data;
-    gtk_text_buffer_cut_clipboard(GTK_TEXT_BUFFER(app->buffer), gtk_clipboard_get(GDK_SELECTION_CLIPBOARD), TRUE);
+
+static void on_latency_paint(GdkFrameClock *clock, gpointer data) {
+    LatencyStats *stats = ((EditorApp *)data)->latency;
+    latency_end(stats, LATENCY_LAYOUT);
+    latency_begin(stats, LATENCY_PAINT);
 }
 
-static void on_copy(GtkWidget *widget, gpointer data) {
-    EditorApp *app = (EditorApp *)data;
-    gtk_text_buffer_copy_clipboard(GTK_TEXT_BUFFER(app->buffer), gtk_clipboard_get(GDK_SELECTION_CLIPBOARD));
+static void on_latency_after_paint(GdkFrameClock *clock, gpointer data) {
+    LatencyStats *stats = ((EditorApp *)data)->latency;
+    latency_end(stats, LATENCY_PAINT);
+    latency_end(stats, LATENCY_KEY_TO_PAINT);
 }
 
-static void on_paste(GtkWidget *widget, gpointer data) {
-    EditorApp *app = (EditorApp *)data;
-    gtk_text_buffer_paste_clipboard(GTK_TEXT_BUFFER(app->buffer), gtk_clipboard_get(GDK_SELECTION_CLIPBOARD), NULL, TRUE);
+static void connect_frame_clock_hooks(GtkWidget *window, gpointer data) {
+    GdkFrameClock *clock = gtk_widget_get_frame_clock(window);
+    g_signal_connect(clock, "layout", G_CALLBACK(on_latency_layout), data);
+    g_signal_connect(clock, "paint", G_CALLBACK(on_latency_paint), data);
+    g_signal_connect_after(clock, "after-paint", G_CALLBACK(on_latency_after_paint), data);
 }
 
-static void on_delete(GtkWidget *widget, gpointer data) {
-    EditorApp *app = (EditorApp *)data;
-    gtk_text_buffer_delete_selection(GTK_TEXT_BUFFER(app->buffer), TRUE, TRUE);
+/* Allocate the histograms and connect the hooks, once */
+static void enable_latency_stats(EditorApp *app) {
+    if (app->latency) return;
+    
+    app->latency = g_new0(LatencyStats, 1);
+    for (gint i = 0; i < N_LATENCY; i++)
+        sc_hist_reset(&app->latency->hist[i]);
+    
+    g_signal_connect(app->view, "key-press-event", G_CALLBACK(on_latency_key_press), app);
+    g_signal_connect(app->buffer, "insert-text", G_CALLBACK(on_latency_insert_begin), app);
+    g_signal_connect_after(app->buffer, "insert-text", G_CALLBACK(on_latency_insert_end), app);
+    g_signal_connect(app->buffer, "delete-range", G_CALLBACK(on_latency_delete_begin), app);
+    g_signal_connect_after(app->buffer, "delete-range", G_CALLBACK(on_latency_delete_end), app);
+    g_signal_connect(app->buffer, "mark-set", G_CALLBACK(on_latency_mark_begin), app);
+    g_signal_connect_after(app->buffer, "mark-set", G_CALLBACK(on_latency_mark_end), app);
+    
+    if (gtk_widget_get_realized(app->window))
+        connect_frame_clock_hooks(app->window, app);
+    else
+        g_signal_connect(app->window, "realize", G_CALLBACK(connect_frame_clock_hooks), app);
 }
 
-static void on_select_all(GtkWidget *widget, gpointer data) {
-    EditorApp *app = (EditorApp *)data;
-    GtkTextIter start, end;
-    gtk_text_buffer_get_bounds(GTK_TEXT_BUFFER(app->buffer), &start, &end);
-    gtk_text_buffer_select_range(GTK_TEXT_BUFFER(app->buffer), &start, &end);
+static void print_latency_report(EditorApp *app) {
+    g_print("\n=== Latency Report (ms) ===\n");
+    g_print("%-14s %8s %8s %8s %8s %8s\n", "", "count", "p50", "p95", "p99", "max");
+    for (gint i = 0; i < N_LATENCY; i++) {
+        sc_histogram *h = &app->latency->hist[i];
+        g_print("%-14s %8llu %8.2f %8.2f %8.2f %8.2f\n", latency_names[i], h->count,
+                sc_hist_percentile(h, 50) / 1000.0, sc_hist_percentile(h, 95) / 1000.0,
+                sc_hist_percentile(h, 99) / 1000.0, h->max / 1000.0);
+    }
 }
-/* Additional Control Structure Snippets */
-static void on_insert_do_while(GtkWidget *widget, gpointer data) {
+
+static gboolean update_latency_hud(gpointer data) {
     EditorApp *app = (EditorApp *)data;
-    const char *code = "do {\n    \n} while (condition);\n";
-    insert_at_cursor(app, code);
+    GString *text = g_string_new(NULL);
+    
+    for (gint i = 0; i < N_LATENCY; i++) {
+        sc_histogram *h = &app->latency->hist[i];
+        if (i > 0) g_string_append_c(text, '\n');
+        g_string_append_printf(text, "%-13s p50 %6.2f  p95 %6.2f  p99 %6.2f ms", latency_names[i],
+                               sc_hist_percentile(h, 50) / 1000.0, sc_hist_percentile(h, 95) / 1000.0,
+                               sc_hist_percentile(h, 99) / 1000.0);
+    }
+    gtk_label_set_text(GTK_LABEL(app->latency->hud), text->str);
+    g_string_free(text, TRUE);
+    return G_SOURCE_CONTINUE;
 }
 
-static void on_insert_if(GtkWidget *widget, gpointer data) {
-    EditorApp *app = (EditorApp *)data;
-    const char *code = "if (condition) {\n    \n}\n";
-    insert_at_cursor(app, code);
+static void show_latency_hud(EditorApp *app, gboolean show) {
+    LatencyStats *stats;
+    
+    if (show) enable_latency_stats(app);
+    stats = app->latency;
+    if (!stats) return;
+    
+    if (!stats->hud) {
+        stats->hud = gtk_label_new(NULL);
+        gtk_widget_set_name(stats->hud, "latency-hud");
+        gtk_widget_set_halign(stats->hud, GTK_ALIGN_END);
+        gtk_widget_set_valign(stats->hud, GTK_ALIGN_START);
+        gtk_widget_set_margin_end(stats->hud, 20);
+        gtk_widget_set_margin_top(stats->hud, 8);
+        gtk_widget_set_opacity(stats->hud, 0.85);
+        
+        GtkCssProvider *css = gtk_css_provider_new();
+        gtk_css_provider_load_from_data(css,
+            "#latency-hud { font-family: monospace; font-size: 9pt; color: #e0e0e0;"
+            " background-color: rgba(0,0,0,0.7); padding: 6px; border-radius: 4px; }", -1, NULL);
+        gtk_style_context_add_provider(gtk_widget_get_style_context(stats->hud),
+                                       GTK_STYLE_PROVIDER(css), GTK_STYLE_PROVIDER_PRIORITY_APPLICATION);
+        g_object_unref(css);
+        
+        gtk_overlay_add_overlay(GTK_OVERLAY(app->editor_overlay), stats->hud);
+        gtk_overlay_set_overlay_pass_through(GTK_OVERLAY(app->editor_overlay), stats->hud, TRUE);
+    }
+    
+    gtk_widget_set_visible(stats->hud, show);
+    if (show && !stats->hud_timeout) {
+        update_latency_hud(app);
+        stats->hud_timeout = g_timeout_add(500, update_latency_hud, app);
+    } else if (!show && stats->hud_timeout) {
+        g_source_remove(stats->hud_timeout);
+        stats->hud_timeout = 0;
+    }
 }
 
-/* Function Snippets */
-static void on_insert_void_function(GtkWidget *widget, gpointer data) {
+static void on_toggle_latency_hud(GtkCheckMenuItem *item, gpointer data) {
     EditorApp *app = (EditorApp *)data;
-    const char *code = 
-        "void function_name(void) {\n"
-        "    \n"
-        "}\n";
-    insert_at_cursor(app, code);
+    show_latency_hud(app, gtk_check_menu_item_get_active(item));
 }
 
-static void on_insert_int_function(GtkWidget *widget, gpointer data) {
-    EditorApp *app = (EditorApp *)data;
-    const char *code = 
-        "int function_name(int param) {\n"
-        "    \n"
-        "    return 0;\n"
-        "}\n";
-    insert_at_cursor(app, code);
+static void on_toggle_trace(GtkCheckMenuItem *item, gpointer data) {
+    if (gtk_check_menu_item_get_active(item)) trace_start();
+    else trace_stop();
 }
 
-static void on_insert_ptr_function(GtkWidget *widget, gpointer data) {
+static void on_save_trace(GtkWidget *widget, gpointer data) {
     EditorApp *app = (EditorApp *)data;
-    const char *code = 
-        "void *function_name(void *param) {\n"
-        "    \n"
-        "    return NULL;\n"
-        "}\n";
-    insert_at_cursor(app, code);
+    GtkWidget *dialog = gtk_file_chooser_dialog_new("Save Trace", GTK_WINDOW(app->window),
+                                                    GTK_FILE_CHOOSER_ACTION_SAVE,
+                                                    "_Cancel", GTK_RESPONSE_CANCEL,
+                                                    "_Save", GTK_RESPONSE_ACCEPT, NULL);
+    gtk_file_chooser_set_do_overwrite_confirmation(GTK_FILE_CHOOSER(dialog), TRUE);
+    gtk_file_chooser_set_current_name(GTK_FILE_CHOOSER(dialog), "scrible-trace.json");
+    
+    if (gtk_dialog_run(GTK_DIALOG(dialog)) == GTK_RESPONSE_ACCEPT) {
+        gchar *filename = gtk_file_chooser_get_filename(GTK_FILE_CHOOSER(dialog));
+        GError *error = NULL;
+        if (trace_write_json(filename, &error)) {
+            g_print("Trace written to %s\n", filename);
+        } else {
+            g_print("Could not write trace: %s\n", error->message);
+            g_error_free(error);
+        }
+        g_free(filename);
+    }
+    gtk_widget_destroy(dialog);
 }
 
-/* Data Structure Snippets */
-static void on_insert_typedef_struct(GtkWidget *widget, gpointer data) {
-    EditorApp *app = (EditorApp *)data;
-    const char *code = 
-        "typedef struct {\n"
-        "    int member1;\n"
-        "    char member2;\n"
-        "} struct_name_t;\n";
-    insert_at_cursor(app, code);
+/* Menu path of an item, "Edit > Go to Line...", as used by the palette */
+static gchar *menu_item_path(GtkWidget *item) {
+    GString *path = g_string_new(NULL);
+    
+    while (item && GTK_IS_MENU_ITEM(item)) {
+        gchar *label = menu_item_plain_label(item);
+        if (path->len > 0) g_string_prepend(path, " > ");
+        g_string_prepend(path, label ? label : "");
+        g_free(label);
+        
+        GtkWidget *menu = gtk_widget_get_parent(item);
+        item = GTK_IS_MENU(menu) ? gtk_menu_get_attach_widget(GTK_MENU(menu)) : NULL;
+    }
+    return g_string_free(path, FALSE);
 }
 
-static void on_insert_enum(GtkWidget *widget, gpointer data) {
+/* Emission hook on GtkMenuItem::activate, sees every menu action */
+static gboolean record_menu_hook(GSignalInvocationHint *hint, guint n_params,
+                                 const GValue *params, gpointer data) {
     EditorApp *app = (EditorApp *)data;
-    const char *code = 
-        "enum enum_name {\n"
-        "    VALUE1,\n"
-        "    VALUE2,\n"
-        "    VALUE3\n"
-        "};\n";
-    insert_at_cursor(app, code);
+    GtkWidget *item = g_value_get_object(&params[0]);
+    GdkEvent *event = gtk_get_current_event();
+    gboolean from_key = FALSE;
+    
+    /* Accelerators on the main window are replayed by their key event */
+    if (event) {
+        GtkWidget *target = gtk_get_event_widget(event);
+        from_key = event->type == GDK_KEY_PRESS && target &&
+                   gtk_widget_get_toplevel(target) == app->window;
+        gdk_event_free(event);
+    }
+    
+    if (!from_key && !app->record_muted && !gtk_menu_item_get_submenu(GTK_MENU_ITEM(item)) &&
+        !g_object_get_data(G_OBJECT(item), "command-palette")) {
+        gchar *path = menu_item_path(item);
+        record_action(app, "menu %s", path);
+        g_free(path);
+    }
+    return TRUE;
 }
 
-static void on_insert_union(GtkWidget *widget, gpointer data) {
+static gboolean record_key_press(GtkWidget *widget, GdkEventKey *event, gpointer data) {
     EditorApp *app = (EditorApp *)data;
-    const char *code = 
-        "union union_name {\n"
-        "    int as_int;\n"
-        "    float as_float;\n"
-        "    char as_bytes[4];\n"
-        "};\n";
-    insert_at_cursor(app, code);
+    const gchar *name = gdk_keyval_name(event->keyval);
+    guint state = event->state & gtk_accelerator_get_default_mod_mask();
+    
+    /* The palette is not recorded, the command picked in it is; quick open is not either */
+    if (gdk_keyval_to_lower(event->keyval) == GDK_KEY_p &&
+        (state == (GDK_CONTROL_MASK | GDK_SHIFT_MASK) || state == GDK_CONTROL_MASK))
+        return FALSE;
+    if (name) record_action(app, "key %s 0x%x", name, state);
+    return FALSE;
 }
 
-static void on_insert_array(GtkWidget *widget, gpointer data) {
+static gboolean record_scroll(GtkWidget *widget, GdkEventScroll *event, gpointer data) {
     EditorApp *app = (EditorApp *)data;
-    const char *code = "int array[SIZE];\n";
-    insert_at_cursor(app, code);
+    gdouble dy = 0;
+    
+    if (event->direction == GDK_SCROLL_SMOOTH) dy = event->delta_y;
+    else if (event->direction == GDK_SCROLL_UP) dy = -1;
+    else if (event->direction == GDK_SCROLL_DOWN) dy = 1;
+    
+    if (dy != 0) record_action(app, "scroll %.3f", dy);
+    return FALSE;
 }
 
-/* Memory Management Snippets */
-static void on_insert_malloc(GtkWidget *widget, gpointer data) {
+static gboolean record_click(GtkWidget *widget, GdkEventButton *event, gpointer data) {
     EditorApp *app = (EditorApp *)data;
-    const char *code = 
-        "ptr = (type *)malloc(n * sizeof(type));\n"
-        "if (ptr == NULL) {\n"
-        "    fprintf(stderr, \"Memory allocation failed\\n\");\n"
-        "    exit(EXIT_FAILURE);\n"
-        "}\n";
-    insert_at_cursor(app, code);
+    GtkTextIter iter;
+    gint bx, by;
+    
+    if (event->type != GDK_BUTTON_PRESS || event->button != 1) return FALSE;
+    gtk_text_view_window_to_buffer_coords(GTK_TEXT_VIEW(app->view), GTK_TEXT_WINDOW_TEXT,
+                                          (gint)event->x, (gint)event->y, &bx, &by);
+    gtk_text_view_get_iter_at_location(GTK_TEXT_VIEW(app->view), &iter, bx, by);
+    record_action(app, "click %d %d", gtk_text_iter_get_line(&iter) + 1,
+                  gtk_text_iter_get_line_offset(&iter));
+    return FALSE;
 }
 
-static void on_insert_calloc(GtkWidget *widget, gpointer data) {
-    EditorApp *app = (EditorApp *)data;
-    const char *code = 
-        "ptr = (type *)calloc(n, sizeof(type));\n"
-        "if (ptr == NULL) {\n"
-        "    fprintf(stderr, \"Memory allocation failed\\n\");\n"
-        "    exit(EXIT_FAILURE);\n"
-        "}\n";
-    insert_at_cursor(app, code);
+static gboolean start_recording(EditorApp *app, const gchar *path) {
+    app->record_file = g_fopen(path, "w");
+    if (!app->record_file) {
+        g_print("Could not record to %s: %s\n", path, g_strerror(errno));
+        return FALSE;
+    }
+    setvbuf(app->record_file, NULL, _IOLBF, 0);
+    app->record_start = g_get_monotonic_time();
+    fprintf(app->record_file, "# scrible session, replay with: scrible --replay %s\n", path);
+    if (app->current_file) record_action(app, "open %s", app->current_file);
+    
+    g_signal_connect(app->window, "key-press-event", G_CALLBACK(record_key_press), app);
+    g_signal_connect(app->view, "scroll-event", G_CALLBACK(record_scroll), app);
+    g_signal_connect(app->view, "button-press-event", G_CALLBACK(record_click), app);
+    g_signal_add_emission_hook(g_signal_lookup("activate", GTK_TYPE_MENU_ITEM), 0,
+                               record_menu_hook, app, NULL);
+    return TRUE;
 }
 
-static void on_insert_realloc(GtkWidget *widget, gpointer data) {
-    EditorApp *app = (EditorApp *)data;
-    const char *code = 
-        "temp = realloc(ptr, new_size * sizeof(type));\n"
-        "if (temp == NULL) {\n"
-        "    fprintf(stderr, \"Reallocation failed\\n\");\n"
-        "    free(ptr);\n"
-        "    exit(EXIT_FAILURE);\n"
-        "}\n"
-        "ptr = temp;\n";
-    insert_at_cursor(app, code);
+/*
+ * Replay (--replay FILE)
+ * Verbs, one per line after the timestamp in ms:
+ *   key NAME [STATE]   key press + release, NAME as from gdk_keyval_name()
+ *   menu PATH          activate a menu item or snippet by its palette label
+ *   scroll DY          scroll the editor by DY wheel steps
+ *   click LINE COL     place the cursor
+ *   open FILE          load a file
+ *   type TEXT          insert TEXT at the cursor (\n and \t escapes)
+ *   goto LINE          jump to a line
+ * Blank lines and lines starting with '#' are ignored. Commands that open
+ * a modal dialog wait for it to be closed before the replay continues.
+ */
+typedef enum {
+    REPLAY_KEY,
+    REPLAY_MENU,
+    REPLAY_SCROLL,
+    REPLAY_CLICK,
+    REPLAY_OPEN,
+    REPLAY_TYPE,
+    REPLAY_GOTO
+} ReplayVerb;
+
+typedef struct {
+    gint64 at_ms;
+    ReplayVerb verb;
+    gchar *text;              /* menu path, file name or text to type */
+    guint keyval;
+    guint state;
+    gdouble dy;
+    gint line;
+    gint col;
+} ReplayAction;
+
+typedef struct ReplayState {
+    GArray *actions;          /* ReplayAction, in script order */
+    guint next;
+    gdouble speed;            /* 1 = recorded pace, 0 = as fast as possible */
+    gint64 started;
+    gint64 busy;              /* time spent inside the actions */
+    guint source;
+} ReplayState;
+
+static void replay_action_clear(gpointer data) {
+    g_free(((ReplayAction *)data)->text);
 }
 
-static void on_insert_free(GtkWidget *widget, gpointer data) {
-    EditorApp *app = (EditorApp *)data;
-    const char *code = 
-        "if (ptr != NULL) {\n"
-        "    free(ptr);\n"
-        "    ptr = NULL;\n"
-        "}\n";
-    insert_at_cursor(app, code);
+static gboolean replay_parse_line(const gchar *line, ReplayAction *action) {
+    gchar verb[16];
+    gint consumed = 0;
+    
+    memset(action, 0, sizeof(*action));
+    if (sscanf(line, "%" G_GINT64_FORMAT " %15s %n", &action->at_ms, verb, &consumed) < 2)
+        return FALSE;
+    const gchar *rest = line + consumed;
+    
+    if (strcmp(verb, "key") == 0) {
+        gchar name[64];
+        action->verb = REPLAY_KEY;
+        if (sscanf(rest, "%63s %x", name, &action->state) < 1) return FALSE;
+        action->keyval = gdk_keyval_from_name(name);
+        return action->keyval != GDK_KEY_VoidSymbol;
+    }
+    if (strcmp(verb, "scroll") == 0) {
+        action->verb = REPLAY_SCROLL;
+        action->dy = g_ascii_strtod(rest, NULL);
+        return TRUE;
+    }
+    if (strcmp(verb, "click") == 0) {
+        action->verb = REPLAY_CLICK;
+        return sscanf(rest, "%d %d", &action->line, &action->col) == 2;
+    }
+    if (strcmp(verb, "goto") == 0) {
+        action->verb = REPLAY_GOTO;
+        action->line = atoi(rest);
+        return action->line > 0;
+    }
+    if (strcmp(verb, "menu") == 0) action->verb = REPLAY_MENU;
+    else if (strcmp(verb, "open") == 0) action->verb = REPLAY_OPEN;
+    else if (strcmp(verb, "type") == 0) action->verb = REPLAY_TYPE;
+    else return FALSE;
+    
+    action->text = action->verb == REPLAY_TYPE ? g_strcompress(rest) : g_strstrip(g_strdup(rest));
+    return TRUE;
 }
 
-/* File I/O Snippets */
-static void on_insert_fopen_read(GtkWidget *widget, gpointer data) {
-    EditorApp *app = (EditorApp *)data;
-    const char *code = 
-        "FILE *fp = fopen(\"filename.txt\", \"r\");\n"
-        "if (fp == NULL) {\n"
-        "    perror(\"Error opening file\");\n"
-        "    return -1;\n"
-        "}\n"
-        "// Read operations here\n"
-        "fclose(fp);\n";
-    insert_at_cursor(app, code);
+static GArray *replay_load(const gchar *path, GError **error) {
+    gchar *contents;
+    
+    if (!g_file_get_contents(path, &contents, NULL, error))
+        return NULL;
+    
+    GArray *actions = g_array_new(FALSE, FALSE, sizeof(ReplayAction));
+    g_array_set_clear_func(actions, replay_action_clear);
+    gchar **lines = g_strsplit(contents, "\n", -1);
+    
+    for (gint i = 0; lines[i]; i++) {
+        const gchar *line = lines[i];
+        ReplayAction action;
+        while (g_ascii_isspace(*line)) line++;
+        if (*line == '\0' || *line == '#') continue;
+        if (replay_parse_line(line, &action)) g_array_append_val(actions, action);
+        else g_print("Replay: %s:%d: cannot parse \"%s\"\n", path, i + 1, line);
+    }
+    g_strfreev(lines);
+    g_free(contents);
+    return actions;
 }
 
-static void on_insert_fopen_write(GtkWidget *widget, gpointer data) {
-    EditorApp *app = (EditorApp *)data;
-    const char *code = 
-        "FILE *fp = fopen(\"filename.txt\", \"w\");\n"
-        "if (fp == NULL) {\n"
-        "    perror(\"Error opening file\");\n"
-        "    return -1;\n"
-        "}\n"
-        "// Write operations here\n"
-        "fclose(fp);\n";
-    insert_at_cursor(app, code);
+static void replay_key(EditorApp *app, guint keyval, guint state) {
+    GdkDisplay *display = gtk_widget_get_display(app->window);
+    GdkEvent *event = gdk_event_new(GDK_KEY_PRESS);
+    GdkKeymapKey *keys;
+    gint n_keys;
+    
+    event->key.window = g_object_ref(gtk_widget_get_window(app->window));
+    event->key.send_event = TRUE;
+    event->key.time = GDK_CURRENT_TIME;
+    event->key.keyval = keyval;
+    event->key.state = state;
+    if (gdk_keymap_get_entries_for_keyval(gdk_keymap_get_for_display(display), keyval, &keys, &n_keys)) {
+        event->key.hardware_keycode = keys[0].keycode;
+        event->key.group = keys[0].group;
+        g_free(keys);
+    }
+    gdk_event_set_device(event, gdk_seat_get_keyboard(gdk_display_get_default_seat(display)));
+    
+    gtk_main_do_event(event);
+    event->type = GDK_KEY_RELEASE;
+    gtk_main_do_event(event);
+    gdk_event_free(event);
 }
 
-static void on_insert_fread(GtkWidget *widget, gpointer data) {
-    EditorApp *app = (EditorApp *)data;
-    const char *code = 
-        "size_t items_read = fread(buffer, sizeof(type), count, fp);\n"
-        "if (items_read != count) {\n"
-        "    if (feof(fp)) {\n"
-        "        printf(\"End of file reached\\n\");\n"
-        "    } else if (ferror(fp)) {\n"
-        "        perror(\"Error reading file\");\n"
-        "    }\n"
-        "}\n";
-    insert_at_cursor(app, code);
+/* Smooth scroll event at the middle of the text, handled like the mouse wheel */
+static void replay_scroll(EditorApp *app, gdouble dy) {
+    GdkWindow *window = gtk_text_view_get_window(GTK_TEXT_VIEW(app->view), GTK_TEXT_WINDOW_TEXT);
+    GdkEvent *event = gdk_event_new(GDK_SCROLL);
+    GdkDisplay *display = gtk_widget_get_display(app->view);
+    
+    event->scroll.window = g_object_ref(window);
+    event->scroll.send_event = TRUE;
+    event->scroll.time = GDK_CURRENT_TIME;
+    event->scroll.direction = GDK_SCROLL_SMOOTH;
+    event->scroll.delta_y = dy;
+    event->scroll.x = gdk_window_get_width(window) / 2;
+    event->scroll.y = gdk_window_get_height(window) / 2;
+    gdk_event_set_device(event, gdk_seat_get_pointer(gdk_display_get_default_seat(display)));
+    
+    gtk_main_do_event(event);
+    gdk_event_free(event);
 }
 
-static void on_insert_fwrite(GtkWidget *widget, gpointer data) {
-    EditorApp *app = (EditorApp *)data;
-    const char *code = 
-        "size_t items_written = fwrite(buffer, sizeof(type), count, fp);\n"
-        "if (items_written != count) {\n"
-        "    perror(\"Error writing file\");\n"
-        "}\n";
-    insert_at_cursor(app, code);
+static void replay_menu(EditorApp *app, const gchar *path) {
+    build_command_index(app);
+    for (guint i = 0; i < app->commands->len; i++) {
+        PaletteEntry *entry = &g_array_index(app->commands, PaletteEntry, i);
+        if (strcmp(entry->label, path) == 0) {
+            palette_entry_run(app, entry);
+            return;
+        }
+    }
+    g_print("Replay: no menu item \"%s\"\n", path);
 }
 
-static void on_insert_fprintf(GtkWidget *widget, gpointer data) {
-    EditorApp *app = (EditorApp *)data;
-    const char *code = "fprintf(fp, \"format string\\n\", args);\n";
-    insert_at_cursor(app, code);
+static void replay_run(EditorApp *app, const ReplayAction *action) {
+    GtkTextBuffer *buffer = GTK_TEXT_BUFFER(app->buffer);
+    GtkTextIter iter;
+    
+    switch (action->verb) {
+    case REPLAY_KEY:
+        replay_key(app, action->keyval, action->state);
+        break;
+    case REPLAY_MENU:
+        replay_menu(app, action->text);
+        break;
+    case REPLAY_SCROLL:
+        replay_scroll(app, action->dy);
+        break;
+    case REPLAY_CLICK:
+        gtk_text_buffer_get_iter_at_line_offset(buffer, &iter, action->line - 1, 0);
+        gtk_text_iter_forward_chars(&iter, MIN(action->col, gtk_text_iter_get_chars_in_line(&iter)));
+        gtk_text_buffer_place_cursor(buffer, &iter);
+        gtk_widget_grab_focus(app->view);
+        break;
+    case REPLAY_OPEN:
+        if (!load_file(app, action->text))
+            g_print("Replay: could not open %s\n", action->text);
+        break;
+    case REPLAY_TYPE:
+        gtk_text_buffer_begin_user_action(buffer);
+        gtk_text_buffer_insert_at_cursor(buffer, action->text, -1);
+        gtk_text_buffer_end_user_action(buffer);
+        break;
+    case REPLAY_GOTO:
+        jump_to_line(app, action->line);
+        break;
+    }
 }
 
-static void on_insert_fscanf(GtkWidget *widget, gpointer data) {
+static gboolean replay_finish(gpointer data) {
     EditorApp *app = (EditorApp *)data;
-    const char *code = 
-        "if (fscanf(fp, \"format\", &var) != 1) {\n"
-        "    fprintf(stderr, \"Error reading input\\n\");\n"
-        "}\n";
-    insert_at_cursor(app, code);
+    ReplayState *replay = app->replay;
+    gint64 elapsed = g_get_monotonic_time() - replay->started;
+    
+    g_print("\n=== Replay ===\n");
+    g_print("actions:         %u\n", replay->actions->len);
+    g_print("script span:     %7.1f ms\n",
+            replay->actions->len ? (gdouble)g_array_index(replay->actions, ReplayAction,
+                                                          replay->actions->len - 1).at_ms : 0.0);
+    g_print("wall time:       %7.1f ms\n", elapsed / 1000.0);
+    g_print("action time:     %7.1f ms (running the actions themselves)\n", replay->busy / 1000.0);
+    print_latency_report(app);
+    
+    gtk_main_quit();
+    return G_SOURCE_REMOVE;
 }
 
-/* Section Comment Snippet */
-static void on_insert_section_comment(GtkWidget *widget, gpointer data) {
+/* Run every action that is due, then sleep until the next one */
+static gboolean replay_step(gpointer data) {
     EditorApp *app = (EditorApp *)data;
-    const char *comment = 
-        "/******************************************************************************\n"
-        " * Section: \n"
-        " * Description: \n"
-        " *****************************************************************************/\n\n";
-    insert_at_cursor(app, comment);
+    ReplayState *replay = app->replay;
+    
+    replay->source = 0;
+    while (replay->next < replay->actions->len) {
+        ReplayAction *action = &g_array_index(replay->actions, ReplayAction, replay->next);
+        gint64 due = replay->speed > 0 ? (gint64)(action->at_ms * 1000 / replay->speed) : 0;
+        gint64 now = g_get_monotonic_time() - replay->started;
+        
+        if (due > now) {
+            replay->source = g_timeout_add(MAX(1, (due - now) / 1000), replay_step, app);
+            return G_SOURCE_REMOVE;
+        }
+        
+        replay->next++;
+        TRACE_BEGIN("replay action");
+        gint64 t0 = g_get_monotonic_time();
+        replay_run(app, action);
+        replay->busy += g_get_monotonic_time() - t0;
+        TRACE_END("replay action");
+        
+        /* As fast as possible still lets each action reach the screen */
+        if (replay->speed <= 0) {
+            replay->source = g_idle_add_full(G_PRIORITY_LOW, replay_step, app, NULL);
+            return G_SOURCE_REMOVE;
+        }
+    }
+    
+    /* Low priority: runs after the last action has been painted */
+    g_idle_add_full(G_PRIORITY_LOW, replay_finish, app, NULL);
+    return G_SOURCE_REMOVE;
 }
 
-/* Insert add ANSI C outline */ 
-static void on_insert_ansi_c_program(GtkWidget *widget, gpointer data) {
+/* Scheduled by on_first_draw, after the file from argv has been loaded */
+static gboolean replay_begin(gpointer data) {
     EditorApp *app = (EditorApp *)data;
-    time_t now = time(NULL);
-    struct tm *t = localtime(&now);
-    char date_buf[64];
-    strftime(date_buf, sizeof(date_buf), "%Y-%m-%d", t);
-    
-    char buf[1024];
-    snprintf(buf, sizeof(buf),
-        "/*\n"
-        " * File: %s\n"
-        " * Author: \n"
-        " * Date: %s\n"
-        " * Description: \n"
-        " */\n\n"
-        "#include <stdio.h>\n"
-        "#include <stdlib.h>\n\n"
-        "int main(int argc, char *argv[]) {\n"
-        "    \n"
-        "    return 0;\n"
-        "}\n",
-        app->current_file ? g_path_get_basename(app->current_file) : "program.c",
-        date_buf);
-    
-    insert_at_cursor(app, buf);
+    
+    g_print("Replaying %u actions\n", app->replay->actions->len);
+    /* Keys are sent to the window, which hands them to its focus widget */
+    gtk_widget_grab_focus(app->view);
+    app->replay->started = g_get_monotonic_time();
+    return replay_step(app);
 }
 
+static gboolean load_replay(EditorApp *app, const gchar *path, gdouble speed) {
+    GError *error = NULL;
+    GArray *actions = replay_load(path, &error);
+    
+    if (!actions) {
+        g_print("Replay: %s\n", error->message);
+        g_error_free(error);
+        return FALSE;
+    }
+    app->replay = g_new0(ReplayState, 1);
+    app->replay->actions = actions;
+    app->replay->speed = speed;
+    return TRUE;
+}
 
 static void create_menubar(EditorApp *app, GtkWidget *vbox) {
     GtkWidget *menubar = gtk_menu_bar_new();
+    app->menubar = menubar;
     
     GtkAccelGroup *accel_group = gtk_accel_group_new();
     gtk_window_add_accel_group(GTK_WINDOW(app->window), accel_group);
@@ -2333,20 +9560,27 @@ static void create_menubar(EditorApp *app, GtkWidget *vbox) {
     
     GtkWidget *new_item = gtk_menu_item_new_with_label("New");
     GtkWidget *open_item = gtk_menu_item_new_with_label("Open");
+    GtkWidget *open_folder_item = gtk_menu_item_new_with_label("Open Folder...");
+    GtkWidget *quick_open_item = gtk_menu_item_new_with_label("Quick Open...");
     GtkWidget *save_item = gtk_menu_item_new_with_label("Save");
     GtkWidget *save_as_item = gtk_menu_item_new_with_label("Save As");
+    GtkWidget *export_tags_item = gtk_menu_item_new_with_label("Export Tags...");
     GtkWidget *quit_item = gtk_menu_item_new_with_label("Quit");
     
     // File Shortcuts
     gtk_widget_add_accelerator(new_item, "activate", accel_group, GDK_KEY_n, GDK_CONTROL_MASK, GTK_ACCEL_VISIBLE);
     gtk_widget_add_accelerator(open_item, "activate", accel_group, GDK_KEY_o, GDK_CONTROL_MASK, GTK_ACCEL_VISIBLE);
+    gtk_widget_add_accelerator(quick_open_item, "activate", accel_group, GDK_KEY_p, GDK_CONTROL_MASK, GTK_ACCEL_VISIBLE);
     gtk_widget_add_accelerator(save_item, "activate", accel_group, GDK_KEY_s, GDK_CONTROL_MASK, GTK_ACCEL_VISIBLE);
     gtk_widget_add_accelerator(quit_item, "activate", accel_group, GDK_KEY_q, GDK_CONTROL_MASK, GTK_ACCEL_VISIBLE);
 
     gtk_menu_shell_append(GTK_MENU_SHELL(file_menu), new_item);
     gtk_menu_shell_append(GTK_MENU_SHELL(file_menu), open_item);
+    gtk_menu_shell_append(GTK_MENU_SHELL(file_menu), open_folder_item);
+    gtk_menu_shell_append(GTK_MENU_SHELL(file_menu), quick_open_item);
     gtk_menu_shell_append(GTK_MENU_SHELL(file_menu), save_item);
     gtk_menu_shell_append(GTK_MENU_SHELL(file_menu), save_as_item);
+    gtk_menu_shell_append(GTK_MENU_SHELL(file_menu), export_tags_item);
     gtk_menu_shell_append(GTK_MENU_SHELL(file_menu), gtk_separator_menu_item_new());
     gtk_menu_shell_append(GTK_MENU_SHELL(file_menu), quit_item);
     gtk_menu_item_set_submenu(GTK_MENU_ITEM(file_item), file_menu);
@@ -2367,6 +9601,12 @@ static void create_menubar(EditorApp *app, GtkWidget *vbox) {
     GtkWidget *duplicate_line_item = gtk_menu_item_new_with_label("Duplicate Line");
     GtkWidget *delete_line_item = gtk_menu_item_new_with_label("Delete Line");
     GtkWidget *goto_line_item = gtk_menu_item_new_with_label("Go to Line...");
+    GtkWidget *matching_brace_item = gtk_menu_item_new_with_label("Jump to Matching Brace");
+    GtkWidget *enclosing_block_item = gtk_menu_item_new_with_label("Select Enclosing Block");
+    GtkWidget *fold_item = gtk_menu_item_new_with_label("Fold/Unfold Block");
+    GtkWidget *unfold_all_item = gtk_menu_item_new_with_label("Unfold All");
+    GtkWidget *definition_item = gtk_menu_item_new_with_label("Go to Definition");
+    GtkWidget *references_item = gtk_menu_item_new_with_label("Find References");
     
     // Edit Shortcuts
     gtk_widget_add_accelerator(undo_item, "activate", accel_group, GDK_KEY_z, GDK_CONTROL_MASK, GTK_ACCEL_VISIBLE);
@@ -2375,6 +9615,11 @@ static void create_menubar(EditorApp *app, GtkWidget *vbox) {
     gtk_widget_add_accelerator(duplicate_line_item, "activate", accel_group, GDK_KEY_d, GDK_CONTROL_MASK, GTK_ACCEL_VISIBLE);
     gtk_widget_add_accelerator(delete_line_item, "activate", accel_group, GDK_KEY_k, GDK_CONTROL_MASK | GDK_SHIFT_MASK, GTK_ACCEL_VISIBLE);
     gtk_widget_add_accelerator(goto_line_item, "activate", accel_group, GDK_KEY_g, GDK_CONTROL_MASK, GTK_ACCEL_VISIBLE);
+    gtk_widget_add_accelerator(matching_brace_item, "activate", accel_group, GDK_KEY_bracketright, GDK_CONTROL_MASK, GTK_ACCEL_VISIBLE);
+    gtk_widget_add_accelerator(enclosing_block_item, "activate", accel_group, GDK_KEY_bracketright, GDK_CONTROL_MASK | GDK_SHIFT_MASK, GTK_ACCEL_VISIBLE);
+    gtk_widget_add_accelerator(fold_item, "activate", accel_group, GDK_KEY_bracketleft, GDK_CONTROL_MASK, GTK_ACCEL_VISIBLE);
+    gtk_widget_add_accelerator(definition_item, "activate", accel_group, GDK_KEY_F12, 0, GTK_ACCEL_VISIBLE);
+    gtk_widget_add_accelerator(references_item, "activate", accel_group, GDK_KEY_F12, GDK_SHIFT_MASK, GTK_ACCEL_VISIBLE);
 
     gtk_menu_shell_append(GTK_MENU_SHELL(edit_menu), duplicate_line_item);
     gtk_menu_shell_append(GTK_MENU_SHELL(edit_menu), delete_line_item);
@@ -2382,6 +9627,18 @@ static void create_menubar(EditorApp *app, GtkWidget *vbox) {
     g_signal_connect(duplicate_line_item, "activate", G_CALLBACK(on_duplicate_line), app);
     g_signal_connect(delete_line_item, "activate", G_CALLBACK(on_delete_line), app);
     g_signal_connect(goto_line_item, "activate", G_CALLBACK(on_goto_line), app);
+    gtk_menu_shell_append(GTK_MENU_SHELL(edit_menu), matching_brace_item);
+    gtk_menu_shell_append(GTK_MENU_SHELL(edit_menu), enclosing_block_item);
+    gtk_menu_shell_append(GTK_MENU_SHELL(edit_menu), fold_item);
+    gtk_menu_shell_append(GTK_MENU_SHELL(edit_menu), unfold_all_item);
+    g_signal_connect(matching_brace_item, "activate", G_CALLBACK(on_jump_matching_brace), app);
+    g_signal_connect(enclosing_block_item, "activate", G_CALLBACK(on_select_enclosing_block), app);
+    g_signal_connect(fold_item, "activate", G_CALLBACK(on_toggle_fold), app);
+    g_signal_connect(unfold_all_item, "activate", G_CALLBACK(on_unfold_all), app);
+    gtk_menu_shell_append(GTK_MENU_SHELL(edit_menu), definition_item);
+    gtk_menu_shell_append(GTK_MENU_SHELL(edit_menu), references_item);
+    g_signal_connect(definition_item, "activate", G_CALLBACK(on_goto_definition), app);
+    g_signal_connect(references_item, "activate", G_CALLBACK(on_find_references), app);
     gtk_menu_shell_append(GTK_MENU_SHELL(edit_menu), gtk_separator_menu_item_new());
     gtk_menu_shell_append(GTK_MENU_SHELL(edit_menu), undo_item);
     gtk_menu_shell_append(GTK_MENU_SHELL(edit_menu), redo_item);
@@ -2401,170 +9658,20 @@ static void create_menubar(EditorApp *app, GtkWidget *vbox) {
     GtkWidget *insert_menu = gtk_menu_new();
     GtkWidget *insert_item = gtk_menu_item_new_with_mnemonic("_Insert");
 
-GtkWidget *ansi_c_program_item = gtk_menu_item_new_with_label("ANSI C Program Template");
-g_signal_connect(ansi_c_program_item, "activate", G_CALLBACK(on_insert_ansi_c_program), app);
-gtk_menu_shell_append(GTK_MENU_SHELL(insert_menu), ansi_c_program_item);
-gtk_menu_shell_append(GTK_MENU_SHELL(insert_menu), gtk_separator_menu_item_new());
-   
-/* Control Structures Submenu */
-GtkWidget *control_menu = gtk_menu_new();
-GtkWidget *control_item = gtk_menu_item_new_with_label("Control Structures");
-GtkWidget *for_snip = gtk_menu_item_new_with_label("for loop");
-GtkWidget *while_snip = gtk_menu_item_new_with_label("while loop");
-GtkWidget *do_while_snip = gtk_menu_item_new_with_label("do-while loop");
-GtkWidget *if_snip = gtk_menu_item_new_with_label("if statement");
-GtkWidget *if_else_snip = gtk_menu_item_new_with_label("if-else statement");
-GtkWidget *switch_snip = gtk_menu_item_new_with_label("switch statement");
-gtk_menu_shell_append(GTK_MENU_SHELL(control_menu), for_snip);
-gtk_menu_shell_append(GTK_MENU_SHELL(control_menu), while_snip);
-gtk_menu_shell_append(GTK_MENU_SHELL(control_menu), do_while_snip);
-gtk_menu_shell_append(GTK_MENU_SHELL(control_menu), gtk_separator_menu_item_new());
-gtk_menu_shell_append(GTK_MENU_SHELL(control_menu), if_snip);
-gtk_menu_shell_append(GTK_MENU_SHELL(control_menu), if_else_snip);
-gtk_menu_shell_append(GTK_MENU_SHELL(control_menu), switch_snip);
-gtk_menu_item_set_submenu(GTK_MENU_ITEM(control_item), control_menu);
-
-/* Functions Submenu */
-GtkWidget *func_menu = gtk_menu_new();
-GtkWidget *func_item = gtk_menu_item_new_with_label("Functions");
-GtkWidget *main_snip = gtk_menu_item_new_with_label("main() function");
-GtkWidget *void_func_snip = gtk_menu_item_new_with_label("void function");
-GtkWidget *int_func_snip = gtk_menu_item_new_with_label("int function");
-GtkWidget *ptr_func_snip = gtk_menu_item_new_with_label("pointer function");
-gtk_menu_shell_append(GTK_MENU_SHELL(func_menu), main_snip);
-gtk_menu_shell_append(GTK_MENU_SHELL(func_menu), void_func_snip);
-gtk_menu_shell_append(GTK_MENU_SHELL(func_menu), int_func_snip);
-gtk_menu_shell_append(GTK_MENU_SHELL(func_menu), ptr_func_snip);
-gtk_menu_item_set_submenu(GTK_MENU_ITEM(func_item), func_menu);
-
-/* Data Structures Submenu */
-GtkWidget *data_menu = gtk_menu_new();
-GtkWidget *data_item = gtk_menu_item_new_with_label("Data Structures");
-GtkWidget *struct_snip = gtk_menu_item_new_with_label("struct definition");
-GtkWidget *typedef_struct_snip = gtk_menu_item_new_with_label("typedef struct");
-GtkWidget *enum_snip = gtk_menu_item_new_with_label("enum definition");
-GtkWidget *union_snip = gtk_menu_item_new_with_label("union definition");
-GtkWidget *array_snip = gtk_menu_item_new_with_label("array declaration");
-gtk_menu_shell_append(GTK_MENU_SHELL(data_menu), struct_snip);
-gtk_menu_shell_append(GTK_MENU_SHELL(data_menu), typedef_struct_snip);
-gtk_menu_shell_append(GTK_MENU_SHELL(data_menu), enum_snip);
-gtk_menu_shell_append(GTK_MENU_SHELL(data_menu), union_snip);
-gtk_menu_shell_append(GTK_MENU_SHELL(data_menu), array_snip);
-gtk_menu_item_set_submenu(GTK_MENU_ITEM(data_item), data_menu);
-
-/* Memory Management Submenu */
-GtkWidget *mem_menu = gtk_menu_new();
-GtkWidget *mem_item = gtk_menu_item_new_with_label("Memory Management");
-GtkWidget *malloc_snip = gtk_menu_item_new_with_label("malloc");
-GtkWidget *calloc_snip = gtk_menu_item_new_with_label("calloc");
-GtkWidget *realloc_snip = gtk_menu_item_new_with_label("realloc");
-GtkWidget *free_snip = gtk_menu_item_new_with_label("free with NULL check");
-gtk_menu_shell_append(GTK_MENU_SHELL(mem_menu), malloc_snip);
-gtk_menu_shell_append(GTK_MENU_SHELL(mem_menu), calloc_snip);
-gtk_menu_shell_append(GTK_MENU_SHELL(mem_menu), realloc_snip);
-gtk_menu_shell_append(GTK_MENU_SHELL(mem_menu), free_snip);
-gtk_menu_item_set_submenu(GTK_MENU_ITEM(mem_item), mem_menu);
-
-/* File I/O Submenu */
-GtkWidget *fileio_menu = gtk_menu_new();
-GtkWidget *fileio_item = gtk_menu_item_new_with_label("File I/O");
-GtkWidget *fopen_snip = gtk_menu_item_new_with_label("fopen read");
-GtkWidget *fopen_write_snip = gtk_menu_item_new_with_label("fopen write");
-GtkWidget *fread_snip = gtk_menu_item_new_with_label("fread");
-GtkWidget *fwrite_snip = gtk_menu_item_new_with_label("fwrite");
-GtkWidget *fprintf_snip = gtk_menu_item_new_with_label("fprintf");
-GtkWidget *fscanf_snip = gtk_menu_item_new_with_label("fscanf");
-gtk_menu_shell_append(GTK_MENU_SHELL(fileio_menu), fopen_snip);
-gtk_menu_shell_append(GTK_MENU_SHELL(fileio_menu), fopen_write_snip);
-gtk_menu_shell_append(GTK_MENU_SHELL(fileio_menu), fread_snip);
-gtk_menu_shell_append(GTK_MENU_SHELL(fileio_menu), fwrite_snip);
-gtk_menu_shell_append(GTK_MENU_SHELL(fileio_menu), fprintf_snip);
-gtk_menu_shell_append(GTK_MENU_SHELL(fileio_menu), fscanf_snip);
-gtk_menu_item_set_submenu(GTK_MENU_ITEM(fileio_item), fileio_menu);
-
-/* Comments Submenu */
-GtkWidget *comment_menu = gtk_menu_new();
-GtkWidget *comment_snip_item = gtk_menu_item_new_with_label("Comments");
-GtkWidget *header_comment_snip = gtk_menu_item_new_with_label("Header Comment");
-GtkWidget *func_comment_snip = gtk_menu_item_new_with_label("Function Comment");
-GtkWidget *section_comment_snip = gtk_menu_item_new_with_label("Section Comment");
-gtk_menu_shell_append(GTK_MENU_SHELL(comment_menu), header_comment_snip);
-gtk_menu_shell_append(GTK_MENU_SHELL(comment_menu), func_comment_snip);
-gtk_menu_shell_append(GTK_MENU_SHELL(comment_menu), section_comment_snip);
-gtk_menu_item_set_submenu(GTK_MENU_ITEM(comment_snip_item), comment_menu);
-
-/* DateTime Submenu */
-GtkWidget *dt_menu = gtk_menu_new();
-GtkWidget *dt_item = gtk_menu_item_new_with_label("Date/Time");
-GtkWidget *time_snip = gtk_menu_item_new_with_label("Current Time");
-GtkWidget *date_snip = gtk_menu_item_new_with_label("Current Date");
-GtkWidget *datetime_snip = gtk_menu_item_new_with_label("Date and Time");
-gtk_menu_shell_append(GTK_MENU_SHELL(dt_menu), time_snip);
-gtk_menu_shell_append(GTK_MENU_SHELL(dt_menu), date_snip);
-gtk_menu_shell_append(GTK_MENU_SHELL(dt_menu), datetime_snip);
-gtk_menu_item_set_submenu(GTK_MENU_ITEM(dt_item), dt_menu);
-
-/* Assemble Insert Menu */
-gtk_menu_shell_append(GTK_MENU_SHELL(insert_menu), control_item);
-gtk_menu_shell_append(GTK_MENU_SHELL(insert_menu), func_item);
-gtk_menu_shell_append(GTK_MENU_SHELL(insert_menu), data_item);
-gtk_menu_shell_append(GTK_MENU_SHELL(insert_menu), mem_item);
-gtk_menu_shell_append(GTK_MENU_SHELL(insert_menu), fileio_item);
-gtk_menu_shell_append(GTK_MENU_SHELL(insert_menu), gtk_separator_menu_item_new());
-gtk_menu_shell_append(GTK_MENU_SHELL(insert_menu), comment_snip_item);
-gtk_menu_shell_append(GTK_MENU_SHELL(insert_menu), dt_item);
+/* Generated from snippets.conf, submenus are built on first hover */
+build_insert_menu(app, insert_menu);
 gtk_menu_item_set_submenu(GTK_MENU_ITEM(insert_item), insert_menu);
-
-/* Control Structures */
-g_signal_connect(for_snip, "activate", G_CALLBACK(on_insert_for_loop), app);
-g_signal_connect(while_snip, "activate", G_CALLBACK(on_insert_while_loop), app);
-g_signal_connect(do_while_snip, "activate", G_CALLBACK(on_insert_do_while), app);
-g_signal_connect(if_snip, "activate", G_CALLBACK(on_insert_if), app);
-g_signal_connect(if_else_snip, "activate", G_CALLBACK(on_insert_if_else), app);
-g_signal_connect(switch_snip, "activate", G_CALLBACK(on_insert_switch), app);
-
-/* Functions */
-g_signal_connect(main_snip, "activate", G_CALLBACK(on_insert_main), app);
-g_signal_connect(void_func_snip, "activate", G_CALLBACK(on_insert_void_function), app);
-g_signal_connect(int_func_snip, "activate", G_CALLBACK(on_insert_int_function), app);
-g_signal_connect(ptr_func_snip, "activate", G_CALLBACK(on_insert_ptr_function), app);
-
-/* Data Structures */
-g_signal_connect(struct_snip, "activate", G_CALLBACK(on_insert_struct), app);
-g_signal_connect(typedef_struct_snip, "activate", G_CALLBACK(on_insert_typedef_struct), app);
-g_signal_connect(enum_snip, "activate", G_CALLBACK(on_insert_enum), app);
-g_signal_connect(union_snip, "activate", G_CALLBACK(on_insert_union), app);
-g_signal_connect(array_snip, "activate", G_CALLBACK(on_insert_array), app);
-
-/* Memory Management */
-g_signal_connect(malloc_snip, "activate", G_CALLBACK(on_insert_malloc), app);
-g_signal_connect(calloc_snip, "activate", G_CALLBACK(on_insert_calloc), app);
-g_signal_connect(realloc_snip, "activate", G_CALLBACK(on_insert_realloc), app);
-g_signal_connect(free_snip, "activate", G_CALLBACK(on_insert_free), app);
-
-/* File I/O */
-g_signal_connect(fopen_snip, "activate", G_CALLBACK(on_insert_fopen_read), app);
-g_signal_connect(fopen_write_snip, "activate", G_CALLBACK(on_insert_fopen_write), app);
-g_signal_connect(fread_snip, "activate", G_CALLBACK(on_insert_fread), app);
-g_signal_connect(fwrite_snip, "activate", G_CALLBACK(on_insert_fwrite), app);
-g_signal_connect(fprintf_snip, "activate", G_CALLBACK(on_insert_fprintf), app);
-g_signal_connect(fscanf_snip, "activate", G_CALLBACK(on_insert_fscanf), app);
-
-/* Comments */
-g_signal_connect(header_comment_snip, "activate", G_CALLBACK(on_insert_header_comment), app);
-g_signal_connect(func_comment_snip, "activate", G_CALLBACK(on_insert_function_comment), app);
-g_signal_connect(section_comment_snip, "activate", G_CALLBACK(on_insert_section_comment), app);
-
-/* Date/Time */
-g_signal_connect(time_snip, "activate", G_CALLBACK(on_insert_time), app);
-g_signal_connect(date_snip, "activate", G_CALLBACK(on_insert_date), app);
-g_signal_connect(datetime_snip, "activate", G_CALLBACK(on_insert_datetime), app);
-    
    
     /* --- VIEW MENU (With Integrated Themes) --- */
     GtkWidget *view_menu = gtk_menu_new();
     GtkWidget *view_item = gtk_menu_item_new_with_mnemonic("_View");
 
+    GtkWidget *palette_item = gtk_menu_item_new_with_label("Command Palette...");
+    g_object_set_data(G_OBJECT(palette_item), "command-palette", GINT_TO_POINTER(TRUE));
+    gtk_widget_add_accelerator(palette_item, "activate", accel_group, GDK_KEY_p, GDK_CONTROL_MASK | GDK_SHIFT_MASK, GTK_ACCEL_VISIBLE);
+    g_signal_connect(palette_item, "activate", G_CALLBACK(on_command_palette), app);
+    gtk_menu_shell_append(GTK_MENU_SHELL(view_menu), palette_item);
+
     GtkWidget *font_item = gtk_menu_item_new_with_label("Change Font...");
     g_signal_connect(font_item, "activate", G_CALLBACK(on_change_font), app);
     gtk_menu_shell_append(GTK_MENU_SHELL(view_menu), font_item);
@@ -2574,6 +9681,21 @@ g_signal_connect(datetime_snip, "activate", G_CALLBACK(on_insert_datetime), app)
     gtk_menu_shell_append(GTK_MENU_SHELL(view_menu), toggle_side);
     GtkWidget *focus_item = gtk_menu_item_new_with_label("Focus Mode");
     gtk_menu_shell_append(GTK_MENU_SHELL(view_menu), focus_item);
+    GtkWidget *latency_item = gtk_check_menu_item_new_with_label("Latency HUD");
+    g_signal_connect(latency_item, "toggled", G_CALLBACK(on_toggle_latency_hud), app);
+    gtk_menu_shell_append(GTK_MENU_SHELL(view_menu), latency_item);
+    app->latency_item = latency_item;
+    GtkWidget *asm_item = gtk_check_menu_item_new_with_label("Assembly View");
+    gtk_widget_add_accelerator(asm_item, "activate", accel_group, GDK_KEY_F7, 0, GTK_ACCEL_VISIBLE);
+    g_signal_connect(asm_item, "toggled", G_CALLBACK(on_toggle_assembly_view), app);
+    gtk_menu_shell_append(GTK_MENU_SHELL(view_menu), asm_item);
+    GtkWidget *minimap_item = gtk_check_menu_item_new_with_label("Minimap");
+    g_signal_connect(minimap_item, "toggled", G_CALLBACK(on_toggle_minimap), app);
+    gtk_menu_shell_append(GTK_MENU_SHELL(view_menu), minimap_item);
+    GtkWidget *semantic_item = gtk_check_menu_item_new_with_label("Semantic Highlighting");
+    gtk_check_menu_item_set_active(GTK_CHECK_MENU_ITEM(semantic_item), TRUE);
+    g_signal_connect(semantic_item, "toggled", G_CALLBACK(on_toggle_semantic), app);
+    gtk_menu_shell_append(GTK_MENU_SHELL(view_menu), semantic_item);
     gtk_menu_item_set_submenu(GTK_MENU_ITEM(view_item), view_menu);
    
 
@@ -2608,6 +9730,15 @@ g_signal_connect(datetime_snip, "activate", G_CALLBACK(on_insert_datetime), app)
     g_signal_connect(color_picker_item, "activate", G_CALLBACK(on_color_picker), app);
     gtk_menu_shell_append(GTK_MENU_SHELL(tools_menu), color_picker_item);
 
+    gtk_menu_shell_append(GTK_MENU_SHELL(tools_menu), gtk_separator_menu_item_new());
+    GtkWidget *trace_item = gtk_check_menu_item_new_with_label("Record Trace");
+    gtk_check_menu_item_set_active(GTK_CHECK_MENU_ITEM(trace_item), g_atomic_int_get(&trace_enabled));
+    g_signal_connect(trace_item, "toggled", G_CALLBACK(on_toggle_trace), app);
+    gtk_menu_shell_append(GTK_MENU_SHELL(tools_menu), trace_item);
+    GtkWidget *save_trace_item = gtk_menu_item_new_with_label("Save Trace...");
+    g_signal_connect(save_trace_item, "activate", G_CALLBACK(on_save_trace), app);
+    gtk_menu_shell_append(GTK_MENU_SHELL(tools_menu), save_trace_item);
+
     gtk_menu_item_set_submenu(GTK_MENU_ITEM(tools_item), tools_menu);
 
 /* --- TRANSFORM MENU --- */
@@ -2663,6 +9794,26 @@ g_signal_connect(datetime_snip, "activate", G_CALLBACK(on_insert_datetime), app)
     g_signal_connect(quick_build_item, "activate", G_CALLBACK(on_quick_build), app);
     gtk_menu_shell_append(GTK_MENU_SHELL(build_menu), quick_build_item);
 
+    GtkWidget *profile_item = gtk_menu_item_new_with_label("Profile & Run");
+    gtk_widget_add_accelerator(profile_item, "activate", accel_group,
+                               GDK_KEY_F5, GDK_SHIFT_MASK, GTK_ACCEL_VISIBLE);
+    g_signal_connect(profile_item, "activate", G_CALLBACK(on_profile_run), app);
+    gtk_menu_shell_append(GTK_MENU_SHELL(build_menu), profile_item);
+
+    GtkWidget *bench_run_item = gtk_menu_item_new_with_label("Benchmark Run...");
+    gtk_widget_add_accelerator(bench_run_item, "activate", accel_group,
+                               GDK_KEY_F5, GDK_CONTROL_MASK, GTK_ACCEL_VISIBLE);
+    g_signal_connect(bench_run_item, "activate", G_CALLBACK(on_benchmark_run), app);
+    gtk_menu_shell_append(GTK_MENU_SHELL(build_menu), bench_run_item);
+
+    GtkWidget *matrix_item = gtk_menu_item_new_with_label("Optimization Matrix...");
+    g_signal_connect(matrix_item, "activate", G_CALLBACK(on_build_matrix), app);
+    gtk_menu_shell_append(GTK_MENU_SHELL(build_menu), matrix_item);
+
+    GtkWidget *clear_profile_item = gtk_menu_item_new_with_label("Clear Profile");
+    g_signal_connect(clear_profile_item, "activate", G_CALLBACK(on_clear_profile), app);
+    gtk_menu_shell_append(GTK_MENU_SHELL(build_menu), clear_profile_item);
+
     gtk_menu_item_set_submenu(GTK_MENU_ITEM(build_item), build_menu);
     gtk_menu_shell_append(GTK_MENU_SHELL(menubar), build_item);
 
@@ -2752,8 +9903,11 @@ gtk_menu_shell_append(GTK_MENU_SHELL(menubar), search_root);
     /* --- CONNECT SIGNALS --- */
     g_signal_connect(new_item, "activate", G_CALLBACK(on_new), app);
     g_signal_connect(open_item, "activate", G_CALLBACK(on_open), app);
+    g_signal_connect(open_folder_item, "activate", G_CALLBACK(on_open_folder), app);
+    g_signal_connect(quick_open_item, "activate", G_CALLBACK(on_quick_open), app);
     g_signal_connect(save_item, "activate", G_CALLBACK(on_save), app);
     g_signal_connect(save_as_item, "activate", G_CALLBACK(on_save_as), app);
+    g_signal_connect(export_tags_item, "activate", G_CALLBACK(on_export_tags), app);
     g_signal_connect(quit_item, "activate", G_CALLBACK(on_quit), app);
     
     g_signal_connect(undo_item, "activate", G_CALLBACK(on_undo), app);
@@ -2766,10 +9920,6 @@ gtk_menu_shell_append(GTK_MENU_SHELL(menubar), search_root);
     g_signal_connect(uncomment_item, "activate", G_CALLBACK(on_uncomment_selection), app);
     g_signal_connect(block_comment_item, "activate", G_CALLBACK(on_block_comment), app);
 
-    g_signal_connect(main_snip, "activate", G_CALLBACK(on_insert_main), app);
-    g_signal_connect(for_snip, "activate", G_CALLBACK(on_insert_for_loop), app);
-    g_signal_connect(time_snip, "activate", G_CALLBACK(on_insert_time), app);
-    
     g_signal_connect(refresh_item, "activate", G_CALLBACK(on_refresh_symbols), app);
     g_signal_connect(light_opt, "toggled", G_CALLBACK(on_theme_change), app);
     g_signal_connect(dark_opt, "toggled", G_CALLBACK(on_theme_change), app);
@@ -2790,12 +9940,14 @@ static void on_cursor_moved(GtkTextBuffer *buffer,
   
     // Optional: Turn off focus mode when user moves cursor manually
     // app->focus_mode = FALSE; 
-    update_status(app);
     if (!app || !app->status_label) return;
 
     /* Only update when the INSERT cursor moves */
     if (mark == gtk_text_buffer_get_insert(buffer)) {
+        snippet_session_follow_cursor(app, location);
         update_status(app);
+        if (app->asm_view && gtk_widget_get_visible(app->asm_view->pane))
+            asm_view_follow_cursor(app);
     }
 }
 
@@ -2844,10 +9996,213 @@ static void on_change_font(GtkWidget *widget, gpointer data) {
     gtk_widget_destroy(dialog);
 }
 
+/* Startup profiling: --startup-stats prints time-to-first-paint */
+static void print_startup_stats(EditorApp *app) {
+    gint64 t0 = app->t_start;
+    
+    g_print("\n=== Startup Stats ===\n");
+    g_print("gtk_init:        %7.1f ms\n", (app->t_gtk_init - t0) / 1000.0);
+    g_print("ui built:        %7.1f ms\n", (app->t_ui_built - t0) / 1000.0);
+    g_print("first paint:     %7.1f ms%s\n", (app->t_first_paint - t0) / 1000.0,
+            app->t_first_paint - t0 > 100000 ? "  (over 100 ms budget)" : "");
+    if (app->t_file_loaded)
+        g_print("file loaded:     %7.1f ms\n", (app->t_file_loaded - t0) / 1000.0);
+}
+
+/* Idle callback: load the command line file after the first frame is on screen */
+static gboolean load_pending_file(gpointer data) {
+    EditorApp *app = (EditorApp *)data;
+    
+    TRACE_BEGIN("idle: load_pending_file");
+    if (app->pending_file) {
+        if (!load_file(app, app->pending_file))
+            g_print("Could not open %s\n", app->pending_file);
+        else if (app->pending_line > 0)
+            jump_to_line(app, app->pending_line);
+        g_free(app->pending_file);
+        app->pending_file = NULL;
+        app->t_file_loaded = g_get_monotonic_time();
+    }
+    if (app->startup_stats)
+        print_startup_stats(app);
+    TRACE_END("idle: load_pending_file");
+    return G_SOURCE_REMOVE;
+}
+
+static gboolean on_first_draw(GtkWidget *widget, cairo_t *cr, gpointer data) {
+    EditorApp *app = (EditorApp *)data;
+    
+    g_signal_handlers_disconnect_by_func(widget, G_CALLBACK(on_first_draw), app);
+    app->t_first_paint = g_get_monotonic_time();
+    g_idle_add(load_pending_file, app);
+    g_idle_add_full(G_PRIORITY_LOW, build_command_index, app, NULL);
+    if (app->replay)
+        app->replay->source = g_idle_add_full(G_PRIORITY_LOW, replay_begin, app, NULL);
+    return FALSE;
+}
+
+/* Split "file:line" (also "file:line:text" from git grep -n) into path and line */
+static gchar *parse_location(const gchar *arg, gint *line) {
+    const gchar *colon = strchr(arg, ':');
+    
+    *line = 0;
+    if (g_file_test(arg, G_FILE_TEST_EXISTS))
+        return g_strdup(arg);
+    
+    while (colon) {
+        if (g_ascii_isdigit(colon[1])) {
+            *line = atoi(colon + 1);
+            return g_strndup(arg, colon - arg);
+        }
+        colon = strchr(colon + 1, ':');
+    }
+    return g_strdup(arg);
+}
+
+#define SCRIBLE_APP_ID "io.github.oneneoncoffee.Scrible"
+
+#if GLIB_CHECK_VERSION(2, 74, 0)
+#define SCRIBLE_APP_FLAGS G_APPLICATION_DEFAULT_FLAGS
+#else
+#define SCRIBLE_APP_FLAGS G_APPLICATION_FLAGS_NONE
+#endif
+
+/* 
+ * Single-instance mode: claim the bus name before gtk_init. If another
+ * scrible already owns it, forward the location over D-Bus and return NULL
+ * so main() can exit without ever opening a display.
+ */
+static GApplication *claim_instance(const gchar *path, gint line, gboolean *forwarded) {
+    GError *error = NULL;
+    GApplication *instance = g_application_new(SCRIBLE_APP_ID, SCRIBLE_APP_FLAGS);
+    GSimpleAction *action = g_simple_action_new("open-location", G_VARIANT_TYPE("(si)"));
+    
+    *forwarded = FALSE;
+    g_action_map_add_action(G_ACTION_MAP(instance), G_ACTION(action));
+    g_object_unref(action);
+    
+    if (!g_application_register(instance, NULL, &error)) {
+        g_print("Single-instance mode unavailable: %s\n", error->message);
+        g_error_free(error);
+        g_object_unref(instance);
+        return NULL;
+    }
+    
+    if (!g_application_get_is_remote(instance))
+        return instance;
+    
+    /* Hand an absolute path over, the running editor has its own cwd */
+    gchar *abs_path = NULL;
+    if (path) {
+        GFile *file = g_file_new_for_commandline_arg(path);
+        abs_path = g_file_get_path(file);
+        g_object_unref(file);
+    }
+    g_action_group_activate_action(G_ACTION_GROUP(instance), "open-location",
+                                   g_variant_new("(si)", abs_path ? abs_path : "", line));
+    g_dbus_connection_flush_sync(g_application_get_dbus_connection(instance), NULL, NULL);
+    g_free(abs_path);
+    g_object_unref(instance);
+    *forwarded = TRUE;
+    return NULL;
+}
+
+static gboolean opt_startup_stats = FALSE;
+static gboolean opt_single_instance = FALSE;
+
+static gchar *opt_trace_file = NULL;
+static gboolean opt_latency_report = FALSE;
+static gboolean opt_latency_hud = FALSE;
+static gchar *opt_record_file = NULL;
+static gchar *opt_replay_file = NULL;
+static gdouble opt_replay_speed = 1.0;
+static gboolean opt_offscreen = FALSE;
+static GOptionEntry option_entries[] = {
+    { "startup-stats", 0, 0, G_OPTION_ARG_NONE, &opt_startup_stats,
+      "Print startup phase timings and time-to-first-paint", NULL },
+    { "single-instance", 0, 0, G_OPTION_ARG_NONE, &opt_single_instance,
+      "Open FILE in an already running scrible and exit", NULL },
+    { "latency-report", 0, 0, G_OPTION_ARG_NONE, &opt_latency_report,
+      "Record editing latency and print p50/p95/p99 on exit", NULL },
+    { "latency-hud", 0, 0, G_OPTION_ARG_NONE, &opt_latency_hud,
+      "Show the editing latency overlay", NULL },
+    { "trace", 0, 0, G_OPTION_ARG_FILENAME, &opt_trace_file,
+      "Record a trace and write it as Chrome trace JSON to FILE on exit", "FILE" },
+    { "record", 0, 0, G_OPTION_ARG_FILENAME, &opt_record_file,
+      "Record keys, clicks, scrolling and menu commands to FILE", "FILE" },
+    { "replay", 0, 0, G_OPTION_ARG_FILENAME, &opt_replay_file,
+      "Replay a recorded FILE, print timings and exit", "FILE" },
+    { "replay-speed", 0, 0, G_OPTION_ARG_DOUBLE, &opt_replay_speed,
+      "Replay pace, 2 = twice as fast, 0 = as fast as possible (default 1)", "N" },
+    { "offscreen", 0, 0, G_OPTION_ARG_NONE, &opt_offscreen,
+      "Render into an offscreen window, for --replay under Xvfb or Broadway", NULL },
+    { NULL }
+};
+
 int main(int argc, char *argv[]) {
+    gint64 t_start = g_get_monotonic_time();
+    GError *error = NULL;
+    
+    GOptionContext *context = g_option_context_new("[FILE]");
+    g_option_context_add_main_entries(context, option_entries, NULL);
+    /* GTK's own options (--display, --gtk-debug...); the display is opened later by gtk_init */
+    g_option_context_add_group(context, gtk_get_option_group(FALSE));
+    g_option_context_set_ignore_unknown_options(context, TRUE);
+    if (!g_option_context_parse(context, &argc, &argv, &error)) {
+        g_printerr("%s\n", error->message);
+        g_error_free(error);
+        g_option_context_free(context);
+        return 1;
+    }
+    g_option_context_free(context);
+    
+    if (opt_trace_file)
+        trace_start();
+    
+    /* Accept "FILE", "FILE:LINE" and vi style "+LINE FILE" */
+    gchar *open_path = NULL;
+    gint open_line = 0;
+    for (int i = 1; i < argc && !open_path; i++) {
+        if (argv[i][0] == '-')
+            continue;         /* an option nobody knew, not a file */
+        if (argv[i][0] == '+' && g_ascii_isdigit(argv[i][1]))
+            open_line = atoi(argv[i] + 1);
+        else {
+            gint line;
+            open_path = parse_location(argv[i], &line);
+            if (line > 0) open_line = line;
+        }
+    }
+    
+    /* Only an explicit yes: SCRIBLE_SINGLE_INSTANCE=0 or an empty value leaves it off */
+    const gchar *single_env = g_getenv("SCRIBLE_SINGLE_INSTANCE");
+    if (single_env && (strcmp(single_env, "1") == 0 || g_ascii_strcasecmp(single_env, "true") == 0 ||
+                       g_ascii_strcasecmp(single_env, "yes") == 0))
+        opt_single_instance = TRUE;
+    
+    GApplication *instance = NULL;
+    if (opt_single_instance) {
+        gboolean forwarded;
+        instance = claim_instance(open_path, open_line, &forwarded);
+        if (forwarded) {
+            g_free(open_path);
+            return 0;
+        }
+    }
+    
+    TRACE_BEGIN("gtk_init");
     gtk_init(&argc, &argv);
+    TRACE_END("gtk_init");
     
     EditorApp *app = g_malloc0(sizeof(EditorApp));
+    app->t_start = t_start;
+    app->t_gtk_init = g_get_monotonic_time();
+    app->startup_stats = opt_startup_stats;
+    app->instance = instance;
+    if (instance) {
+        GAction *open_action = g_action_map_lookup_action(G_ACTION_MAP(instance), "open-location");
+        g_signal_connect(open_action, "activate", G_CALLBACK(on_remote_open), app);
+    }
 
     /* Initialize all pointers and state FIRST */
     app->dark_css = NULL;
@@ -2860,8 +10215,11 @@ int main(int argc, char *argv[]) {
     app->search_context = NULL;
     app->bookmarks = NULL;
     
+    if (opt_replay_file && !load_replay(app, opt_replay_file, opt_replay_speed))
+        return 1;
+    
     /* Window Setup */
-    app->window = gtk_window_new(GTK_WINDOW_TOPLEVEL);
+    app->window = opt_offscreen ? gtk_offscreen_window_new() : gtk_window_new(GTK_WINDOW_TOPLEVEL);
     gtk_window_set_title(GTK_WINDOW(app->window), "Scrible Code Editor");
     gtk_window_set_default_size(GTK_WINDOW(app->window), 1000, 600);
     g_signal_connect(app->window, "destroy", G_CALLBACK(gtk_main_quit), NULL);
@@ -2871,6 +10229,7 @@ int main(int argc, char *argv[]) {
     gtk_container_add(GTK_CONTAINER(app->window), vbox);
 
     /* Create menubar */
+    app->snippets = load_snippets();
     create_menubar(app, vbox);
 
     /* Horizontal Paned container for Sidebar and Editor */
@@ -2899,17 +10258,30 @@ int main(int argc, char *argv[]) {
     gtk_container_add(GTK_CONTAINER(tree_scroll), app->tree_view);
     app->tree_scroll = tree_scroll; 
     
-    /* Pack sidebar into the first pane */
-    gtk_paned_pack1(GTK_PANED(hpaned), tree_scroll, FALSE, FALSE);
+    /* Pack sidebar into the first pane: Symbols and Files pages */
+    setup_quick_open(app);
+    app->sidebar = gtk_notebook_new();
+    gtk_notebook_append_page(GTK_NOTEBOOK(app->sidebar), tree_scroll, gtk_label_new("Symbols"));
+    gtk_notebook_append_page(GTK_NOTEBOOK(app->sidebar), setup_file_tree(app), gtk_label_new("Files"));
+    g_signal_connect(app->sidebar, "switch-page", G_CALLBACK(on_sidebar_page), app);
+    gtk_paned_pack1(GTK_PANED(hpaned), app->sidebar, FALSE, FALSE);
 
     /* --- Editor (Right Pane) --- */
     app->buffer = GTK_SOURCE_BUFFER(gtk_source_buffer_new(NULL)); 
     // Enable undo/redo history (100 steps)
     gtk_source_buffer_set_max_undo_levels(app->buffer, 100);
-    app->view   = gtk_source_view_new_with_buffer(app->buffer);
+    app->view   = scrible_view_new(app->buffer);
     gtk_source_view_set_show_line_numbers(GTK_SOURCE_VIEW(app->view), TRUE);
     gtk_source_view_set_auto_indent(GTK_SOURCE_VIEW(app->view), TRUE);
     gtk_source_view_set_tab_width(GTK_SOURCE_VIEW(app->view), 4);
+    setup_long_lines(app);
+    /* Before any other buffer handler, so the timings include them */
+    if (opt_latency_report || opt_latency_hud || app->replay)
+        enable_latency_stats(app);
+    setup_completion(app);
+    setup_brace_index(app);
+    setup_semantic(app);
+    setup_file_watch(app, vbox);
     
     GtkWidget *scrolled = gtk_scrolled_window_new(NULL, NULL);
     gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(scrolled),
@@ -2917,18 +10289,20 @@ int main(int argc, char *argv[]) {
                                    GTK_POLICY_AUTOMATIC);
     gtk_container_add(GTK_CONTAINER(scrolled), app->view);
     
-    /* Create the yellow highlight tag */
-    gtk_text_buffer_create_tag(GTK_TEXT_BUFFER(app->buffer), "jump_highlight",
-                           "background", "#ffff00", /* Bright Yellow */
-                           "foreground", "#0000EE", /* blue text for contrast */
-                           NULL);
     /* Create bookmark tag */ 
     gtk_text_buffer_create_tag(GTK_TEXT_BUFFER(app->buffer), "bookmark",
                        "background", "#3584e4", /* Blue background */
                        "foreground", "#ffffff", /* White text */
                        NULL);
-    /* Pack editor into the second pane */
-    gtk_paned_pack2(GTK_PANED(hpaned), scrolled, TRUE, FALSE);
+    /* Pack editor into the second pane, under an overlay for the latency HUD */
+    app->editor_overlay = gtk_overlay_new();
+    GtkWidget *editor_box = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 0);
+    gtk_box_pack_start(GTK_BOX(editor_box), scrolled, TRUE, TRUE, 0);
+    gtk_box_pack_start(GTK_BOX(editor_box), create_minimap(app), FALSE, FALSE, 0);
+    gtk_container_add(GTK_CONTAINER(app->editor_overlay), editor_box);
+    app->editor_paned = gtk_paned_new(GTK_ORIENTATION_HORIZONTAL);
+    gtk_paned_pack1(GTK_PANED(app->editor_paned), app->editor_overlay, TRUE, FALSE);
+    gtk_paned_pack2(GTK_PANED(hpaned), app->editor_paned, TRUE, FALSE);
 
     /* Set initial sidebar width (divider position) */
     gtk_paned_set_position(GTK_PANED(hpaned), 250);
@@ -2945,43 +10319,15 @@ int main(int argc, char *argv[]) {
     /* Signals */
     g_signal_connect(GTK_TEXT_BUFFER(app->buffer), "mark-set", 
                      G_CALLBACK(on_cursor_moved), app);
+    /* Typing moves the cursor without a mark-set */
+    g_signal_connect(GTK_TEXT_BUFFER(app->buffer), "changed",
+                     G_CALLBACK(on_buffer_changed_status), app);
+    g_signal_connect(app->view, "key-press-event",
+                     G_CALLBACK(on_view_key_press), app);
     GtkTreeSelection *selection = gtk_tree_view_get_selection(GTK_TREE_VIEW(app->tree_view));
     g_signal_connect(selection, "changed", 
                      G_CALLBACK(on_tree_selection_changed), app);
 
-    /* Show all widgets FIRST */
-    gtk_widget_show_all(app->window);
-    
-    /* Create theme providers AFTER widgets are visible */
-    app->dark_css  = create_dark_theme();
-    app->light_css = create_light_theme();
-    app->green_css = create_green_theme();
-    
-    /* Apply the selected theme */
-    apply_theme(app);
-    
-    /* If a filename was provided as argument, open it */
-    if (argc > 1) {
-        gchar *contents;
-        gsize length;
-        
-        if (g_file_get_contents(argv[1], &contents, &length, NULL)) {
-            gtk_text_buffer_set_text(GTK_TEXT_BUFFER(app->buffer), contents, length);
-            g_free(contents);
-            
-            app->current_file = g_strdup(argv[1]);
-            
-            /* Auto-detect language */
-            GtkSourceLanguageManager *lm = gtk_source_language_manager_get_default();
-            GtkSourceLanguage *lang = gtk_source_language_manager_guess_language(lm, argv[1], NULL);
-            gtk_source_buffer_set_language(app->buffer, lang);
-            
-            parse_symbols(app);
-            update_status(app);
-        }
-    }
-    
-  
   // 1. Create the Search Bar widget
 app->search_bar = gtk_search_bar_new();
 GtkWidget *search_entry = gtk_search_entry_new();
@@ -2995,16 +10341,62 @@ gtk_box_pack_start(GTK_BOX(vbox), app->search_bar, FALSE, FALSE, 0);
 // 3. Optional: Connect the search entry to the search context
 g_signal_connect(search_entry, "search-changed", G_CALLBACK(on_search_entry_changed), app);
 
+    /* Only the active theme is parsed; it is applied before the first frame
+     * so the window is not restyled right after it appears */
+    apply_theme(app);
+    
+    /* The file given on the command line is loaded after the first paint */
+    app->pending_file = open_path;
+    app->pending_line = open_line;
+    g_signal_connect_after(app->window, "draw", G_CALLBACK(on_first_draw), app);
+    
+    app->t_ui_built = g_get_monotonic_time();
+    gtk_widget_show_all(app->window);
+    if (opt_latency_hud)
+        gtk_check_menu_item_set_active(GTK_CHECK_MENU_ITEM(app->latency_item), TRUE);
+    if (opt_record_file && start_recording(app, opt_record_file))
+        g_print("Recording session to %s\n", opt_record_file);
+    
     g_print("Scrible editor initialized successfully\n"); 
     
     gtk_main();
     
+    if (opt_latency_report && !app->replay)
+        print_latency_report(app);
+    if (opt_trace_file) {
+        GError *error = NULL;
+        if (trace_write_json(opt_trace_file, &error)) {
+            g_print("Trace written to %s\n", opt_trace_file);
+        } else {
+            g_print("Could not write trace: %s\n", error->message);
+            g_error_free(error);
+        }
+        g_free(opt_trace_file);
+    }
+    
     /* Cleanup */
     if (app->current_file) g_free(app->current_file);
+    g_free(app->pending_file);
     if (app->bookmarks) g_list_free(app->bookmarks);
     if (app->dark_css) g_object_unref(app->dark_css);
     if (app->light_css) g_object_unref(app->light_css);
     if (app->green_css) g_object_unref(app->green_css);
+    if (app->instance) g_object_unref(app->instance);
+    snippet_session_end(app);
+    snippet_table_free(app->snippets);
+    word_index_free(app->words);
+    if (app->commands) g_array_free(app->commands, TRUE);
+    if (app->latency && app->latency->hud_timeout) g_source_remove(app->latency->hud_timeout);
+    g_free(app->latency);
+    profile_data_free(app->profile);
+    if (app->record_file) fclose(app->record_file);
+    if (app->replay) {
+        if (app->replay->source) g_source_remove(app->replay->source);
+        g_array_free(app->replay->actions, TRUE);
+        g_free(app->replay);
+    }
+    g_free(opt_record_file);
+    g_free(opt_replay_file);
     g_free(app);
     
     g_print("Exiting scrible editor cleanly\n"); 
@@ -0,0 +1,422 @@
+/*
+ * scrible_bench.c Microbenchmarks for libscrible-core
+ * Generates reproducible synthetic C source and log corpora (fixed seed)
+ * from 1 KB up to 500 MB and times every core operation on them, printing
+ * throughput and per-run latency percentiles.
+ *
+ * Build and run: make bench
+ * Options:
+ *   --max-size SIZE   largest corpus, e.g. 16M (default 500M)
+ *   --only NAME       run only operations whose name contains NAME
+ *   --runs N          force N timed runs per case
+ *   --csv             machine readable output
+ *   --compare A.csv B.csv...
+ *                     compare --csv results (e.g. of different build
+ *                     profiles, see make compare) against the first file
+ */
+#include "scrible_core.h"
+
+#include <math.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BENCH_SEED       0x5C81B1Eu
+#define BENCH_BUDGET     (256u << 20)   /* bytes processed per case, bounds the run count */
+#define BENCH_MIN_RUNS   3
+#define BENCH_MAX_RUNS   1000
+
+typedef struct {
+    uint64_t state;
+} bench_rng;
+
+/* xorshift64*, the same sequence on every machine */
+static uint32_t rng_next(bench_rng *rng) {
+    rng->state ^= rng->state >> 12;
+    rng->state ^= rng->state << 25;
+    rng->state ^= rng->state >> 27;
+    return (uint32_t)((rng->state * 0x2545F4914F6CDD1DULL) >> 32);
+}
+
+static uint32_t rng_range(bench_rng *rng, uint32_t n) {
+    return rng_next(rng) % n;
+}
+
+typedef struct {
+    char *data;
+    size_t len;
+    size_t cap;
+} corpus;
+
+static void corpus_appendf(corpus *c, const char *fmt, ...) {
+    va_list ap;
+    size_t room = c->cap - c->len;
+
+    va_start(ap, fmt);
+    int n = vsnprintf(c->data + c->len, room, fmt, ap);
+    va_end(ap);
+    c->len += (size_t)n < room ? (size_t)n : room - 1;
+}
+
+static const char *c_types[] = { "int", "char *", "size_t", "double", "struct node *", "void" };
+static const char *c_names[] = { "buffer", "count", "index", "node", "result", "length", "value", "state" };
+static const char *log_levels[] = { "INFO ", "INFO ", "INFO ", "DEBUG", "WARN ", "ERROR" };
+static const char *log_paths[] = { "/api/v1/items", "/api/v1/users", "/healthz", "/static/app.js", "/login" };
+
+#define PICK(rng, arr) ((arr)[rng_range((rng), sizeof(arr) / sizeof((arr)[0]))])
+
+/* One function of plausible C, with comments and some trailing whitespace */
+static void gen_c_chunk(corpus *c, bench_rng *rng, unsigned id) {
+    const char *trail = rng_range(rng, 4) == 0 ? "  \t" : "";
+
+    corpus_appendf(c, "/*\n * fn_%u: generated function %u\n */\n", id, rng_next(rng));
+    corpus_appendf(c, "static %s fn_%u(%s %s, int %s)%s\n{\n",
+                   PICK(rng, c_types), id, PICK(rng, c_types), PICK(rng, c_names),
+                   PICK(rng, c_names), trail);
+
+    unsigned body = 3 + rng_range(rng, 12);
+    for (unsigned i = 0; i < body; i++) {
+        switch (rng_range(rng, 6)) {
+        case 0:
+            corpus_appendf(c, "    for (int i = 0; i < %u; i++) {\n        %s += i;\n    }\n",
+                           rng_range(rng, 1000), PICK(rng, c_names));
+            break;
+        case 1:
+            corpus_appendf(c, "    if (%s > %u) {%s\n        return %s;\n    }\n",
+                           PICK(rng, c_names), rng_range(rng, 100), trail, PICK(rng, c_names));
+            break;
+        case 2:
+            corpus_appendf(c, "    // %s keeps track of %s   \n", PICK(rng, c_names), PICK(rng, c_names));
+            break;
+        case 3:
+            corpus_appendf(c, "    %s = helper_%u(%s, %u);\n",
+                           PICK(rng, c_names), rng_range(rng, 50), PICK(rng, c_names), rng_next(rng));
+            break;
+        case 4:
+            corpus_appendf(c, "    printf(\"%%s: %%d\\n\", \"%s\", %s);%s\n",
+                           PICK(rng, c_names), PICK(rng, c_names), trail);
+            break;
+        default:
+            corpus_appendf(c, "\n");
+            break;
+        }
+    }
+    corpus_appendf(c, "    return 0;\n}\n\n");
+}
+
+/* One access-log style line */
+static void gen_log_chunk(corpus *c, bench_rng *rng, unsigned id) {
+    unsigned ms = id * 37 % 1000;
+    corpus_appendf(c, "2026-10-19T%02u:%02u:%02u.%03uZ %s [worker-%u] %s %s id=%08x status=%u latency=%ums%s\n",
+                   (id / 3600) % 24, (id / 60) % 60, id % 60, ms, PICK(rng, log_levels),
+                   rng_range(rng, 16), rng_range(rng, 5) ? "GET" : "POST", PICK(rng, log_paths),
+                   rng_next(rng), rng_range(rng, 5) ? 200 : 500, rng_range(rng, 900),
+                   rng_range(rng, 8) == 0 ? "   " : "");
+}
+
+typedef void (*gen_fn)(corpus *c, bench_rng *rng, unsigned id);
+
+static corpus make_corpus(gen_fn gen, size_t size) {
+    corpus c;
+    bench_rng rng = { BENCH_SEED };
+    unsigned id = 0;
+
+    c.cap = size + 4096;
+    c.data = malloc(c.cap);
+    c.len = 0;
+    if (!c.data) {
+        fprintf(stderr, "scrible-bench: cannot allocate %zu bytes\n", c.cap);
+        exit(1);
+    }
+    while (c.len < size)
+        gen(&c, &rng, id++);
+    c.len = size;
+    return c;
+}
+
+/* Operations under test; scratch holds any output */
+typedef struct {
+    const char *text;
+    size_t len;
+    char *scratch;
+    size_t sink;
+} bench_ctx;
+
+static void count_symbol(const char *text, size_t len, int line, void *user) {
+    size_t *sink = user;
+    *sink += len + (size_t)line + (unsigned char)text[0];
+}
+
+static void op_parse_symbols(bench_ctx *ctx) {
+    ctx->sink += sc_parse_symbols(ctx->text, ctx->len, count_symbol, &ctx->sink);
+}
+
+static void op_count_words(bench_ctx *ctx) {
+    sc_counts counts;
+    sc_count_words(ctx->text, ctx->len, &counts);
+    ctx->sink += counts.words + counts.chars;
+}
+
+static void op_sort_lines(bench_ctx *ctx) {
+    if (sc_sort_lines(ctx->text, ctx->len, ctx->scratch) != 0) {
+        fprintf(stderr, "scrible-bench: sort_lines out of memory\n");
+        exit(1);
+    }
+    ctx->sink += (unsigned char)ctx->scratch[ctx->len / 2];
+}
+
+static void op_strip_trailing(bench_ctx *ctx) {
+    ctx->sink += sc_strip_trailing(ctx->text, ctx->len, ctx->scratch);
+}
+
+static void op_comment_lines(bench_ctx *ctx) {
+    ctx->sink += sc_comment_lines(ctx->text, ctx->len, ctx->scratch);
+}
+
+static void op_uncomment_lines(bench_ctx *ctx) {
+    ctx->sink += sc_uncomment_lines(ctx->text, ctx->len, ctx->scratch);
+}
+
+typedef struct {
+    const char *name;
+    void (*run)(bench_ctx *ctx);
+} bench_op;
+
+static const bench_op ops[] = {
+    { "parse_symbols",   op_parse_symbols },
+    { "count_words",     op_count_words },
+    { "sort_lines",      op_sort_lines },
+    { "strip_trailing",  op_strip_trailing },
+    { "comment_lines",   op_comment_lines },
+    { "uncomment_lines", op_uncomment_lines },
+};
+
+static const struct {
+    const char *name;
+    gen_fn gen;
+} corpora[] = {
+    { "c",   gen_c_chunk },
+    { "log", gen_log_chunk },
+};
+
+static const size_t sizes[] = {
+    1u << 10, 64u << 10, 1u << 20, 16u << 20, 128u << 20, 500u << 20
+};
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static int compare_doubles(const void *a, const void *b) {
+    double da = *(const double *)a, db = *(const double *)b;
+    return (da > db) - (da < db);
+}
+
+/* Nearest-rank percentile of sorted samples */
+static double percentile(const double *sorted, int n, double p) {
+    int rank = (int)(p / 100.0 * n + 0.999999);
+    if (rank < 1) rank = 1;
+    if (rank > n) rank = n;
+    return sorted[rank - 1];
+}
+
+static size_t parse_size(const char *arg) {
+    char *end;
+    double v = strtod(arg, &end);
+    switch (*end) {
+    case 'k': case 'K': v *= 1 << 10; break;
+    case 'm': case 'M': v *= 1 << 20; break;
+    case 'g': case 'G': v *= 1 << 30; break;
+    default: break;
+    }
+    return (size_t)v;
+}
+
+static void format_size(size_t size, char *buf, size_t n) {
+    if (size >= (1u << 20)) snprintf(buf, n, "%zuM", size >> 20);
+    else snprintf(buf, n, "%zuK", size >> 10);
+}
+
+#define COMPARE_MAX_FILES 8
+#define COMPARE_MAX_ROWS  256
+
+typedef struct {
+    char corpus[16];
+    size_t size;
+    char op[32];
+    double mbps[COMPARE_MAX_FILES];   /* 0 = missing from that file */
+} compare_row;
+
+/* Name of a result file without directory and .csv, used as column header */
+static void compare_label(const char *path, char *buf, size_t n) {
+    const char *base = strrchr(path, '/');
+    base = base ? base + 1 : path;
+    size_t len = strcspn(base, ".");
+    snprintf(buf, n, "%.*s", (int)len, base);
+}
+
+static int compare_results(int n_files, char **paths) {
+    static compare_row rows[COMPARE_MAX_ROWS];
+    char labels[COMPARE_MAX_FILES][16];
+    int n_rows = 0;
+
+    if (n_files < 2 || n_files > COMPARE_MAX_FILES) {
+        fprintf(stderr, "scrible-bench: --compare takes 2 to %d files\n", COMPARE_MAX_FILES);
+        return 2;
+    }
+    for (int f = 0; f < n_files; f++) {
+        FILE *in = fopen(paths[f], "r");
+        char line[256];
+
+        if (!in) {
+            fprintf(stderr, "scrible-bench: cannot open %s\n", paths[f]);
+            return 1;
+        }
+        compare_label(paths[f], labels[f], sizeof(labels[f]));
+        while (fgets(line, sizeof(line), in)) {
+            compare_row r = { 0 };
+            double mbps;
+            int i;
+
+            if (sscanf(line, "%15[^,],%zu,%31[^,],%*d,%lf", r.corpus, &r.size, r.op, &mbps) != 4)
+                continue;   /* header */
+            for (i = 0; i < n_rows; i++)
+                if (rows[i].size == r.size && strcmp(rows[i].corpus, r.corpus) == 0 &&
+                    strcmp(rows[i].op, r.op) == 0)
+                    break;
+            if (i == n_rows) {
+                if (n_rows == COMPARE_MAX_ROWS) continue;
+                rows[n_rows++] = r;
+            }
+            rows[i].mbps[f] = mbps;
+        }
+        fclose(in);
+    }
+
+    printf("MB/s at the median, change against %s\n", labels[0]);
+    printf("%-5s %6s %-16s %10s", "data", "size", "operation", labels[0]);
+    for (int f = 1; f < n_files; f++) printf(" %18s", labels[f]);
+    printf("\n");
+
+    double log_sum[COMPARE_MAX_FILES] = { 0 };
+    int n_ratios[COMPARE_MAX_FILES] = { 0 };
+    for (int i = 0; i < n_rows; i++) {
+        char size_label[16];
+        double base = rows[i].mbps[0];
+
+        format_size(rows[i].size, size_label, sizeof(size_label));
+        printf("%-5s %6s %-16s %10.1f", rows[i].corpus, size_label, rows[i].op, base);
+        for (int f = 1; f < n_files; f++) {
+            double v = rows[i].mbps[f];
+            if (v <= 0 || base <= 0) {
+                printf(" %18s", "-");
+                continue;
+            }
+            printf(" %10.1f %+6.1f%%", v, (v / base - 1) * 100);
+            log_sum[f] += log(v / base);
+            n_ratios[f]++;
+        }
+        printf("\n");
+    }
+
+    /* Geometric mean of the per-case ratios, so no single size dominates */
+    int best = 0;
+    double best_gain = 1;
+    printf("\ngeomean vs %s:", labels[0]);
+    for (int f = 1; f < n_files; f++) {
+        double gain = n_ratios[f] ? exp(log_sum[f] / n_ratios[f]) : 1;
+        printf("  %s %+.1f%%", labels[f], (gain - 1) * 100);
+        if (gain > best_gain) {
+            best_gain = gain;
+            best = f;
+        }
+    }
+    printf("\nfastest: %s\n", labels[best]);
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    size_t max_size = 500u << 20;
+    const char *only = NULL;
+    int forced_runs = 0;
+    int csv = 0;
+
+    if (argc > 1 && strcmp(argv[1], "--compare") == 0)
+        return compare_results(argc - 2, argv + 2);
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--max-size") == 0 && i + 1 < argc) max_size = parse_size(argv[++i]);
+        else if (strcmp(argv[i], "--only") == 0 && i + 1 < argc) only = argv[++i];
+        else if (strcmp(argv[i], "--runs") == 0 && i + 1 < argc) forced_runs = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--csv") == 0) csv = 1;
+        else {
+            fprintf(stderr, "usage: %s [--max-size SIZE] [--only NAME] [--runs N] [--csv]\n"
+                            "       %s --compare BASE.csv OTHER.csv...\n", argv[0], argv[0]);
+            return 2;
+        }
+    }
+
+    if (csv) printf("corpus,size,op,runs,mb_per_s,p50_us,p95_us,p99_us\n");
+    else printf("%-5s %6s %-16s %5s %10s %12s %12s %12s\n",
+                "data", "size", "operation", "runs", "MB/s", "p50 us", "p95 us", "p99 us");
+
+    size_t sink = 0;
+    for (size_t ci = 0; ci < sizeof(corpora) / sizeof(corpora[0]); ci++) {
+        for (size_t si = 0; si < sizeof(sizes) / sizeof(sizes[0]) && sizes[si] <= max_size; si++) {
+            size_t size = sizes[si];
+            corpus c = make_corpus(corpora[ci].gen, size);
+            size_t scratch_len = size + 3 * sc_count_lines(c.data, c.len) + 1;
+            bench_ctx ctx = { c.data, c.len, malloc(scratch_len), 0 };
+            char size_label[16];
+
+            if (!ctx.scratch) {
+                fprintf(stderr, "scrible-bench: cannot allocate %zu bytes\n", scratch_len);
+                return 1;
+            }
+            format_size(size, size_label, sizeof(size_label));
+
+            for (size_t oi = 0; oi < sizeof(ops) / sizeof(ops[0]); oi++) {
+                if (only && !strstr(ops[oi].name, only)) continue;
+
+                int runs = forced_runs > 0 ? forced_runs : (int)(BENCH_BUDGET / size);
+                if (forced_runs <= 0) {
+                    if (runs < BENCH_MIN_RUNS) runs = BENCH_MIN_RUNS;
+                    if (runs > BENCH_MAX_RUNS) runs = BENCH_MAX_RUNS;
+                }
+                double *samples = malloc(runs * sizeof(double));
+
+                ops[oi].run(&ctx);   /* warm up caches and page in scratch */
+                for (int r = 0; r < runs; r++) {
+                    double t0 = now_ns();
+                    ops[oi].run(&ctx);
+                    samples[r] = now_ns() - t0;
+                }
+                qsort(samples, runs, sizeof(double), compare_doubles);
+
+                double p50 = percentile(samples, runs, 50);
+                double mbps = (double)size / (1 << 20) / (p50 / 1e9);
+                if (csv)
+                    printf("%s,%zu,%s,%d,%.1f,%.2f,%.2f,%.2f\n", corpora[ci].name, size,
+                           ops[oi].name, runs, mbps, p50 / 1e3,
+                           percentile(samples, runs, 95) / 1e3, percentile(samples, runs, 99) / 1e3);
+                else
+                    printf("%-5s %6s %-16s %5d %10.1f %12.2f %12.2f %12.2f\n", corpora[ci].name,
+                           size_label, ops[oi].name, runs, mbps, p50 / 1e3,
+                           percentile(samples, runs, 95) / 1e3, percentile(samples, runs, 99) / 1e3);
+                fflush(stdout);
+                free(samples);
+            }
+            sink += ctx.sink;
+            free(ctx.scratch);
+            free(c.data);
+        }
+    }
+    /* Keeps the results observable so no operation is optimized away */
+    if (sink == 42) fprintf(stderr, "\n");
+    return 0;
+}
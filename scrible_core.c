@@ -0,0 +1,1327 @@
+/*
+ * scrible_core.c Text processing core of the scrible editor
+ * See scrible_core.h. Everything works on (pointer, length) byte ranges and
+ * walks lines with memchr, so no function copies a line to NUL terminate it.
+ */
+#include "scrible_core.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/* memmem over a byte range, needle is a short C string */
+static const char *find_in(const char *hay, size_t len, const char *needle) {
+    size_t n = strlen(needle);
+    if (n > len) return NULL;
+
+    const char *end = hay + len - n;
+    for (const char *p = hay; p <= end; p++) {
+        p = memchr(p, needle[0], end - p + 1);
+        if (!p) return NULL;
+        if (memcmp(p, needle, n) == 0) return p;
+    }
+    return NULL;
+}
+
+static const char *line_end(const char *p, const char *end) {
+    const char *nl = memchr(p, '\n', end - p);
+    return nl ? nl : end;
+}
+
+static int is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+}
+
+size_t sc_count_lines(const char *text, size_t len) {
+    const char *p = text, *end = text + len;
+    size_t lines = 1;
+
+    while ((p = memchr(p, '\n', end - p)) != NULL) {
+        lines++;
+        p++;
+    }
+    return lines;
+}
+
+size_t sc_parse_symbols(const char *text, size_t len, sc_symbol_fn fn, void *user) {
+    const char *p = text, *end = text + len;
+    size_t found = 0;
+    int line = 1;
+
+    for (;;) {
+        const char *eol = line_end(p, end);
+        const char *s = p;
+        while (s < eol && is_space(*s)) s++;
+        size_t n = eol - s;
+
+        if (n > 0 && memchr(s, '(', n) && !memchr(s, ';', n) &&
+            !find_in(s, n, "if") && !find_in(s, n, "while") && !find_in(s, n, "for")) {
+            if (fn) fn(s, n, line, user);
+            found++;
+        }
+        if (eol == end) break;
+        p = eol + 1;
+        line++;
+    }
+    return found;
+}
+
+void sc_count_words(const char *text, size_t len, sc_counts *counts) {
+    size_t words = 0, chars = 0, lines = 1;
+    int in_word = 0;
+
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = (unsigned char)text[i];
+        int sep = (c == ' ' || c == '\n' || c == '\t' || c == '\r');
+
+        if (!sep && !in_word) words++;
+        in_word = !sep;
+        if ((c & 0xC0) != 0x80) chars++;
+        if (c == '\n') lines++;
+    }
+    counts->words = words;
+    counts->chars = chars;
+    counts->lines = lines;
+}
+
+typedef struct {
+    const char *start;
+    size_t len;
+} sc_line;
+
+static int compare_lines(const void *a, const void *b) {
+    const sc_line *la = a, *lb = b;
+    size_t n = la->len < lb->len ? la->len : lb->len;
+    int cmp = memcmp(la->start, lb->start, n);
+
+    if (cmp != 0) return cmp;
+    return (la->len > lb->len) - (la->len < lb->len);
+}
+
+int sc_sort_lines(const char *text, size_t len, char *out) {
+    size_t n_lines = sc_count_lines(text, len);
+    sc_line *lines = malloc(n_lines * sizeof(sc_line));
+    const char *p = text, *end = text + len;
+
+    if (!lines) return -1;
+    for (size_t i = 0; i < n_lines; i++) {
+        const char *eol = line_end(p, end);
+        lines[i].start = p;
+        lines[i].len = eol - p;
+        p = eol + 1;
+    }
+
+    qsort(lines, n_lines, sizeof(sc_line), compare_lines);
+
+    char *o = out;
+    for (size_t i = 0; i < n_lines; i++) {
+        if (i > 0) *o++ = '\n';
+        memcpy(o, lines[i].start, lines[i].len);
+        o += lines[i].len;
+    }
+    free(lines);
+    return 0;
+}
+
+size_t sc_strip_trailing(const char *text, size_t len, char *out) {
+    const char *p = text, *end = text + len;
+    char *o = out;
+
+    for (;;) {
+        const char *eol = line_end(p, end);
+        const char *keep = eol;
+        while (keep > p && (keep[-1] == ' ' || keep[-1] == '\t')) keep--;
+
+        memmove(o, p, keep - p);
+        o += keep - p;
+        if (eol == end) break;
+        *o++ = '\n';
+        p = eol + 1;
+    }
+    return o - out;
+}
+
+size_t sc_comment_lines(const char *text, size_t len, char *out) {
+    const char *p = text, *end = text + len;
+    char *o = out;
+
+    for (;;) {
+        const char *eol = line_end(p, end);
+        memcpy(o, "// ", 3);
+        memcpy(o + 3, p, eol - p);
+        o += 3 + (eol - p);
+        if (eol == end) break;
+        *o++ = '\n';
+        p = eol + 1;
+    }
+    return o - out;
+}
+
+size_t sc_uncomment_span(const char *line, size_t len, size_t *start) {
+    size_t i = 0;
+
+    while (i < len && is_space(line[i])) i++;
+    if (i + 1 >= len || line[i] != '/' || line[i + 1] != '/')
+        return 0;
+
+    *start = i;
+    return (i + 2 < len && line[i + 2] == ' ') ? 3 : 2;
+}
+
+size_t sc_uncomment_lines(const char *text, size_t len, char *out) {
+    const char *p = text, *end = text + len;
+    char *o = out;
+
+    for (;;) {
+        const char *eol = line_end(p, end);
+        size_t n = eol - p, start = 0;
+        size_t cut = sc_uncomment_span(p, n, &start);
+
+        memmove(o, p, start);
+        memmove(o + start, p + start + cut, n - start - cut);
+        o += n - cut;
+        if (eol == end) break;
+        *o++ = '\n';
+        p = eol + 1;
+    }
+    return o - out;
+}
+
+size_t sc_longest_line(const char *text, size_t len) {
+    const char *p = text, *end = text + len;
+    size_t longest = 0;
+
+    for (;;) {
+        const char *eol = line_end(p, end);
+        if ((size_t)(eol - p) > longest) longest = eol - p;
+        if (eol == end) break;
+        p = eol + 1;
+    }
+    return longest;
+}
+
+/* Bytes to take from a line with rest bytes left, given rest > limit */
+static size_t split_piece(const char *p, size_t limit) {
+    size_t cut = limit;
+
+    for (size_t i = limit; i > limit - limit / 4; i--)
+        if (p[i - 1] == ' ' || p[i - 1] == '\t' || p[i - 1] == ',' || p[i - 1] == ';')
+            return i;
+    while (cut > limit - 3 && ((unsigned char)p[cut] & 0xC0) == 0x80) cut--;
+    return ((unsigned char)p[cut] & 0xC0) == 0x80 ? limit : cut;
+}
+
+size_t sc_split_long_lines(const char *text, size_t len, size_t limit, char *out, size_t *breaks) {
+    const char *p = text, *end = text + len;
+    char *o = out;
+    size_t inserted = 0, line = 0;
+
+    if (limit < 16) limit = 16;
+    for (;;) {
+        const char *eol = line_end(p, end);
+
+        while ((size_t)(eol - p) > limit) {
+            size_t piece = split_piece(p, limit);
+            if (out) {
+                memcpy(o, p, piece);
+                o += piece;
+                *o++ = '\n';
+            }
+            if (breaks) breaks[inserted] = line;
+            inserted++;
+            line++;
+            p += piece;
+        }
+        if (out) {
+            memcpy(o, p, eol - p);
+            o += eol - p;
+        }
+        if (eol == end) break;
+        if (out) *o++ = '\n';
+        p = eol + 1;
+        line++;
+    }
+    return inserted;
+}
+
+static int word_at(const char *p, size_t n, const char *word) {
+    size_t w = strlen(word);
+    return n >= w && memcmp(p, word, w) == 0;
+}
+
+int sc_lex_line(const char *line, size_t len, int state, sc_token_fn fn, void *user) {
+    int directive = 0;
+    size_t i = 0;
+
+    if (state == SC_LEX_CODE) {
+        size_t j = 0;
+        while (j < len && (line[j] == ' ' || line[j] == '\t')) j++;
+        if (j < len && line[j] == '#') {
+            size_t k = j + 1;
+            while (k < len && (line[k] == ' ' || line[k] == '\t')) k++;
+            directive = 1;
+            if (word_at(line + k, len - k, "if"))
+                fn(j, 'i', user);
+            else if (word_at(line + k, len - k, "else") || word_at(line + k, len - k, "elif"))
+                fn(j, 'e', user);
+            else if (word_at(line + k, len - k, "endif"))
+                fn(j, 'n', user);
+            i = k;
+        }
+    }
+
+    for (; i < len; i++) {
+        char c = line[i];
+
+        if (state == SC_LEX_COMMENT) {
+            if (c == '*' && i + 1 < len && line[i + 1] == '/') {
+                state = SC_LEX_CODE;
+                i++;
+            }
+        } else if (c == '/' && i + 1 < len && line[i + 1] == '/') {
+            break;
+        } else if (c == '/' && i + 1 < len && line[i + 1] == '*') {
+            state = SC_LEX_COMMENT;
+            i++;
+        } else if (c == '"' || c == '\'') {
+            /* A literal ends at its closing quote or, unterminated, at the end of the line */
+            for (i++; i < len && line[i] != c; i++)
+                if (line[i] == '\\') i++;
+        } else if ((c == '{' || c == '}') && !directive) {
+            fn(i, c, user);
+        }
+    }
+    return state;
+}
+
+static int is_ident_start(char c) {
+    return c == '_' || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+static int is_ident_char(char c) {
+    return is_ident_start(c) || (c >= '0' && c <= '9');
+}
+
+/* End of the literal starting at i (the quote), at most len */
+static size_t skip_literal(const char *p, size_t i, size_t len) {
+    char quote = p[i];
+    for (i++; i < len && p[i] != quote && p[i] != '\n'; i++)
+        if (p[i] == '\\') i++;
+    return i < len ? i + 1 : len;
+}
+
+int sc_lex_idents(const char *line, size_t len, int state, sc_span_fn fn, void *user) {
+    size_t i = 0;
+
+    if (state == SC_LEX_CODE) {
+        while (i < len && (line[i] == ' ' || line[i] == '\t')) i++;
+        if (i < len && line[i] == '#') {
+            for (i++; i < len && (line[i] == ' ' || line[i] == '\t'); i++)
+                ;
+            if (word_at(line + i, len - i, "include")) return state;
+            while (i < len && is_ident_char(line[i])) i++;
+        }
+    }
+
+    while (i < len) {
+        char c = line[i];
+
+        if (state == SC_LEX_COMMENT) {
+            if (c == '*' && i + 1 < len && line[i + 1] == '/') {
+                state = SC_LEX_CODE;
+                i++;
+            }
+            i++;
+        } else if (c == '/' && i + 1 < len && line[i + 1] == '/') {
+            break;
+        } else if (c == '/' && i + 1 < len && line[i + 1] == '*') {
+            state = SC_LEX_COMMENT;
+            i += 2;
+        } else if (c == '"' || c == '\'') {
+            i = skip_literal(line, i, len);
+        } else if (is_ident_start(c)) {
+            size_t start = i;
+            while (i < len && is_ident_char(line[i])) i++;
+            fn(start, i - start, user);
+        } else if (c >= '0' && c <= '9') {
+            while (i < len && (is_ident_char(line[i]) || line[i] == '.')) i++;
+        } else {
+            i++;
+        }
+    }
+    return state;
+}
+
+/*
+ * Declaration scan: a small tokenizer and two state machines, one for
+ * file scope statements and one for statements inside a function body.
+ */
+#define DECL_MAX_PARAMS 32
+
+static const char *const decl_qualifiers[] = {
+    "const", "static", "volatile", "register", "extern", "inline", "auto",
+    "restrict", "_Atomic", "_Thread_local", NULL
+};
+
+/* Type names, the first four also work as prefixes of one */
+static const char *const decl_types[] = {
+    "unsigned", "signed", "long", "short",
+    "int", "char", "void", "float", "double", "_Bool", "_Complex", NULL
+};
+
+/* Keywords that cannot start a declaration or be a declared name */
+static const char *const decl_keywords[] = {
+    "break", "case", "continue", "default", "do", "else", "for", "goto", "if",
+    "return", "sizeof", "switch", "typedef", "while", "_Alignof", "_Generic",
+    "_Static_assert", "__attribute__", "__asm__", "asm", NULL
+};
+
+enum {
+    DS_START,       /* at the start of a statement */
+    DS_TYPE,        /* type seen, expecting a declarator */
+    DS_NAME,        /* declarator name seen */
+    DS_DECLARED,    /* after an array declarator's ']' */
+    DS_ARRAY,       /* inside [ ] */
+    DS_INIT,        /* skipping an initializer */
+    DS_SKIP         /* not a declaration, wait for the next statement */
+};
+
+typedef struct {
+    const char *text;
+    size_t len;
+    size_t pos;
+    int bol;                  /* only blanks since the last newline */
+    size_t start, tlen;       /* current token */
+    char type;                /* 'w' identifier, 'l' literal or number, else the character, 0 at the end */
+    char prev;
+
+    sc_decl_fn fn;
+    void *user;
+    size_t found;
+
+    int depth;                /* braces */
+    int tag_next;             /* after struct/union/enum: the next identifier is a tag */
+    int enum_pending;
+    int enum_depth;           /* brace depth inside an enum body, 0 when not in one */
+    int enum_paren;
+    int enumerator_next;
+
+    /* File scope statement */
+    int paren;
+    int is_typedef, has_assign;
+    size_t ident, ident_len;
+    size_t alias, alias_len;  /* typedef name of a function pointer typedef */
+    size_t func, func_len;
+    size_t params[DECL_MAX_PARAMS][2];
+    int nparams;
+    size_t param, param_len;
+
+    /* Function body */
+    size_t body;              /* offset of its '{', SC_NO_SCOPE outside */
+    int dstate;
+    int nest;
+    int for_pending;
+    size_t name, name_len;
+} decl_scan;
+
+static int word_in(const char *p, size_t n, const char *const *words) {
+    for (; *words; words++)
+        if (strlen(*words) == n && memcmp(p, *words, n) == 0) return 1;
+    return 0;
+}
+
+static void decl_report(decl_scan *s, size_t offset, size_t len, int kind, size_t scope) {
+    if (len == 0) return;
+    s->fn(offset, len, kind, scope, s->user);
+    s->found++;
+}
+
+/* Skip a preprocessor line (i is at its '#'), reporting a #define name */
+static size_t decl_directive(decl_scan *s, size_t i) {
+    const char *t = s->text;
+    size_t n = s->len;
+
+    for (i++; i < n && (t[i] == ' ' || t[i] == '\t'); i++)
+        ;
+    if (word_at(t + i, n - i, "define") && i + 6 < n && (t[i + 6] == ' ' || t[i + 6] == '\t')) {
+        for (i += 6; i < n && (t[i] == ' ' || t[i] == '\t'); i++)
+            ;
+        size_t start = i;
+        while (i < n && is_ident_char(t[i])) i++;
+        if (i > start && is_ident_start(t[start])) decl_report(s, start, i - start, SC_SYM_MACRO, SC_NO_SCOPE);
+    }
+    /* To the end of the line, following backslash continuations */
+    for (;;) {
+        const char *nl = memchr(t + i, '\n', n - i);
+        if (!nl) return n;
+        i = nl - t;
+        size_t k = i;
+        if (k > 0 && t[k - 1] == '\r') k--;
+        if (k == 0 || t[k - 1] != '\\') return i;
+        i++;
+    }
+}
+
+static char decl_next(decl_scan *s) {
+    const char *t = s->text;
+    size_t n = s->len, i = s->pos;
+
+    s->prev = s->type;
+    for (;;) {
+        while (i < n && (is_space(t[i]) || t[i] == '\f' || t[i] == '\v')) {
+            if (t[i] == '\n') s->bol = 1;
+            i++;
+        }
+        if (i >= n) {
+            s->pos = n;
+            s->type = 0;
+            return 0;
+        }
+        if (t[i] == '/' && i + 1 < n && t[i + 1] == '/') {
+            i = line_end(t + i, t + n) - t;
+        } else if (t[i] == '/' && i + 1 < n && t[i + 1] == '*') {
+            const char *close = find_in(t + i + 2, n - i - 2, "*/");
+            i = close ? (size_t)(close - t) + 2 : n;
+        } else if (t[i] == '#' && s->bol) {
+            i = decl_directive(s, i);
+        } else {
+            break;
+        }
+    }
+
+    char c = t[i];
+    s->bol = 0;
+    s->start = i;
+    if (is_ident_start(c)) {
+        while (i < n && is_ident_char(t[i])) i++;
+        s->type = 'w';
+    } else if (c >= '0' && c <= '9') {
+        while (i < n && (is_ident_char(t[i]) || t[i] == '.')) i++;
+        s->type = 'l';
+    } else if (c == '"' || c == '\'') {
+        i = skip_literal(t, i, n);
+        s->type = 'l';
+    } else {
+        i++;
+        s->type = c;
+    }
+    s->tlen = i - s->start;
+    s->pos = i;
+    return s->type;
+}
+
+static int decl_is(decl_scan *s, const char *word) {
+    return s->type == 'w' && s->tlen == strlen(word) && memcmp(s->text + s->start, word, s->tlen) == 0;
+}
+
+static void decl_reset_statement(decl_scan *s) {
+    s->paren = 0;
+    s->is_typedef = s->has_assign = 0;
+    s->ident_len = s->alias_len = s->func_len = s->param_len = 0;
+    s->nparams = 0;
+    s->enum_pending = 0;
+}
+
+static void decl_push_param(decl_scan *s) {
+    if (s->param_len && s->nparams < DECL_MAX_PARAMS) {
+        s->params[s->nparams][0] = s->param;
+        s->params[s->nparams][1] = s->param_len;
+        s->nparams++;
+    }
+    s->param_len = 0;
+}
+
+/* Identifiers common to both scopes: tags and the keywords that introduce them */
+static int decl_tag(decl_scan *s) {
+    if (s->type != 'w') return 0;
+    if (s->tag_next) {
+        s->tag_next = 0;
+        decl_report(s, s->start, s->tlen, SC_SYM_TYPE, SC_NO_SCOPE);
+        return 1;
+    }
+    if (decl_is(s, "struct") || decl_is(s, "union") || decl_is(s, "enum")) {
+        s->tag_next = 1;
+        if (decl_is(s, "enum")) s->enum_pending = 1;
+        return 1;
+    }
+    return 0;
+}
+
+static void decl_enum_body(decl_scan *s) {
+    switch (s->type) {
+    case 'w':
+        if (s->enumerator_next) decl_report(s, s->start, s->tlen, SC_SYM_ENUM, SC_NO_SCOPE);
+        s->enumerator_next = 0;
+        break;
+    case '(': s->enum_paren++; break;
+    case ')': if (s->enum_paren) s->enum_paren--; break;
+    case ',': if (!s->enum_paren) s->enumerator_next = 1; break;
+    case '}':
+        s->depth--;
+        s->enum_depth = 0;
+        break;
+    case '{': s->depth++; break;
+    }
+}
+
+static void decl_file_scope(decl_scan *s) {
+    const char *word = s->text + s->start;
+
+    if (s->depth > 0) {
+        /* Inside a struct or union body at file scope, only tags matter */
+        if (s->type == '{') s->depth++;
+        else if (s->type == '}') s->depth--;
+        else decl_tag(s);
+        return;
+    }
+
+    switch (s->type) {
+    case 'w':
+        if (decl_tag(s)) break;
+        if (decl_is(s, "typedef")) {
+            s->is_typedef = 1;
+        } else if (s->paren == 0) {
+            s->ident = s->start;
+            s->ident_len = s->tlen;
+        } else if (s->paren == 1 && s->is_typedef && s->prev == '*' && !s->alias_len) {
+            s->alias = s->start;
+            s->alias_len = s->tlen;
+        } else if (s->paren == 1 && s->func_len && !word_in(word, s->tlen, decl_qualifiers) &&
+                   !word_in(word, s->tlen, decl_types)) {
+            s->param = s->start;
+            s->param_len = s->tlen;
+        }
+        break;
+    case '(':
+        if (s->paren == 0 && s->prev == 'w' && !s->has_assign && !s->is_typedef &&
+            !word_in(s->text + s->ident, s->ident_len, decl_keywords) &&
+            !word_in(s->text + s->ident, s->ident_len, decl_types)) {
+            s->func = s->ident;
+            s->func_len = s->ident_len;
+            s->nparams = 0;
+            s->param_len = 0;
+        }
+        s->paren++;
+        break;
+    case ')':
+        if (s->paren == 1 && s->func_len) decl_push_param(s);
+        if (s->paren) s->paren--;
+        break;
+    case ',':
+        if (s->paren == 1 && s->func_len) decl_push_param(s);
+        else if (s->paren == 0 && s->is_typedef)
+            decl_report(s, s->ident, s->ident_len, SC_SYM_TYPE, SC_NO_SCOPE);
+        break;
+    case '=':
+        if (s->paren == 0) s->has_assign = 1;
+        break;
+    case ';':
+        if (s->is_typedef) {
+            if (s->alias_len) decl_report(s, s->alias, s->alias_len, SC_SYM_TYPE, SC_NO_SCOPE);
+            else decl_report(s, s->ident, s->ident_len, SC_SYM_TYPE, SC_NO_SCOPE);
+        } else if (s->func_len && !s->has_assign) {
+            decl_report(s, s->func, s->func_len, SC_SYM_FUNCTION, SC_NO_SCOPE);
+        }
+        decl_reset_statement(s);
+        break;
+    case '{':
+        /* extern "C" { does not open a scope, its '}' is ignored like any at depth 0 */
+        if (s->prev == 'l' && s->ident_len == 6 && memcmp(s->text + s->ident, "extern", 6) == 0) {
+            decl_reset_statement(s);
+            break;
+        }
+        s->depth++;
+        if (s->func_len && !s->has_assign && !s->is_typedef && s->prev == ')' && s->paren == 0) {
+            s->body = s->start;
+            decl_report(s, s->func, s->func_len, SC_SYM_FUNCTION, SC_NO_SCOPE);
+            for (int i = 0; i < s->nparams; i++)
+                decl_report(s, s->params[i][0], s->params[i][1], SC_SYM_LOCAL, s->body);
+            s->dstate = DS_START;
+            s->for_pending = 0;
+        } else if (s->enum_pending) {
+            s->enum_pending = 0;
+            s->enum_depth = s->depth;
+            s->enumerator_next = 1;
+            s->enum_paren = 0;
+        }
+        break;
+    }
+}
+
+static void decl_function_body(decl_scan *s) {
+    const char *word = s->text + s->start;
+    char c = s->type;
+
+    if (c == '{') {
+        s->depth++;
+        if (s->enum_pending) {
+            s->enum_pending = 0;
+            s->enum_depth = s->depth;
+            s->enumerator_next = 1;
+            s->enum_paren = 0;
+        } else if (s->dstate == DS_INIT) {
+            s->nest++;
+        } else {
+            s->dstate = DS_START;
+        }
+        return;
+    }
+    if (c == '}') {
+        if (--s->depth == 0) {
+            decl_report(s, s->body, s->start + 1 - s->body, SC_SYM_BODY, SC_NO_SCOPE);
+            s->body = SC_NO_SCOPE;
+            decl_reset_statement(s);
+        } else if (s->dstate == DS_INIT && s->nest > 0) {
+            s->nest--;
+        } else {
+            s->dstate = DS_START;
+        }
+        return;
+    }
+    if (c == ';') {
+        if (s->dstate == DS_NAME) decl_report(s, s->name, s->name_len, SC_SYM_LOCAL, s->body);
+        s->dstate = DS_START;
+        s->enum_pending = 0;
+        s->tag_next = 0;
+        return;
+    }
+    if (decl_tag(s)) {
+        if (s->dstate == DS_START) s->dstate = DS_TYPE;
+        return;
+    }
+
+    switch (s->dstate) {
+    case DS_START:
+        if (c == 'w') {
+            if (decl_is(s, "for")) s->for_pending = 1;
+            else if (word_in(word, s->tlen, decl_keywords)) s->dstate = DS_SKIP;
+            else if (!word_in(word, s->tlen, decl_qualifiers)) s->dstate = DS_TYPE;
+        } else if (c == '(' && s->for_pending) {
+            s->for_pending = 0;
+        } else {
+            s->dstate = DS_SKIP;
+        }
+        break;
+    case DS_TYPE:
+        if (c == 'w') {
+            if (word_in(word, s->tlen, decl_keywords)) {
+                s->dstate = DS_SKIP;
+            } else if (!word_in(word, s->tlen, decl_qualifiers) && !word_in(word, s->tlen, decl_types)) {
+                s->name = s->start;
+                s->name_len = s->tlen;
+                s->dstate = DS_NAME;
+            }
+        } else if (c != '*') {
+            s->dstate = DS_SKIP;
+        }
+        break;
+    case DS_NAME:
+        if (c == '=' || c == ',' || c == '[')
+            decl_report(s, s->name, s->name_len, SC_SYM_LOCAL, s->body);
+        /* fall through */
+    case DS_DECLARED:
+        if (c == '=') {
+            s->dstate = DS_INIT;
+            s->nest = 0;
+        } else if (c == ',') {
+            s->dstate = DS_TYPE;
+        } else if (c == '[') {
+            s->dstate = DS_ARRAY;
+            s->nest = 1;
+        } else {
+            s->dstate = DS_SKIP;
+        }
+        break;
+    case DS_ARRAY:
+        if (c == '[') s->nest++;
+        else if (c == ']' && --s->nest == 0) s->dstate = DS_DECLARED;
+        break;
+    case DS_INIT:
+        if (c == '(' || c == '[') s->nest++;
+        else if ((c == ')' || c == ']') && s->nest > 0) s->nest--;
+        else if (c == ',' && s->nest == 0) s->dstate = DS_TYPE;
+        break;
+    }
+}
+
+size_t sc_scan_decls(const char *text, size_t len, sc_decl_fn fn, void *user) {
+    decl_scan s;
+
+    memset(&s, 0, sizeof(s));
+    s.text = text;
+    s.len = len;
+    s.bol = 1;
+    s.fn = fn;
+    s.user = user;
+    s.body = SC_NO_SCOPE;
+
+    while (decl_next(&s)) {
+        if (s.enum_depth && s.depth == s.enum_depth) decl_enum_body(&s);
+        else if (s.body != SC_NO_SCOPE) decl_function_body(&s);
+        else decl_file_scope(&s);
+        if (s.type != 'w') s.tag_next = 0;
+    }
+    return s.found;
+}
+
+unsigned long long sc_hash64(const void *data, size_t len) {
+    const unsigned char *p = data;
+    unsigned long long h = 14695981039346656037ULL;
+
+    for (size_t i = 0; i < len; i++) {
+        h ^= p[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+static size_t index_hashes_size(size_t nhashes) {
+    return (nhashes * sizeof(unsigned int) + 7) & ~(size_t)7;
+}
+
+size_t sc_index_size(const sc_index *index) {
+    return sizeof(sc_index_header) + index->nfiles * sizeof(sc_index_file) +
+           index->nsymbols * sizeof(sc_index_symbol) + index_hashes_size(index->nhashes) +
+           index->strings_len;
+}
+
+void sc_index_store(const sc_index *index, void *out) {
+    sc_index_header header;
+    char *p = out;
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SC_INDEX_MAGIC, 4);
+    header.version = SC_INDEX_VERSION;
+    header.nfiles = index->nfiles;
+    header.nsymbols = index->nsymbols;
+    header.nhashes = index->nhashes;
+    header.strings_len = index->strings_len;
+
+    memcpy(p, &header, sizeof(header));
+    p += sizeof(header);
+    if (index->nfiles) memcpy(p, index->files, index->nfiles * sizeof(sc_index_file));
+    p += index->nfiles * sizeof(sc_index_file);
+    if (index->nsymbols) memcpy(p, index->symbols, index->nsymbols * sizeof(sc_index_symbol));
+    p += index->nsymbols * sizeof(sc_index_symbol);
+    memset(p, 0, index_hashes_size(index->nhashes));
+    if (index->nhashes) memcpy(p, index->hashes, index->nhashes * sizeof(unsigned int));
+    p += index_hashes_size(index->nhashes);
+    if (index->strings_len) memcpy(p, index->strings, index->strings_len);
+}
+
+/* strcmp of a pool string against (name, len) */
+static int index_name_cmp(const sc_index *index, unsigned long long offset, const char *name, size_t len) {
+    const char *s = index->strings + offset;
+    size_t n = strnlen(s, index->strings_len - offset);
+    int c = memcmp(s, name, n < len ? n : len);
+    if (c) return c;
+    return n < len ? -1 : n > len;
+}
+
+int sc_index_open(const void *data, size_t len, sc_index *index) {
+    const char *p = data;
+    sc_index_header header;
+
+    if (len < sizeof(header) || ((size_t)p & 7)) return -1;
+    memcpy(&header, p, sizeof(header));
+    if (memcmp(header.magic, SC_INDEX_MAGIC, 4) != 0 || header.version != SC_INDEX_VERSION) return -1;
+
+    /* Counts bounded by len first, so the size sum cannot overflow */
+    if (header.nfiles > len / sizeof(sc_index_file) || header.nsymbols > len / sizeof(sc_index_symbol) ||
+        header.nhashes > len / sizeof(unsigned int) || header.strings_len > len)
+        return -1;
+    index->nfiles = header.nfiles;
+    index->nsymbols = header.nsymbols;
+    index->nhashes = header.nhashes;
+    index->strings_len = header.strings_len;
+    if (sc_index_size(index) != len) return -1;
+
+    p += sizeof(header);
+    index->files = (const sc_index_file *)p;
+    p += index->nfiles * sizeof(sc_index_file);
+    index->symbols = (const sc_index_symbol *)p;
+    p += index->nsymbols * sizeof(sc_index_symbol);
+    index->hashes = (const unsigned int *)p;
+    p += index_hashes_size(index->nhashes);
+    index->strings = p;
+
+    if (index->strings_len == 0 || index->strings[index->strings_len - 1] != '\0') return -1;
+    for (size_t i = 0; i < index->nfiles; i++) {
+        const sc_index_file *f = &index->files[i];
+        if (f->path >= index->strings_len || f->idents > index->nhashes ||
+            f->nidents > index->nhashes - f->idents)
+            return -1;
+    }
+    /* Names must really be in order, lookups binary search them */
+    for (size_t i = 0; i < index->nsymbols; i++) {
+        const sc_index_symbol *s = &index->symbols[i];
+        if (s->name >= index->strings_len || s->file >= index->nfiles ||
+            s->kind < SC_SYM_FUNCTION || s->kind > SC_SYM_ENUM)
+            return -1;
+        if (i > 0 && s->name != s[-1].name) {
+            const char *prev = index->strings + s[-1].name;
+            if (s->name < s[-1].name || index_name_cmp(index, s->name, prev, strlen(prev)) <= 0)
+                return -1;
+        }
+    }
+    return 0;
+}
+
+size_t sc_index_lookup(const sc_index *index, const char *name, size_t len, size_t *first) {
+    size_t lo = 0, hi = index->nsymbols;
+
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (index_name_cmp(index, index->symbols[mid].name, name, len) < 0) lo = mid + 1;
+        else hi = mid;
+    }
+    *first = lo;
+    /* Equal names share their pool offset */
+    size_t end = lo;
+    if (lo < index->nsymbols && index_name_cmp(index, index->symbols[lo].name, name, len) == 0)
+        while (end < index->nsymbols && index->symbols[end].name == index->symbols[lo].name) end++;
+    return end - lo;
+}
+
+int sc_index_mentions(const sc_index *index, size_t file, const char *name, size_t len) {
+    const sc_index_file *f = &index->files[file];
+    const unsigned int *h = index->hashes + f->idents;
+    unsigned int want = (unsigned int)sc_hash64(name, len);
+    size_t lo = 0, hi = f->nidents;
+
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (h[mid] < want) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo < f->nidents && h[lo] == want;
+}
+
+/* Start of the line after the one holding offset, len if it is the last */
+static size_t tags_line_after(const char *data, size_t len, size_t offset) {
+    const char *nl = memchr(data + offset, '\n', len - offset);
+    return nl ? (size_t)(nl - data) + 1 : len;
+}
+
+static int fold_byte(unsigned char c) {
+    return c >= 'a' && c <= 'z' ? c - 'a' + 'A' : c;
+}
+
+/*
+ * The tag name of the line at offset against (name, nlen), optionally
+ * ignoring ASCII case. Only a name followed by a tab matches; a line that
+ * is just the name sorts before it, as it does in the file.
+ */
+static int tags_key_cmp(const char *data, size_t len, size_t offset, const char *name, size_t nlen, int fold) {
+    const unsigned char *p = (const unsigned char *)data + offset;
+    const unsigned char *n = (const unsigned char *)name;
+    size_t avail = len - offset;
+
+    for (size_t i = 0;; i++) {
+        int end = i == avail || p[i] == '\t' || p[i] == '\n';
+        if (i == nlen) return i == avail || p[i] == '\n' ? -1 : p[i] == '\t' ? 0 : 1;
+        if (end) return -1;
+        int a = fold ? fold_byte(p[i]) : p[i];
+        int b = fold ? fold_byte(n[i]) : n[i];
+        if (a != b) return a - b;
+    }
+}
+
+int sc_tags_sorted(const char *data, size_t len) {
+    static const char key[] = "!_TAG_FILE_SORTED\t";
+    size_t pos = 0;
+
+    /* Pseudo-tags come first */
+    while (pos < len && data[pos] == '!') {
+        if (len - pos > sizeof(key) && memcmp(data + pos, key, sizeof(key) - 1) == 0) {
+            char c = data[pos + sizeof(key) - 1];
+            return c == '1' ? 1 : c == '2' ? 2 : 0;
+        }
+        pos = tags_line_after(data, len, pos);
+    }
+    return 0;
+}
+
+size_t sc_tags_find(const char *data, size_t len, int sorted, const char *name, size_t nlen, size_t from) {
+    if (!sorted) {
+        for (size_t pos = from; pos < len; pos = tags_line_after(data, len, pos))
+            if (tags_key_cmp(data, len, pos, name, nlen, 0) == 0) return pos;
+        return len;
+    }
+
+    /*
+     * Lower bound over byte offsets: lo is always a line start, every line
+     * starting before lo sorts before name and every line starting at or
+     * after hi does not.
+     */
+    int fold = sorted == 2;
+    size_t lo = from, hi = len;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        size_t line = mid == lo ? lo : tags_line_after(data, len, mid - 1);
+        if (line >= hi) hi = mid;
+        else if (tags_key_cmp(data, len, line, name, nlen, fold) < 0) lo = tags_line_after(data, len, line);
+        else hi = line;
+    }
+    /* Case-folded order keeps equal names together but mixes their case */
+    for (size_t pos = lo; pos < len && tags_key_cmp(data, len, pos, name, nlen, fold) == 0;
+         pos = tags_line_after(data, len, pos)) {
+        if (!fold || tags_key_cmp(data, len, pos, name, nlen, 0) == 0) return pos;
+    }
+    return len;
+}
+
+/* Decimal number in [p, end) without overflow; 0 if it does not fit */
+static unsigned int tags_number(const char *p, const char *end) {
+    unsigned long long n = 0;
+
+    for (; p < end && *p >= '0' && *p <= '9'; p++) {
+        n = n * 10 + (unsigned)(*p - '0');
+        if (n > 0xffffffffULL) return 0;
+    }
+    return (unsigned int)n;
+}
+
+int sc_tag_parse(const char *line, size_t len, sc_tag *tag) {
+    const char *p = line, *end = line + len;
+    const char *tab;
+
+    memset(tag, 0, sizeof(*tag));
+    if (end > p && end[-1] == '\r') end--;
+    if (p == end || *p == '!') return -1;
+
+    tab = memchr(p, '\t', end - p);
+    if (!tab || tab == p) return -1;
+    tag->name = p;
+    tag->name_len = tab - p;
+    p = tab + 1;
+    tab = memchr(p, '\t', end - p);
+    if (!tab || tab == p) return -1;
+    tag->file = p;
+    tag->file_len = tab - p;
+    p = tab + 1;
+
+    /* Address: a line number or a /pattern/ or ?pattern? search, which may hold tabs */
+    if (p < end && (*p == '/' || *p == '?')) {
+        char delim = *p++;
+        const char *q = p;
+        while (q < end && *q != delim) q += *q == '\\' && q + 1 < end ? 2 : 1;
+        if (q >= end) return -1;
+        tag->pattern = p;
+        tag->pattern_len = q - p;
+        p = q + 1;
+    } else if (p < end && *p >= '0' && *p <= '9') {
+        tag->line = tags_number(p, end);
+        while (p < end && *p >= '0' && *p <= '9') p++;
+    } else {
+        return -1;
+    }
+
+    /* Extension fields after ;" : a bare kind letter, kind:x, line:n */
+    if (end - p < 2 || p[0] != ';' || p[1] != '"') return 0;
+    for (p += 2; p < end; p = tab + 1) {
+        tab = memchr(p, '\t', end - p);
+        if (!tab) tab = end;
+        if (tab - p == 1 && *p != '\t') tag->kind = *p;
+        else if (tab - p == 6 && memcmp(p, "kind:", 5) == 0) tag->kind = p[5];
+        else if (tab - p > 5 && memcmp(p, "line:", 5) == 0) tag->line = tags_number(p + 5, tab);
+        if (tab == end) break;
+    }
+    return 0;
+}
+
+/* Whether the escaped pattern matches line from its start, to its end if anchored */
+static int tag_pattern_at(const char *line, size_t len, const char *pat, size_t plen, int anchored) {
+    size_t i = 0, j = 0;
+
+    while (j < plen) {
+        char c = pat[j];
+        if (c == '\\' && j + 1 < plen) c = pat[++j];
+        if (i == len || line[i] != c) return 0;
+        i++;
+        j++;
+    }
+    return !anchored || i == len;
+}
+
+unsigned int sc_tag_find_pattern(const char *text, size_t len, const char *pattern, size_t plen) {
+    int start = plen > 0 && pattern[0] == '^';
+    int anchored = 0;
+    unsigned int number = 1;
+
+    if (start) {
+        pattern++;
+        plen--;
+    }
+    /* A '$' is an anchor unless escaped */
+    if (plen > 0 && pattern[plen - 1] == '$') {
+        size_t backslashes = 0;
+        while (backslashes < plen - 1 && pattern[plen - 2 - backslashes] == '\\') backslashes++;
+        if (backslashes % 2 == 0) {
+            plen--;
+            anchored = 1;
+        }
+    }
+
+    for (size_t pos = 0; pos < len || (pos == 0 && len == 0); number++) {
+        const char *nl = memchr(text + pos, '\n', len - pos);
+        size_t end = nl ? (size_t)(nl - text) : len;
+        size_t n = end - pos;
+        if (n > 0 && text[end - 1] == '\r') n--;
+        for (size_t k = 0; k <= n; k++) {
+            if (tag_pattern_at(text + pos + k, n - k, pattern, plen, anchored)) return number;
+            if (start) break;
+        }
+        if (!nl || number == 0xffffffffu) break;
+        pos = end + 1;
+    }
+    return 0;
+}
+
+/* Longest edit script a bisection searches before replacing its whole region instead */
+#define DIFF_MAX_COST 4096
+
+typedef struct {
+    const unsigned int *a, *b;      /* line ids, equal ids for equal lines */
+    long *v1, *v2;                  /* forward and reverse furthest x per diagonal */
+    long vmax;                      /* bound on d the arrays were sized for */
+    sc_hunk_fn fn;
+    void *user;
+    size_t pa, pac, pb, pbc;        /* the hunk being extended */
+    int pending;
+    size_t hunks;
+} diff_state;
+
+/* Number the lines of both texts so equal lines get equal ids; returns 0, or -1 without memory */
+static int diff_number_lines(const char *a, size_t alen, const char *b, size_t blen,
+                             unsigned int **ida, size_t *na, unsigned int **idb, size_t *nb) {
+    size_t n = sc_count_lines(a, alen) + sc_count_lines(b, blen);
+    size_t size = 16;
+    while (size < 2 * n) size *= 2;
+    sc_line *lines = malloc(n * sizeof(sc_line));
+    unsigned int *ids = malloc(n * sizeof(unsigned int));
+    size_t *table = calloc(size, sizeof(size_t));     /* line index + 1, 0 if empty */
+    size_t k = 0;
+
+    if (!lines || !ids || !table) {
+        free(lines);
+        free(ids);
+        free(table);
+        return -1;
+    }
+    for (int side = 0; side < 2; side++) {
+        const char *p = side ? b : a, *end = p + (side ? blen : alen);
+        for (;;) {
+            const char *eol = line_end(p, end);
+            lines[k].start = p;
+            lines[k].len = eol - p;
+            size_t slot = (size_t)sc_hash64(p, eol - p) & (size - 1);
+            while (table[slot] && compare_lines(&lines[table[slot] - 1], &lines[k]) != 0)
+                slot = (slot + 1) & (size - 1);
+            if (!table[slot]) table[slot] = k + 1;
+            ids[k] = (unsigned int)(table[slot] - 1);
+            k++;
+            if (eol == end) break;
+            p = eol + 1;
+        }
+        if (side == 0) *na = k;
+    }
+    *nb = k - *na;
+    free(table);
+    free(lines);
+    *ida = ids;
+    *idb = ids + *na;
+    return 0;
+}
+
+static void diff_flush(diff_state *s) {
+    if (!s->pending) return;
+    if (s->fn) s->fn(s->pa, s->pac, s->pb, s->pbc, s->user);
+    s->hunks++;
+    s->pending = 0;
+}
+
+/* Edits arrive in order; touching ones make one hunk */
+static void diff_edit(diff_state *s, size_t a, size_t ac, size_t b, size_t bc) {
+    if (s->pending && a == s->pa + s->pac && b == s->pb + s->pbc) {
+        s->pac += ac;
+        s->pbc += bc;
+        return;
+    }
+    diff_flush(s);
+    s->pa = a;
+    s->pac = ac;
+    s->pb = b;
+    s->pbc = bc;
+    s->pending = 1;
+}
+
+/*
+ * Myers' middle snake of a[a0, a1) and b[b0, b1), searched from both ends
+ * at once in linear space. Returns 1 with the split point in *x, *y, or 0
+ * if none was found within DIFF_MAX_COST.
+ */
+static int diff_bisect(diff_state *s, size_t a0, size_t a1, size_t b0, size_t b1, size_t *x, size_t *y) {
+    const unsigned int *a = s->a + a0, *b = s->b + b0;
+    long n = (long)(a1 - a0), m = (long)(b1 - b0);
+    long max_d = (n + m + 1) / 2;
+    if (max_d > s->vmax) max_d = s->vmax;
+    long offset = max_d + 1, length = 2 * max_d + 3;
+    long delta = n - m;
+    int front = (delta & 1) != 0;
+    long k1start = 0, k1end = 0, k2start = 0, k2end = 0;
+
+    for (long i = 0; i < length; i++) s->v1[i] = s->v2[i] = -1;
+    s->v1[offset + 1] = 0;
+    s->v2[offset + 1] = 0;
+
+    for (long d = 0; d < max_d; d++) {
+        for (long k1 = -d + k1start; k1 <= d - k1end; k1 += 2) {
+            long k1o = offset + k1, x1, y1;
+            if (k1 == -d || (k1 != d && s->v1[k1o - 1] < s->v1[k1o + 1])) x1 = s->v1[k1o + 1];
+            else x1 = s->v1[k1o - 1] + 1;
+            y1 = x1 - k1;
+            while (x1 < n && y1 < m && a[x1] == b[y1]) {
+                x1++;
+                y1++;
+            }
+            s->v1[k1o] = x1;
+            if (x1 > n) {
+                k1end += 2;
+            } else if (y1 > m) {
+                k1start += 2;
+            } else if (front) {
+                long k2o = offset + delta - k1;
+                if (k2o >= 0 && k2o < length && s->v2[k2o] != -1 && x1 >= n - s->v2[k2o]) {
+                    *x = a0 + x1;
+                    *y = b0 + y1;
+                    return 1;
+                }
+            }
+        }
+        for (long k2 = -d + k2start; k2 <= d - k2end; k2 += 2) {
+            long k2o = offset + k2, x2, y2;
+            if (k2 == -d || (k2 != d && s->v2[k2o - 1] < s->v2[k2o + 1])) x2 = s->v2[k2o + 1];
+            else x2 = s->v2[k2o - 1] + 1;
+            y2 = x2 - k2;
+            while (x2 < n && y2 < m && a[n - x2 - 1] == b[m - y2 - 1]) {
+                x2++;
+                y2++;
+            }
+            s->v2[k2o] = x2;
+            if (x2 > n) {
+                k2end += 2;
+            } else if (y2 > m) {
+                k2start += 2;
+            } else if (!front) {
+                long k1o = offset + delta - k2;
+                if (k1o >= 0 && k1o < length && s->v1[k1o] != -1) {
+                    long x1 = s->v1[k1o], y1 = offset + x1 - k1o;
+                    if (x1 >= n - x2) {
+                        *x = a0 + x1;
+                        *y = b0 + y1;
+                        return 1;
+                    }
+                }
+            }
+        }
+    }
+    return 0;
+}
+
+static void diff_region(diff_state *s, size_t a0, size_t a1, size_t b0, size_t b1) {
+    size_t x, y;
+
+    while (a0 < a1 && b0 < b1 && s->a[a0] == s->b[b0]) {
+        a0++;
+        b0++;
+    }
+    while (a0 < a1 && b0 < b1 && s->a[a1 - 1] == s->b[b1 - 1]) {
+        a1--;
+        b1--;
+    }
+    if (a0 == a1 || b0 == b1) {
+        if (a0 < a1 || b0 < b1) diff_edit(s, a0, a1 - a0, b0, b1 - b0);
+        return;
+    }
+    /* A split at either end would not make progress */
+    if (diff_bisect(s, a0, a1, b0, b1, &x, &y) && !(x == a0 && y == b0) && !(x == a1 && y == b1)) {
+        diff_region(s, a0, x, b0, y);
+        diff_region(s, x, a1, y, b1);
+    } else {
+        diff_edit(s, a0, a1 - a0, b0, b1 - b0);
+    }
+}
+
+size_t sc_diff_lines(const char *a, size_t alen, const char *b, size_t blen, sc_hunk_fn fn, void *user) {
+    diff_state s;
+    unsigned int *ids, *idb;
+    size_t na = 0, nb = 0;
+
+    memset(&s, 0, sizeof(s));
+    if (diff_number_lines(a, alen, b, blen, &ids, &na, &idb, &nb) != 0) return (size_t)-1;
+    s.a = ids;
+    s.b = idb;
+    s.vmax = (long)((na + nb + 1) / 2);
+    if (s.vmax > DIFF_MAX_COST) s.vmax = DIFF_MAX_COST;
+    s.v1 = malloc((2 * s.vmax + 3) * sizeof(long));
+    s.v2 = malloc((2 * s.vmax + 3) * sizeof(long));
+    s.fn = fn;
+    s.user = user;
+    if (!s.v1 || !s.v2) {
+        free(s.v1);
+        free(s.v2);
+        free(ids);
+        return (size_t)-1;
+    }
+
+    diff_region(&s, 0, na, 0, nb);
+    diff_flush(&s);
+    free(s.v1);
+    free(s.v2);
+    free(ids);
+    return s.hunks;
+}
+
+void sc_hist_reset(sc_histogram *h) {
+    memset(h, 0, sizeof(*h));
+}
+
+static unsigned int hist_bucket(unsigned long long v) {
+    if (v < 16) return (unsigned int)v;
+
+    unsigned int e = 63 - __builtin_clzll(v);
+    unsigned int sub = (unsigned int)(v >> (e - 4)) & 15;
+    return 16 + (e - 4) * 16 + sub;
+}
+
+static unsigned long long hist_bucket_upper(unsigned int i) {
+    if (i < 16) return i;
+
+    unsigned int e = (i - 16) / 16 + 4;
+    unsigned long long sub = (i - 16) % 16;
+    return ((16 + sub + 1) << (e - 4)) - 1;
+}
+
+void sc_hist_add(sc_histogram *h, unsigned long long value) {
+    h->buckets[hist_bucket(value)]++;
+    h->count++;
+    h->sum += value;
+    if (value > h->max) h->max = value;
+}
+
+unsigned long long sc_hist_percentile(const sc_histogram *h, double p) {
+    if (h->count == 0) return 0;
+
+    unsigned long long rank = (unsigned long long)(p / 100.0 * h->count + 0.5);
+    unsigned long long seen = 0;
+    if (rank < 1) rank = 1;
+
+    for (unsigned int i = 0; i < SC_HIST_BUCKETS; i++) {
+        seen += h->buckets[i];
+        if (seen >= rank) {
+            unsigned long long upper = hist_bucket_upper(i);
+            return upper < h->max ? upper : h->max;
+        }
+    }
+    return h->max;
+}
@@ -0,0 +1,264 @@
+/*
+ * scrible_core.h Text processing core of the scrible editor
+ * Plain C over byte buffers, no GTK or GLib, so the algorithms behind the
+ * editor's tools can be benchmarked and tested without a display.
+ * Lines are separated by '\n'; text does not need to be NUL terminated.
+ */
+#ifndef SCRIBLE_CORE_H
+#define SCRIBLE_CORE_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Called for every symbol found: trimmed line text and its 1-based line number */
+typedef void (*sc_symbol_fn)(const char *text, size_t len, int line, void *user);
+
+typedef struct {
+    size_t words;   /* runs of characters other than space, \t, \r, \n */
+    size_t chars;   /* UTF-8 characters */
+    size_t lines;
+} sc_counts;
+
+/* Number of lines in text (newlines + 1, an empty text has one line) */
+size_t sc_count_lines(const char *text, size_t len);
+
+/*
+ * Function detection used by the Symbols sidebar: a line that, after leading
+ * whitespace, contains '(' but no ';' and none of "if", "while", "for".
+ * Returns the number of symbols reported to fn (which may be NULL).
+ */
+size_t sc_parse_symbols(const char *text, size_t len, sc_symbol_fn fn, void *user);
+
+/* Word, character and line counts */
+void sc_count_words(const char *text, size_t len, sc_counts *counts);
+
+/*
+ * Sort lines in byte order into out (len bytes), keeping the line count.
+ * Returns 0, or -1 if memory ran out (out is left untouched).
+ */
+int sc_sort_lines(const char *text, size_t len, char *out);
+
+/* Drop spaces and tabs before each newline and at the end; out may be text. Returns new length */
+size_t sc_strip_trailing(const char *text, size_t len, char *out);
+
+/* Prefix every line with "// "; out needs len + 3 * sc_count_lines() bytes. Returns new length */
+size_t sc_comment_lines(const char *text, size_t len, char *out);
+
+/*
+ * For one line: if it starts with "//" after whitespace, return how many
+ * bytes to delete ("//" plus one following space) and set *start to where
+ * they begin. Returns 0 if the line is not a // comment.
+ */
+size_t sc_uncomment_span(const char *line, size_t len, size_t *start);
+
+/* sc_uncomment_span applied to every line; out may be text. Returns new length */
+size_t sc_uncomment_lines(const char *text, size_t len, char *out);
+
+/* Length in bytes of the longest line */
+size_t sc_longest_line(const char *text, size_t len);
+
+/*
+ * Cut lines longer than limit bytes (at least 16) into pieces of at most
+ * limit bytes by inserting '\n', preferring to cut after a space, tab,
+ * comma or semicolon in the last quarter of a piece and never inside a
+ * UTF-8 sequence. Returns the number of newlines inserted; out (len plus
+ * that many bytes) and breaks (0-based output line of each inserted newline)
+ * may be NULL to only count.
+ */
+size_t sc_split_long_lines(const char *text, size_t len, size_t limit, char *out, size_t *breaks);
+
+/* Lexer state between lines for sc_lex_line */
+#define SC_LEX_CODE     0
+#define SC_LEX_COMMENT  1   /* inside a block comment */
+
+/* Called for each structure token: byte offset in the line and its kind */
+typedef void (*sc_token_fn)(size_t offset, char kind, void *user);
+
+/*
+ * Scan one line of C for '{' and '}' outside comments, string and character
+ * literals, and for preprocessor conditionals, reported at the '#' as 'i'
+ * (#if, #ifdef, #ifndef), 'e' (#else, #elif) or 'n' (#endif). Braces on a
+ * directive line are ignored. state is what the previous line returned
+ * (SC_LEX_CODE for the first line); returns the state for the next line.
+ */
+int sc_lex_line(const char *line, size_t len, int state, sc_token_fn fn, void *user);
+
+/* Called for each identifier outside comments and literals: byte offset and length */
+typedef void (*sc_span_fn)(size_t offset, size_t len, void *user);
+
+/*
+ * sc_lex_line's counterpart for identifiers: reports every identifier of
+ * one line, skipping comments, literals, numbers, the directive name of a
+ * preprocessor line and the rest of an #include. Same states as sc_lex_line.
+ */
+int sc_lex_idents(const char *line, size_t len, int state, sc_span_fn fn, void *user);
+
+/* Declaration kinds reported by sc_scan_decls */
+#define SC_SYM_FUNCTION 1
+#define SC_SYM_TYPE     2   /* typedef name or struct/union/enum tag */
+#define SC_SYM_MACRO    3
+#define SC_SYM_ENUM     4   /* enumeration constant */
+#define SC_SYM_LOCAL    5   /* parameter or local variable */
+#define SC_SYM_BODY     6   /* function body, from its '{' to its '}' */
+
+#define SC_NO_SCOPE ((size_t)-1)
+
+/*
+ * Called for each declaration: byte offset and length of the name (of the
+ * whole body for SC_SYM_BODY), its kind, and for SC_SYM_LOCAL the offset of
+ * the '{' of the function body it belongs to (SC_NO_SCOPE otherwise).
+ */
+typedef void (*sc_decl_fn)(size_t offset, size_t len, int kind, size_t scope, void *user);
+
+/*
+ * Heuristic declaration scan of C source, good enough for highlighting:
+ * functions defined or declared at file scope, typedefs and tags, #define
+ * names, enumeration constants, and parameters and block-scope variables
+ * of each function. A body is reported after its locals. Returns the
+ * number of declarations reported.
+ */
+size_t sc_scan_decls(const char *text, size_t len, sc_decl_fn fn, void *user);
+
+/* 64-bit FNV-1a */
+unsigned long long sc_hash64(const void *data, size_t len);
+
+/*
+ * Project index file: what the editor knows about every source file of a
+ * tree, stored so it can be mapped and used without parsing. Layout, in
+ * native byte order (the file is a cache, not an exchange format):
+ *   sc_index_header, sc_index_file[nfiles], sc_index_symbol[nsymbols],
+ *   unsigned int hashes[nhashes] padded to 8 bytes, char strings[strings_len]
+ * Symbols are sorted by name, then file and line; their names come first
+ * in the string pool, in sorted order, so name offsets sort like names.
+ */
+#define SC_INDEX_MAGIC    "SCIX"
+#define SC_INDEX_VERSION  1
+
+typedef struct {
+    char magic[4];
+    unsigned int version;
+    unsigned long long nfiles;
+    unsigned long long nsymbols;
+    unsigned long long nhashes;
+    unsigned long long strings_len;
+} sc_index_header;
+
+typedef struct {
+    unsigned long long path;        /* string pool offset */
+    long long mtime;                /* seconds */
+    unsigned long long size;
+    unsigned long long hash;        /* sc_hash64 of the contents */
+    unsigned long long idents;      /* first of its identifier hashes */
+    unsigned int nidents;           /* sorted, distinct (unsigned int)sc_hash64 of identifiers */
+    unsigned int reserved;
+} sc_index_file;
+
+typedef struct {
+    unsigned long long name;        /* string pool offset */
+    unsigned int file;
+    unsigned int line;              /* 1-based */
+    unsigned int kind;              /* SC_SYM_FUNCTION .. SC_SYM_ENUM */
+    unsigned int definition;        /* 0 for a function declared without a body */
+} sc_index_symbol;
+
+typedef struct {
+    const sc_index_file *files;
+    size_t nfiles;
+    const sc_index_symbol *symbols;
+    size_t nsymbols;
+    const unsigned int *hashes;
+    size_t nhashes;
+    const char *strings;
+    size_t strings_len;
+} sc_index;
+
+/* Bytes sc_index_store needs for these sections */
+size_t sc_index_size(const sc_index *index);
+
+/* Write the index image (sc_index_size bytes) to out */
+void sc_index_store(const sc_index *index, void *out);
+
+/*
+ * Point index into an image of len bytes (8-byte aligned, e.g. mapped),
+ * after checking every count, offset and string in it. Returns 0, or -1
+ * if the image is not a valid index of this version.
+ */
+int sc_index_open(const void *data, size_t len, sc_index *index);
+
+/* Number of symbols called name, the first of which is stored in *first */
+size_t sc_index_lookup(const sc_index *index, const char *name, size_t len, size_t *first);
+
+/* Whether file may contain identifier name (hash collisions aside) */
+int sc_index_mentions(const sc_index *index, size_t file, const char *name, size_t len);
+
+/*
+ * ctags "tags" files, read in place (for instance from a mapping): lines
+ * of name<TAB>file<TAB>address[;"<TAB>extension fields], preceded by
+ * "!_" pseudo-tags. The address is a line number or a /pattern/ search.
+ */
+typedef struct {
+    const char *name;
+    size_t name_len;
+    const char *file;               /* as written, usually relative to the tags file */
+    size_t file_len;
+    const char *pattern;            /* between the delimiters, still escaped; NULL for a line number */
+    size_t pattern_len;
+    unsigned int line;              /* from the address or a line: field, 0 if not given */
+    char kind;                      /* kind letter, 0 if not given */
+} sc_tag;
+
+/* The !_TAG_FILE_SORTED pseudo-tag: 1 sorted, 2 sorted ignoring case, 0 unsorted or not said */
+int sc_tags_sorted(const char *data, size_t len);
+
+/*
+ * Offset of the first line at or after from (a line start) tagging name,
+ * or len if there is none. Binary search unless sorted (as returned by
+ * sc_tags_sorted) is 0; call again from the next line for further tags.
+ */
+size_t sc_tags_find(const char *data, size_t len, int sorted, const char *name, size_t nlen, size_t from);
+
+/* Split one line (without its '\n'). Returns 0, or -1 for a pseudo-tag or malformed line */
+int sc_tag_parse(const char *line, size_t len, sc_tag *tag);
+
+/* 1-based number of the first line of text matching an sc_tag pattern, 0 if none */
+unsigned int sc_tag_find_pattern(const char *text, size_t len, const char *pattern, size_t plen);
+
+/* Called for each hunk, in order: a_count lines of a from a_line (0-based) became b_count lines of b from b_line */
+typedef void (*sc_hunk_fn)(size_t a_line, size_t a_count, size_t b_line, size_t b_count, void *user);
+
+/*
+ * Line diff of a against b (Myers, linear space), as maximal hunks with at
+ * least one equal line between them. Minimal unless an edit script longer
+ * than a few thousand lines is needed somewhere, where that region is
+ * replaced whole. Returns the number of hunks, or (size_t)-1 if memory ran out.
+ */
+size_t sc_diff_lines(const char *a, size_t alen, const char *b, size_t blen, sc_hunk_fn fn, void *user);
+
+/*
+ * Log-linear histogram: exact below 16, then 16 buckets per power of two
+ * (about 6% resolution). Fixed size, no allocation, cheap enough to update
+ * on every keystroke. Values are in whatever unit the caller uses.
+ */
+#define SC_HIST_BUCKETS 976
+
+typedef struct {
+    unsigned long long count;
+    unsigned long long sum;
+    unsigned long long max;
+    unsigned int buckets[SC_HIST_BUCKETS];
+} sc_histogram;
+
+void sc_hist_reset(sc_histogram *h);
+void sc_hist_add(sc_histogram *h, unsigned long long value);
+
+/* Upper bound of the bucket holding the p-th percentile (0-100), 0 if empty */
+unsigned long long sc_hist_percentile(const sc_histogram *h, double p);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SCRIBLE_CORE_H */
@@ -0,0 +1,977 @@
+/*
+ * scrible_fuzz.c Fuzz and stress harness for libscrible-core
+ * Every input is run through all core routines and checked against
+ * invariants that hold for any byte string (round trips, lengths, line
+ * counts, sort order); a violation aborts so the fuzzer keeps the input.
+ * Inputs are copied into an exact-size allocation without a NUL, so a
+ * sanitizer build catches any read past the end.
+ *
+ * libFuzzer:  make fuzz             (clang, -fsanitize=fuzzer,address,undefined)
+ * AFL:        make scrible-fuzz CC=afl-clang-fast
+ *             afl-fuzz -i fuzz-corpus -o findings -- ./scrible-fuzz @@
+ * Stress:     make stress           (ASan/UBSan, random edit streams)
+ * Options of the standalone binary:
+ *   FILE...           run each file once (no FILE: read stdin)
+ *   --stress          apply random edits to a buffer, checking after each
+ *   --edits N         edits per stress run (default 100000)
+ *   --seed N          stress seed (default fixed)
+ *   --script N        print a random N action script for scrible --replay
+ */
+#include "scrible_core.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define FUZZ_SEED         0x5C81B1Eu
+#define FUZZ_MAX_STRESS   (64u << 10)   /* stress buffer stops growing here */
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            abort(); \
+        } \
+    } while (0)
+
+static size_t count_newlines(const char *text, size_t len) {
+    size_t n = 0;
+    for (size_t i = 0; i < len; i++) n += text[i] == '\n';
+    return n;
+}
+
+static void *xmalloc(size_t n) {
+    void *p = malloc(n ? n : 1);
+    if (!p) abort();
+    return p;
+}
+
+typedef struct {
+    const char *text;
+    size_t len;
+    size_t lines;
+    size_t found;
+} symbol_check;
+
+static void check_symbol(const char *text, size_t len, int line, void *user) {
+    symbol_check *sc = user;
+
+    CHECK(text >= sc->text && text + len <= sc->text + sc->len);
+    CHECK(len > 0 && !memchr(text, '\n', len));
+    CHECK(line >= 1 && (size_t)line <= sc->lines);
+    sc->found++;
+}
+
+static void fuzz_symbols(const char *text, size_t len, size_t lines) {
+    symbol_check sc = { text, len, lines, 0 };
+
+    size_t found = sc_parse_symbols(text, len, check_symbol, &sc);
+    CHECK(found == sc.found);
+    CHECK(sc_parse_symbols(text, len, NULL, NULL) == found);
+}
+
+static void fuzz_counts(const char *text, size_t len, size_t lines) {
+    sc_counts counts;
+
+    sc_count_words(text, len, &counts);
+    CHECK(counts.lines == lines);
+    CHECK(counts.chars <= len);
+    CHECK(counts.words <= len);
+}
+
+static int line_cmp(const char *a, size_t an, const char *b, size_t bn) {
+    int cmp = memcmp(a, b, an < bn ? an : bn);
+    return cmp ? cmp : (an > bn) - (an < bn);
+}
+
+static void fuzz_sort(const char *text, size_t len, size_t lines) {
+    char *out = xmalloc(len);
+    char *again = xmalloc(len);
+
+    CHECK(sc_sort_lines(text, len, out) == 0);
+    CHECK(sc_count_lines(out, len) == lines);
+
+    /* Sorted line by line, and sorting is idempotent */
+    const char *p = out, *end = out + len, *prev = NULL;
+    size_t prev_len = 0;
+    for (;;) {
+        const char *nl = memchr(p, '\n', end - p);
+        const char *eol = nl ? nl : end;
+        if (prev) CHECK(line_cmp(prev, prev_len, p, eol - p) <= 0);
+        prev = p;
+        prev_len = eol - p;
+        if (!nl) break;
+        p = nl + 1;
+    }
+    CHECK(sc_sort_lines(out, len, again) == 0);
+    CHECK(len == 0 || memcmp(out, again, len) == 0);
+
+    free(again);
+    free(out);
+}
+
+static void fuzz_strip(const char *text, size_t len, size_t lines) {
+    char *out = xmalloc(len);
+    char *inplace = xmalloc(len);
+
+    size_t n = sc_strip_trailing(text, len, out);
+    CHECK(n <= len);
+    CHECK(sc_count_lines(out, n) == lines);
+    CHECK(n == 0 || (out[n - 1] != ' ' && out[n - 1] != '\t'));
+    for (size_t i = 0; i < n; i++)
+        if (out[i] == '\n') CHECK(i == 0 || (out[i - 1] != ' ' && out[i - 1] != '\t'));
+
+    /* The editor strips in place */
+    memcpy(inplace, text, len);
+    CHECK(sc_strip_trailing(inplace, len, inplace) == n);
+    CHECK(n == 0 || memcmp(out, inplace, n) == 0);
+    CHECK(sc_strip_trailing(out, n, out) == n);
+
+    free(inplace);
+    free(out);
+}
+
+static void fuzz_comments(const char *text, size_t len, size_t lines) {
+    size_t cap = len + 3 * lines;
+    char *commented = xmalloc(cap);
+    char *plain = xmalloc(cap);
+
+    /* Commenting then uncommenting gives the text back */
+    size_t n = sc_comment_lines(text, len, commented);
+    CHECK(n == cap);
+    CHECK(sc_count_lines(commented, n) == lines);
+    size_t m = sc_uncomment_lines(commented, n, plain);
+    CHECK(m == len);
+    CHECK(len == 0 || memcmp(plain, text, len) == 0);
+
+    /* Uncommenting only shrinks, in place too, and keeps the line count */
+    m = sc_uncomment_lines(text, len, plain);
+    CHECK(m <= len);
+    CHECK(sc_count_lines(plain, m) == lines);
+    memcpy(commented, text, len);
+    CHECK(sc_uncomment_lines(commented, len, commented) == m);
+    CHECK(m == 0 || memcmp(commented, plain, m) == 0);
+
+    /* Per line, as the Uncomment Lines command uses it */
+    const char *p = text, *end = text + len;
+    for (;;) {
+        const char *nl = memchr(p, '\n', end - p);
+        size_t line_len = (nl ? nl : end) - p, start = 0;
+        size_t cut = sc_uncomment_span(p, line_len, &start);
+        CHECK(cut == 0 || cut == 2 || cut == 3);
+        CHECK(start + cut <= line_len);
+        if (cut) CHECK(p[start] == '/' && p[start + 1] == '/');
+        if (!nl) break;
+        p = nl + 1;
+    }
+
+    free(plain);
+    free(commented);
+}
+
+static void fuzz_split(const char *text, size_t len, size_t lines) {
+    size_t limit = 16 + (len ? (unsigned char)text[0] & 63 : 0);
+    size_t n = sc_split_long_lines(text, len, limit, NULL, NULL);
+    char *out = xmalloc(len + n);
+    char *joined = xmalloc(len);
+    size_t *breaks = xmalloc(n * sizeof(size_t));
+
+    CHECK(sc_split_long_lines(text, len, limit, out, breaks) == n);
+    CHECK(sc_count_lines(out, len + n) == lines + n);
+    CHECK(n == 0 || sc_longest_line(out, len + n) <= limit);
+    CHECK(n > 0 || sc_longest_line(text, len) <= limit);
+
+    /* Dropping the inserted newlines gives the text back, as saving does */
+    size_t line = 0, k = 0, m = 0;
+    for (size_t i = 0; i < len + n; i++) {
+        if (out[i] == '\n') {
+            if (k < n && breaks[k] == line) {
+                CHECK(i > 0 && out[i - 1] != '\n');
+                k++;
+                line++;
+                continue;
+            }
+            line++;
+        }
+        joined[m++] = out[i];
+    }
+    CHECK(k == n && m == len);
+    CHECK(len == 0 || memcmp(joined, text, len) == 0);
+
+    free(breaks);
+    free(joined);
+    free(out);
+}
+
+typedef struct {
+    const char *line;
+    size_t len;
+    size_t last;
+    size_t tokens;
+} lex_check;
+
+static void check_token(size_t offset, char kind, void *user) {
+    lex_check *lc = user;
+
+    CHECK(offset < lc->len);
+    CHECK(lc->tokens == 0 || offset > lc->last);
+    if (kind == '{' || kind == '}') CHECK(lc->line[offset] == kind);
+    else CHECK((kind == 'i' || kind == 'e' || kind == 'n') && lc->line[offset] == '#' && lc->tokens == 0);
+    lc->last = offset;
+    lc->tokens++;
+}
+
+static int ident_char(char c) {
+    return c == '_' || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9');
+}
+
+/* A whole identifier: starts with a letter or '_' and is not part of a longer word */
+static int is_ident(const char *text, size_t len, size_t offset, size_t n) {
+    if (n == 0 || offset + n > len || (text[offset] >= '0' && text[offset] <= '9')) return 0;
+    for (size_t i = 0; i < n; i++)
+        if (!ident_char(text[offset + i])) return 0;
+    return (offset == 0 || !ident_char(text[offset - 1])) &&
+           (offset + n == len || !ident_char(text[offset + n]));
+}
+
+static void check_ident(size_t offset, size_t n, void *user) {
+    lex_check *lc = user;
+
+    CHECK(is_ident(lc->line, lc->len, offset, n));
+    CHECK(lc->tokens == 0 || offset > lc->last);
+    lc->last = offset;
+    lc->tokens++;
+}
+
+static void fuzz_lex(const char *text, size_t len) {
+    const char *p = text, *end = text + len;
+    int state = SC_LEX_CODE, ident_state = SC_LEX_CODE;
+
+    for (;;) {
+        const char *nl = memchr(p, '\n', end - p);
+        lex_check lc = { p, (nl ? nl : end) - p, 0, 0 };
+        state = sc_lex_line(p, lc.len, state, check_token, &lc);
+        CHECK(state == SC_LEX_CODE || state == SC_LEX_COMMENT);
+        lc.tokens = 0;
+        ident_state = sc_lex_idents(p, lc.len, ident_state, check_ident, &lc);
+        CHECK(ident_state == SC_LEX_CODE || ident_state == SC_LEX_COMMENT);
+        if (!nl) break;
+        p = nl + 1;
+    }
+}
+
+typedef struct {
+    const char *text;
+    size_t len;
+    size_t found;
+    size_t last_body_end;
+} decl_check;
+
+static void check_decl(size_t offset, size_t n, int kind, size_t scope, void *user) {
+    decl_check *dc = user;
+
+    dc->found++;
+    if (kind == SC_SYM_BODY) {
+        /* Bodies do not nest and come in order */
+        CHECK(n >= 2 && offset + n <= dc->len && offset >= dc->last_body_end);
+        CHECK(dc->text[offset] == '{' && dc->text[offset + n - 1] == '}');
+        CHECK(scope == SC_NO_SCOPE);
+        dc->last_body_end = offset + n;
+        return;
+    }
+    CHECK(kind >= SC_SYM_FUNCTION && kind <= SC_SYM_LOCAL);
+    CHECK(is_ident(dc->text, dc->len, offset, n));
+    if (kind == SC_SYM_LOCAL) CHECK(scope < dc->len && dc->text[scope] == '{' && scope >= dc->last_body_end);
+    else CHECK(scope == SC_NO_SCOPE);
+}
+
+static void fuzz_decls(const char *text, size_t len) {
+    decl_check dc = { text, len, 0, 0 };
+    CHECK(sc_scan_decls(text, len, check_decl, &dc) == dc.found);
+}
+
+typedef struct {
+    size_t offset;
+    size_t len;
+    unsigned int line;
+    unsigned int kind;
+} index_name;
+
+typedef struct {
+    const char *text;
+    index_name *names;
+    size_t count;
+    size_t cap;
+} index_names;
+
+static const char *index_text;
+
+static int index_name_order(const void *a, const void *b) {
+    const index_name *x = a, *y = b;
+    size_t n = x->len < y->len ? x->len : y->len;
+    int c = memcmp(index_text + x->offset, index_text + y->offset, n);
+    if (c) return c;
+    if (x->len != y->len) return x->len < y->len ? -1 : 1;
+    return x->line < y->line ? -1 : x->line > y->line;
+}
+
+static void collect_name(size_t offset, size_t n, int kind, size_t scope, void *user) {
+    index_names *names = user;
+
+    (void)scope;
+    if (kind == SC_SYM_LOCAL || kind == SC_SYM_BODY) return;
+    if (names->count == names->cap) {
+        names->cap = names->cap ? 2 * names->cap : 64;
+        names->names = realloc(names->names, names->cap * sizeof(index_name));
+        CHECK(names->names);
+    }
+    /* Offsets stand in for lines, any increasing number will do */
+    index_name name = { offset, n, (unsigned int)offset + 1, (unsigned int)kind };
+    names->names[names->count++] = name;
+}
+
+/* Whatever the bytes, opening them as an index must fail cleanly or give a usable index */
+static void fuzz_index_image(const void *data, size_t len) {
+    unsigned long long *image = xmalloc(len / 8 * 8 + 8);
+    sc_index index;
+
+    memcpy(image, data, len);
+    if (sc_index_open(image, len, &index) == 0) {
+        for (size_t i = 0; i < index.nsymbols; i++) {
+            const char *name = index.strings + index.symbols[i].name;
+            size_t first, n = sc_index_lookup(&index, name, strlen(name), &first);
+            CHECK(first <= i);
+            (void)n;
+        }
+        for (size_t i = 0; i < index.nfiles; i++)
+            sc_index_mentions(&index, i, "main", 4);
+    }
+    free(image);
+}
+
+/* Index the declarations of the input as one file, store it, open it and look every name up */
+static void fuzz_index(const char *text, size_t len) {
+    index_names names = { text, NULL, 0, 0 };
+
+    fuzz_index_image(text, len);
+    sc_scan_decls(text, len, collect_name, &names);
+    index_text = text;
+    if (names.count) qsort(names.names, names.count, sizeof(index_name), index_name_order);
+
+    /* Distinct names go first in the pool, in order, then the file's path */
+    char *pool = xmalloc(len + names.count + 8);
+    sc_index_symbol *symbols = xmalloc(names.count * sizeof(sc_index_symbol) + 1);
+    unsigned int *hashes = xmalloc(names.count * sizeof(unsigned int) + 1);
+    size_t pool_len = 0, nhashes = 0;
+    for (size_t i = 0; i < names.count; i++) {
+        index_name *n = &names.names[i];
+        if (i == 0 || n->len != n[-1].len || memcmp(text + n->offset, text + n[-1].offset, n->len) != 0) {
+            memcpy(pool + pool_len, text + n->offset, n->len);
+            pool[pool_len + n->len] = '\0';
+            pool_len += n->len + 1;
+            hashes[nhashes++] = (unsigned int)sc_hash64(text + n->offset, n->len);
+        }
+        sc_index_symbol sym = { pool_len - n->len - 1, 0, n->line, n->kind, 1 };
+        symbols[i] = sym;
+    }
+    for (size_t i = 1; i < nhashes; i++)
+        for (size_t j = i; j > 0 && hashes[j - 1] > hashes[j]; j--) {
+            unsigned int t = hashes[j];
+            hashes[j] = hashes[j - 1];
+            hashes[j - 1] = t;
+        }
+    size_t path = pool_len;
+    memcpy(pool + pool_len, "f.c", 4);
+    pool_len += 4;
+
+    sc_index_file file = { path, 1, len, sc_hash64(text, len), 0, (unsigned int)nhashes, 0 };
+    sc_index in = { &file, 1, symbols, names.count, hashes, nhashes, pool, pool_len }, out;
+    size_t size = sc_index_size(&in);
+    unsigned long long *image = xmalloc(size);
+    sc_index_store(&in, image);
+    CHECK(sc_index_open(image, size, &out) == 0);
+    CHECK(out.nsymbols == names.count && out.nfiles == 1 && out.nhashes == nhashes);
+    CHECK(sc_index_open(image, size - 1, &out) == -1 && sc_index_open(image, size, &out) == 0);
+
+    /* Single corrupted bytes of a valid image */
+    for (size_t k = 0; k < 32; k++) {
+        unsigned char *bytes = (unsigned char *)image;
+        size_t at = (k * 131 + len) % size;
+        bytes[at] ^= 0x5A + k;
+        fuzz_index_image(image, size);
+        bytes[at] ^= 0x5A + k;
+    }
+
+    for (size_t i = 0; i < names.count; i++) {
+        const char *name = text + names.names[i].offset;
+        size_t first, n = sc_index_lookup(&out, name, names.names[i].len, &first);
+        CHECK(n >= 1 && first <= i && i < first + n);
+        CHECK(out.symbols[i].line == names.names[i].line);
+        CHECK(sc_index_mentions(&out, 0, name, names.names[i].len));
+    }
+    free(image);
+    free(hashes);
+    free(symbols);
+    free(pool);
+    free(names.names);
+}
+
+/* Every lookup on any bytes stays in bounds and lands on a line of that name */
+static void check_tags_lookup(const char *data, size_t len, int sorted, const char *name, size_t nlen) {
+    size_t pos = sc_tags_find(data, len, sorted, name, nlen, 0);
+
+    CHECK(pos <= len);
+    if (pos == len) return;
+    CHECK(pos == 0 || data[pos - 1] == '\n');
+    CHECK(len - pos > nlen && memcmp(data + pos, name, nlen) == 0);
+    CHECK(data[pos + nlen] == '\t');
+}
+
+/* A line holding only the name, last or not, is not a tag of that name */
+static void check_tags_untabbed(void) {
+    static const char last_text[] = "!_TAG_FILE_SORTED\t1\t/sorted/\nalpha\ta.c\t1\nbeta";
+    static const char before_text[] = "!_TAG_FILE_SORTED\t1\t/sorted/\nbeta\nbeta\tb.c\t2\n";
+    size_t n = sizeof(last_text) - 1, m = sizeof(before_text) - 1;
+    /* Exactly sized heap copies, so a read past the end is caught like one past a mapping */
+    char *last = xmalloc(n), *before = xmalloc(m);
+
+    memcpy(last, last_text, n);
+    memcpy(before, before_text, m);
+    for (int sorted = 0; sorted <= 2; sorted++) {
+        CHECK(sc_tags_find(last, n, sorted, "beta", 4, 0) == n);
+        CHECK(sc_tags_find(last, n, sorted, "alpha", 5, 0) == (size_t)(strstr(last_text, "alpha\t") - last_text));
+        CHECK(sc_tags_find(before, m, sorted, "beta", 4, 0) == (size_t)(strstr(before_text, "beta\t") - before_text));
+    }
+    free(last);
+    free(before);
+}
+
+static int tags_fold;
+
+static int tags_line_order(const void *a, const void *b) {
+    const index_name *x = a, *y = b;
+    size_t n = x->len < y->len ? x->len : y->len;
+    for (size_t i = 0; i < n; i++) {
+        unsigned char c = index_text[x->offset + i], d = index_text[y->offset + i];
+        if (tags_fold) {
+            if (c >= 'a' && c <= 'z') c -= 'a' - 'A';
+            if (d >= 'a' && d <= 'z') d -= 'a' - 'A';
+        }
+        if (c != d) return c < d ? -1 : 1;
+    }
+    if (x->len != y->len) return x->len < y->len ? -1 : 1;
+    return x->line < y->line ? -1 : x->line > y->line;
+}
+
+/* The declarations of the input as a tags file sorted one way; every tag must be found */
+static void fuzz_tags_sorted(const char *text, index_names *names, int fold) {
+    static const char header[] = "!_TAG_FILE_FORMAT\t2\t/extended format/\n!_TAG_FILE_SORTED\t%d\t/sorted/\n";
+    size_t cap = sizeof(header) + 32;
+
+    tags_fold = fold;
+    index_text = text;
+    if (names->count) qsort(names->names, names->count, sizeof(index_name), tags_line_order);
+    for (size_t i = 0; i < names->count; i++) cap += names->names[i].len + 32;
+
+    char *tags = xmalloc(cap);
+    size_t len = (size_t)snprintf(tags, cap, header, fold ? 2 : 1);
+    for (size_t i = 0; i < names->count; i++) {
+        index_name *n = &names->names[i];
+        memcpy(tags + len, text + n->offset, n->len);
+        len += n->len;
+        len += (size_t)snprintf(tags + len, cap - len, "\tf.c\t%u;\"\tf\n", n->line);
+    }
+    CHECK(sc_tags_sorted(tags, len) == (fold ? 2 : 1));
+
+    for (size_t i = 0; i < names->count; i++) {
+        index_name *n = &names->names[i];
+        size_t found = 0, pos = sc_tags_find(tags, len, fold ? 2 : 1, text + n->offset, n->len, 0);
+        for (; pos < len; pos = sc_tags_find(tags, len, fold ? 2 : 1, text + n->offset, n->len, pos)) {
+            const char *nl = memchr(tags + pos, '\n', len - pos);
+            sc_tag tag;
+            CHECK(nl && sc_tag_parse(tags + pos, nl - (tags + pos), &tag) == 0);
+            CHECK(tag.name_len == n->len && memcmp(tag.name, text + n->offset, n->len) == 0);
+            CHECK(tag.kind == 'f' && tag.pattern == NULL && tag.file_len == 3);
+            found += tag.line == n->line;
+            pos = nl + 1 - tags;
+        }
+        CHECK(found == 1);
+    }
+    free(tags);
+}
+
+static void fuzz_tags(const char *text, size_t len) {
+    index_names names = { text, NULL, 0, 0 };
+    int sorted = sc_tags_sorted(text, len);
+    size_t pos = 0, number = 1;
+
+    CHECK(sorted >= 0 && sorted <= 2);
+    /* The input as a tags file */
+    while (pos < len) {
+        const char *nl = memchr(text + pos, '\n', len - pos);
+        size_t end = nl ? (size_t)(nl - text) : len;
+        sc_tag tag;
+        if (sc_tag_parse(text + pos, end - pos, &tag) == 0) {
+            CHECK(tag.name == text + pos && tag.name_len > 0);
+            CHECK(tag.file > tag.name && tag.file + tag.file_len <= text + end);
+            CHECK(!tag.pattern || (tag.pattern > tag.file && tag.pattern + tag.pattern_len <= text + end));
+            CHECK(sc_tags_find(text, len, 0, tag.name, tag.name_len, 0) <= pos);
+            check_tags_lookup(text, len, sorted, tag.name, tag.name_len);
+            check_tags_lookup(text, len, 1, tag.name, tag.name_len);
+            check_tags_lookup(text, len, 2, tag.name, tag.name_len);
+            if (tag.pattern) sc_tag_find_pattern(text, len, tag.pattern, tag.pattern_len);
+        }
+
+        /* Each line found again by its own escaped, anchored pattern */
+        if (number <= 64 && (end == pos || text[end - 1] != '\r')) {
+            char *pattern = xmalloc(2 * (end - pos) + 2);
+            size_t plen = 0;
+            pattern[plen++] = '^';
+            for (size_t i = pos; i < end; i++) {
+                if (text[i] == '\\' || text[i] == '/') pattern[plen++] = '\\';
+                pattern[plen++] = text[i];
+            }
+            pattern[plen++] = '$';
+            unsigned int line = sc_tag_find_pattern(text, len, pattern, plen);
+            CHECK(line >= 1 && line <= number);
+            free(pattern);
+        }
+        if (!nl) break;
+        pos = end + 1;
+        number++;
+    }
+
+    sc_scan_decls(text, len, collect_name, &names);
+    fuzz_tags_sorted(text, &names, 0);
+    fuzz_tags_sorted(text, &names, 1);
+    free(names.names);
+    check_tags_untabbed();
+}
+
+typedef struct {
+    const char *a, *b;
+    size_t alen, blen;
+    size_t a_next, b_next;          /* lines of each side up to the end of the last hunk */
+    size_t cost;                    /* lines deleted plus lines inserted */
+    const char *a_at, *b_at;        /* start of line a_line / b_line of each side */
+    size_t a_line, b_line;
+    char *out;                      /* a with the hunks applied, line by line */
+    size_t out_len;
+    size_t out_lines;
+} diff_check;
+
+/* Append count lines of a text starting at line from, moving its cursor (at, line) forward */
+static void diff_copy_lines(diff_check *dc, const char *text, size_t len, const char **at, size_t *line,
+                            size_t from, size_t count) {
+    const char *end = text + len;
+
+    CHECK(from >= *line);
+    for (; *line < from; ++*line) *at = (const char *)memchr(*at, '\n', end - *at) + 1;
+    for (size_t i = 0; i < count; i++, ++*line) {
+        const char *eol = memchr(*at, '\n', end - *at);
+        size_t n = (eol ? eol : end) - *at;
+        if (dc->out_lines++) dc->out[dc->out_len++] = '\n';
+        memcpy(dc->out + dc->out_len, *at, n);
+        dc->out_len += n;
+        *at = eol ? eol + 1 : end;
+    }
+}
+
+static void check_hunk(size_t a_line, size_t a_count, size_t b_line, size_t b_count, void *user) {
+    diff_check *dc = user;
+
+    /* In order, not empty, apart, and equal lines in between */
+    CHECK(a_count + b_count > 0);
+    CHECK(a_line >= dc->a_next && b_line >= dc->b_next);
+    CHECK(a_line - dc->a_next == b_line - dc->b_next);
+    CHECK(dc->a_next == 0 && dc->b_next == 0 ? 1 : a_line > dc->a_next);
+    CHECK(a_line + a_count <= sc_count_lines(dc->a, dc->alen) && b_line + b_count <= sc_count_lines(dc->b, dc->blen));
+    diff_copy_lines(dc, dc->a, dc->alen, &dc->a_at, &dc->a_line, dc->a_next, a_line - dc->a_next);
+    diff_copy_lines(dc, dc->b, dc->blen, &dc->b_at, &dc->b_line, b_line, b_count);
+    dc->a_next = a_line + a_count;
+    dc->b_next = b_line + b_count;
+    dc->cost += a_count + b_count;
+}
+
+/* Start and length of line n (0-based) of text, which must exist */
+static const char *nth_line(const char *text, size_t len, size_t n, size_t *line_len) {
+    const char *p = text, *end = text + len;
+    while (n--) p = (const char *)memchr(p, '\n', end - p) + 1;
+    const char *eol = memchr(p, '\n', end - p);
+    *line_len = (eol ? eol : end) - p;
+    return p;
+}
+
+/* Length of the longest common subsequence of lines, for small inputs */
+static size_t lcs_lines(const char *a, size_t alen, const char *b, size_t blen) {
+    size_t na = sc_count_lines(a, alen), nb = sc_count_lines(b, blen);
+    size_t *row = calloc(nb + 1, sizeof(size_t)), *prev = calloc(nb + 1, sizeof(size_t));
+    CHECK(row && prev);
+    for (size_t i = 0; i < na; i++) {
+        size_t an;
+        const char *al = nth_line(a, alen, i, &an);
+        for (size_t j = 0; j < nb; j++) {
+            size_t bn;
+            const char *bl = nth_line(b, blen, j, &bn);
+            if (an == bn && memcmp(al, bl, an) == 0) row[j + 1] = prev[j] + 1;
+            else row[j + 1] = row[j] > prev[j + 1] ? row[j] : prev[j + 1];
+        }
+        size_t *t = prev;
+        prev = row;
+        row = t;
+    }
+    size_t result = prev[nb];
+    free(row);
+    free(prev);
+    return result;
+}
+
+/* Diff a against b, apply the hunks to a and compare with b; minimal for small inputs */
+static void check_diff(const char *a, size_t alen, const char *b, size_t blen) {
+    diff_check dc = { a, b, alen, blen, 0, 0, 0, a, b, 0, 0, xmalloc(alen + blen + 1), 0, 0 };
+    size_t na = sc_count_lines(a, alen), nb = sc_count_lines(b, blen);
+
+    size_t hunks = sc_diff_lines(a, alen, b, blen, check_hunk, &dc);
+    CHECK(hunks != (size_t)-1);
+    CHECK(na - dc.a_next == nb - dc.b_next);
+    diff_copy_lines(&dc, a, alen, &dc.a_at, &dc.a_line, dc.a_next, na - dc.a_next);
+    CHECK(dc.out_lines == nb && dc.out_len == blen && memcmp(dc.out, b, blen) == 0);
+    if (na <= 200 && nb <= 200) CHECK(dc.cost == na + nb - 2 * lcs_lines(a, alen, b, blen));
+    free(dc.out);
+}
+
+static void fuzz_diff(const char *text, size_t len, size_t lines) {
+    size_t half = len / 2;
+
+    check_diff(text, len, text, len);
+    check_diff(text, half, text + half, len - half);
+    check_diff(text + half, len - half, text, half);
+
+    /* Against its own sorted lines and with every third line dropped */
+    char *sorted = xmalloc(len);
+    CHECK(sc_sort_lines(text, len, sorted) == 0);
+    check_diff(text, len, sorted, len);
+    free(sorted);
+
+    char *dropped = xmalloc(len);
+    size_t out = 0, line = 0;
+    for (const char *p = text, *end = text + len;; line++) {
+        const char *eol = memchr(p, '\n', end - p);
+        size_t n = (eol ? eol + 1 : end) - p;
+        if (line % 3 != 1) {
+            memcpy(dropped + out, p, n);
+            out += n;
+        }
+        if (!eol) break;
+        p = eol + 1;
+    }
+    check_diff(text, len, dropped, out);
+    check_diff(dropped, out, text, len);
+    free(dropped);
+    (void)lines;
+}
+
+static void fuzz_histogram(const char *text, size_t len) {
+    static sc_histogram h;
+    unsigned long long max = 0;
+
+    sc_hist_reset(&h);
+    for (size_t i = 0; i + 8 <= len; i += 8) {
+        unsigned long long v;
+        memcpy(&v, text + i, 8);
+        v >>= text[i] & 63;
+        sc_hist_add(&h, v);
+        if (v > max) max = v;
+    }
+    CHECK(h.max == max);
+
+    unsigned long long last = 0;
+    for (int p = 0; p <= 100; p += 5) {
+        unsigned long long v = sc_hist_percentile(&h, p);
+        CHECK(v >= last && v <= max);
+        last = v;
+    }
+    CHECK(sc_hist_percentile(&h, 100) == max);
+}
+
+/* All routines on one input */
+static void fuzz_all(const char *text, size_t len) {
+    size_t lines = sc_count_lines(text, len);
+
+    CHECK(lines == count_newlines(text, len) + 1);
+    fuzz_symbols(text, len, lines);
+    fuzz_counts(text, len, lines);
+    fuzz_sort(text, len, lines);
+    fuzz_strip(text, len, lines);
+    fuzz_comments(text, len, lines);
+    fuzz_split(text, len, lines);
+    fuzz_lex(text, len);
+    fuzz_decls(text, len);
+    fuzz_index(text, len);
+    fuzz_tags(text, len);
+    fuzz_diff(text, len, lines);
+    fuzz_histogram(text, len);
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    char *copy = xmalloc(size);
+
+    memcpy(copy, data, size);
+    fuzz_all(copy, size);
+    free(copy);
+    return 0;
+}
+
+#ifndef SCRIBLE_LIBFUZZER
+
+typedef struct {
+    uint64_t state;
+} fuzz_rng;
+
+/* xorshift64*, as in scrible_bench.c */
+static uint32_t rng_next(fuzz_rng *rng) {
+    rng->state ^= rng->state >> 12;
+    rng->state ^= rng->state << 25;
+    rng->state ^= rng->state >> 27;
+    return (uint32_t)((rng->state * 0x2545F4914F6CDD1DULL) >> 32);
+}
+
+static uint32_t rng_range(fuzz_rng *rng, uint32_t n) {
+    return rng_next(rng) % n;
+}
+
+#define PICK(rng, arr) ((arr)[rng_range((rng), sizeof(arr) / sizeof((arr)[0]))])
+
+/* Fragments that steer edits towards the cases the parsers branch on */
+static const char *fragments[] = {
+    "\n", "\n", " ", "\t", "  ", "//", "// ", "/", "(", ")", ";", "{", "}", "*",
+    "if", "while", "for", "int", "static", "main", "x", "_name", "\r\n", "\xc3\xa9",
+    "\xe2\x82\xac", "\xff", "\x80", "\0", "int f(void)\n", "    // note\n", "\t\t  \n",
+};
+
+typedef struct {
+    char *data;
+    size_t len;
+} stress_buffer;
+
+/* Replace [at, at + del) with ins; the buffer is reallocated to its exact size */
+static void buffer_splice(stress_buffer *b, size_t at, size_t del, const char *ins, size_t ins_len) {
+    size_t len = b->len - del + ins_len;
+    char *data = xmalloc(len);
+
+    memcpy(data, b->data, at);
+    memcpy(data + at, ins, ins_len);
+    memcpy(data + at + ins_len, b->data + at + del, b->len - at - del);
+    free(b->data);
+    b->data = data;
+    b->len = len;
+}
+
+/* Byte range of whole lines around a random position, like a selection */
+static void pick_lines(stress_buffer *b, fuzz_rng *rng, size_t *start, size_t *end) {
+    size_t a = b->len ? rng_range(rng, (uint32_t)b->len + 1) : 0;
+    size_t z = a + (b->len - a ? rng_range(rng, (uint32_t)(b->len - a) + 1) : 0);
+
+    while (a > 0 && b->data[a - 1] != '\n') a--;
+    while (z < b->len && b->data[z] != '\n') z++;
+    *start = a;
+    *end = z;
+}
+
+static void stress_edit(stress_buffer *b, fuzz_rng *rng) {
+    size_t start, end, cap, n;
+    char *out;
+
+    switch (rng_range(rng, 10)) {
+    case 0: case 1: case 2: case 3: {
+        /* Typing or pasting a few fragments */
+        char paste[256];
+        size_t paste_len = 0;
+        for (uint32_t k = 1 + rng_range(rng, 8); k > 0; k--) {
+            const char *frag = PICK(rng, fragments);
+            size_t frag_len = frag[0] ? strlen(frag) : 1;
+            memcpy(paste + paste_len, frag, frag_len);
+            paste_len += frag_len;
+        }
+        if (b->len + paste_len > FUZZ_MAX_STRESS) break;
+        buffer_splice(b, b->len ? rng_range(rng, (uint32_t)b->len + 1) : 0, 0, paste, paste_len);
+        break;
+    }
+    case 4: case 5: {
+        /* Backspace or deleting a selection */
+        if (b->len == 0) break;
+        size_t at = rng_range(rng, (uint32_t)b->len);
+        size_t limit = b->len > FUZZ_MAX_STRESS / 2 ? 4096 : 16;   /* keep the size bounded */
+        size_t max = b->len - at < limit ? b->len - at : limit;
+        buffer_splice(b, at, 1 + rng_range(rng, (uint32_t)max), "", 0);
+        break;
+    }
+    case 6:
+        pick_lines(b, rng, &start, &end);
+        cap = (end - start) + 3 * sc_count_lines(b->data + start, end - start);
+        if (b->len - (end - start) + cap > FUZZ_MAX_STRESS) break;
+        out = xmalloc(cap);
+        n = sc_comment_lines(b->data + start, end - start, out);
+        buffer_splice(b, start, end - start, out, n);
+        free(out);
+        break;
+    case 7:
+        pick_lines(b, rng, &start, &end);
+        out = xmalloc(end - start);
+        n = sc_uncomment_lines(b->data + start, end - start, out);
+        buffer_splice(b, start, end - start, out, n);
+        free(out);
+        break;
+    case 8:
+        pick_lines(b, rng, &start, &end);
+        out = xmalloc(end - start);
+        CHECK(sc_sort_lines(b->data + start, end - start, out) == 0);
+        buffer_splice(b, start, end - start, out, end - start);
+        free(out);
+        break;
+    case 9:
+        out = xmalloc(b->len);
+        n = sc_strip_trailing(b->data, b->len, out);
+        buffer_splice(b, 0, b->len, out, n);
+        free(out);
+        break;
+    }
+}
+
+static int run_stress(unsigned long edits, uint64_t seed) {
+    fuzz_rng rng = { seed };
+    stress_buffer b = { xmalloc(0), 0 };
+    unsigned long checks = 0;
+
+    for (unsigned long i = 0; i < edits; i++) {
+        stress_edit(&b, &rng);
+
+        /* Whole buffer checks cost O(n log n); spread them out as it grows */
+        if (b.len < 4096 || i % (1 + b.len / 1024) == 0) {
+            fuzz_all(b.data, b.len);
+            checks++;
+        }
+    }
+    printf("stress: %lu edits, %lu full checks, final buffer %zu bytes, %zu lines\n",
+           edits, checks, b.len, sc_count_lines(b.data, b.len));
+    free(b.data);
+    return 0;
+}
+
+/* Commands without dialogs, so a generated script runs unattended */
+static const char *script_menus[] = {
+    "Edit > Undo", "Edit > Redo", "Edit > Comment Lines", "Edit > Uncomment Lines",
+    "Edit > Duplicate Line", "Edit > Delete Line", "Transform > Sort Selected Lines",
+    "Transform > Selection to Uppercase", "Format > Strip Trailing Spaces",
+    "View > Refresh Symbols",
+};
+static const char *script_keys[] = {
+    "Return", "BackSpace", "Delete", "Tab", "Left", "Right", "Up", "Down",
+    "Home", "End", "Page_Up", "Page_Down", "braceleft", "braceright", "semicolon",
+};
+static const char *script_text[] = {
+    "int ", "x", "count", " = 0;", "if (x) ", "// ", "\\n", "\\t", "for", "malloc",
+    "static void f(void) {\\n", "}\\n", "\\303\\251",
+};
+
+/* Random session for `scrible --replay`, to run the GTK side under ASan */
+static int print_script(unsigned long actions, uint64_t seed) {
+    fuzz_rng rng = { seed };
+    unsigned long ms = 0;
+
+    printf("# generated by scrible-fuzz --script %lu --seed %llu\n",
+           actions, (unsigned long long)seed);
+    for (unsigned long i = 0; i < actions; i++) {
+        ms += rng_range(&rng, 30);
+        switch (rng_range(&rng, 10)) {
+        case 0: case 1: case 2: case 3:
+            printf("%lu type %s\n", ms, PICK(&rng, script_text));
+            break;
+        case 4: case 5:
+            printf("%lu key %s 0x%x\n", ms, PICK(&rng, script_keys),
+                   rng_range(&rng, 4) == 0 ? 1u : 0u);   /* sometimes with Shift */
+            break;
+        case 6:
+            printf("%lu menu %s\n", ms, PICK(&rng, script_menus));
+            break;
+        case 7:
+            printf("%lu click %u %u\n", ms, 1 + rng_range(&rng, 200), rng_range(&rng, 80));
+            break;
+        case 8:
+            printf("%lu scroll %d\n", ms, (int)rng_range(&rng, 11) - 5);
+            break;
+        case 9:
+            printf("%lu goto %u\n", ms, 1 + rng_range(&rng, 500));
+            break;
+        }
+    }
+    return 0;
+}
+
+static int run_file(FILE *f, const char *name) {
+    size_t cap = 1 << 16, len = 0, n;
+    char *data = xmalloc(cap);
+
+    while ((n = fread(data + len, 1, cap - len, f)) > 0) {
+        len += n;
+        if (len == cap) {
+            data = realloc(data, cap *= 2);
+            if (!data) abort();
+        }
+    }
+    if (ferror(f)) {
+        fprintf(stderr, "scrible-fuzz: cannot read %s\n", name);
+        free(data);
+        return 1;
+    }
+    LLVMFuzzerTestOneInput((const uint8_t *)data, len);
+    free(data);
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    unsigned long edits = 100000, script = 0;
+    uint64_t seed = FUZZ_SEED;
+    int stress = 0, files = 0, status = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--stress") == 0) {
+            stress = 1;
+        } else if (strcmp(argv[i], "--edits") == 0 && i + 1 < argc) {
+            edits = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = strtoull(argv[++i], NULL, 0);
+            if (seed == 0) seed = FUZZ_SEED;   /* xorshift is stuck at 0 */
+        } else if (strcmp(argv[i], "--script") == 0 && i + 1 < argc) {
+            script = strtoul(argv[++i], NULL, 10);
+        } else if (argv[i][0] == '-' && argv[i][1]) {
+            fprintf(stderr, "usage: %s [--stress] [--edits N] [--seed N] [--script N] [FILE...]\n",
+                    argv[0]);
+            return 2;
+        }
+    }
+
+    if (script) return print_script(script, seed);
+    if (stress) return run_stress(edits, seed);
+
+    for (int i = 1; i < argc; i++) {
+        if (argv[i][0] == '-' && argv[i][1]) {
+            if (strcmp(argv[i], "--edits") == 0 || strcmp(argv[i], "--seed") == 0) i++;
+            continue;
+        }
+        FILE *f = strcmp(argv[i], "-") == 0 ? stdin : fopen(argv[i], "rb");
+        if (!f) {
+            fprintf(stderr, "scrible-fuzz: cannot open %s\n", argv[i]);
+            status = 1;
+            continue;
+        }
+        status |= run_file(f, argv[i]);
+        if (f != stdin) fclose(f);
+        files++;
+    }
+    if (files == 0 && status == 0) status = run_file(stdin, "stdin");
+    return status;
+}
+
+#endif /* SCRIBLE_LIBFUZZER */